@@ -8,6 +8,9 @@
 #include <stdint.h>
 #include <errno.h>
 
+/* Number of segments passed to each writev() call */
+#define CSWP_TCP_MAX_SEGMENTS 16
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <basetsd.h>
@@ -27,8 +30,33 @@ static ssize_t write(int fd, void* vptr, size_t n)
     return send(fd, vptr, n, 0);
 }
 
+struct iovec
+{
+    void* iov_base;
+    size_t iov_len;
+};
+
+static ssize_t writev(int fd, const struct iovec* iov, int count)
+{
+    WSABUF bufs[CSWP_TCP_MAX_SEGMENTS];
+    DWORD sent;
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        bufs[i].buf = iov[i].iov_base;
+        bufs[i].len = (ULONG)iov[i].iov_len;
+    }
+
+    WSASetLastError(0);
+    if (WSASend(fd, bufs, count, &sent, 0, NULL, NULL) != 0)
+        return -1;
+    return sent;
+}
+
 #else // linux
 #include <unistd.h>
+#include <sys/uio.h>
 #endif
 
 #include "common_tcp.h"
@@ -80,9 +108,12 @@ ssize_t cswp_read_msg_tcp(int fd, void* buf, size_t maxSz)
 
     uint32_t msgLen = cswp_common_tcp_get_uint32(buf);
 
-    /* This will be validated during CSWP msg parsing */
-    if (msgLen > maxSz)
-        msgLen = maxSz;
+    /* Reading part of a message would leave the stream out of step */
+    if (msgLen < hdrLen || msgLen > maxSz)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
 
     nread = cswp_readn(fd, (CSWP_MSG_LEN*)buf + 1, msgLen - hdrLen);
     if (nread == -1)
@@ -93,6 +124,60 @@ ssize_t cswp_read_msg_tcp(int fd, void* buf, size_t maxSz)
     return nread + hdrLen;
 }
 
+ssize_t cswp_readv_msg_tcp(int fd, const cswp_tcp_segment_t* seg, int count)
+{
+    size_t hdrLen = sizeof(CSWP_MSG_LEN);
+    size_t capacity = 0;
+    size_t offset = hdrLen;
+    size_t nleft, want;
+    ssize_t nread;
+    int i;
+
+    for (i = 0; i < count; ++i)
+        capacity += seg[i].size;
+
+    if (count < 1 || seg[0].size < hdrLen)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    nread = cswp_readn(fd, seg[0].data, hdrLen);
+    if (nread == -1)
+        return -1;
+    else if (nread != hdrLen)
+        return 0;
+
+    uint32_t msgLen = cswp_common_tcp_get_uint32(seg[0].data);
+
+    /* Reading part of a message would leave the stream out of step */
+    if (msgLen < hdrLen || msgLen > capacity)
+    {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    /* Fill each segment in turn */
+    nleft = msgLen - hdrLen;
+    for (i = 0; nleft > 0; ++i)
+    {
+        want = seg[i].size - offset;
+        if (want > nleft)
+            want = nleft;
+
+        nread = cswp_readn(fd, (char*)seg[i].data + offset, want);
+        if (nread == -1)
+            return -1;
+        else if (nread != want)
+            return 0;
+
+        nleft -= want;
+        offset = 0;
+    }
+
+    return msgLen;
+}
+
 ssize_t cswp_write_msg_tcp(int fd, const void* vptr, size_t n)
 {
     errno = 0;
@@ -116,3 +201,54 @@ ssize_t cswp_write_msg_tcp(int fd, const void* vptr, size_t n)
     return n;
 }
 
+ssize_t cswp_writev_msg_tcp(int fd, const cswp_tcp_segment_t* seg, int count)
+{
+    struct iovec iov[CSWP_TCP_MAX_SEGMENTS];
+    ssize_t total = 0;
+    ssize_t nwritten;
+    int first;
+    int n;
+    int i;
+
+    errno = 0;
+
+    while (count > 0)
+    {
+        n = count < CSWP_TCP_MAX_SEGMENTS ? count : CSWP_TCP_MAX_SEGMENTS;
+        for (i = 0; i < n; ++i)
+        {
+            iov[i].iov_base = seg[i].data;
+            iov[i].iov_len = seg[i].size;
+        }
+
+        first = 0;
+        nwritten = 0;
+        while (1)
+        {
+            /* skip past the segments written, then the written part of the next */
+            while (first < n && (size_t)nwritten >= iov[first].iov_len)
+            {
+                nwritten -= iov[first].iov_len;
+                first++;
+            }
+            if (first == n)
+                break;
+            iov[first].iov_base = (char*)iov[first].iov_base + nwritten;
+            iov[first].iov_len -= nwritten;
+
+            if ((nwritten = writev(fd, &iov[first], n - first)) <= 0)
+            {
+                if (nwritten < 0 && errno == EINTR)
+                    nwritten = 0;   /* and call writev() again */
+                else
+                    return -1;    /* error */
+            }
+            total += nwritten;
+        }
+
+        seg += n;
+        count -= n;
+    }
+    return total;
+}
+
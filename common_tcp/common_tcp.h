@@ -13,10 +13,22 @@ extern "C"
 
 #include <stdlib.h>
 
+/* Part of a message read or written by cswp_readv_msg_tcp/cswp_writev_msg_tcp */
+typedef struct
+{
+    void* data;
+    size_t size;
+} cswp_tcp_segment_t;
+
 /* These functions assume buf to be a 32-bit aligned buffer */
 /* They return -1 on error and set errno. Otherwise, return num bytes r/w */
+/* cswp_read_msg_tcp fails with EMSGSIZE if the message does not fit in n bytes */
 ssize_t cswp_read_msg_tcp(int fd, void* vptr, size_t n);
 ssize_t cswp_write_msg_tcp(int fd, const void* vptr, size_t sz);
+/* cswp_writev_msg_tcp writes count segments back to back without copying them */
+ssize_t cswp_writev_msg_tcp(int fd, const cswp_tcp_segment_t* seg, int count);
+/* cswp_readv_msg_tcp reads a message into the segments in order, the first must hold the length */
+ssize_t cswp_readv_msg_tcp(int fd, const cswp_tcp_segment_t* seg, int count);
 
 #ifdef __cplusplus
 }
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <limits.h>
+#include <errno.h>
 
 #include "greatest.h"
 #include "fff.h"
@@ -28,8 +29,11 @@ FAKE_VOID_FUNC(WSASetLastError, int);
 #define RWRET int
 #else // linux
 
+#include <sys/uio.h>
+
 FAKE_VALUE_FUNC(ssize_t, read, int, void*, size_t);
 FAKE_VALUE_FUNC(ssize_t, write, int, const void*, size_t);
+FAKE_VALUE_FUNC(ssize_t, writev, int, const struct iovec*, int);
 
 #define RWRET ssize_t
 
@@ -40,9 +44,16 @@ FAKE_VALUE_FUNC(ssize_t, write, int, const void*, size_t);
 #define SETUP_N_RUN(x) setup();RUN_TEST(x);
 
 /* List of fakes used by this unit tester */
+#ifdef _WIN32
 #define FFF_FAKES_LIST(FAKE)            \
   FAKE(read)       \
   FAKE(write)
+#else
+#define FFF_FAKES_LIST(FAKE)            \
+  FAKE(read)       \
+  FAKE(write)      \
+  FAKE(writev)
+#endif
 
 
 void setup()
@@ -133,6 +144,46 @@ TEST test_cswp_write_msg_tcp__no_write(void)
 }
 
 
+#ifndef _WIN32
+TEST test_cswp_writev_msg_tcp(void)
+{
+    char a[8];
+    char b[12];
+    cswp_tcp_segment_t seg[] = { { a, sizeof(a) }, { b, 0 }, { b, sizeof(b) } };
+
+    writev_fake.return_val = 20;
+    ASSERT_EQ(cswp_writev_msg_tcp(FAKE_FD, seg, 3), 20);
+    ASSERT_EQ(writev_fake.call_count, 1);
+    ASSERT_EQ(writev_fake.arg2_val, 3);
+
+    /* Partial writes resume from the first unwritten byte */
+    RESET_FAKE(writev);
+    RWRET returnSeq[] = {5, 10, 5};
+    SET_RETURN_SEQ(writev, returnSeq, 3);
+
+    ASSERT_EQ(cswp_writev_msg_tcp(FAKE_FD, seg, 3), 20);
+    ASSERT_EQ(writev_fake.call_count, 3);
+    ASSERT_EQ(writev_fake.arg2_history[1], 3);
+    ASSERT_EQ(writev_fake.arg2_history[2], 1);
+    PASS();
+}
+
+
+TEST test_cswp_writev_msg_tcp__no_write(void)
+{
+    char a[8];
+    cswp_tcp_segment_t seg[] = { { a, sizeof(a) } };
+
+    writev_fake.return_val = -1;
+
+    ASSERT_EQ(cswp_writev_msg_tcp(FAKE_FD, seg, 1), -1);
+    ASSERT_EQ(writev_fake.call_count, 1);
+
+    PASS();
+}
+#endif
+
+
 TEST test_cswp_read_msg_tcp(void)
 {
     uint32_t msgLen = sizeof(uint32_t) * 2;
@@ -157,10 +208,50 @@ TEST test_cswp_read_msg_tcp__edge_cases(void)
     read_fake.return_val = 0;
     ASSERT_EQ(cswp_read_msg_tcp(FAKE_FD, fakeMsgBuf, SIZE_MAX), 0);
 
-    read_fake.return_val = 1;
+    /* Oversized message is rejected without reading any of the body */
+    read_fake.return_val = sizeof(msgLen);
+    read_fake.call_count = 0;
     msgLen = UINT32_MAX;
 
-    ASSERT_EQ(cswp_read_msg_tcp(FAKE_FD, fakeMsgBuf, UINT16_MAX), UINT16_MAX);
+    ASSERT_EQ(cswp_read_msg_tcp(FAKE_FD, fakeMsgBuf, UINT16_MAX), -1);
+    ASSERT_EQ(errno, EMSGSIZE);
+    ASSERT_EQ(read_fake.call_count, 1);
+
+    PASS();
+}
+
+
+TEST test_cswp_readv_msg_tcp(void)
+{
+    uint32_t msgLen = 16;
+    uint32_t body[4];
+    cswp_tcp_segment_t seg[] = { { &msgLen, sizeof(msgLen) }, { body, 8 }, { body + 2, 8 } };
+    read_fake.return_val = sizeof(msgLen);
+
+    /* Header, then each segment filled in turn */
+    ASSERT_EQ(cswp_readv_msg_tcp(FAKE_FD, seg, 3), 16);
+    ASSERT_EQ(read_fake.call_count, 4);
+
+    PASS();
+}
+
+
+TEST test_cswp_readv_msg_tcp__edge_cases(void)
+{
+    uint32_t msgLen = 64;
+    uint32_t body[4];
+    cswp_tcp_segment_t seg[] = { { &msgLen, sizeof(msgLen) }, { body, sizeof(body) } };
+    read_fake.return_val = sizeof(msgLen);
+
+    /* Message larger than all segments is rejected without reading the body */
+    ASSERT_EQ(cswp_readv_msg_tcp(FAKE_FD, seg, 2), -1);
+    ASSERT_EQ(errno, EMSGSIZE);
+    ASSERT_EQ(read_fake.call_count, 1);
+
+    /* First segment must hold the length */
+    seg[0].size = 2;
+    ASSERT_EQ(cswp_readv_msg_tcp(FAKE_FD, seg, 2), -1);
+    ASSERT_EQ(errno, EINVAL);
 
     PASS();
 }
@@ -171,9 +262,15 @@ SUITE(s) {
     SETUP_N_RUN(test_cswp_readn__no_read);
     SETUP_N_RUN(test_cswp_write_msg_tcp);
     SETUP_N_RUN(test_cswp_write_msg_tcp__no_write);
+#ifndef _WIN32
+    SETUP_N_RUN(test_cswp_writev_msg_tcp);
+    SETUP_N_RUN(test_cswp_writev_msg_tcp__no_write);
+#endif
 
     SETUP_N_RUN(test_cswp_read_msg_tcp);
     SETUP_N_RUN(test_cswp_read_msg_tcp__edge_cases);
+    SETUP_N_RUN(test_cswp_readv_msg_tcp);
+    SETUP_N_RUN(test_cswp_readv_msg_tcp__edge_cases);
 }
 
 
@@ -6,14 +6,91 @@
 #include "cswp_client.h"
 #include "cswp_client_commands.h"
 #include "cswp_buffer.h"
+#include "cswp_checksum.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
-
-#define BUFFER_SIZE 32768
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION session_lock_t;
+typedef CONDITION_VARIABLE session_cond_t;
+#define session_lock_init(l)      InitializeCriticalSection(l)
+#define session_lock_destroy(l)   DeleteCriticalSection(l)
+#define session_lock(l)           EnterCriticalSection(l)
+#define session_unlock(l)         LeaveCriticalSection(l)
+#define session_cond_init(c)      InitializeConditionVariable(c)
+#define session_cond_destroy(c)
+#define session_cond_wait(c, l)   SleepConditionVariableCS(c, l, INFINITE)
+#define session_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t session_lock_t;
+typedef pthread_cond_t session_cond_t;
+#define session_lock_init(l)      pthread_mutex_init(l, NULL)
+#define session_lock_destroy(l)   pthread_mutex_destroy(l)
+#define session_lock(l)           pthread_mutex_lock(l)
+#define session_unlock(l)         pthread_mutex_unlock(l)
+#define session_cond_init(c)      pthread_cond_init(c, NULL)
+#define session_cond_destroy(c)   pthread_cond_destroy(c)
+#define session_cond_wait(c, l)   pthread_cond_wait(c, l)
+#define session_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+#define BUFFER_SIZE CSWP_DEFAULT_MESSAGE_SIZE
 #define ERROR_MESSAGE_SIZE 1024
 
+/* Space for a command header and its fixed size fields */
+#define CSWP_CMD_RESERVE 64
+/* Largest encoding of a varint */
+#define CSWP_VARINT_MAX 10
+
+/* Memory writes of at least this size are sent from the caller's buffer
+ * when the transport supports sendv */
+#define SENDV_MIN_SIZE 4096
+/* Memory reads of at least this size are received into the caller's buffer
+ * when the transport supports receivev */
+#define RECEIVEV_MIN_SIZE 4096
+/* Largest response message before the data of a single read */
+#define RX_PREFIX_MAX (4 + 1 + 3 * CSWP_VARINT_MAX)
+
+/* Memory transfers too large for one message are split into chunks that are
+ * a multiple of the largest access size, with up to this many outstanding */
+#define MEM_CHUNK_ALIGN 8
+#define MEM_CHUNK_DEPTH 8
+
+/* Link estimates: round trip time is measured from exchanges of less than
+ * LINK_SMALL_BYTES and transfer rate from those of at least LINK_LARGE_BYTES,
+ * each measurement moving the estimate 1/LINK_SMOOTHING of the way */
+#define LINK_SMALL_BYTES 1024
+#define LINK_LARGE_BYTES (16 * 1024)
+#define LINK_SMOOTHING 8
+/* Memory transfer chunks take about this long at the measured rate, so other
+ * requests on the connection are not held up for long */
+#define LINK_CHUNK_TIME_US 10000
+#define LINK_CHUNK_MIN (16 * 1024)
+/* Smallest write-behind batch sized from the link estimates */
+#define LINK_BATCH_MIN 4096
+
+/* Bytes of a CSWP_MEM_READ_MULTI or CSWP_MEM_WRITE_MULTI request for each
+ * segment descriptor, and of the response for each segment status */
+#define MEM_MULTI_SEGMENT_BYTES (8 + CSWP_VARINT_MAX)
+#define MEM_MULTI_STATUS_BYTES 3
+/* Bytes of a CSWP_MEM_CHECKSUM response for each digest */
+#define MEM_CHECKSUM_DIGEST_BYTES 8
+/* Digests sent with CSWP_MEM_READ_DELTA */
+#define MEM_DELTA_CHECKSUM CSWP_CHECKSUM_FNV1A64
+/* Bytes of a CSWP_MEM_SEARCH response for each match */
+#define MEM_SEARCH_HIT_BYTES 8
+
+/* Largest server ID kept for register list cache keys */
+#define SERVER_ID_SIZE 256
+/* Register list cache files start with this, then the key and the encoded
+ * CSWP_REG_LIST response body */
+#define REG_LIST_FILE_MAGIC "CSWPRL1"
+
 /* Header is:
  * uint32 size
  * varint command count (allow 10 bytes)
@@ -36,10 +113,19 @@
 
 typedef int (*complete_func)(cswp_client_t* client, void* replyData);
 
+/* Space for the largest reply_data_* record */
+#define REPLY_DATA_SIZE (8 * sizeof(void*))
+
+/* Initial number of pending responses, doubled as batches grow */
+#define PENDING_INITIAL 16
+
 /**
  * Data required to process a response
+ *
+ * Pending responses are held in order in an array owned by the client and
+ * reused for each request, so queueing a command does not allocate
  */
-typedef struct _pending_response_t
+typedef struct
 {
     /** Expected response message type */
     cswp_commands_t type;
@@ -48,13 +134,126 @@ typedef struct _pending_response_t
     complete_func complete;
 
     /** Argument to pass to completion response */
-    void* replyData;
-
-    /** Pointer to next response */
-    struct _pending_response_t* next;
+    union
+    {
+        uint8_t data[REPLY_DATA_SIZE];
+        void* align;
+        uint64_t align64;
+    } replyData;
 } pending_response_t;
 
 
+/* Width of a register ID in a template, so it can be patched in place */
+#define TEMPLATE_REG_ID_SIZE 5
+
+/**
+ * Operand that can be patched in a template
+ */
+typedef struct
+{
+    /** Operation in the template */
+    unsigned op;
+    /** Operand type */
+    cswp_template_operand_t operand;
+    /** Element within the operation, e.g. register number */
+    unsigned index;
+    /** Offset of the operand in the encoded request */
+    size_t offset;
+    /** Size of the operand */
+    size_t size;
+} template_slot_t;
+
+/**
+ * Pre-encoded batch recorded by cswp_template_begin() / cswp_template_end()
+ */
+struct _cswp_batch_template_t
+{
+    /** Encoded request, including message header */
+    uint8_t* request;
+    /** Size of encoded request */
+    uint32_t size;
+
+    /** Expected response sequence */
+    pending_response_t* pending_responses;
+    /** Number of commands in request */
+    int num_cmds;
+
+    /** Patchable operands */
+    template_slot_t* slots;
+    /** Number of entries in slots */
+    unsigned num_slots;
+};
+
+/*
+ * Limit on request bytes outstanding from cswp_batch_submit().  This keeps
+ * requests within typical socket buffering so the server cannot be blocked
+ * sending a response while the client is blocked sending a request.
+ */
+#define ASYNC_MAX_BYTES (256 * 1024)
+
+/**
+ * State of a submitted batch
+ */
+typedef enum
+{
+    ASYNC_FREE,
+    ASYNC_IN_FLIGHT,
+    ASYNC_COMPLETE
+} async_state_t;
+
+/**
+ * Batch sent by cswp_batch_submit()
+ *
+ * The pending responses array is exchanged with the client's when a batch is
+ * submitted, so the arrays are recycled between batches
+ */
+typedef struct
+{
+    /** Batch state */
+    async_state_t state;
+    /** Handle returned to caller */
+    cswp_batch_handle_t handle;
+    /** Client that submitted the batch */
+    cswp_client_t* owner;
+    /** Number of leading commands that are queued writes */
+    int deferred;
+
+    /** Expected response sequence, num_cmds entries are used */
+    pending_response_t* responses;
+    /** Number of commands in batch */
+    int num_cmds;
+    /** Array recycled for client batches */
+    pending_response_t* pending_responses;
+    /** Number of entries allocated in pending_responses */
+    unsigned pending_capacity;
+    /** Size of request message */
+    uint32_t reqSize;
+
+    /** Destination for the data of a batch holding a single read, or NULL */
+    uint8_t* rx_data;
+    /** Number of bytes expected at rx_data */
+    size_t rx_size;
+    /** Response message up to the read data if the read succeeds */
+    uint8_t rx_prefix[RX_PREFIX_MAX];
+    /** Number of bytes in rx_prefix */
+    size_t rx_prefix_size;
+
+    /** Time the request was sent, in us */
+    uint64_t sent;
+    /** Set if no other batch was in flight when sent */
+    int idle;
+
+    /** Completion callback */
+    cswp_batch_callback_t callback;
+    /** Argument to completion callback */
+    void* userData;
+
+    /** Batch result once complete */
+    int result;
+    /** Number of operations completed */
+    unsigned opsCompleted;
+} async_batch_t;
+
 /**
  * Batch mode and whether to continue / abort on error
  */
@@ -66,62 +265,207 @@ typedef enum
 } batch_mode_t;
 
 /**
- * Private data for CSWP client
+ * Connection shared by one or more clients
+ *
+ * Each client builds requests in its own buffers.  Requests from all clients
+ * are sent in turn and the responses are received by whichever client is
+ * waiting for one, so the lock is not held while waiting for the server.
  */
-typedef struct _cswp_client_priv_t
+typedef struct
 {
     /** Transport interface */
     cswp_client_transport_t* transport;
 
+    /** Response buffer, used by the receiving client */
+    CSWP_BUFFER* rsp;
+
+    /** Maximum message size negotiated with the server */
+    size_t messageSize;
+
+    /** Client that opened the session */
+    cswp_client_t* client;
+    /** Number of clients using the session */
+    unsigned refCount;
+
+    /** Protects the fields below and sending on the transport */
+    session_lock_t lock;
+    /** Signalled when a response has been processed */
+    session_cond_t responded;
+    /** Set while a client is receiving a response */
+    int receiving;
+
+    /** Ring of submitted batches, async_used entries from async_head */
+    async_batch_t* async;
+    /** Number of entries allocated in async */
+    unsigned async_capacity;
+    /** Maximum number of batches in flight */
+    unsigned async_window;
+    /** Oldest submitted batch */
+    unsigned async_head;
+    /** Number of submitted batches not yet released */
+    unsigned async_used;
+    /** Number of batches awaiting a response */
+    unsigned async_in_flight;
+    /** Request bytes awaiting a response */
+    size_t async_bytes;
+    /** Last handle issued */
+    cswp_batch_handle_t async_handle;
+
+    /** Read data of the response being processed, if it was received
+     *  straight into the caller's buffer */
+    uint8_t* rx_direct;
+    /** Number of bytes at rx_direct */
+    size_t rx_direct_size;
+
+    /** Smoothed round trip time in us, 0 until measured */
+    uint64_t link_rtt;
+    /** Smoothed transfer rate in bytes per second, 0 until measured */
+    uint64_t link_rate;
+    /** Number of round trip time measurements */
+    unsigned link_rtt_samples;
+    /** Number of transfer rate measurements */
+    unsigned link_rate_samples;
+    /** Time the last response was received, in us */
+    uint64_t link_last_rx;
+
+    /** Server ID from CSWP_INIT */
+    char server_id[SERVER_ID_SIZE];
+    /** Server version from CSWP_INIT */
+    unsigned server_version;
+} cswp_client_session_t;
+
+/**
+ * Register list stored in one allocation: this header, the entries, the
+ * name index and the strings
+ */
+struct _cswp_reg_list_t
+{
+    /** Number of registers */
+    unsigned count;
+    /** Registers in server order */
+    cswp_register_info_t* entries;
+    /** Open addressed name hash: entry index + 1, or 0 for an empty slot */
+    uint32_t* index;
+    /** Number of slots in index, a power of 2 */
+    unsigned indexSize;
+};
+
+/**
+ * Private data for CSWP client
+ */
+typedef struct _cswp_client_priv_t
+{
+    /** Connection used by this client */
+    cswp_client_session_t* session;
+
     /** Header buffers */
     CSWP_BUFFER* hdr;
     /** Request buffer */
     CSWP_BUFFER* cmd;
-    /** Response buffer */
-    CSWP_BUFFER* rsp;
+    /** Caller data sent after the request buffer, NULL if none */
+    const uint8_t* ext_data;
+    /** Number of bytes at ext_data */
+    size_t ext_size;
+    /** Caller buffer for the data of a leading read, NULL if none */
+    uint8_t* rx_data;
+    /** Number of bytes to read into rx_data */
+    size_t rx_size;
+    /** Command type of the leading read */
+    cswp_commands_t rx_type;
+    /** Set while sending a chunk of a large memory transfer */
+    int chunking;
 
     /** Batch mode */
     batch_mode_t batch_mode;
     /** Number of command in batch request */
     int num_cmds;
 
-    /** Expected response sequence */
+    /** Expected response sequence, num_cmds entries are used */
     pending_response_t* pending_responses;
+    /** Number of entries allocated in pending_responses */
+    unsigned pending_capacity;
+
+    /** Set while recording a template */
+    int recording;
+    /** Operands recorded for the template */
+    template_slot_t* slots;
+    /** Number of slots recorded */
+    unsigned num_slots;
+    /** Number of entries allocated in slots */
+    unsigned slot_capacity;
+
+    /** Number of writes to queue before sending, 0 if write-behind is off */
+    unsigned wb_max_ops;
+    /** Request size at which queued writes are sent */
+    size_t wb_max_bytes;
+    /** Time in ms that writes may be queued for, 0 for no limit */
+    unsigned wb_delay;
+    /** Number of writes queued at the start of the request */
+    int wb_queued;
+    /** Request buffer used by queued writes */
+    size_t wb_used;
+    /** Time by which queued writes are sent */
+    uint64_t wb_deadline;
+    /** First error from queued writes, for the next synchronous call */
+    int wb_error;
+
+    /** Register list of each device, NULL until fetched */
+    cswp_reg_list_t** reg_lists;
+    /** Number of entries in reg_lists */
+    unsigned num_reg_lists;
+    /** Device types given to cswp_set_devices() */
+    char** device_types;
+    /** Number of entries in device_types */
+    unsigned num_device_types;
+    /** Directory register lists are kept in, NULL if none */
+    char* reg_list_cache;
+
+    /**
+     * Protects errorMsg, wb_error and the register lists and cache settings,
+     * which are also used when another client on the session completes this
+     * client's batches
+     */
+    session_lock_t state_lock;
 } cswp_client_priv_t;
 
 
 /*
  * Add an expected response
+ *
+ * Returns the zeroed reply data record of replySize bytes (at most
+ * REPLY_DATA_SIZE) to be filled in for the completion function.  The record
+ * is only valid until the next request is added.
  */
-static void cswp_client_push_request(cswp_client_t* client,
-                                     cswp_commands_t type,
-                                     complete_func complete,
-                                     void* replyData)
+static void* cswp_client_push_request(cswp_client_t* client,
+                                      cswp_commands_t type,
+                                      complete_func complete,
+                                      size_t replySize)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    pending_response_t** pPending;
     pending_response_t* pending_response;
 
-    // go to end of list
-    pPending = &priv->pending_responses;
-    while (*pPending != NULL)
-        pPending = &((*pPending)->next);
+    if (priv->num_cmds == priv->pending_capacity)
+    {
+        unsigned capacity = priv->pending_capacity ? priv->pending_capacity * 2 : PENDING_INITIAL;
+        pending_response_t* pending = realloc(priv->pending_responses, capacity * sizeof(pending_response_t));
+        if (pending == NULL)
+            return NULL;
+        priv->pending_responses = pending;
+        priv->pending_capacity = capacity;
+    }
 
-    // add to end of list
-    pending_response = (pending_response_t*)calloc(sizeof(pending_response_t), 1);
+    pending_response = &priv->pending_responses[priv->num_cmds++];
     pending_response->type = type;
     pending_response->complete = complete;
-    pending_response->replyData = replyData;
-    *pPending = pending_response;
+    memset(pending_response->replyData.data, 0, replySize);
 
-    ++priv->num_cmds;
+    return pending_response->replyData.data;
 }
 
 /*
- * Initialise client
+ * Allocate per-client state
  */
-int cswp_client_init(cswp_client_t* client,
-                     cswp_client_transport_t* transport)
+static cswp_client_priv_t* cswp_client_alloc(cswp_client_t* client)
 {
     cswp_client_priv_t* priv;
 
@@ -130,58 +474,344 @@ int cswp_client_init(cswp_client_t* client,
 
     /* Allocate and initialise private data */
     priv = calloc(sizeof(cswp_client_priv_t), 1);
-    priv->transport = transport;
     priv->hdr = cswp_buffer_alloc(CSWP_REQ_HEADER_SIZE);
     priv->cmd = cswp_buffer_alloc(BUFFER_SIZE);
-    priv->rsp = cswp_buffer_alloc(BUFFER_SIZE);
     priv->batch_mode = BATCH_NONE;
+    session_lock_init(&priv->state_lock);
     client->priv = priv;
 
+    return priv;
+}
+
+/*
+ * Initialise client
+ */
+int cswp_client_init(cswp_client_t* client,
+                     cswp_client_transport_t* transport)
+{
+    cswp_client_priv_t* priv = cswp_client_alloc(client);
+    cswp_client_session_t* session;
+
+    session = calloc(sizeof(cswp_client_session_t), 1);
+    session->transport = transport;
+    session->rsp = cswp_buffer_alloc(BUFFER_SIZE);
+    session->messageSize = CSWP_DEFAULT_MESSAGE_SIZE;
+    session->client = client;
+    session->refCount = 1;
+    session_lock_init(&session->lock);
+    session_cond_init(&session->responded);
+    session->async_window = CSWP_DEFAULT_BATCH_WINDOW;
+    priv->session = session;
+
     return CSWP_SUCCESS;
 }
 
 
+int cswp_client_init_shared(cswp_client_t* client,
+                            cswp_client_t* shared)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)shared->priv)->session;
+    cswp_client_priv_t* priv = cswp_client_alloc(client);
+
+    session_lock(&session->lock);
+    session->refCount++;
+    session_unlock(&session->lock);
+    priv->session = session;
+
+    return CSWP_SUCCESS;
+}
+
+
+/*
+ * Release the session once the last client has finished with it
+ */
+static void cswp_client_free_session(cswp_client_session_t* session)
+{
+    unsigned i;
+
+    cswp_buffer_free(session->rsp);
+    if (session->async)
+    {
+        for (i = 0; i < session->async_capacity; ++i)
+            free(session->async[i].pending_responses);
+        free(session->async);
+    }
+    session_cond_destroy(&session->responded);
+    session_lock_destroy(&session->lock);
+    free(session);
+}
+
+
+/*
+ * Free the register lists fetched for devices
+ */
+static void cswp_client_clear_reg_lists(cswp_client_priv_t* priv)
+{
+    unsigned i;
+
+    session_lock(&priv->state_lock);
+    for (i = 0; i < priv->num_reg_lists; ++i)
+        free(priv->reg_lists[i]);
+    free(priv->reg_lists);
+    priv->reg_lists = NULL;
+    priv->num_reg_lists = 0;
+    session_unlock(&priv->state_lock);
+}
+
+/*
+ * Free the device types recorded from cswp_set_devices()
+ */
+static void cswp_client_clear_device_types(cswp_client_priv_t* priv)
+{
+    unsigned i;
+
+    for (i = 0; i < priv->num_device_types; ++i)
+        free(priv->device_types[i]);
+    free(priv->device_types);
+    priv->device_types = NULL;
+    priv->num_device_types = 0;
+}
+
 int cswp_client_term(cswp_client_t* client)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-
-    /* Cleanup error message */
-    free(client->errorMsg);
-    client->errorMsg = NULL;
+    cswp_client_session_t* session;
+    unsigned refCount;
 
     /* Cleanup private data */
     if (priv)
     {
+        session = priv->session;
+
+        /* The session must not refer to this client after it is gone */
+        cswp_batch_flush(client);
+        session_lock(&session->lock);
+        refCount = --session->refCount;
+        if (session->client == client)
+            session->client = NULL;
+        session_unlock(&session->lock);
+        if (refCount == 0)
+            cswp_client_free_session(session);
+
         cswp_buffer_free(priv->hdr);
         cswp_buffer_free(priv->cmd);
-        cswp_buffer_free(priv->rsp);
+        free(priv->pending_responses);
+        free(priv->slots);
+        cswp_client_clear_reg_lists(priv);
+        cswp_client_clear_device_types(priv);
+        free(priv->reg_list_cache);
+        session_lock_destroy(&priv->state_lock);
 
         free(client->priv);
         client->priv = NULL;
     }
 
+    /* Cleanup error message */
+    free(client->errorMsg);
+    client->errorMsg = NULL;
+
     return CSWP_SUCCESS;
 }
 
 /*
  * Prepare the request buffer to write command data
  */
+static int cswp_client_reserve_cmd(cswp_client_t* client, size_t size);
+
 static int cswp_client_prepare_cmd(cswp_client_t* client)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res = CSWP_SUCCESS;
 
     if (priv->batch_mode == BATCH_NONE)
+    {
+        priv->ext_data = NULL;
+        priv->ext_size = 0;
+        priv->rx_data = NULL;
+    }
+
+    if (priv->batch_mode == BATCH_NONE && priv->wb_queued > 0)
+    {
+        /* keep queued writes, dropping any partly encoded command */
+        priv->cmd->pos = priv->wb_used;
+        priv->cmd->used = priv->wb_used;
+        priv->num_cmds = priv->wb_queued;
+
+        /* commands that don't reserve space need room after the writes */
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE);
+    }
+    else if (priv->batch_mode == BATCH_NONE)
     {
         /* reset buffer, reserving space for message header */
         priv->cmd->pos = CSWP_REQ_HEADER_SIZE;
         priv->cmd->used = CSWP_REQ_HEADER_SIZE;
-        priv->pending_responses = NULL;
         priv->num_cmds = 0;
     }
 
+    return res;
+}
+
+static int cswp_client_send_writes(cswp_client_t* client);
+
+
+/*
+ * Grow the request buffer to make space for another size bytes
+ *
+ * The buffer does not grow beyond the negotiated message size, so
+ * encoding may still fail with CSWP_BUFFER_FULL
+ */
+static int cswp_client_reserve_cmd(cswp_client_t* client, size_t size)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    CSWP_BUFFER* newBuf;
+    size_t newSize;
+
+    if (priv->cmd->size - priv->cmd->used >= size)
+        return CSWP_SUCCESS;
+
+    /* Send queued writes rather than exceed the message size */
+    if (priv->batch_mode == BATCH_NONE && priv->wb_queued > 0 &&
+        priv->cmd->used + size > priv->session->messageSize)
+    {
+        cswp_client_send_writes(client);
+        cswp_client_prepare_cmd(client);
+        if (priv->cmd->size - priv->cmd->used >= size)
+            return CSWP_SUCCESS;
+    }
+
+    newSize = priv->cmd->size;
+    while (newSize < priv->cmd->used + size)
+        newSize *= 2;
+    if (newSize > priv->session->messageSize)
+        newSize = priv->session->messageSize;
+    if (newSize <= priv->cmd->size)
+        return CSWP_SUCCESS;
+
+    newBuf = cswp_buffer_realloc(priv->cmd, newSize);
+    if (newBuf == NULL)
+        return cswp_client_error(client, CSWP_BUFFER_FULL, "Failed to allocate %lu byte request buffer",
+                                 (unsigned long)newSize);
+    priv->cmd = newBuf;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Number of bytes used to encode a varint
+ */
+static size_t cswp_varint_size(varint_t val)
+{
+    size_t size = 1;
+
+    for (; val > 0x7F; val >>= 7)
+        ++size;
+
+    return size;
+}
+
+/*
+ * Encode a varint at p, returning the number of bytes used
+ */
+static size_t cswp_client_put_varint(uint8_t* p, varint_t val)
+{
+    size_t size = 0;
+
+    while (val > 0x7F)
+    {
+        p[size++] = 0x80 | (val & 0x7F);
+        val >>= 7;
+    }
+    p[size++] = val & 0x7F;
+
+    return size;
+}
+
+/*
+ * Record the position of an operand when recording a template
+ */
+static int cswp_client_add_slot(cswp_client_t* client,
+                                cswp_template_operand_t operand,
+                                unsigned index,
+                                size_t offset,
+                                size_t size)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    template_slot_t* slot;
+
+    if (!priv->recording)
+        return CSWP_SUCCESS;
+
+    if (priv->num_slots == priv->slot_capacity)
+    {
+        unsigned capacity = priv->slot_capacity ? priv->slot_capacity * 2 : PENDING_INITIAL;
+        template_slot_t* slots = realloc(priv->slots, capacity * sizeof(template_slot_t));
+        if (slots == NULL)
+            return cswp_client_error(client, CSWP_FAILED, "Failed to allocate template operands");
+        priv->slots = slots;
+        priv->slot_capacity = capacity;
+    }
+
+    slot = &priv->slots[priv->num_slots++];
+    slot->op = priv->num_cmds;
+    slot->operand = operand;
+    slot->index = index;
+    slot->offset = offset;
+    slot->size = size;
+
     return CSWP_SUCCESS;
 }
 
+/*
+ * Encode a register ID as a varint padded to TEMPLATE_REG_ID_SIZE bytes
+ */
+static void cswp_client_encode_reg_id(uint8_t* p, unsigned registerID)
+{
+    int i;
+
+    for (i = 0; i < TEMPLATE_REG_ID_SIZE - 1; ++i)
+    {
+        p[i] = 0x80 | (registerID & 0x7F);
+        registerID >>= 7;
+    }
+    p[i] = registerID & 0x7F;
+}
+
+/*
+ * Add a register ID to the request
+ *
+ * Templates use a fixed width encoding so the ID can be patched in place
+ */
+static int cswp_client_put_reg_id(cswp_client_t* client, unsigned index, unsigned registerID)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    void* p;
+    int res;
+
+    if (!priv->recording)
+        return cswp_buffer_put_varint(priv->cmd, registerID);
+
+    res = cswp_client_add_slot(client, CSWP_TEMPLATE_REG_ID, index, priv->cmd->used, TEMPLATE_REG_ID_SIZE);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_put_direct(priv->cmd, &p, TEMPLATE_REG_ID_SIZE);
+    if (res == CSWP_SUCCESS)
+        cswp_client_encode_reg_id(p, registerID);
+
+    return res;
+}
+
+/*
+ * Record the address of a memory command, encoded after the command type
+ * and device number
+ */
+static int cswp_client_add_address_slot(cswp_client_t* client,
+                                        size_t start,
+                                        cswp_commands_t type,
+                                        unsigned deviceNo)
+{
+    return cswp_client_add_slot(client, CSWP_TEMPLATE_ADDRESS, 0,
+                                start + cswp_varint_size(type) + cswp_varint_size(deviceNo),
+                                sizeof(uint64_t));
+}
 
 /*
  * Process a server response
@@ -194,7 +824,7 @@ static int cswp_client_process_response(cswp_client_t* client,
     int res;
 
     /* Examine the header */
-    res = cswp_decode_response_header(priv->rsp, &msgType, &errCode);
+    res = cswp_decode_response_header(priv->session->rsp, &msgType, &errCode);
     /* Check the message type is as expected */
     if (res == CSWP_SUCCESS && msgType != pendingRsp->type)
     {
@@ -204,31 +834,30 @@ static int cswp_client_process_response(cswp_client_t* client,
     if (res == CSWP_SUCCESS && errCode != CSWP_SUCCESS)
     {
         res = errCode;
-        cswp_decode_error_response_body(priv->rsp, client->errorMsg, ERROR_MESSAGE_SIZE);
+        session_lock(&priv->state_lock);
+        cswp_decode_error_response_body(priv->session->rsp, client->errorMsg, ERROR_MESSAGE_SIZE);
+        session_unlock(&priv->state_lock);
     }
     if (res == CSWP_SUCCESS)
     {
         /* Call any message specific response handler */
         if (pendingRsp->complete)
-            res = pendingRsp->complete(client, pendingRsp->replyData);
+            res = pendingRsp->complete(client, pendingRsp->replyData.data);
     }
 
     return res;
 }
 
 /*
- * Send request and receive response
+ * Insert the message header before the commands in the request buffer
  */
-static int cswp_client_transact(cswp_client_t* client, unsigned* opsCompleted)
+static void cswp_client_encode_header(cswp_client_t* client, uint8_t** data, uint32_t* size)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res;
-    uint32_t reqSize, rspSize;
+    uint32_t reqSize;
     size_t reqOffset;
-    varint_t numRsps;
     uint8_t* pBuf;
     uint8_t *pHdr;
-    pending_response_t* pendingRsp;
 
     /* encode message header */
     cswp_buffer_clear(priv->hdr);
@@ -238,7 +867,7 @@ static int cswp_client_transact(cswp_client_t* client, unsigned* opsCompleted)
     /* Insert header before message body */
     /*   Calculate position where header will start */
     reqOffset = CSWP_REQ_HEADER_SIZE - 4 - priv->hdr->used;
-    reqSize = priv->cmd->used - reqOffset;
+    reqSize = priv->cmd->used + priv->ext_size - reqOffset;
     pBuf = priv->cmd->buf + reqOffset;
     pHdr = pBuf;
     /*   Inject message length */
@@ -249,212 +878,1190 @@ static int cswp_client_transact(cswp_client_t* client, unsigned* opsCompleted)
     /*    Copy header */
     memcpy(pHdr, priv->hdr->buf, priv->hdr->used);
 
-    if (opsCompleted)
-        *opsCompleted = 0;
+    *data = pBuf;
+    *size = reqSize;
+}
 
-    /* Send to server */
-    res = priv->transport->send(client, priv->transport, pBuf, reqSize);
+/*
+ * Keep the first error from queued writes for the next synchronous call
+ */
+static void cswp_client_keep_write_error(cswp_client_t* client, int res)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
 
-    /* Get response */
-    if (res == CSWP_SUCCESS)
-        res = priv->transport->receive(client, priv->transport, priv->rsp->buf, priv->rsp->size, &priv->rsp->used);
+    session_lock(&priv->state_lock);
+    if (priv->wb_error == CSWP_SUCCESS)
+        priv->wb_error = res;
+    session_unlock(&priv->state_lock);
+}
 
-    if (res == CSWP_SUCCESS)
-    {
-        /* Decode header */
-        cswp_buffer_seek(priv->rsp, 0);
-        cswp_buffer_get_uint32(priv->rsp, &rspSize);
-        /* check reply length matches data received */
-        if (rspSize > priv->rsp->used)
-            res = cswp_client_error(client, CSWP_COMMS, "Incomplete response received.  Received %d bytes, expected %d",
-                                    priv->rsp->used, rspSize);
-    }
+/*
+ * Process a received response against the expected responses
+ *
+ * The first deferred responses are for queued writes, whose errors are kept
+ * for the next synchronous call
+ */
+static int cswp_client_process_responses(cswp_client_t* client,
+                                         pending_response_t* pendingRsps,
+                                         int numCmds,
+                                         int deferred,
+                                         unsigned* opsCompleted)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    CSWP_BUFFER* rsp = priv->session->rsp;
+    int res = CSWP_SUCCESS;
+    uint32_t rspSize;
+    varint_t numRsps;
+    int wbRes;
+    int i;
+
+    *opsCompleted = 0;
+
+    /* Decode header */
+    cswp_buffer_seek(rsp, 0);
+    cswp_buffer_get_uint32(rsp, &rspSize);
+    /* check reply length matches data received */
+    if (rspSize > rsp->used + priv->session->rx_direct_size)
+        res = cswp_client_error(client, CSWP_COMMS, "Incomplete response received.  Received %d bytes, expected %d",
+                                rsp->used, rspSize);
 
     if (res == CSWP_SUCCESS)
     {
         /* Check all responses received */
-        cswp_buffer_get_varint(priv->rsp, &numRsps);
-        if (numRsps != priv->num_cmds)
+        cswp_buffer_get_varint(rsp, &numRsps);
+        if (numRsps != numCmds)
             res = cswp_client_error(client, CSWP_COMMS, "Incomplete response received.  Received %d responses, expected %d",
-                                    numRsps, priv->num_cmds);
+                                    numRsps, numCmds);
     }
 
+    /* queued writes continue on error */
+    for (i = 0; i < deferred && res == CSWP_SUCCESS; ++i)
+    {
+        wbRes = cswp_client_process_response(client, &pendingRsps[i]);
+        cswp_client_keep_write_error(client, wbRes);
+    }
+    if (res != CSWP_SUCCESS && deferred > 0)
+        cswp_client_keep_write_error(client, res);
+
     if (res == CSWP_SUCCESS)
     {
         /* process each response */
-        pendingRsp = priv->pending_responses;
-        while (pendingRsp != NULL && res == CSWP_SUCCESS)
+        for (i = deferred; i < numCmds && res == CSWP_SUCCESS; ++i)
         {
-            res = cswp_client_process_response(client, pendingRsp);
+            res = cswp_client_process_response(client, &pendingRsps[i]);
 
-            if (opsCompleted && res == CSWP_SUCCESS)
+            if (res == CSWP_SUCCESS)
                 (*opsCompleted)++;
-
-            pendingRsp = pendingRsp->next;
         }
         /* TODO: continue processing on error? */
     }
 
-    /* cleanup response list */
-    pendingRsp = priv->pending_responses;
-    while (pendingRsp != NULL)
-    {
-        pending_response_t* d = pendingRsp;
-        if (pendingRsp->replyData)
-            free(pendingRsp->replyData);
-        pendingRsp = pendingRsp->next;
-        free(d);
-    }
-    priv->pending_responses = NULL;
-
     return res;
 }
 
+static int cswp_client_send_batch(cswp_client_t* client,
+                                  const cswp_batch_template_t* tmpl,
+                                  cswp_batch_callback_t callback,
+                                  void* userData,
+                                  cswp_batch_handle_t* handle);
+
 /*
- * Process a request
+ * Send request and receive response
  *
- * Unless in batch mode, call cswp_client_transact()
+ * The request joins any submitted batches on the transport, and the
+ * responses to those are completed on the way
  */
-static int cswp_client_process(cswp_client_t* client)
+static int cswp_client_transact(cswp_client_t* client, unsigned* opsCompleted)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res = CSWP_SUCCESS;
+    cswp_batch_handle_t handle;
+    int res;
 
-    if (priv->batch_mode == BATCH_NONE && priv->num_cmds > 0)
-        res = cswp_client_transact(client, NULL);
+    if (opsCompleted)
+        *opsCompleted = 0;
+
+    res = cswp_client_send_batch(client, NULL, NULL, NULL, &handle);
+    if (res == CSWP_SUCCESS)
+        res = cswp_batch_wait(client, handle, opsCompleted);
+    else if (priv->wb_queued > 0)
+    {
+        /* queued writes were not sent */
+        cswp_client_keep_write_error(client, res);
+        priv->wb_queued = 0;
+    }
 
     return res;
 }
 
 /*
- * Write an error message into client error message buffer
+ * Microseconds from an arbitrary start
  */
-int cswp_client_error(cswp_client_t* client, int errorCode, const char* fmt, ...)
+static uint64_t cswp_client_time_us(void)
 {
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(client->errorMsg, ERROR_MESSAGE_SIZE, fmt, args);
-    va_end(args);
-    return errorCode;
+#ifdef _WIN32
+    LARGE_INTEGER count, freq;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&freq);
+    return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000 +
+        (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
 }
 
-/**
- * Reply data for CSWP_INIT command
+/*
+ * Milliseconds from an arbitrary start
  */
-struct reply_data_init {
-    /** Server protocol version returned by CSWP server */
-    unsigned* serverProtocolVersion;
-    /** Buffer for server ID returned by CSWP server */
-    char* serverID;
-    /** Size of serverID buffer */
-    size_t serverIDSize;
-    /** Server version returned by CSWP server */
+static uint64_t cswp_client_time_ms(void)
+{
+    return cswp_client_time_us() / 1000;
+}
+
+/*
+ * Move an estimate towards a measurement
+ */
+static uint64_t cswp_client_smooth(uint64_t estimate, uint64_t sample)
+{
+    if (estimate == 0)
+        return sample;
+
+    return estimate + ((int64_t)sample - (int64_t)estimate) / LINK_SMOOTHING;
+}
+
+/*
+ * Update the link estimates from the response to a batch, received at now
+ *
+ * A batch sent to an idle link measures the round trip time if small, or the
+ * transfer rate beyond the round trip time if large.  A large batch sent
+ * before the previous response arrived kept the link busy since then, so the
+ * time between responses measures the transfer rate.
+ *
+ * Called with the session lock held
+ */
+static void cswp_client_measure_link(cswp_client_session_t* session,
+                                     const async_batch_t* batch,
+                                     uint64_t now,
+                                     size_t bytes)
+{
+    uint64_t elapsed = now - batch->sent;
+    uint64_t busy = 0;
+
+    if (batch->idle && bytes < LINK_SMALL_BYTES)
+    {
+        session->link_rtt = cswp_client_smooth(session->link_rtt, elapsed ? elapsed : 1);
+        session->link_rtt_samples++;
+    }
+    else if (batch->idle && bytes >= LINK_LARGE_BYTES && session->link_rtt > 0)
+        busy = elapsed > session->link_rtt ? elapsed - session->link_rtt : 0;
+    else if (!batch->idle && bytes >= LINK_LARGE_BYTES && batch->sent < session->link_last_rx)
+        busy = now - session->link_last_rx;
+
+    if (busy > 0)
+    {
+        session->link_rate = cswp_client_smooth(session->link_rate, (uint64_t)bytes * 1000000 / busy);
+        session->link_rate_samples++;
+    }
+
+    session->link_last_rx = now;
+}
+
+/*
+ * Bytes in flight needed to keep the link busy, 0 until measured
+ */
+static uint64_t cswp_client_link_bdp(cswp_client_session_t* session)
+{
+    uint64_t bdp;
+
+    session_lock(&session->lock);
+    bdp = session->link_rtt * session->link_rate / 1000000;
+    session_unlock(&session->lock);
+
+    return bdp;
+}
+
+/*
+ * Report an error from queued writes in preference to the call's own result
+ */
+static int cswp_client_write_error(cswp_client_t* client, int res)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+
+    session_lock(&priv->state_lock);
+    if (priv->wb_error != CSWP_SUCCESS)
+    {
+        res = priv->wb_error;
+        priv->wb_error = CSWP_SUCCESS;
+    }
+    session_unlock(&priv->state_lock);
+
+    return res;
+}
+
+/*
+ * Send any queued writes
+ *
+ * Errors are kept for the next synchronous call
+ */
+static int cswp_client_send_writes(cswp_client_t* client)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res;
+
+    if (priv->wb_queued == 0 || priv->batch_mode != BATCH_NONE)
+        return CSWP_SUCCESS;
+
+    /* Drop anything encoded after the writes */
+    priv->cmd->pos = priv->wb_used;
+    priv->cmd->used = priv->wb_used;
+    priv->num_cmds = priv->wb_queued;
+
+    res = cswp_client_transact(client, NULL);
+    cswp_client_keep_write_error(client, res);
+    priv->wb_queued = 0;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Process a request
+ *
+ * Unless in batch mode, call cswp_client_transact()
+ */
+static int cswp_client_process(cswp_client_t* client)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    pending_response_t* last;
+    uint64_t now;
+    uint64_t maxBytes;
+    int res = CSWP_SUCCESS;
+
+    if (priv->batch_mode != BATCH_NONE || priv->num_cmds == 0)
+        return CSWP_SUCCESS;
+
+    /* Queue writes when write-behind is enabled */
+    last = &priv->pending_responses[priv->num_cmds - 1];
+    if (priv->wb_max_ops > 0 &&
+        (last->type == CSWP_MEM_WRITE || last->type == CSWP_MEM_FILL || last->type == CSWP_REG_WRITE))
+    {
+        now = cswp_client_time_ms();
+        if (priv->wb_queued == 0)
+            priv->wb_deadline = now + priv->wb_delay;
+        priv->wb_queued = priv->num_cmds;
+        priv->wb_used = priv->cmd->used;
+
+        /* Without a limit, send about as much as the link holds */
+        maxBytes = priv->wb_max_bytes;
+        if (maxBytes == 0)
+        {
+            maxBytes = cswp_client_link_bdp(priv->session);
+            if (maxBytes > 0 && maxBytes < LINK_BATCH_MIN)
+                maxBytes = LINK_BATCH_MIN;
+        }
+
+        if (priv->num_cmds >= priv->wb_max_ops ||
+            (maxBytes > 0 && priv->cmd->used >= maxBytes) ||
+            (priv->wb_delay > 0 && now >= priv->wb_deadline))
+        {
+            cswp_client_send_writes(client);
+        }
+
+        return CSWP_SUCCESS;
+    }
+
+    res = cswp_client_transact(client, NULL);
+
+    return cswp_client_write_error(client, res);
+}
+
+/*
+ * Write an error message into client error message buffer
+ */
+int cswp_client_error(cswp_client_t* client, int errorCode, const char* fmt, ...)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    va_list args;
+    va_start(args, fmt);
+    session_lock(&priv->state_lock);
+    vsnprintf(client->errorMsg, ERROR_MESSAGE_SIZE, fmt, args);
+    session_unlock(&priv->state_lock);
+    va_end(args);
+    return errorCode;
+}
+
+/**
+ * Reply data for CSWP_INIT command
+ */
+struct reply_data_init {
+    /** Server protocol version returned by CSWP server */
+    unsigned* serverProtocolVersion;
+    /** Buffer for server ID returned by CSWP server */
+    char* serverID;
+    /** Size of serverID buffer */
+    size_t serverIDSize;
+    /** Server version returned by CSWP server */
     unsigned* serverVersion;
 };
 
-/*
- * Completion function for CSWP_INIT
- */
-static int cswp_init_complete(cswp_client_t* client,
-                              void* replyData)
+/*
+ * Use a negotiated message size, growing the response buffer to hold
+ * the largest response
+ */
+static int cswp_client_set_message_size(cswp_client_t* client, size_t messageSize)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+    CSWP_BUFFER* newBuf;
+
+    if (messageSize < CSWP_DEFAULT_MESSAGE_SIZE || messageSize > CSWP_MAX_MESSAGE_SIZE)
+        return cswp_client_error(client, CSWP_COMMS, "Invalid message size from server: %lu",
+                                 (unsigned long)messageSize);
+
+    if (session->rsp->size < messageSize)
+    {
+        newBuf = cswp_buffer_realloc(session->rsp, messageSize);
+        if (newBuf == NULL)
+            return cswp_client_error(client, CSWP_FAILED, "Failed to allocate %lu byte response buffer",
+                                     (unsigned long)messageSize);
+        session->rsp = newBuf;
+    }
+    session->messageSize = messageSize;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Completion function for CSWP_INIT
+ */
+static int cswp_init_complete(cswp_client_t* client,
+                              void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_init* initReply = (struct reply_data_init*)replyData;
+    varint_t protoVer, svrVer;
+    varint_t messageSize;
+    int res;
+
+    res = cswp_decode_init_response_body(priv->session->rsp, &protoVer,
+                                         priv->session->server_id, sizeof(priv->session->server_id), &svrVer);
+    if (res == CSWP_SUCCESS)
+    {
+        priv->session->server_version = svrVer;
+        if (initReply->serverID && initReply->serverIDSize > 0)
+        {
+            if (strlen(priv->session->server_id) >= initReply->serverIDSize)
+                res = CSWP_OUTPUT_BUFFER_OVERFLOW;
+            else
+                strcpy(initReply->serverID, priv->session->server_id);
+        }
+    }
+    if (res == CSWP_SUCCESS && protoVer >= CSWP_PROTOCOL_v2)
+    {
+        res = cswp_decode_init_response_message_size(priv->session->rsp, &messageSize);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_set_message_size(client, messageSize);
+    }
+    if (res == CSWP_SUCCESS)
+    {
+        if (initReply->serverProtocolVersion)
+            *initReply->serverProtocolVersion = protoVer;
+        if (initReply->serverVersion)
+            *initReply->serverVersion = svrVer;
+    }
+
+    return res;
+}
+
+int cswp_init(cswp_client_t* client,
+              const char*    clientID,
+              unsigned*      serverProtocolVersion,
+              char*          serverID,
+              size_t         serverIDSize,
+              unsigned*      serverVersion)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    cswp_client_session_t* session = priv->session;
+    int res = CSWP_SUCCESS;
+
+    if (session->client != client)
+        return cswp_client_error(client, CSWP_NOT_PERMITTED, "Session is opened by another client");
+
+    if (session->transport->connect)
+        res = session->transport->connect(client, session->transport);
+    if (res == CSWP_SUCCESS)
+    {
+        /* Until the server agrees a larger size */
+        session->messageSize = CSWP_DEFAULT_MESSAGE_SIZE;
+
+        /* The server may have changed */
+        cswp_client_clear_reg_lists(priv);
+
+        cswp_client_prepare_cmd(client);
+        res = cswp_encode_init_command(priv->cmd, CSWP_PROTOCOL_v2, clientID);
+        if (res == CSWP_SUCCESS)
+            res = cswp_encode_init_message_size(priv->cmd, CSWP_MAX_MESSAGE_SIZE);
+    }
+    if (res == CSWP_SUCCESS)
+    {
+        struct reply_data_init* initReply = cswp_client_push_request(client, CSWP_INIT, cswp_init_complete, sizeof(struct reply_data_init));
+        initReply->serverProtocolVersion = serverProtocolVersion;
+        initReply->serverID = serverID;
+        initReply->serverIDSize = serverIDSize;
+        initReply->serverVersion = serverVersion;
+    }
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_process(client);
+
+    return res;
+}
+
+
+size_t cswp_client_get_message_size(cswp_client_t* client)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+
+    return priv->session->messageSize;
+}
+
+
+int cswp_term(cswp_client_t* client)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    cswp_client_session_t* session = priv->session;
+    int res;
+
+    if (session->client != client)
+        return cswp_client_error(client, CSWP_NOT_PERMITTED, "Session is opened by another client");
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_encode_term_command(priv->cmd);
+    if (res == CSWP_SUCCESS)
+        cswp_client_push_request(client, CSWP_TERM, NULL, 0);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_process(client);
+
+    if (session->transport->disconnect)
+        session->transport->disconnect(client, session->transport);
+
+    return res;
+}
+
+
+int cswp_batch_begin(cswp_client_t* client, int abortOnError)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+
+    /* Batches start after any queued writes */
+    cswp_client_send_writes(client);
+
+    /* Clear buffer */
+    cswp_client_prepare_cmd(client);
+    priv->recording = 0;
+
+    if (abortOnError)
+        priv->batch_mode = BATCH_ABORT;
+    else
+        priv->batch_mode = BATCH_CONTINUE;
+
+    return CSWP_SUCCESS;
+}
+
+
+int cswp_batch_end(cswp_client_t* client, unsigned *opsCompleted)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res = CSWP_SUCCESS;
+
+    /* Process any pending operations */
+    if (priv->num_cmds > 0)
+        res = cswp_client_transact(client, opsCompleted);
+
+    priv->batch_mode = BATCH_NONE;
+    priv->recording = 0;
+
+    return cswp_client_write_error(client, res);
+}
+
+
+/*
+ * Release completed batches from the head of the ring
+ *
+ * The functions below are called with the session lock held
+ */
+static void cswp_client_reclaim_async(cswp_client_session_t* session)
+{
+    while (session->async_used > 0 && session->async[session->async_head].state == ASYNC_FREE)
+    {
+        session->async_head = (session->async_head + 1) % session->async_capacity;
+        session->async_used--;
+    }
+}
+
+/*
+ * Find a submitted batch that has not been released
+ */
+static async_batch_t* cswp_client_find_async(cswp_client_session_t* session, cswp_batch_handle_t handle)
+{
+    async_batch_t* batch;
+    unsigned i;
+
+    for (i = 0; i < session->async_used; ++i)
+    {
+        batch = &session->async[(session->async_head + i) % session->async_capacity];
+        if (batch->state != ASYNC_FREE && batch->handle == handle)
+            return batch;
+    }
+
+    return NULL;
+}
+
+/*
+ * Find the oldest batch in flight, optionally only those from one client
+ *
+ * Responses arrive in submission order, so this is the next to complete
+ */
+static async_batch_t* cswp_client_next_async(cswp_client_session_t* session, cswp_client_t* owner)
+{
+    async_batch_t* batch;
+    unsigned i;
+
+    for (i = 0; i < session->async_used; ++i)
+    {
+        batch = &session->async[(session->async_head + i) % session->async_capacity];
+        if (batch->state == ASYNC_IN_FLIGHT && (owner == NULL || batch->owner == owner))
+            return batch;
+    }
+
+    return NULL;
+}
+
+/*
+ * Report completion of a batch
+ *
+ * Batches with a callback are released, others wait for cswp_batch_wait()
+ */
+static void cswp_client_complete_async(cswp_client_session_t* session, async_batch_t* batch)
+{
+    batch->state = ASYNC_COMPLETE;
+    if (batch->callback)
+    {
+        batch->callback(batch->owner, batch->handle, batch->result, batch->opsCompleted, batch->userData);
+        batch->state = ASYNC_FREE;
+        cswp_client_reclaim_async(session);
+    }
+}
+
+/*
+ * Receive a response, placing the data of a successful read straight into
+ * the caller's buffer
+ *
+ * Any other response is reassembled in the response buffer, leaving the
+ * caller's buffer undefined
+ */
+static int cswp_client_receive_direct(cswp_client_t* owner,
+                                      cswp_client_session_t* session,
+                                      const async_batch_t* rx)
+{
+    CSWP_BUFFER* rsp = session->rsp;
+    cswp_client_iovec_t iov[3];
+    size_t dataUsed, tailUsed;
+    int res;
+
+    iov[0].data = rsp->buf;
+    iov[0].size = rx->rx_prefix_size;
+    iov[1].data = rx->rx_data;
+    iov[1].size = rx->rx_size;
+    iov[2].data = rsp->buf + rx->rx_prefix_size;
+    iov[2].size = rsp->size - rx->rx_prefix_size;
+
+    res = session->transport->receivev(owner, session->transport, iov, 3, &rsp->used);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    if (rsp->used == rx->rx_prefix_size + rx->rx_size &&
+        memcmp(rsp->buf, rx->rx_prefix, rx->rx_prefix_size) == 0)
+    {
+        /* As predicted: the data is already in place */
+        rsp->used = rx->rx_prefix_size;
+        session->rx_direct = rx->rx_data;
+        session->rx_direct_size = rx->rx_size;
+        return CSWP_SUCCESS;
+    }
+
+    if (rsp->used > rsp->size)
+        return cswp_client_error(owner, CSWP_COMMS, "Response of %lu bytes exceeds message size",
+                                 (unsigned long)rsp->used);
+
+    /* Move the part received into the caller's buffer back into place */
+    if (rsp->used > rx->rx_prefix_size)
+    {
+        dataUsed = rsp->used - rx->rx_prefix_size;
+        if (dataUsed > rx->rx_size)
+            dataUsed = rx->rx_size;
+        tailUsed = rsp->used - rx->rx_prefix_size - dataUsed;
+        memmove(rsp->buf + rx->rx_prefix_size + dataUsed, rsp->buf + rx->rx_prefix_size, tailUsed);
+        memcpy(rsp->buf + rx->rx_prefix_size, rx->rx_data, dataUsed);
+    }
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Wait for the next response to be processed
+ *
+ * If no other client is receiving, receive the response for the oldest batch
+ * in flight.  The lock is released while waiting, so batches may have moved
+ * in the ring on return.
+ */
+static void cswp_client_await_response(cswp_client_session_t* session)
+{
+    async_batch_t* batch;
+    async_batch_t rx;
+    int direct = 0;
+    cswp_client_t* owner;
+    CSWP_BUFFER* rsp = session->rsp;
+    uint64_t now;
+    int res;
+
+    if (session->receiving)
+    {
+        session_cond_wait(&session->responded, &session->lock);
+        return;
+    }
+
+    session->receiving = 1;
+    batch = cswp_client_next_async(session, NULL);
+    owner = batch->owner;
+    direct = batch->rx_data && session->transport->receivev &&
+        batch->rx_size >= RECEIVEV_MIN_SIZE;
+    if (direct)
+    {
+        /* Batch may move in the ring while unlocked */
+        rx = *batch;
+    }
+    session_unlock(&session->lock);
+
+    if (direct)
+        res = cswp_client_receive_direct(owner, session, &rx);
+    else
+        res = session->transport->receive(owner, session->transport, rsp->buf, rsp->size, &rsp->used);
+    now = cswp_client_time_us();
+
+    session_lock(&session->lock);
+    batch = cswp_client_next_async(session, NULL);
+    batch->opsCompleted = 0;
+    if (res == CSWP_SUCCESS)
+        cswp_client_measure_link(session, batch, now, batch->reqSize + rsp->used + session->rx_direct_size);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_process_responses(owner, batch->responses, batch->num_cmds, batch->deferred, &batch->opsCompleted);
+    session->rx_direct = NULL;
+    session->rx_direct_size = 0;
+    batch->result = res;
+    session->async_in_flight--;
+    session->async_bytes -= batch->reqSize;
+    session->receiving = 0;
+
+    cswp_client_complete_async(session, batch);
+    session_cond_broadcast(&session->responded);
+}
+
+/*
+ * Make space in the ring for another batch
+ *
+ * Batches waiting for cswp_batch_wait() stay in the ring, so it grows
+ * rather than limiting the number submitted
+ */
+static int cswp_client_reserve_async(cswp_client_t* client)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+    async_batch_t* ring;
+    unsigned capacity, i;
+
+    if (session->async_used < session->async_capacity)
+        return CSWP_SUCCESS;
+
+    capacity = session->async_capacity ? session->async_capacity * 2 : session->async_window;
+    ring = calloc(capacity, sizeof(async_batch_t));
+    if (ring == NULL)
+        return cswp_client_error(client, CSWP_FAILED, "Failed to allocate batch list");
+
+    /* unroll from head, all entries are in use */
+    for (i = 0; i < session->async_capacity; ++i)
+        ring[i] = session->async[(session->async_head + i) % session->async_capacity];
+    free(session->async);
+    session->async = ring;
+    session->async_capacity = capacity;
+    session->async_head = 0;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Record where the data of a batch's only command, a memory read, goes
+ *
+ * The response message is predicted up to the data, so a successful read
+ * can be recognised once received
+ */
+static void cswp_client_expect_read(async_batch_t* batch,
+                                    cswp_commands_t type,
+                                    uint8_t* data,
+                                    size_t size)
+{
+    uint8_t* p = batch->rx_prefix + 4;
+    size_t msgSize;
+
+    p += cswp_client_put_varint(p, 1);
+    p += cswp_client_put_varint(p, type);
+    p += cswp_client_put_varint(p, CSWP_SUCCESS);
+    p += cswp_client_put_varint(p, size);
+    batch->rx_prefix_size = p - batch->rx_prefix;
+
+    msgSize = batch->rx_prefix_size + size;
+    batch->rx_prefix[0] = (msgSize & 0xFF);
+    batch->rx_prefix[1] = ((msgSize >> 8) & 0xFF);
+    batch->rx_prefix[2] = ((msgSize >> 16) & 0xFF);
+    batch->rx_prefix[3] = ((msgSize >> 24) & 0xFF);
+
+    batch->rx_data = data;
+    batch->rx_size = size;
+}
+
+/*
+ * Send the current request, or a template, as a batch
+ */
+static int cswp_client_send_batch(cswp_client_t* client,
+                                  const cswp_batch_template_t* tmpl,
+                                  cswp_batch_callback_t callback,
+                                  void* userData,
+                                  cswp_batch_handle_t* handle)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    cswp_client_session_t* session = priv->session;
+    async_batch_t* batch;
+    pending_response_t* pending;
+    unsigned capacity;
+    uint32_t reqSize = 0;
+    uint8_t* pBuf = NULL;
+    cswp_client_iovec_t iov[2];
+    int res;
+
+    if (tmpl)
+    {
+        pBuf = tmpl->request;
+        reqSize = tmpl->size;
+    }
+    else if (priv->num_cmds > 0)
+        cswp_client_encode_header(client, &pBuf, &reqSize);
+
+    session_lock(&session->lock);
+
+    /* Wait for space in the window, and for the transport to be free if it
+       can't send while receiving */
+    while (session->async_in_flight > 0 &&
+           (session->async_in_flight >= session->async_window ||
+            session->async_bytes + reqSize > ASYNC_MAX_BYTES ||
+            (session->receiving && !session->transport->duplex)))
+    {
+        cswp_client_await_response(session);
+    }
+
+    res = cswp_client_reserve_async(client);
+    if (res != CSWP_SUCCESS)
+    {
+        session_unlock(&session->lock);
+        return res;
+    }
+
+    batch = &session->async[(session->async_head + session->async_used) % session->async_capacity];
+    session->async_used++;
+    if (tmpl)
+    {
+        /* Templates keep their own pending responses */
+        batch->responses = tmpl->pending_responses;
+        batch->num_cmds = tmpl->num_cmds;
+        batch->deferred = 0;
+    }
+    else
+    {
+        /* Hand the pending responses to the batch, taking its previous array */
+        pending = batch->pending_responses;
+        capacity = batch->pending_capacity;
+        batch->pending_responses = priv->pending_responses;
+        batch->pending_capacity = priv->pending_capacity;
+        batch->responses = batch->pending_responses;
+        batch->num_cmds = priv->num_cmds;
+        batch->deferred = priv->wb_queued;
+        priv->pending_responses = pending;
+        priv->pending_capacity = capacity;
+        priv->num_cmds = 0;
+        priv->batch_mode = BATCH_NONE;
+        priv->recording = 0;
+        priv->wb_queued = 0;
+    }
+
+    /* Caller data follows the encoded request */
+    iov[0].data = pBuf;
+    iov[0].size = reqSize - priv->ext_size;
+    iov[1].data = (void*)priv->ext_data;
+    iov[1].size = priv->ext_size;
+    priv->ext_data = NULL;
+    priv->ext_size = 0;
+
+    /* Data of a lone read may be received into the caller's buffer */
+    batch->rx_data = NULL;
+    if (!tmpl && batch->num_cmds == 1 && batch->deferred == 0 && priv->rx_data)
+        cswp_client_expect_read(batch, priv->rx_type, priv->rx_data, priv->rx_size);
+    priv->rx_data = NULL;
+
+    if (++session->async_handle == 0)
+        session->async_handle = 1;
+    batch->handle = session->async_handle;
+    batch->owner = client;
+    batch->reqSize = reqSize;
+    batch->callback = callback;
+    batch->userData = userData;
+    batch->result = CSWP_SUCCESS;
+    batch->opsCompleted = 0;
+    batch->state = ASYNC_IN_FLIGHT;
+
+    if (handle)
+        *handle = batch->handle;
+
+    /* Send while holding the lock so requests go out in ring order */
+    batch->sent = cswp_client_time_us();
+    batch->idle = session->async_in_flight == 0;
+    if (batch->num_cmds > 0 && iov[1].size > 0)
+        res = session->transport->sendv(client, session->transport, iov, 2);
+    else if (batch->num_cmds > 0)
+        res = session->transport->send(client, session->transport, pBuf, reqSize);
+
+    if (res != CSWP_SUCCESS)
+    {
+        /* Not sent, so nothing to complete */
+        batch->state = ASYNC_FREE;
+        cswp_client_reclaim_async(session);
+    }
+    else if (batch->num_cmds > 0)
+    {
+        session->async_in_flight++;
+        session->async_bytes += reqSize;
+    }
+    else
+    {
+        /* Empty batch: nothing sent to transport */
+        cswp_client_complete_async(session, batch);
+    }
+
+    session_unlock(&session->lock);
+
+    return res;
+}
+
+
+int cswp_batch_submit(cswp_client_t* client,
+                      cswp_batch_callback_t callback,
+                      void* userData,
+                      cswp_batch_handle_t* handle)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+
+    if (priv->batch_mode == BATCH_NONE)
+        return cswp_client_error(client, CSWP_NOT_PERMITTED, "No batch to submit");
+
+    return cswp_client_send_batch(client, NULL, callback, userData, handle);
+}
+
+
+int cswp_batch_wait(cswp_client_t* client,
+                    cswp_batch_handle_t handle,
+                    unsigned* opsCompleted)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+    async_batch_t* batch;
+    int res;
+
+    if (opsCompleted)
+        *opsCompleted = 0;
+
+    session_lock(&session->lock);
+
+    /* Look the batch up again after each response as the ring may move */
+    while ((batch = cswp_client_find_async(session, handle)) != NULL &&
+           batch->owner == client && batch->callback == NULL &&
+           batch->state == ASYNC_IN_FLIGHT)
+    {
+        cswp_client_await_response(session);
+    }
+
+    if (batch == NULL || batch->owner != client || batch->callback != NULL)
+    {
+        session_unlock(&session->lock);
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Invalid batch handle %u", handle);
+    }
+
+    if (opsCompleted)
+        *opsCompleted = batch->opsCompleted;
+    res = batch->result;
+
+    batch->state = ASYNC_FREE;
+    cswp_client_reclaim_async(session);
+
+    session_unlock(&session->lock);
+
+    return res;
+}
+
+
+int cswp_batch_poll(cswp_client_t* client,
+                    cswp_batch_handle_t handle)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+    async_batch_t* batch;
+    int complete;
+
+    session_lock(&session->lock);
+    batch = cswp_client_find_async(session, handle);
+    complete = (batch == NULL || batch->state != ASYNC_IN_FLIGHT);
+    session_unlock(&session->lock);
+
+    return complete;
+}
+
+
+int cswp_batch_flush(cswp_client_t* client)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+
+    session_lock(&session->lock);
+    while (cswp_client_next_async(session, client) != NULL)
+        cswp_client_await_response(session);
+    session_unlock(&session->lock);
+
+    return CSWP_SUCCESS;
+}
+
+
+int cswp_client_set_window(cswp_client_t* client, unsigned window)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+
+    if (window == 0)
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Batch window must be at least 1");
+
+    session_lock(&session->lock);
+    session->async_window = window;
+    session_unlock(&session->lock);
+
+    return CSWP_SUCCESS;
+}
+
+
+int cswp_template_begin(cswp_client_t* client, int abortOnError)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    struct reply_data_init* initReply = (struct reply_data_init*)replyData;
-    varint_t protoVer, svrVer;
     int res;
 
-    res = cswp_decode_init_response_body(priv->rsp, &protoVer, initReply->serverID, initReply->serverIDSize, &svrVer);
-    if (res == CSWP_SUCCESS)
-    {
-        if (initReply->serverProtocolVersion)
-            *initReply->serverProtocolVersion = protoVer;
-        if (initReply->serverVersion)
-            *initReply->serverVersion = svrVer;
-    }
+    res = cswp_batch_begin(client, abortOnError);
+    priv->recording = 1;
+    priv->num_slots = 0;
 
     return res;
 }
 
-int cswp_init(cswp_client_t* client,
-              const char*    clientID,
-              unsigned*      serverProtocolVersion,
-              char*          serverID,
-              size_t         serverIDSize,
-              unsigned*      serverVersion)
+
+int cswp_template_end(cswp_client_t* client, cswp_batch_template_t** tmpl)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res = CSWP_SUCCESS;
+    cswp_batch_template_t* t;
+    uint8_t* pBuf;
+    uint32_t reqSize;
+    size_t reqOffset;
+    unsigned i;
 
-    if (priv->transport->connect)
-        res = priv->transport->connect(client, priv->transport);
-    if (res == CSWP_SUCCESS)
+    *tmpl = NULL;
+    if (!priv->recording)
+        return cswp_client_error(client, CSWP_NOT_PERMITTED, "No template being recorded");
+
+    cswp_client_encode_header(client, &pBuf, &reqSize);
+    reqOffset = pBuf - priv->cmd->buf;
+
+    t = calloc(1, sizeof(cswp_batch_template_t));
+    if (t)
     {
-        cswp_client_prepare_cmd(client);
-        res = cswp_encode_init_command(priv->cmd, CSWP_PROTOCOL_v1, clientID);
+        t->request = malloc(reqSize);
+        t->pending_responses = malloc((priv->num_cmds + 1) * sizeof(pending_response_t));
+        t->slots = malloc((priv->num_slots + 1) * sizeof(template_slot_t));
     }
-    if (res == CSWP_SUCCESS)
+    if (t == NULL || t->request == NULL || t->pending_responses == NULL || t->slots == NULL)
     {
-        struct reply_data_init* initReply = calloc(1, sizeof(struct reply_data_init));
-        initReply->serverProtocolVersion = serverProtocolVersion;
-        initReply->serverID = serverID;
-        initReply->serverIDSize = serverIDSize;
-        initReply->serverVersion = serverVersion;
-        cswp_client_push_request(client, CSWP_INIT, cswp_init_complete, initReply);
+        cswp_template_free(t);
+        return cswp_client_error(client, CSWP_FAILED, "Failed to allocate template");
     }
-    if (res == CSWP_SUCCESS)
-        res = cswp_client_process(client);
 
-    return res;
+    memcpy(t->request, pBuf, reqSize);
+    t->size = reqSize;
+    memcpy(t->pending_responses, priv->pending_responses, priv->num_cmds * sizeof(pending_response_t));
+    t->num_cmds = priv->num_cmds;
+    /* slot offsets are relative to the start of the message */
+    for (i = 0; i < priv->num_slots; ++i)
+    {
+        t->slots[i] = priv->slots[i];
+        t->slots[i].offset -= reqOffset;
+    }
+    t->num_slots = priv->num_slots;
+
+    priv->num_cmds = 0;
+    priv->num_slots = 0;
+    priv->batch_mode = BATCH_NONE;
+    priv->recording = 0;
+
+    *tmpl = t;
+
+    return CSWP_SUCCESS;
 }
 
 
-int cswp_term(cswp_client_t* client)
+void cswp_template_free(cswp_batch_template_t* tmpl)
 {
-    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    if (tmpl)
+    {
+        free(tmpl->request);
+        free(tmpl->pending_responses);
+        free(tmpl->slots);
+        free(tmpl);
+    }
+}
+
+
+int cswp_template_set(cswp_batch_template_t* tmpl,
+                      unsigned op,
+                      cswp_template_operand_t operand,
+                      unsigned index,
+                      const void* value,
+                      size_t size)
+{
+    template_slot_t* slot = NULL;
+    uint8_t* p;
+    uint64_t address;
+    uint32_t regValue;
+    unsigned regID;
+    unsigned i;
+
+    for (i = 0; i < tmpl->num_slots && slot == NULL; ++i)
+    {
+        if (tmpl->slots[i].op == op && tmpl->slots[i].operand == operand && tmpl->slots[i].index == index)
+            slot = &tmpl->slots[i];
+    }
+    if (slot == NULL)
+        return CSWP_BAD_ARGS;
+
+    p = tmpl->request + slot->offset;
+    switch (operand)
+    {
+    case CSWP_TEMPLATE_ADDRESS:
+        if (size != sizeof(address))
+            return CSWP_BAD_ARGS;
+        memcpy(&address, value, sizeof(address));
+        for (i = 0; i < 8; ++i)
+            p[i] = (address >> (i * 8)) & 0xFF;
+        break;
+
+    case CSWP_TEMPLATE_REG_ID:
+        if (size != sizeof(regID))
+            return CSWP_BAD_ARGS;
+        memcpy(&regID, value, sizeof(regID));
+        cswp_client_encode_reg_id(p, regID);
+        break;
+
+    case CSWP_TEMPLATE_REG_VALUE:
+        if (size != sizeof(regValue))
+            return CSWP_BAD_ARGS;
+        memcpy(&regValue, value, sizeof(regValue));
+        for (i = 0; i < 4; ++i)
+            p[i] = (regValue >> (i * 8)) & 0xFF;
+        break;
+
+    case CSWP_TEMPLATE_DATA:
+        if (size != slot->size)
+            return CSWP_BAD_ARGS;
+        memcpy(p, value, size);
+        break;
+
+    default:
+        return CSWP_BAD_ARGS;
+    }
+
+    return CSWP_SUCCESS;
+}
+
+
+int cswp_template_run(cswp_client_t* client,
+                      const cswp_batch_template_t* tmpl,
+                      unsigned* opsCompleted)
+{
+    cswp_batch_handle_t handle;
     int res;
 
-    cswp_client_prepare_cmd(client);
-    res = cswp_encode_term_command(priv->cmd);
-    if (res == CSWP_SUCCESS)
-        cswp_client_push_request(client, CSWP_TERM, NULL, 0);
-    if (res == CSWP_SUCCESS)
-        res = cswp_client_process(client);
+    if (opsCompleted)
+        *opsCompleted = 0;
 
-    if (priv->transport->disconnect)
-        priv->transport->disconnect(client, priv->transport);
+    cswp_client_send_writes(client);
+    res = cswp_client_send_batch(client, tmpl, NULL, NULL, &handle);
+    if (res == CSWP_SUCCESS)
+        res = cswp_batch_wait(client, handle, opsCompleted);
 
-    return res;
+    return cswp_client_write_error(client, res);
 }
 
 
-int cswp_batch_begin(cswp_client_t* client, int abortOnError)
+int cswp_template_submit(cswp_client_t* client,
+                         const cswp_batch_template_t* tmpl,
+                         cswp_batch_callback_t callback,
+                         void* userData,
+                         cswp_batch_handle_t* handle)
 {
-    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    cswp_client_send_writes(client);
+    return cswp_client_send_batch(client, tmpl, callback, userData, handle);
+}
 
-    /* Clear buffer */
-    cswp_client_prepare_cmd(client);
 
-    if (abortOnError)
-        priv->batch_mode = BATCH_ABORT;
-    else
-        priv->batch_mode = BATCH_CONTINUE;
+int cswp_client_get_link_stats(cswp_client_t* client, cswp_client_link_stats_t* stats)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+
+    session_lock(&session->lock);
+    stats->rtt = session->link_rtt;
+    stats->bandwidth = session->link_rate;
+    stats->rttSamples = session->link_rtt_samples;
+    stats->bandwidthSamples = session->link_rate_samples;
+    session_unlock(&session->lock);
 
     return CSWP_SUCCESS;
 }
 
 
-int cswp_batch_end(cswp_client_t* client, unsigned *opsCompleted)
+int cswp_client_set_write_behind(cswp_client_t* client,
+                                 unsigned maxOps,
+                                 size_t maxBytes,
+                                 unsigned delay)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res = CSWP_SUCCESS;
 
-    /* Process any pending operations */
-    if (priv->num_cmds > 0)
-        res = cswp_client_transact(client, opsCompleted);
+    cswp_client_send_writes(client);
 
-    priv->batch_mode = BATCH_NONE;
+    priv->wb_max_ops = maxOps;
+    priv->wb_max_bytes = maxBytes;
+    priv->wb_delay = delay;
 
-    return res;
+    return CSWP_SUCCESS;
+}
+
+
+int cswp_client_flush_writes(cswp_client_t* client)
+{
+    cswp_client_send_writes(client);
+
+    return cswp_client_write_error(client, CSWP_SUCCESS);
 }
 
 
@@ -481,8 +2088,27 @@ int cswp_set_devices(cswp_client_t* client,
                      const char** deviceTypes)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    unsigned i;
     int res;
 
+    /* Registers may differ between devices at the same index */
+    cswp_client_clear_reg_lists(priv);
+    session_lock(&priv->state_lock);
+    cswp_client_clear_device_types(priv);
+    if (deviceTypes && deviceCount > 0)
+    {
+        priv->device_types = calloc(deviceCount, sizeof(char*));
+        if (priv->device_types)
+            priv->num_device_types = deviceCount;
+        for (i = 0; i < priv->num_device_types; ++i)
+        {
+            priv->device_types[i] = malloc(strlen(deviceTypes[i]) + 1);
+            if (priv->device_types[i])
+                strcpy(priv->device_types[i], deviceTypes[i]);
+        }
+    }
+    session_unlock(&priv->state_lock);
+
     cswp_client_prepare_cmd(client);
     res = cswp_encode_set_devices_command(priv->cmd, deviceCount, deviceList, deviceTypes);
     if (res == CSWP_SUCCESS)
@@ -525,7 +2151,7 @@ static int cswp_get_devices_complete(cswp_client_t* client,
     int res;
     int i;
 
-    res = cswp_decode_get_devices_response_body(priv->rsp, &devCount);
+    res = cswp_decode_get_devices_response_body(priv->session->rsp, &devCount);
     if (res == CSWP_SUCCESS)
     {
         *getDevicesReplyData->deviceCount = devCount;
@@ -540,8 +2166,8 @@ static int cswp_get_devices_complete(cswp_client_t* client,
         else
             for (i = 0; i < devCount && res == CSWP_SUCCESS; ++i)
             {
-                res = cswp_buffer_get_string(priv->rsp, getDevicesReplyData->deviceList[i], getDevicesReplyData->deviceListEntrySize);
-                res = cswp_buffer_get_string(priv->rsp, getDevicesReplyData->deviceTypes[i], getDevicesReplyData->deviceTypeEntrySize);
+                res = cswp_buffer_get_string(priv->session->rsp, getDevicesReplyData->deviceList[i], getDevicesReplyData->deviceListEntrySize);
+                res = cswp_buffer_get_string(priv->session->rsp, getDevicesReplyData->deviceTypes[i], getDevicesReplyData->deviceTypeEntrySize);
             }
     }
 
@@ -564,7 +2190,7 @@ int cswp_get_devices(cswp_client_t* client,
     res = cswp_encode_get_devices_command(priv->cmd);
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_get_devices* replyData = calloc(1, sizeof(struct reply_data_get_devices));
+        struct reply_data_get_devices* replyData = cswp_client_push_request(client, CSWP_GET_DEVICES, cswp_get_devices_complete, sizeof(struct reply_data_get_devices));
         replyData->deviceCount = deviceCount;
         replyData->deviceList = deviceList;
         replyData->deviceListSize = deviceListSize;
@@ -572,7 +2198,6 @@ int cswp_get_devices(cswp_client_t* client,
         replyData->deviceTypes = deviceTypes;
         replyData->deviceTypeSize = deviceTypeSize;
         replyData->deviceTypeEntrySize = deviceTypeEntrySize;
-        cswp_client_push_request(client, CSWP_GET_DEVICES, cswp_get_devices_complete, replyData);
     }
     if (res == CSWP_SUCCESS)
         res = cswp_client_process(client);
@@ -605,7 +2230,7 @@ static int cswp_get_system_description_complete(cswp_client_t* client,
     varint_t systemDescriptionFormat, systemDescriptionSize;
     int res;
 
-    res = cswp_decode_get_system_description_response_body(priv->rsp,
+    res = cswp_decode_get_system_description_response_body(priv->session->rsp,
                                                            &systemDescriptionFormat,
                                                            &systemDescriptionSize,
                                                            getSystemDescriptionReplyData->descriptionDataBuffer,
@@ -636,12 +2261,11 @@ int cswp_get_system_description(cswp_client_t* client,
     res = cswp_encode_get_system_description_command(priv->cmd);
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_get_system_description* replyData = calloc(1, sizeof(struct reply_data_get_system_description));
+        struct reply_data_get_system_description* replyData = cswp_client_push_request(client, CSWP_GET_SYSTEM_DESCRIPTION, cswp_get_system_description_complete, sizeof(struct reply_data_get_system_description));
         replyData->descriptionFormat = descriptionFormat;
         replyData->descriptionSize = descriptionSize;
         replyData->descriptionDataBuffer = descriptionDataBuffer;
         replyData->bufferSize = bufferSize;
-        cswp_client_push_request(client, CSWP_GET_SYSTEM_DESCRIPTION, cswp_get_system_description_complete, replyData);
     }
     if (res == CSWP_SUCCESS)
         res = cswp_client_process(client);
@@ -669,7 +2293,7 @@ static int cswp_device_open_complete(cswp_client_t* client,
     struct reply_data_device_open* deviceOpenReplyData = (struct reply_data_device_open*)replyData;
     int res;
 
-    res = cswp_decode_device_open_response_body(priv->rsp,
+    res = cswp_decode_device_open_response_body(priv->session->rsp,
                                                 deviceOpenReplyData->deviceInfo,
                                                 deviceOpenReplyData->deviceInfoSize);
 
@@ -689,10 +2313,9 @@ int cswp_device_open(cswp_client_t* client,
     res = cswp_encode_device_open_command(priv->cmd, deviceNo);
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_device_open* replyData = calloc(1, sizeof(struct reply_data_device_open));
+        struct reply_data_device_open* replyData = cswp_client_push_request(client, CSWP_DEVICE_OPEN, cswp_device_open_complete, sizeof(struct reply_data_device_open));
         replyData->deviceInfo = deviceInfo;
         replyData->deviceInfoSize = deviceInfoSize;
-        cswp_client_push_request(client, CSWP_DEVICE_OPEN, cswp_device_open_complete, replyData);
     }
     if (res == CSWP_SUCCESS)
         res = cswp_client_process(client);
@@ -732,114 +2355,468 @@ int cswp_set_config(cswp_client_t* client,
     if (res == CSWP_SUCCESS)
         res = cswp_client_process(client);
 
-    return res;
+    return res;
+}
+
+/**
+ * Reply data for CSWP_GET_CONFIG command
+ */
+struct reply_data_get_config {
+    /** Buffer for configuration item value */
+    char* value;
+    /** Size of value buffer */
+    size_t valueSize;
+};
+
+static int cswp_get_config_complete(cswp_client_t* client,
+                                    void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_get_config* getConfigReplyData = (struct reply_data_get_config*)replyData;
+    int res;
+
+    res = cswp_decode_get_config_response_body(priv->session->rsp,
+                                               getConfigReplyData->value,
+                                               getConfigReplyData->valueSize);
+
+    return res;
+}
+
+int cswp_get_config(cswp_client_t* client,
+                    varint_t deviceNo,
+                    const char* name,
+                    char* value,
+                    size_t valueSize)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res;
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_encode_get_config_command(priv->cmd, deviceNo, name);
+    if (res == CSWP_SUCCESS)
+    {
+        struct reply_data_get_config* replyData = cswp_client_push_request(client, CSWP_GET_CONFIG, cswp_get_config_complete, sizeof(struct reply_data_get_config));
+        replyData->value = value;
+        replyData->valueSize = valueSize;
+        res = cswp_client_process(client);
+    }
+
+    return res;
+}
+
+/**
+ * Reply data for CSWP_GET_DEVICE_CAPABILITIES command
+ */
+struct reply_data_get_device_capabilities {
+    /** Capabilities returned by the CSWP server */
+    unsigned* capabilities;
+    /** Capability data returned by the CSWP server */
+    unsigned* capabilityData;
+};
+
+static int cswp_get_device_capabilities_complete(cswp_client_t* client,
+                                                 void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_get_device_capabilities* getDeviceCapabilitiesReplyData = (struct reply_data_get_device_capabilities*)replyData;
+    int res;
+    varint_t capabilities, capabilityData;
+
+    res = cswp_decode_get_device_capabilities_response_body(priv->session->rsp,
+                                                            &capabilities,
+                                                            &capabilityData);
+    if (res == CSWP_SUCCESS)
+    {
+        *getDeviceCapabilitiesReplyData->capabilities = capabilities;
+        *getDeviceCapabilitiesReplyData->capabilityData = capabilityData;
+    }
+
+    return res;
+}
+
+int cswp_get_device_capabilities(cswp_client_t* client,
+                                 varint_t deviceNo,
+                                 unsigned* capabilities,
+                                 unsigned* capabilityData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res;
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_encode_get_device_capabilities_command(priv->cmd, deviceNo);
+    if (res == CSWP_SUCCESS)
+    {
+        struct reply_data_get_device_capabilities* replyData = cswp_client_push_request(client, CSWP_GET_DEVICE_CAPABILITIES, cswp_get_device_capabilities_complete, sizeof(struct reply_data_get_device_capabilities));
+        replyData->capabilities = capabilities;
+        replyData->capabilityData = capabilityData;
+        res = cswp_client_process(client);
+    }
+    return res;
+}
+
+/*
+ * FNV-1a hash of a string
+ */
+static uint32_t cswp_reg_list_hash(const char* str)
+{
+    uint32_t h = 2166136261u;
+
+    while (*str)
+    {
+        h ^= (uint8_t)*str++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+/*
+ * Skip a string in a register list body, counting its size once terminated
+ */
+static int cswp_reg_list_skip_string(CSWP_BUFFER* buf, size_t* strBytes)
+{
+    varint_t len;
+    void* data;
+    int res;
+
+    res = cswp_buffer_get_varint(buf, &len);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(buf, &data, len);
+    if (res == CSWP_SUCCESS)
+        *strBytes += len + 1;
+
+    return res;
+}
+
+/*
+ * Copy a string from a register list body to *str, advancing *str
+ *
+ * The body has already been checked by cswp_reg_list_skip_string()
+ */
+static const char* cswp_reg_list_take_string(CSWP_BUFFER* buf, char** str)
+{
+    char* start = *str;
+    varint_t len;
+    void* data;
+
+    cswp_buffer_get_varint(buf, &len);
+    cswp_buffer_get_direct(buf, &data, len);
+    memcpy(start, data, len);
+    start[len] = '\0';
+    *str += len + 1;
+
+    return start;
+}
+
+/*
+ * Build a register list from a CSWP_REG_LIST response body
+ *
+ * The body is walked once to size the allocation, then again to fill it, so
+ * each string is copied once
+ */
+static int cswp_reg_list_build(cswp_client_t* client, CSWP_BUFFER* buf, cswp_reg_list_t** regList)
+{
+    cswp_reg_list_t* list;
+    size_t start = buf->pos;
+    size_t strBytes = 0;
+    varint_t count, id, size;
+    unsigned indexSize = 8;
+    unsigned i, h;
+    char* str;
+    int res;
+
+    res = cswp_decode_reg_list_response_body(buf, &count);
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+    {
+        res = cswp_buffer_get_varint(buf, &id);
+        if (res == CSWP_SUCCESS)
+            res = cswp_reg_list_skip_string(buf, &strBytes);
+        if (res == CSWP_SUCCESS)
+            res = cswp_buffer_get_varint(buf, &size);
+        if (res == CSWP_SUCCESS)
+            res = cswp_reg_list_skip_string(buf, &strBytes);
+        if (res == CSWP_SUCCESS)
+            res = cswp_reg_list_skip_string(buf, &strBytes);
+    }
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    while (indexSize < 2 * count)
+        indexSize *= 2;
+
+    list = malloc(sizeof(cswp_reg_list_t) +
+                  count * sizeof(cswp_register_info_t) +
+                  indexSize * sizeof(uint32_t) +
+                  strBytes);
+    if (list == NULL)
+        return cswp_client_error(client, CSWP_FAILED, "Failed to allocate register list");
+
+    list->count = count;
+    list->entries = (cswp_register_info_t*)(list + 1);
+    list->index = (uint32_t*)(list->entries + count);
+    list->indexSize = indexSize;
+    memset(list->index, 0, indexSize * sizeof(uint32_t));
+    str = (char*)(list->index + indexSize);
+
+    cswp_buffer_seek(buf, start);
+    cswp_decode_reg_list_response_body(buf, &count);
+    for (i = 0; i < count; ++i)
+    {
+        cswp_buffer_get_varint(buf, &id);
+        list->entries[i].id = id;
+        list->entries[i].name = cswp_reg_list_take_string(buf, &str);
+        cswp_buffer_get_varint(buf, &size);
+        list->entries[i].size = size;
+        list->entries[i].displayName = cswp_reg_list_take_string(buf, &str);
+        list->entries[i].description = cswp_reg_list_take_string(buf, &str);
+
+        h = cswp_reg_list_hash(list->entries[i].name) & (indexSize - 1);
+        while (list->index[h] != 0)
+            h = (h + 1) & (indexSize - 1);
+        list->index[h] = i + 1;
+    }
+
+    *regList = list;
+
+    return CSWP_SUCCESS;
+}
+
+
+unsigned cswp_reg_list_count(const cswp_reg_list_t* regList)
+{
+    return regList->count;
+}
+
+
+const cswp_register_info_t* cswp_reg_list_entries(const cswp_reg_list_t* regList)
+{
+    return regList->entries;
+}
+
+
+const cswp_register_info_t* cswp_reg_list_find(const cswp_reg_list_t* regList,
+                                               const char* name)
+{
+    unsigned h = cswp_reg_list_hash(name) & (regList->indexSize - 1);
+    uint32_t slot;
+
+    while ((slot = regList->index[h]) != 0)
+    {
+        if (strcmp(regList->entries[slot - 1].name, name) == 0)
+            return &regList->entries[slot - 1];
+        h = (h + 1) & (regList->indexSize - 1);
+    }
+
+    return NULL;
 }
 
-/**
- * Reply data for CSWP_GET_CONFIG command
+/*
+ * Get the register list kept for a device, or NULL
  */
-struct reply_data_get_config {
-    /** Buffer for configuration item value */
-    char* value;
-    /** Size of value buffer */
-    size_t valueSize;
-};
-
-static int cswp_get_config_complete(cswp_client_t* client,
-                                    void* replyData)
+static const cswp_reg_list_t* cswp_client_find_reg_list(cswp_client_t* client, unsigned deviceNo)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    struct reply_data_get_config* getConfigReplyData = (struct reply_data_get_config*)replyData;
-    int res;
+    const cswp_reg_list_t* regList;
 
-    res = cswp_decode_get_config_response_body(priv->rsp,
-                                               getConfigReplyData->value,
-                                               getConfigReplyData->valueSize);
+    session_lock(&priv->state_lock);
+    regList = deviceNo < priv->num_reg_lists ? priv->reg_lists[deviceNo] : NULL;
+    session_unlock(&priv->state_lock);
 
-    return res;
+    return regList;
 }
 
-int cswp_get_config(cswp_client_t* client,
-                    varint_t deviceNo,
-                    const char* name,
-                    char* value,
-                    size_t valueSize)
+/*
+ * Keep the register list for a device
+ *
+ * A list already kept stays in place, as the caller may be using it, and
+ * replaces *regList
+ */
+static int cswp_client_keep_reg_list(cswp_client_t* client, unsigned deviceNo, cswp_reg_list_t** regList)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res;
+    cswp_reg_list_t** lists;
 
-    cswp_client_prepare_cmd(client);
-    res = cswp_encode_get_config_command(priv->cmd, deviceNo, name);
-    if (res == CSWP_SUCCESS)
+    session_lock(&priv->state_lock);
+    if (deviceNo >= priv->num_reg_lists)
     {
-        struct reply_data_get_config* replyData = calloc(1, sizeof(struct reply_data_get_config));
-        replyData->value = value;
-        replyData->valueSize = valueSize;
-        cswp_client_push_request(client, CSWP_GET_CONFIG, cswp_get_config_complete, replyData);
-        res = cswp_client_process(client);
+        lists = realloc(priv->reg_lists, (deviceNo + 1) * sizeof(cswp_reg_list_t*));
+        if (lists == NULL)
+        {
+            session_unlock(&priv->state_lock);
+            free(*regList);
+            return cswp_client_error(client, CSWP_FAILED, "Failed to allocate register list");
+        }
+        memset(lists + priv->num_reg_lists, 0, (deviceNo + 1 - priv->num_reg_lists) * sizeof(cswp_reg_list_t*));
+        priv->reg_lists = lists;
+        priv->num_reg_lists = deviceNo + 1;
     }
 
-    return res;
+    if (priv->reg_lists[deviceNo])
+    {
+        free(*regList);
+        *regList = priv->reg_lists[deviceNo];
+    }
+    else
+        priv->reg_lists[deviceNo] = *regList;
+    session_unlock(&priv->state_lock);
+
+    return CSWP_SUCCESS;
 }
 
-/**
- * Reply data for CSWP_GET_DEVICE_CAPABILITIES command
+/*
+ * Get the cache file name and key for a device's register list, with the
+ * state lock held
+ *
+ * Returns 0 if there is no cache directory or the device type is unknown
  */
-struct reply_data_get_device_capabilities {
-    /** Capabilities returned by the CSWP server */
-    unsigned* capabilities;
-    /** Capability data returned by the CSWP server */
-    unsigned* capabilityData;
-};
-
-static int cswp_get_device_capabilities_complete(cswp_client_t* client,
-                                                 void* replyData)
+static int cswp_client_reg_list_name(cswp_client_t* client,
+                                     unsigned deviceNo,
+                                     char* path,
+                                     size_t pathSize,
+                                     char* key,
+                                     size_t keySize)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    struct reply_data_get_device_capabilities* getDeviceCapabilitiesReplyData = (struct reply_data_get_device_capabilities*)replyData;
-    int res;
-    varint_t capabilities, capabilityData;
-
-    res = cswp_decode_get_device_capabilities_response_body(priv->rsp,
-                                                            &capabilities,
-                                                            &capabilityData);
-    if (res == CSWP_SUCCESS)
+    const char* deviceType;
+    size_t len;
+    int n;
+
+    if (priv->reg_list_cache == NULL || deviceNo >= priv->num_device_types ||
+        priv->device_types[deviceNo] == NULL)
+        return 0;
+    deviceType = priv->device_types[deviceNo];
+
+    n = snprintf(key, keySize, "%s\n%u\n%s", priv->session->server_id,
+                 priv->session->server_version, deviceType);
+    if (n < 0 || (size_t)n >= keySize)
+        return 0;
+
+    /* Readable name from the device type, hash of the full key */
+    n = snprintf(path, pathSize, "%s/", priv->reg_list_cache);
+    if (n < 0 || (size_t)n >= pathSize)
+        return 0;
+    len = n;
+    for (; *deviceType && len + 32 < pathSize; ++deviceType)
     {
-        *getDeviceCapabilitiesReplyData->capabilities = capabilities;
-        *getDeviceCapabilitiesReplyData->capabilityData = capabilityData;
+        if ((*deviceType >= 'a' && *deviceType <= 'z') || (*deviceType >= 'A' && *deviceType <= 'Z') ||
+            (*deviceType >= '0' && *deviceType <= '9') || *deviceType == '.' || *deviceType == '-')
+            path[len++] = *deviceType;
+        else
+            path[len++] = '_';
     }
+    n = snprintf(path + len, pathSize - len, "_%08x.reglist", (unsigned)cswp_reg_list_hash(key));
 
-    return res;
+    return n > 0 && (size_t)n < pathSize - len;
 }
 
-int cswp_get_device_capabilities(cswp_client_t* client,
-                                 varint_t deviceNo,
-                                 unsigned* capabilities,
-                                 unsigned* capabilityData)
+/*
+ * Get the cache file name and key for a device's register list
+ *
+ * Returns 0 if there is no cache directory or the device type is unknown
+ */
+static int cswp_client_reg_list_file(cswp_client_t* client,
+                                     unsigned deviceNo,
+                                     char* path,
+                                     size_t pathSize,
+                                     char* key,
+                                     size_t keySize)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
     int res;
 
-    cswp_client_prepare_cmd(client);
-    res = cswp_encode_get_device_capabilities_command(priv->cmd, deviceNo);
-    if (res == CSWP_SUCCESS)
+    session_lock(&priv->state_lock);
+    res = cswp_client_reg_list_name(client, deviceNo, path, pathSize, key, keySize);
+    session_unlock(&priv->state_lock);
+
+    return res;
+}
+
+/*
+ * Read a device's register list from the cache directory, if stored
+ */
+static cswp_reg_list_t* cswp_client_load_reg_list(cswp_client_t* client, unsigned deviceNo)
+{
+    char path[1024];
+    char key[SERVER_ID_SIZE + 512];
+    size_t keyLen;
+    cswp_reg_list_t* regList = NULL;
+    CSWP_BUFFER* buf = NULL;
+    FILE* f;
+    long fileSize;
+
+    if (!cswp_client_reg_list_file(client, deviceNo, path, sizeof(path), key, sizeof(key)))
+        return NULL;
+
+    f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    keyLen = strlen(key) + 1;
+    if (fseek(f, 0, SEEK_END) == 0 && (fileSize = ftell(f)) > 0 &&
+        (size_t)fileSize > sizeof(REG_LIST_FILE_MAGIC) + keyLen &&
+        fseek(f, 0, SEEK_SET) == 0)
     {
-        struct reply_data_get_device_capabilities* replyData = calloc(1, sizeof(struct reply_data_get_device_capabilities));
-        replyData->capabilities = capabilities;
-        replyData->capabilityData = capabilityData;
-        cswp_client_push_request(client, CSWP_GET_DEVICE_CAPABILITIES, cswp_get_device_capabilities_complete, replyData);
-        res = cswp_client_process(client);
+        buf = cswp_buffer_alloc(fileSize);
     }
-    return res;
+    if (buf && fread(buf->buf, 1, fileSize, f) == (size_t)fileSize)
+    {
+        buf->used = fileSize;
+        if (memcmp(buf->buf, REG_LIST_FILE_MAGIC, sizeof(REG_LIST_FILE_MAGIC)) == 0 &&
+            memcmp(buf->buf + sizeof(REG_LIST_FILE_MAGIC), key, keyLen) == 0)
+        {
+            /* Anything unreadable is fetched from the server instead */
+            cswp_buffer_seek(buf, sizeof(REG_LIST_FILE_MAGIC) + keyLen);
+            if (cswp_reg_list_build(client, buf, &regList) != CSWP_SUCCESS)
+                regList = NULL;
+            else if (buf->pos != buf->used)
+            {
+                free(regList);
+                regList = NULL;
+            }
+        }
+    }
+
+    cswp_buffer_free(buf);
+    fclose(f);
+
+    return regList;
+}
+
+/*
+ * Store a register list body in the cache directory
+ *
+ * The cache is an optimisation, so failures are ignored
+ */
+static void cswp_client_save_reg_list(cswp_client_t* client, unsigned deviceNo, const uint8_t* body, size_t size)
+{
+    char path[1024];
+    char key[SERVER_ID_SIZE + 512];
+    FILE* f;
+    int ok;
+
+    if (!cswp_client_reg_list_file(client, deviceNo, path, sizeof(path), key, sizeof(key)))
+        return;
+
+    f = fopen(path, "wb");
+    if (f == NULL)
+        return;
+
+    ok = fwrite(REG_LIST_FILE_MAGIC, 1, sizeof(REG_LIST_FILE_MAGIC), f) == sizeof(REG_LIST_FILE_MAGIC) &&
+        fwrite(key, 1, strlen(key) + 1, f) == strlen(key) + 1 &&
+        fwrite(body, 1, size, f) == size;
+    if (fclose(f) != 0 || !ok)
+        remove(path);
 }
 
 /**
  * Reply data for CSWP_REG_LIST command
  */
 struct reply_data_reg_list {
+    /** Device the list is for */
+    unsigned deviceNo;
     /** Number of registers returned by CSWP server */
     unsigned* registerCount;
-    /** Register info returned by CSWP server */
+    /** Register info returned by CSWP server, NULL to only keep the list */
     cswp_register_info_t* registerInfo;
     /** Size of the registerInfo buffer */
     size_t registerInfoSize;
@@ -849,92 +2826,129 @@ struct reply_data_reg_list {
     size_t strBufSize;
 };
 
+/*
+ * Copy a string to the caller's string buffer
+ */
+static int cswp_reg_list_copy_string(cswp_client_t* client,
+                                     struct reply_data_reg_list* regListReplyData,
+                                     const char* str,
+                                     const char** copy)
+{
+    size_t len = strlen(str);
+
+    if (len >= regListReplyData->strBufSize)
+        return cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "strBuf too small");
+
+    memcpy(regListReplyData->strBuf, str, len + 1);
+    *copy = regListReplyData->strBuf;
+    regListReplyData->strBuf += len + 1;
+    regListReplyData->strBufSize -= len + 1;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Copy a register list to the caller's buffers
+ */
+static int cswp_reg_list_copy(cswp_client_t* client,
+                              const cswp_reg_list_t* regList,
+                              struct reply_data_reg_list* regListReplyData)
+{
+    cswp_register_info_t* info = regListReplyData->registerInfo;
+    unsigned i;
+    int res = CSWP_SUCCESS;
+
+    *regListReplyData->registerCount = regList->count;
+    if (regListReplyData->registerInfoSize < regList->count)
+        return cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "registerInfo too small");
+
+    for (i = 0; i < regList->count && res == CSWP_SUCCESS; ++i)
+    {
+        info[i].id = regList->entries[i].id;
+        info[i].size = regList->entries[i].size;
+        res = cswp_reg_list_copy_string(client, regListReplyData, regList->entries[i].name, &info[i].name);
+        if (res == CSWP_SUCCESS)
+            res = cswp_reg_list_copy_string(client, regListReplyData, regList->entries[i].displayName, &info[i].displayName);
+        if (res == CSWP_SUCCESS)
+            res = cswp_reg_list_copy_string(client, regListReplyData, regList->entries[i].description, &info[i].description);
+    }
+
+    return res;
+}
+
 /*
  * Completion function for CSWP_REG_LIST
+ *
+ * The list is kept for the device, and stored in the cache directory
  */
 static int cswp_device_reg_list_complete(cswp_client_t* client,
                                          void* replyData)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
     struct reply_data_reg_list* regListReplyData = (struct reply_data_reg_list*)replyData;
-    varint_t regCount;
+    CSWP_BUFFER* rsp = priv->session->rsp;
+    cswp_reg_list_t* regList;
+    size_t start = rsp->pos;
     int res;
-    int i;
 
-    res = cswp_decode_reg_list_response_body(priv->rsp, &regCount);
-    if (res == CSWP_SUCCESS)
+    res = cswp_reg_list_build(client, rsp, &regList);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    cswp_client_save_reg_list(client, regListReplyData->deviceNo, rsp->buf + start, rsp->pos - start);
+    res = cswp_client_keep_reg_list(client, regListReplyData->deviceNo, &regList);
+    if (res == CSWP_SUCCESS && regListReplyData->registerInfo)
+        res = cswp_reg_list_copy(client, regList, regListReplyData);
+
+    return res;
+}
+
+/*
+ * Find a device's register list without asking the server: either kept from
+ * before or in the cache directory
+ */
+static const cswp_reg_list_t* cswp_client_known_reg_list(cswp_client_t* client, unsigned deviceNo)
+{
+    cswp_reg_list_t* regList;
+
+    if (cswp_client_find_reg_list(client, deviceNo) == NULL)
     {
-        *regListReplyData->registerCount = regCount;
-        if (regListReplyData->registerInfoSize < regCount)
-            res = cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "registerInfo too small");
+        regList = cswp_client_load_reg_list(client, deviceNo);
+        if (regList)
+            cswp_client_keep_reg_list(client, deviceNo, &regList);
     }
+
+    return cswp_client_find_reg_list(client, deviceNo);
+}
+
+/*
+ * Request the register list of a device
+ */
+static int cswp_client_request_reg_list(cswp_client_t* client,
+                                        unsigned deviceNo,
+                                        unsigned* registerCount,
+                                        cswp_register_info_t* registerInfo,
+                                        size_t registerInfoSize,
+                                        char *strBuf,
+                                        size_t strBufSize)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res;
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_encode_reg_list_command(priv->cmd, deviceNo);
     if (res == CSWP_SUCCESS)
     {
-        /* get register info */
-
-        const size_t nameSize = 256;
-        const size_t descSize = 1024;
-        char* regName = malloc(nameSize);
-        char* displayName = malloc(nameSize);
-        char* description = malloc(descSize);
-        for (i = 0; i < regCount && res == CSWP_SUCCESS; ++i)
-        {
-            varint_t regID, regSize;
-            res = cswp_decode_reg_info(priv->rsp, &regID,
-                                       regName, nameSize,
-                                       &regSize,
-                                       displayName, nameSize,
-                                       description, descSize);
-            if (res == CSWP_SUCCESS)
-            {
-				size_t len;
-                regListReplyData->registerInfo[i].id = regID;
-                regListReplyData->registerInfo[i].size = regSize;
-
-                len = strlen(regName);
-                if (len > regListReplyData->strBufSize)
-                {
-                    res = cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "strBuf too small");
-                }
-                else
-                {
-                    strcpy(regListReplyData->strBuf, regName);
-                    regListReplyData->registerInfo[i].name = regListReplyData->strBuf;
-                    regListReplyData->strBuf += len+1;
-                    regListReplyData->strBufSize -= len+1;
-                }
-
-                len = strlen(displayName);
-                if (len > regListReplyData->strBufSize)
-                {
-                    res = cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "strBuf too small");
-                }
-                else
-                {
-                    strcpy(regListReplyData->strBuf, displayName);
-                    regListReplyData->registerInfo[i].displayName = regListReplyData->strBuf;
-                    regListReplyData->strBuf += len+1;
-                    regListReplyData->strBufSize -= len+1;
-                }
-
-                len = strlen(description);
-                if (len > regListReplyData->strBufSize)
-                {
-                    res = cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "strBuf too small");
-                }
-                else
-                {
-                    strcpy(regListReplyData->strBuf, description);
-                    regListReplyData->registerInfo[i].description = regListReplyData->strBuf;
-                    regListReplyData->strBuf += len+1;
-                    regListReplyData->strBufSize -= len+1;
-                }
-            }
-        }
-        free(regName);
-        free(displayName);
-        free(description);
+        struct reply_data_reg_list* replyData = cswp_client_push_request(client, CSWP_REG_LIST, cswp_device_reg_list_complete, sizeof(struct reply_data_reg_list));
+        replyData->deviceNo = deviceNo;
+        replyData->registerCount = registerCount;
+        replyData->registerInfo = registerInfo;
+        replyData->registerInfoSize = registerInfoSize;
+        replyData->strBuf = strBuf;
+        replyData->strBufSize = strBufSize;
     }
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_process(client);
 
     return res;
 }
@@ -948,26 +2962,73 @@ int cswp_device_reg_list(cswp_client_t* client,
                          size_t strBufSize)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int res;
+    const cswp_reg_list_t* regList = NULL;
+    struct reply_data_reg_list copy;
 
-    cswp_client_prepare_cmd(client);
-    res = cswp_encode_reg_list_command(priv->cmd, deviceNo);
-    if (res == CSWP_SUCCESS)
+    /* Requests in batches complete in order, so always go to the server */
+    if (priv->batch_mode == BATCH_NONE)
+        regList = cswp_client_known_reg_list(client, deviceNo);
+    if (regList)
     {
-        struct reply_data_reg_list* replyData = calloc(1, sizeof(struct reply_data_reg_list));
-        replyData->registerCount = registerCount;
-        replyData->registerInfo = registerInfo;
-        replyData->registerInfoSize = registerInfoSize;
-        replyData->strBuf = strBuf;
-        replyData->strBufSize = strBufSize;
-        cswp_client_push_request(client, CSWP_REG_LIST, cswp_device_reg_list_complete, replyData);
+        copy.deviceNo = deviceNo;
+        copy.registerCount = registerCount;
+        copy.registerInfo = registerInfo;
+        copy.registerInfoSize = registerInfoSize;
+        copy.strBuf = strBuf;
+        copy.strBufSize = strBufSize;
+        return cswp_reg_list_copy(client, regList, &copy);
     }
+
+    return cswp_client_request_reg_list(client, deviceNo, registerCount, registerInfo, registerInfoSize,
+                                        strBuf, strBufSize);
+}
+
+
+int cswp_device_get_reg_list(cswp_client_t* client,
+                             unsigned deviceNo,
+                             const cswp_reg_list_t** regList)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    unsigned registerCount;
+    int res;
+
+    if (priv->batch_mode != BATCH_NONE)
+        return cswp_client_error(client, CSWP_NOT_PERMITTED, "Register list not available in a batch");
+
+    *regList = cswp_client_known_reg_list(client, deviceNo);
+    if (*regList)
+        return CSWP_SUCCESS;
+
+    res = cswp_client_request_reg_list(client, deviceNo, &registerCount, NULL, 0, NULL, 0);
     if (res == CSWP_SUCCESS)
-        res = cswp_client_process(client);
+        *regList = cswp_client_find_reg_list(client, deviceNo);
 
     return res;
 }
 
+
+int cswp_client_set_reg_list_cache(cswp_client_t* client,
+                                   const char* directory)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    char* copy = NULL;
+
+    if (directory)
+    {
+        copy = malloc(strlen(directory) + 1);
+        if (copy == NULL)
+            return cswp_client_error(client, CSWP_FAILED, "Failed to allocate cache directory");
+        strcpy(copy, directory);
+    }
+
+    session_lock(&priv->state_lock);
+    free(priv->reg_list_cache);
+    priv->reg_list_cache = copy;
+    session_unlock(&priv->state_lock);
+
+    return CSWP_SUCCESS;
+}
+
 /**
  * Reply data for CSWP_REG_READ command
  */
@@ -990,14 +3051,14 @@ static int cswp_device_reg_read_complete(cswp_client_t* client,
     varint_t count;
     int i;
 
-    res = cswp_decode_reg_read_response_body(priv->rsp, &count);
+    res = cswp_decode_reg_read_response_body(priv->session->rsp, &count);
     if (res == CSWP_SUCCESS)
     {
         if (regReadReplyData->registerValuesSize < count)
             res = cswp_client_error(client, CSWP_OUTPUT_BUFFER_OVERFLOW, "registerValues too small");
         else
             for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
-                res = cswp_buffer_get_uint32(priv->rsp, &regReadReplyData->registerValues[i]);
+                res = cswp_buffer_get_uint32(priv->session->rsp, &regReadReplyData->registerValues[i]);
     }
 
     return res;
@@ -1011,58 +3072,214 @@ int cswp_device_reg_read(cswp_client_t* client,
                          size_t registerValuesSize)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    varint_t *regIDs;
     int res;
     int i;
 
-    regIDs = malloc(registerCount * sizeof(varint_t));
-    for (i = 0; i < registerCount; ++i)
-        regIDs[i] = registerIDs[i];
     cswp_client_prepare_cmd(client);
-    res = cswp_encode_reg_read_command(priv->cmd, deviceNo, registerCount, regIDs);
-    free(regIDs);
+    res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + registerCount * CSWP_VARINT_MAX);
+    if (res == CSWP_SUCCESS)
+        res = cswp_encode_reg_read_command(priv->cmd, deviceNo, registerCount, NULL);
+    for (i = 0; res == CSWP_SUCCESS && i < registerCount; ++i)
+        res = cswp_client_put_reg_id(client, i, registerIDs[i]);
 
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_reg_read* replyData = calloc(1, sizeof(struct reply_data_reg_read));
+        struct reply_data_reg_read* replyData = cswp_client_push_request(client, CSWP_REG_READ, cswp_device_reg_read_complete, sizeof(struct reply_data_reg_read));
         replyData->registerValues = registerValues;
         replyData->registerValuesSize = registerValuesSize;
-        cswp_client_push_request(client, CSWP_REG_READ, cswp_device_reg_read_complete, replyData);
         res = cswp_client_process(client);
     }
 
-    return res;
-}
+    return res;
+}
+
+
+int cswp_device_reg_write(cswp_client_t* client,
+                          unsigned deviceNo,
+                          size_t registerCount,
+                          const unsigned* registerIDs,
+                          const uint32_t* registerValues,
+                          size_t registerValuesSize)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int i;
+    int res;
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + registerCount * (CSWP_VARINT_MAX + 4));
+    if (res == CSWP_SUCCESS)
+        res = cswp_encode_reg_write_command(priv->cmd, deviceNo, registerCount);
+    for (i = 0; res == CSWP_SUCCESS && i < registerCount; ++i)
+    {
+        res = cswp_client_put_reg_id(client, i, registerIDs[i]);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_slot(client, CSWP_TEMPLATE_REG_VALUE, i, priv->cmd->used, sizeof(uint32_t));
+        if (res == CSWP_SUCCESS)
+            res = cswp_buffer_put_uint32(priv->cmd, registerValues[i]);
+    }
+    if (res == CSWP_SUCCESS)
+    {
+        cswp_client_push_request(client, CSWP_REG_WRITE, NULL, 0);
+        res = cswp_client_process(client);
+    }
+
+    return res;
+}
+
+
+/*
+ * Largest memory transfer sent in one request
+ *
+ * Limited by the message size, and once the transfer rate is known, to about
+ * LINK_CHUNK_TIME_US of transfer
+ */
+static size_t cswp_client_mem_chunk_size(cswp_client_t* client)
+{
+    cswp_client_session_t* session = ((cswp_client_priv_t*)client->priv)->session;
+    size_t chunk = session->messageSize - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE;
+    uint64_t target;
+
+    session_lock(&session->lock);
+    target = session->link_rate * LINK_CHUNK_TIME_US / 1000000;
+    session_unlock(&session->lock);
+
+    if (target > 0 && target < LINK_CHUNK_MIN)
+        target = LINK_CHUNK_MIN;
+    if (target > 0 && target < chunk)
+        chunk = (size_t)target;
+
+    return chunk - (chunk % MEM_CHUNK_ALIGN);
+}
+
+/*
+ * Number of chunks to keep in flight
+ *
+ * Enough to cover a round trip, plus one being transferred
+ */
+static unsigned cswp_client_mem_chunk_depth(cswp_client_t* client, size_t chunk)
+{
+    uint64_t bdp = cswp_client_link_bdp(((cswp_client_priv_t*)client->priv)->session);
+    uint64_t depth;
+
+    if (bdp == 0)
+        return MEM_CHUNK_DEPTH;
+
+    depth = bdp / chunk + 2;
+
+    return depth < MEM_CHUNK_DEPTH ? (unsigned)depth : MEM_CHUNK_DEPTH;
+}
+
+/*
+ * Transfer memory in chunks that each fit in a message
+ *
+ * Each chunk is submitted as a batch so several are in flight at once, and
+ * the batches are collected in order.  Chunks start at multiples of the chunk
+ * size from address, or all at address for CSWP_MEM_NO_ADDR_INC.  No more
+ * chunks are submitted after one fails.
+ */
+static int cswp_client_mem_chunked(cswp_client_t* client,
+                                   cswp_commands_t type,
+                                   unsigned deviceNo,
+                                   uint64_t address,
+                                   size_t size,
+                                   cswp_access_size_t accessSize,
+                                   unsigned flags,
+                                   uint8_t* buf,
+                                   size_t* bytesRead)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    cswp_batch_handle_t handles[MEM_CHUNK_DEPTH];
+    size_t counts[MEM_CHUNK_DEPTH];
+    size_t chunk = cswp_client_mem_chunk_size(client);
+    unsigned depth = cswp_client_mem_chunk_depth(client, chunk);
+    size_t offset = 0;
+    size_t total = 0;
+    size_t n;
+    uint64_t chunkAddress;
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    unsigned ops;
+    unsigned slot;
+    int res = CSWP_SUCCESS;
+    int chunkRes;
+
+    /* Write chunks carry their data, so must share the request byte window */
+    if (type == CSWP_MEM_WRITE && chunk + CSWP_REQ_HEADER_SIZE + CSWP_CMD_RESERVE > ASYNC_MAX_BYTES / depth)
+    {
+        chunk = ASYNC_MAX_BYTES / depth - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE;
+        chunk -= chunk % MEM_CHUNK_ALIGN;
+    }
+
+    while (completed < submitted || (offset < size && res == CSWP_SUCCESS))
+    {
+        if (offset < size && res == CSWP_SUCCESS && submitted - completed < depth)
+        {
+            n = size - offset < chunk ? size - offset : chunk;
+            chunkAddress = (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset;
+            slot = submitted % MEM_CHUNK_DEPTH;
+            counts[slot] = n;
+
+            cswp_batch_begin(client, 1);
+            priv->chunking = 1;
+            if (type == CSWP_MEM_READ)
+                chunkRes = cswp_device_mem_read(client, deviceNo, chunkAddress, n, accessSize, flags,
+                                                buf + offset, &counts[slot]);
+            else
+                chunkRes = cswp_device_mem_write(client, deviceNo, chunkAddress, n, accessSize, flags,
+                                                 buf + offset);
+            if (chunkRes == CSWP_SUCCESS)
+                chunkRes = cswp_batch_submit(client, NULL, NULL, &handles[slot]);
+            priv->chunking = 0;
+
+            if (chunkRes == CSWP_SUCCESS)
+            {
+                submitted++;
+                offset += n;
+            }
+            else
+            {
+                /* Abandon the unsent chunk */
+                priv->batch_mode = BATCH_NONE;
+                cswp_client_prepare_cmd(client);
+                res = chunkRes;
+            }
+        }
+        else
+        {
+            slot = completed % MEM_CHUNK_DEPTH;
+            chunkRes = cswp_batch_wait(client, handles[slot], &ops);
+            completed++;
+            if (res == CSWP_SUCCESS)
+                res = chunkRes;
+            if (res == CSWP_SUCCESS)
+                total += counts[slot];
+        }
+    }
+
+    if (bytesRead)
+        *bytesRead = total;
 
+    return cswp_client_write_error(client, res);
+}
 
-int cswp_device_reg_write(cswp_client_t* client,
-                          unsigned deviceNo,
-                          size_t registerCount,
-                          const unsigned* registerIDs,
-                          const uint32_t* registerValues,
-                          size_t registerValuesSize)
+/*
+ * Note the caller's buffer for a read that may be alone in its request
+ */
+static void cswp_client_set_read_buffer(cswp_client_t* client,
+                                        cswp_commands_t type,
+                                        uint8_t* buf,
+                                        size_t size)
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
-    int i;
-    int res;
 
-    cswp_client_prepare_cmd(client);
-    res = cswp_encode_reg_write_command(priv->cmd, deviceNo, registerCount);
-    for (i = 0; i < registerCount; ++i)
-    {
-        cswp_buffer_put_varint(priv->cmd, registerIDs[i]);
-        cswp_buffer_put_uint32(priv->cmd, registerValues[i]);
-    }
-    if (res == CSWP_SUCCESS)
+    if (priv->num_cmds == 1)
     {
-        cswp_client_push_request(client, CSWP_REG_WRITE, NULL, 0);
-        res = cswp_client_process(client);
+        priv->rx_data = buf;
+        priv->rx_size = size;
+        priv->rx_type = type;
     }
-
-    return res;
 }
 
-
 /**
  * Reply data for CSWP_MEM_READ command
  */
@@ -1084,11 +3301,15 @@ static int cswp_device_mem_read_complete(cswp_client_t* client, void* replyData)
     varint_t bytesRead;
     void* pData;
 
-    res = cswp_decode_mem_read_response_body(priv->rsp, &bytesRead);
+    res = cswp_decode_mem_read_response_body(priv->session->rsp, &bytesRead);
     if (res == CSWP_SUCCESS)
     {
-        cswp_buffer_get_direct(priv->rsp, &pData, bytesRead);
-        memcpy(memReadReplyData->buf, pData, bytesRead);
+        /* Unless already received into the buffer */
+        if (priv->session->rx_direct != memReadReplyData->buf)
+        {
+            cswp_buffer_get_direct(priv->session->rsp, &pData, bytesRead);
+            memcpy(memReadReplyData->buf, pData, bytesRead);
+        }
         *memReadReplyData->bytesRead = bytesRead;
     }
 
@@ -1106,15 +3327,23 @@ int cswp_device_mem_read(cswp_client_t* client,
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
     int res;
+    size_t start;
+
+    if (priv->batch_mode == BATCH_NONE && size > cswp_client_mem_chunk_size(client))
+        return cswp_client_mem_chunked(client, CSWP_MEM_READ, deviceNo, address, size, accessSize, flags,
+                                       buf, bytesRead);
 
     cswp_client_prepare_cmd(client);
+    start = priv->cmd->used;
     res = cswp_encode_mem_read_command(priv->cmd, deviceNo, address, size, accessSize, flags);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_add_address_slot(client, start, CSWP_MEM_READ, deviceNo);
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_mem_read* replyData = calloc(1, sizeof(struct reply_data_mem_read));
+        struct reply_data_mem_read* replyData = cswp_client_push_request(client, CSWP_MEM_READ, cswp_device_mem_read_complete, sizeof(struct reply_data_mem_read));
         replyData->buf = buf;
         replyData->bytesRead = bytesRead;
-        cswp_client_push_request(client, CSWP_MEM_READ, cswp_device_mem_read_complete, replyData);
+        cswp_client_set_read_buffer(client, CSWP_MEM_READ, buf, size);
         res = cswp_client_process(client);
     }
 
@@ -1122,6 +3351,24 @@ int cswp_device_mem_read(cswp_client_t* client,
 }
 
 
+/*
+ * Check whether size bytes of command data may be sent from the caller's
+ * buffer
+ *
+ * Only for commands sent before the encoding call returns, so not in batches
+ * (other than chunks of a large transfer) or when writes may be queued
+ */
+static int cswp_client_can_send_direct(cswp_client_t* client, size_t size)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+
+    return size >= SENDV_MIN_SIZE &&
+        priv->session->transport->sendv != NULL &&
+        ((priv->batch_mode == BATCH_NONE && priv->wb_max_ops == 0) || priv->chunking) &&
+        priv->cmd->used + CSWP_CMD_RESERVE + size <= priv->session->messageSize;
+}
+
+
 int cswp_device_mem_write(cswp_client_t* client,
                           unsigned deviceNo,
                           uint64_t address,
@@ -1132,9 +3379,36 @@ int cswp_device_mem_write(cswp_client_t* client,
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
     int res;
+    size_t start;
+
+    if (priv->batch_mode == BATCH_NONE && size > cswp_client_mem_chunk_size(client))
+        return cswp_client_mem_chunked(client, CSWP_MEM_WRITE, deviceNo, address, size, accessSize, flags,
+                                       (uint8_t*)pData, NULL);
 
     cswp_client_prepare_cmd(client);
-    res = cswp_encode_mem_write_command(priv->cmd, deviceNo, address, size, accessSize, flags, pData);
+    if (cswp_client_can_send_direct(client, size))
+    {
+        /* Immediate request: send the data from the caller's buffer */
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE);
+        if (res == CSWP_SUCCESS)
+            res = cswp_encode_mem_write_header(priv->cmd, deviceNo, address, size, accessSize, flags);
+        if (res == CSWP_SUCCESS)
+        {
+            priv->ext_data = pData;
+            priv->ext_size = size;
+        }
+    }
+    else
+    {
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + size);
+        start = priv->cmd->used;
+        if (res == CSWP_SUCCESS)
+            res = cswp_encode_mem_write_command(priv->cmd, deviceNo, address, size, accessSize, flags, pData);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_address_slot(client, start, CSWP_MEM_WRITE, deviceNo);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_slot(client, CSWP_TEMPLATE_DATA, 0, priv->cmd->used - size, size);
+    }
     if (res == CSWP_SUCCESS)
         cswp_client_push_request(client, CSWP_MEM_WRITE, NULL, 0);
     if (res == CSWP_SUCCESS)
@@ -1165,12 +3439,15 @@ static int cswp_device_mem_poll_complete(cswp_client_t* client, void* replyData)
     varint_t bytesRead;
     void* pData;
 
-    res = cswp_decode_mem_poll_response_body(priv->rsp, &bytesRead);
+    res = cswp_decode_mem_poll_response_body(priv->session->rsp, &bytesRead);
     if (res == CSWP_SUCCESS)
     {
-        cswp_buffer_get_direct(priv->rsp, &pData, bytesRead);
-        if (memPollReplyData->buf)
+        /* Unless already received into the buffer */
+        if (memPollReplyData->buf && priv->session->rx_direct != memPollReplyData->buf)
+        {
+            cswp_buffer_get_direct(priv->session->rsp, &pData, bytesRead);
             memcpy(memPollReplyData->buf, pData, bytesRead);
+        }
         if (memPollReplyData->bytesRead)
             *memPollReplyData->bytesRead = bytesRead;
     }
@@ -1193,18 +3470,586 @@ int cswp_device_mem_poll(cswp_client_t* client,
 {
     cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
     int res;
+    size_t start;
 
     cswp_client_prepare_cmd(client);
+    start = priv->cmd->used;
     res = cswp_encode_mem_poll_command(priv->cmd, deviceNo,
                                        address, size, accessSize, flags,
                                        tries, interval, mask, value);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_add_address_slot(client, start, CSWP_MEM_POLL, deviceNo);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_add_slot(client, CSWP_TEMPLATE_DATA, 0, priv->cmd->used - size, size);
     if (res == CSWP_SUCCESS)
     {
-        struct reply_data_mem_poll* replyData = calloc(1, sizeof(struct reply_data_mem_poll));
+        struct reply_data_mem_poll* replyData = cswp_client_push_request(client, CSWP_MEM_POLL, cswp_device_mem_poll_complete, sizeof(struct reply_data_mem_poll));
         replyData->buf = buf;
         replyData->bytesRead = bytesRead;
-        cswp_client_push_request(client, CSWP_MEM_POLL, cswp_device_mem_poll_complete, replyData);
+        if (buf)
+            cswp_client_set_read_buffer(client, CSWP_MEM_POLL, buf, size);
+        res = cswp_client_process(client);
+    }
+
+    return res;
+}
+
+
+int cswp_device_mem_fill(cswp_client_t* client,
+                         unsigned deviceNo,
+                         uint64_t address,
+                         size_t size,
+                         cswp_access_size_t accessSize,
+                         unsigned flags,
+                         const uint8_t* pattern,
+                         size_t patternSize)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    int res;
+    size_t start;
+
+    if (patternSize == 0 || patternSize > CSWP_MEM_FILL_MAX_PATTERN)
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Invalid fill pattern size %u", (unsigned)patternSize);
+
+    cswp_client_prepare_cmd(client);
+    res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + patternSize);
+    start = priv->cmd->used;
+    if (res == CSWP_SUCCESS)
+        res = cswp_encode_mem_fill_command(priv->cmd, deviceNo, address, size, accessSize, flags,
+                                           pattern, patternSize);
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_add_address_slot(client, start, CSWP_MEM_FILL, deviceNo);
+    if (res == CSWP_SUCCESS)
+        cswp_client_push_request(client, CSWP_MEM_FILL, NULL, 0);
+    if (res == CSWP_SUCCESS)
         res = cswp_client_process(client);
+
+    return res;
+}
+
+
+/**
+ * Reply data for CSWP_MEM_READ_MULTI and CSWP_MEM_WRITE_MULTI commands
+ */
+struct reply_data_mem_multi {
+    /** Segments in the request */
+    const cswp_mem_segment_t* segs;
+    /** Number of segments in the request */
+    unsigned count;
+    /** Receives the status of each segment, may be NULL */
+    int* status;
+};
+
+/*
+ * Decode the segment status of a CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI response, returning the first failure
+ */
+static int cswp_client_mem_multi_status(cswp_client_t* client, struct reply_data_mem_multi* reply)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    varint_t count;
+    varint_t status;
+    int segRes = CSWP_SUCCESS;
+    unsigned i;
+    int res;
+
+    res = cswp_decode_mem_segment_status_count(priv->session->rsp, &count);
+    if (res == CSWP_SUCCESS && count != reply->count)
+        res = cswp_client_error(client, CSWP_COMMS, "Unexpected segment count: %lu", (unsigned long)count);
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+    {
+        res = cswp_decode_mem_segment_status(priv->session->rsp, &status);
+        if (res == CSWP_SUCCESS)
+        {
+            if (reply->status)
+                reply->status[i] = (int)status;
+            if (status != CSWP_SUCCESS && segRes == CSWP_SUCCESS)
+                segRes = (int)status;
+        }
+    }
+
+    return (res != CSWP_SUCCESS) ? res : segRes;
+}
+
+/*
+ * Completion function for CSWP_MEM_READ_MULTI
+ */
+static int cswp_device_mem_read_multi_complete(cswp_client_t* client, void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_multi* reply = (struct reply_data_mem_multi*)replyData;
+    varint_t size;
+    size_t total = 0;
+    uint8_t* pData;
+    unsigned i;
+    int res;
+
+    for (i = 0; i < reply->count; ++i)
+        total += reply->segs[i].size;
+
+    res = cswp_decode_mem_read_multi_response_body(priv->session->rsp, &size);
+    if (res == CSWP_SUCCESS && size != total)
+        res = cswp_client_error(client, CSWP_COMMS, "Unexpected read size: %lu", (unsigned long)size);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(priv->session->rsp, (void**)&pData, size);
+    for (i = 0; i < reply->count && res == CSWP_SUCCESS; ++i)
+    {
+        memcpy(reply->segs[i].data, pData, reply->segs[i].size);
+        pData += reply->segs[i].size;
+    }
+    if (res == CSWP_SUCCESS)
+        res = cswp_client_mem_multi_status(client, reply);
+
+    return res;
+}
+
+/*
+ * Completion function for CSWP_MEM_WRITE_MULTI
+ */
+static int cswp_device_mem_write_multi_complete(cswp_client_t* client, void* replyData)
+{
+    return cswp_client_mem_multi_status(client, (struct reply_data_mem_multi*)replyData);
+}
+
+/*
+ * Number of segments from segs that fit in one CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI request and its response
+ */
+static unsigned cswp_client_mem_multi_group(cswp_client_t* client, cswp_commands_t type,
+                                            const cswp_mem_segment_t* segs, unsigned count)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    size_t limit = priv->session->messageSize - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE;
+    size_t reqSize = 0;
+    size_t rspSize = 0;
+    unsigned n;
+
+    for (n = 0; n < count; ++n)
+    {
+        if (segs[n].size > limit)
+            break;
+        reqSize += MEM_MULTI_SEGMENT_BYTES + (type == CSWP_MEM_WRITE_MULTI ? segs[n].size : 0);
+        rspSize += MEM_MULTI_STATUS_BYTES + (type == CSWP_MEM_READ_MULTI ? segs[n].size : 0);
+        if (reqSize > limit || rspSize > limit)
+            break;
+    }
+
+    return n;
+}
+
+/*
+ * Read or write a list of segments, in as few messages as they fit in
+ */
+static int cswp_client_mem_multi(cswp_client_t* client,
+                                 cswp_commands_t type,
+                                 unsigned deviceNo,
+                                 cswp_access_size_t accessSize,
+                                 unsigned flags,
+                                 const cswp_mem_segment_t* segs,
+                                 unsigned count,
+                                 int* status)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_multi* replyData;
+    unsigned first;
+    unsigned n;
+    unsigned i;
+    size_t dataSize;
+    int res = CSWP_SUCCESS;
+
+    /* Segments in messages that are not sent are reported as failed */
+    for (i = 0; status && i < count; ++i)
+        status[i] = CSWP_FAILED;
+
+    for (first = 0; first < count && res == CSWP_SUCCESS; first += n)
+    {
+        n = cswp_client_mem_multi_group(client, type, segs + first, count - first);
+        if (n == 0)
+            return cswp_client_error(client, CSWP_BAD_ARGS, "Memory segment %u too large for one message", first);
+
+        dataSize = 0;
+        for (i = 0; type == CSWP_MEM_WRITE_MULTI && i < n; ++i)
+            dataSize += segs[first + i].size;
+
+        cswp_client_prepare_cmd(client);
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + n * MEM_MULTI_SEGMENT_BYTES + dataSize);
+        if (res == CSWP_SUCCESS)
+        {
+            if (type == CSWP_MEM_READ_MULTI)
+                res = cswp_encode_mem_read_multi_command(priv->cmd, deviceNo, accessSize, flags, n);
+            else
+                res = cswp_encode_mem_write_multi_command(priv->cmd, deviceNo, accessSize, flags, n);
+        }
+        for (i = 0; i < n && res == CSWP_SUCCESS; ++i)
+            res = cswp_encode_mem_segment(priv->cmd, segs[first + i].address, segs[first + i].size);
+        for (i = 0; type == CSWP_MEM_WRITE_MULTI && i < n && res == CSWP_SUCCESS; ++i)
+            res = cswp_buffer_put_data(priv->cmd, segs[first + i].data, segs[first + i].size);
+        if (res == CSWP_SUCCESS)
+        {
+            replyData = cswp_client_push_request(client, type,
+                                                 (type == CSWP_MEM_READ_MULTI) ? cswp_device_mem_read_multi_complete
+                                                                               : cswp_device_mem_write_multi_complete,
+                                                 sizeof(struct reply_data_mem_multi));
+            replyData->segs = segs + first;
+            replyData->count = n;
+            replyData->status = status ? status + first : NULL;
+            res = cswp_client_process(client);
+        }
+    }
+
+    return res;
+}
+
+int cswp_device_mem_read_multi(cswp_client_t* client,
+                               unsigned deviceNo,
+                               cswp_access_size_t accessSize,
+                               unsigned flags,
+                               const cswp_mem_segment_t* segs,
+                               unsigned count,
+                               int* status)
+{
+    return cswp_client_mem_multi(client, CSWP_MEM_READ_MULTI, deviceNo, accessSize, flags, segs, count, status);
+}
+
+int cswp_device_mem_write_multi(cswp_client_t* client,
+                                unsigned deviceNo,
+                                cswp_access_size_t accessSize,
+                                unsigned flags,
+                                const cswp_mem_segment_t* segs,
+                                unsigned count,
+                                int* status)
+{
+    return cswp_client_mem_multi(client, CSWP_MEM_WRITE_MULTI, deviceNo, accessSize, flags, segs, count, status);
+}
+
+
+/**
+ * Reply data for CSWP_MEM_CHECKSUM command
+ */
+struct reply_data_mem_checksum {
+    /** Receives the digests */
+    uint64_t* digests;
+    /** Number of digests expected */
+    size_t count;
+};
+
+/*
+ * Completion function for CSWP_MEM_CHECKSUM
+ */
+static int cswp_device_mem_checksum_complete(cswp_client_t* client, void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_checksum* reply = (struct reply_data_mem_checksum*)replyData;
+    varint_t count;
+    size_t i;
+    int res;
+
+    res = cswp_decode_mem_checksum_response_body(priv->session->rsp, &count);
+    if (res == CSWP_SUCCESS && count != reply->count)
+        res = cswp_client_error(client, CSWP_COMMS, "Unexpected digest count: %lu", (unsigned long)count);
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+        res = cswp_decode_mem_checksum_digest(priv->session->rsp, &reply->digests[i]);
+
+    return res;
+}
+
+int cswp_device_mem_checksum(cswp_client_t* client,
+                             unsigned deviceNo,
+                             uint64_t address,
+                             size_t size,
+                             cswp_access_size_t accessSize,
+                             unsigned flags,
+                             cswp_checksum_t algorithm,
+                             size_t blockSize,
+                             uint64_t* digests)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_checksum* replyData;
+    size_t count = cswp_checksum_count(size, blockSize);
+    size_t maxCount;
+    size_t first;
+    size_t n;
+    size_t offset;
+    size_t len;
+    size_t start;
+    int res = CSWP_SUCCESS;
+
+    /* Each message covers as many whole blocks as its digests fit in */
+    maxCount = (priv->session->messageSize - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE) / MEM_CHECKSUM_DIGEST_BYTES;
+    for (first = 0; first < count && res == CSWP_SUCCESS; first += n)
+    {
+        n = count - first;
+        if (n > maxCount)
+            n = maxCount;
+        if (count == 1)
+        {
+            offset = 0;
+            len = size;
+        }
+        else
+        {
+            offset = first * blockSize;
+            len = size - offset;
+            if (len > n * blockSize)
+                len = n * blockSize;
+        }
+
+        cswp_client_prepare_cmd(client);
+        start = priv->cmd->used;
+        res = cswp_encode_mem_checksum_command(priv->cmd, deviceNo,
+                                               (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                               len, accessSize, flags, algorithm, blockSize);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_address_slot(client, start, CSWP_MEM_CHECKSUM, deviceNo);
+        if (res == CSWP_SUCCESS)
+        {
+            replyData = cswp_client_push_request(client, CSWP_MEM_CHECKSUM, cswp_device_mem_checksum_complete,
+                                                 sizeof(struct reply_data_mem_checksum));
+            replyData->digests = digests + first;
+            replyData->count = n;
+            res = cswp_client_process(client);
+        }
+    }
+
+    return res;
+}
+
+
+/**
+ * Reply data for CSWP_MEM_READ_DELTA command
+ */
+struct reply_data_mem_read_delta {
+    /** Receives the data of changed blocks */
+    uint8_t* buf;
+    /** Number of bytes in the request */
+    size_t size;
+    /** Bytes in each block */
+    size_t blockSize;
+    /** Number of blocks in the request */
+    size_t count;
+    /** Receives the changed block bitmap, may be NULL */
+    uint8_t* changed;
+    /** Index of the first block of the request in changed */
+    size_t first;
+};
+
+/*
+ * Completion function for CSWP_MEM_READ_DELTA
+ */
+static int cswp_device_mem_read_delta_complete(cswp_client_t* client, void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_read_delta* reply = (struct reply_data_mem_read_delta*)replyData;
+    varint_t count;
+    uint8_t* bitmap;
+    void* pData;
+    size_t offset;
+    size_t n;
+    size_t i;
+    int res;
+
+    res = cswp_decode_mem_read_delta_response_body(priv->session->rsp, &count);
+    if (res == CSWP_SUCCESS && count != reply->count)
+        res = cswp_client_error(client, CSWP_COMMS, "Unexpected block count: %lu", (unsigned long)count);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(priv->session->rsp, (void**)&bitmap, (count + 7) / 8);
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+    {
+        if ((bitmap[i / 8] & (1 << (i % 8))) == 0)
+            continue;
+        offset = i * reply->blockSize;
+        n = reply->size - offset;
+        if (n > reply->blockSize)
+            n = reply->blockSize;
+        res = cswp_buffer_get_direct(priv->session->rsp, &pData, n);
+        if (res == CSWP_SUCCESS)
+        {
+            memcpy(reply->buf + offset, pData, n);
+            if (reply->changed)
+                reply->changed[(reply->first + i) / 8] |= (uint8_t)(1 << ((reply->first + i) % 8));
+        }
+    }
+
+    return res;
+}
+
+int cswp_device_mem_read_delta(cswp_client_t* client,
+                               unsigned deviceNo,
+                               uint64_t address,
+                               size_t size,
+                               cswp_access_size_t accessSize,
+                               unsigned flags,
+                               size_t blockSize,
+                               uint8_t* buf,
+                               uint8_t* changed)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_read_delta* replyData;
+    size_t limit = priv->session->messageSize - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE;
+    size_t count = cswp_checksum_count(size, blockSize);
+    size_t block = (count == 1) ? size : blockSize;
+    size_t maxCount;
+    size_t first;
+    size_t n;
+    size_t offset;
+    size_t len;
+    size_t i;
+    size_t start;
+    int res = CSWP_SUCCESS;
+
+    /* Each message carries a digest for each of its blocks, and must have
+       room in the response for all of them to have changed */
+    maxCount = limit / MEM_CHECKSUM_DIGEST_BYTES;
+    if (maxCount > limit / (block + 1))
+        maxCount = limit / (block + 1);
+    if (maxCount == 0)
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Delta read block of %lu bytes too large for one message",
+                                 (unsigned long)block);
+
+    if (changed)
+        memset(changed, 0, (count + 7) / 8);
+
+    for (first = 0; first < count && res == CSWP_SUCCESS; first += n)
+    {
+        n = count - first;
+        if (n > maxCount)
+            n = maxCount;
+        offset = first * block;
+        len = size - offset;
+        if (len > n * block)
+            len = n * block;
+
+        cswp_client_prepare_cmd(client);
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + n * MEM_CHECKSUM_DIGEST_BYTES);
+        start = priv->cmd->used;
+        if (res == CSWP_SUCCESS)
+            res = cswp_encode_mem_read_delta_command(priv->cmd, deviceNo,
+                                                     (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                                     len, accessSize, flags, MEM_DELTA_CHECKSUM, blockSize, n);
+        for (i = 0; i < n && res == CSWP_SUCCESS; ++i)
+            res = cswp_encode_mem_read_delta_digest(priv->cmd,
+                                                    cswp_checksum(MEM_DELTA_CHECKSUM, buf + offset + i * block,
+                                                                  (len - i * block < block) ? len - i * block : block));
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_address_slot(client, start, CSWP_MEM_READ_DELTA, deviceNo);
+        if (res == CSWP_SUCCESS)
+        {
+            replyData = cswp_client_push_request(client, CSWP_MEM_READ_DELTA, cswp_device_mem_read_delta_complete,
+                                                 sizeof(struct reply_data_mem_read_delta));
+            replyData->buf = buf + offset;
+            replyData->size = len;
+            replyData->blockSize = block;
+            replyData->count = n;
+            replyData->changed = changed;
+            replyData->first = first;
+            res = cswp_client_process(client);
+        }
+    }
+
+    return res;
+}
+
+
+/**
+ * Reply data for CSWP_MEM_SEARCH command
+ */
+struct reply_data_mem_search {
+    /** Receives the match addresses */
+    uint64_t* hits;
+    /** Most matches requested */
+    size_t maxHits;
+    /** Receives the number of matches */
+    size_t* hitCount;
+};
+
+/*
+ * Completion function for CSWP_MEM_SEARCH
+ */
+static int cswp_device_mem_search_complete(cswp_client_t* client, void* replyData)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_search* reply = (struct reply_data_mem_search*)replyData;
+    varint_t count;
+    size_t i;
+    int res;
+
+    res = cswp_decode_mem_search_response_body(priv->session->rsp, &count);
+    if (res == CSWP_SUCCESS && count > reply->maxHits)
+        res = cswp_client_error(client, CSWP_COMMS, "Unexpected match count: %lu", (unsigned long)count);
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+        res = cswp_decode_mem_search_hit(priv->session->rsp, &reply->hits[i]);
+    if (res == CSWP_SUCCESS)
+        *reply->hitCount = count;
+
+    return res;
+}
+
+int cswp_device_mem_search(cswp_client_t* client,
+                           unsigned deviceNo,
+                           uint64_t address,
+                           size_t size,
+                           cswp_access_size_t accessSize,
+                           unsigned flags,
+                           const uint8_t* pattern,
+                           const uint8_t* mask,
+                           size_t patternSize,
+                           size_t alignment,
+                           uint64_t* hits,
+                           size_t maxHits,
+                           size_t* hitCount)
+{
+    cswp_client_priv_t* priv = (cswp_client_priv_t*)client->priv;
+    struct reply_data_mem_search* replyData;
+    size_t maxPerMsg = (priv->session->messageSize - CSWP_REQ_HEADER_SIZE - CSWP_CMD_RESERVE) / MEM_SEARCH_HIT_BYTES;
+    uint64_t end = address + size;
+    size_t total = 0;
+    size_t found;
+    size_t n;
+    size_t start;
+    int batch = (priv->batch_mode != BATCH_NONE);
+    int res = CSWP_SUCCESS;
+
+    *hitCount = 0;
+    if (patternSize == 0 || patternSize > CSWP_MEM_SEARCH_MAX_PATTERN)
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Invalid search pattern size %u", (unsigned)patternSize);
+    if (flags & CSWP_MEM_NO_ADDR_INC)
+        return cswp_client_error(client, CSWP_BAD_ARGS, "Search requires address increment");
+
+    while (total < maxHits && address < end && res == CSWP_SUCCESS)
+    {
+        n = maxHits - total;
+        if (n > maxPerMsg)
+            n = maxPerMsg;
+
+        found = 0;
+        cswp_client_prepare_cmd(client);
+        res = cswp_client_reserve_cmd(client, CSWP_CMD_RESERVE + 2 * patternSize);
+        start = priv->cmd->used;
+        if (res == CSWP_SUCCESS)
+            res = cswp_encode_mem_search_command(priv->cmd, deviceNo, address, end - address, accessSize, flags,
+                                                 alignment, n, pattern, mask, patternSize);
+        if (res == CSWP_SUCCESS)
+            res = cswp_client_add_address_slot(client, start, CSWP_MEM_SEARCH, deviceNo);
+        if (res == CSWP_SUCCESS)
+        {
+            replyData = cswp_client_push_request(client, CSWP_MEM_SEARCH, cswp_device_mem_search_complete,
+                                                 sizeof(struct reply_data_mem_search));
+            replyData->hits = hits + total;
+            replyData->maxHits = n;
+            replyData->hitCount = batch ? hitCount : &found;
+            res = cswp_client_process(client);
+        }
+
+        /* The results of a batched request are not known until later */
+        if (batch)
+            break;
+
+        total += found;
+        *hitCount = total;
+        if (found < n)
+            break;
+        /* Continue after the last match */
+        address = hits[total - 1] + 1;
     }
 
     return res;
@@ -25,8 +25,24 @@ extern "C" {
 
 struct _cswp_client_t;
 
+/**
+ * Data segment for cswp_client_transport_t::sendv() and receivev()
+ */
+typedef struct
+{
+    /** Start of segment */
+    void* data;
+    /** Number of bytes in segment */
+    size_t size;
+} cswp_client_iovec_t;
+
 /**
  * Client transport functions
+ *
+ * Clients sharing a connection call the transport from several threads, but
+ * only one thread at a time sends (send or sendv) and only one at a time
+ * receives (receive or receivev).  Unless duplex is set, no thread sends
+ * while another is receiving.
  */
 typedef struct _cswp_client_transport_t
 {
@@ -54,6 +70,32 @@ typedef struct _cswp_client_transport_t
      * Private data for transport
      */
     void *priv;
+
+    /**
+     * Send data gathered from several segments as one message
+     *
+     * Optional, may be NULL.  When present, large memory writes are sent
+     * from the caller's buffer instead of being copied into the request.
+     */
+    int (*sendv)(struct _cswp_client_t* client, struct _cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count);
+
+    /**
+     * Receive a message, filling the segments in order
+     *
+     * Optional, may be NULL.  Segments after the one holding the end of the
+     * message are left untouched.  When present, large memory reads are
+     * received straight into the caller's buffer.
+     */
+    int (*receivev)(struct _cswp_client_t* client, struct _cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count, size_t* used);
+
+    /**
+     * Set if send and sendv may be called on one thread while receive or
+     * receivev is in progress on another
+     *
+     * When clear, a client sharing the connection waits for the response
+     * being received before sending its request.
+     */
+    int duplex;
 } cswp_client_transport_t;
 
 
@@ -82,6 +124,21 @@ typedef struct _cswp_client_t
 int cswp_client_init(cswp_client_t* client,
                      cswp_client_transport_t* transport);
 
+/**
+ * Initialise CSWP client sharing the connection of another client
+ *
+ * Each client has its own batch and error message, so clients sharing a
+ * connection can be used from different threads.  Requests are sent in the
+ * order they are submitted and responses are received by whichever client
+ * is waiting for one.  The connection is opened and closed by cswp_init()
+ * and cswp_term() on the client passed to cswp_client_init().
+ *
+ * @param client Pointer to cswp_client_t
+ * @param shared Client initialised by cswp_client_init()
+ */
+int cswp_client_init_shared(cswp_client_t* client,
+                            cswp_client_t* shared);
+
 /**
  * Cleanup CSWP client
  *
@@ -113,6 +170,17 @@ int cswp_init(cswp_client_t* client,
               size_t         serverIDSize,
               unsigned*      serverVersion);
 
+/**
+ * Get the maximum message size for the connection
+ *
+ * This is CSWP_DEFAULT_MESSAGE_SIZE unless a larger size was agreed with
+ * the server by cswp_init()
+ *
+ * @param client Pointer to cswp_client_t
+ * @return The maximum size of a request or response message in bytes
+ */
+size_t cswp_client_get_message_size(cswp_client_t* client);
+
 /**
  * Close CSWP connection to target
  *
@@ -138,6 +206,256 @@ int cswp_batch_begin(cswp_client_t* client, int abortOnError);
  */
 int cswp_batch_end(cswp_client_t* client, unsigned* opsCompleted);
 
+/**
+ * Handle for a batch submitted by cswp_batch_submit()
+ */
+typedef unsigned cswp_batch_handle_t;
+
+/**
+ * Default number of batches that may be outstanding on the transport
+ */
+#define CSWP_DEFAULT_BATCH_WINDOW 4
+
+/**
+ * Completion callback for a submitted batch
+ *
+ * Called from whichever client call receives the batch response, which may
+ * be on another thread for a shared connection.  It must not make calls on
+ * any client using the connection.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param handle Handle returned by cswp_batch_submit()
+ * @param result Result of the batch, as would be returned by cswp_batch_end()
+ * @param opsCompleted Number of operations completed
+ * @param userData Value passed to cswp_batch_submit()
+ */
+typedef void (*cswp_batch_callback_t)(cswp_client_t* client,
+                                      cswp_batch_handle_t handle,
+                                      int result,
+                                      unsigned opsCompleted,
+                                      void* userData);
+
+/**
+ * Send batch of commands without waiting for the response
+ *
+ * Ends a batch started with cswp_batch_begin().  The buffers passed to the
+ * commands in the batch must remain valid until the batch completes.
+ *
+ * If the window of outstanding batches is full, the oldest outstanding
+ * response is received first.  Completed batches are reported through the
+ * callback or, when callback is NULL, must be collected with
+ * cswp_batch_wait().  Any other client request first completes all
+ * outstanding batches.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param callback Function to call on completion, or NULL
+ * @param userData Value passed to callback
+ * @param handle Receives handle for the batch, may be NULL if callback is set
+ */
+int cswp_batch_submit(cswp_client_t* client,
+                      cswp_batch_callback_t callback,
+                      void* userData,
+                      cswp_batch_handle_t* handle);
+
+/**
+ * Wait for a submitted batch to complete
+ *
+ * Receives responses up to and including the batch.  Only batches submitted
+ * by this client without a callback can be waited for.  The handle may not
+ * be used after this call.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param handle Handle returned by cswp_batch_submit()
+ * @param opsCompleted Receives number of operations completed
+ * @return Result of the batch, as would be returned by cswp_batch_end()
+ */
+int cswp_batch_wait(cswp_client_t* client,
+                    cswp_batch_handle_t handle,
+                    unsigned* opsCompleted);
+
+/**
+ * Test whether a submitted batch has completed
+ *
+ * Does not receive any responses
+ *
+ * @param client Pointer to cswp_client_t
+ * @param handle Handle returned by cswp_batch_submit()
+ * @return Non-zero if the batch has completed
+ */
+int cswp_batch_poll(cswp_client_t* client,
+                    cswp_batch_handle_t handle);
+
+/**
+ * Receive responses for all batches submitted by the client
+ *
+ * Batch results are reported through the callback or cswp_batch_wait()
+ *
+ * @param client Pointer to cswp_client_t
+ */
+int cswp_batch_flush(cswp_client_t* client);
+
+/**
+ * Set the number of batches that may be outstanding on the transport
+ *
+ * The window is shared by all clients using the connection.  The default
+ * is CSWP_DEFAULT_BATCH_WINDOW.  Batches already in flight are not affected.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param window Number of outstanding batches, at least 1
+ */
+int cswp_client_set_window(cswp_client_t* client, unsigned window);
+
+/**
+ * Link performance estimated from the requests sent
+ */
+typedef struct
+{
+    /** Smoothed round trip time of a small request in microseconds, 0 until measured */
+    uint64_t rtt;
+    /** Smoothed transfer rate in bytes per second, 0 until measured */
+    uint64_t bandwidth;
+    /** Number of round trip time measurements */
+    unsigned rttSamples;
+    /** Number of transfer rate measurements */
+    unsigned bandwidthSamples;
+} cswp_client_link_stats_t;
+
+/**
+ * Get the current link estimates
+ *
+ * The estimates are kept for the connection, so are shared by all clients
+ * using it.  Large memory transfers are split into chunks sized from the
+ * transfer rate, and write-behind batches are sized from the product of
+ * round trip time and transfer rate unless a limit is given.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param stats Receives the estimates
+ */
+int cswp_client_get_link_stats(cswp_client_t* client, cswp_client_link_stats_t* stats);
+
+/**
+ * Batch recorded for replay
+ */
+typedef struct _cswp_batch_template_t cswp_batch_template_t;
+
+/**
+ * Operands that can be changed in a recorded batch
+ */
+typedef enum
+{
+    CSWP_TEMPLATE_ADDRESS,   /**< Address of a memory access */
+    CSWP_TEMPLATE_DATA,      /**< Data of a memory write, or value of a memory poll */
+    CSWP_TEMPLATE_REG_ID,    /**< Register ID of a register access */
+    CSWP_TEMPLATE_REG_VALUE, /**< Value of a register write */
+} cswp_template_operand_t;
+
+/**
+ * Begin recording a batch of commands
+ *
+ * Commands issued until cswp_template_end() are encoded into the template
+ * rather than executed.  Buffers that receive command results are used each
+ * time the template is run.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param abortOnError 0: continue on error, Non-zero: abort on error
+ */
+int cswp_template_begin(cswp_client_t* client, int abortOnError);
+
+/**
+ * Complete recording a batch of commands
+ *
+ * @param client Pointer to cswp_client_t
+ * @param tmpl Receives the template, to be freed by cswp_template_free()
+ */
+int cswp_template_end(cswp_client_t* client, cswp_batch_template_t** tmpl);
+
+/**
+ * Free a template
+ *
+ * @param tmpl Template from cswp_template_end()
+ */
+void cswp_template_free(cswp_batch_template_t* tmpl);
+
+/**
+ * Change an operand of a recorded command
+ *
+ * The operand keeps the size it was recorded with.  Templates may be
+ * changed once a run has been submitted.
+ *
+ * @param tmpl Template from cswp_template_end()
+ * @param op Index of the command in the template
+ * @param operand Operand to change
+ * @param index Register number within a register access, otherwise 0
+ * @param value New value of the operand: uint64_t for CSWP_TEMPLATE_ADDRESS,
+ *              unsigned for CSWP_TEMPLATE_REG_ID, uint32_t for
+ *              CSWP_TEMPLATE_REG_VALUE or the data bytes for CSWP_TEMPLATE_DATA
+ * @param size Size of value
+ */
+int cswp_template_set(cswp_batch_template_t* tmpl,
+                      unsigned op,
+                      cswp_template_operand_t operand,
+                      unsigned index,
+                      const void* value,
+                      size_t size);
+
+/**
+ * Execute a template
+ *
+ * @param client Pointer to cswp_client_t
+ * @param tmpl Template from cswp_template_end()
+ * @param opsCompleted Receives number of operations completed
+ */
+int cswp_template_run(cswp_client_t* client,
+                      const cswp_batch_template_t* tmpl,
+                      unsigned* opsCompleted);
+
+/**
+ * Send a template without waiting for the response
+ *
+ * As cswp_batch_submit(), for a recorded batch
+ *
+ * @param client Pointer to cswp_client_t
+ * @param tmpl Template from cswp_template_end()
+ * @param callback Function to call on completion, or NULL
+ * @param userData Value passed to callback
+ * @param handle Receives handle for the batch, may be NULL if callback is set
+ */
+int cswp_template_submit(cswp_client_t* client,
+                         const cswp_batch_template_t* tmpl,
+                         cswp_batch_callback_t callback,
+                         void* userData,
+                         cswp_batch_handle_t* handle);
+
+/**
+ * Queue memory and register writes outside of batches
+ *
+ * When enabled, cswp_device_mem_write(), cswp_device_mem_fill() and
+ * cswp_device_reg_write() return without waiting for the server.  Queued
+ * writes are sent ahead of the next command that needs a response, or when
+ * maxOps writes or maxBytes of request are queued, or when a write is made
+ * more than delay ms after the first was queued.  The first error from
+ * queued writes is returned by the next call that waits for a response, in
+ * preference to its own result.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param maxOps Number of writes to queue, 0 to disable
+ * @param maxBytes Request size at which writes are sent, 0 to size batches
+ *                 from the link estimates (see cswp_client_get_link_stats())
+ * @param delay Time in ms a write may be queued, 0 for no limit
+ */
+int cswp_client_set_write_behind(cswp_client_t* client,
+                                 unsigned maxOps,
+                                 size_t maxBytes,
+                                 unsigned delay);
+
+/**
+ * Send queued writes
+ *
+ * @param client Pointer to cswp_client_t
+ * @return CSWP_SUCCESS or the first error from queued writes
+ */
+int cswp_client_flush_writes(cswp_client_t* client);
+
 /**
  * Send client information to server
  *
@@ -292,6 +610,65 @@ int cswp_device_reg_list(cswp_client_t* client,
                          char *strBuf,
                          size_t strBufSize);
 
+/**
+ * Register list of a device, held by the client
+ */
+typedef struct _cswp_reg_list_t cswp_reg_list_t;
+
+/**
+ * Get the register list of a device
+ *
+ * The list is fetched from the server on first use and kept by the client
+ * until the next cswp_init(), cswp_set_devices() or cswp_client_term().
+ * Later calls to this function and cswp_device_reg_list() outside batches
+ * use the kept list.  Not permitted in a batch.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param regList Receives the register list, owned by the client
+ */
+int cswp_device_get_reg_list(cswp_client_t* client,
+                             unsigned deviceNo,
+                             const cswp_reg_list_t** regList);
+
+/**
+ * Get the number of registers in a register list
+ *
+ * @param regList Register list from cswp_device_get_reg_list()
+ */
+unsigned cswp_reg_list_count(const cswp_reg_list_t* regList);
+
+/**
+ * Get the registers in a register list, in the order given by the server
+ *
+ * @param regList Register list from cswp_device_get_reg_list()
+ * @return Array of cswp_reg_list_count() entries
+ */
+const cswp_register_info_t* cswp_reg_list_entries(const cswp_reg_list_t* regList);
+
+/**
+ * Find a register by name
+ *
+ * @param regList Register list from cswp_device_get_reg_list()
+ * @param name Register name
+ * @return The first register with the name, or NULL if there is none
+ */
+const cswp_register_info_t* cswp_reg_list_find(const cswp_reg_list_t* regList,
+                                               const char* name);
+
+/**
+ * Keep register lists in a directory between connections
+ *
+ * Lists are stored by server ID, server version and device type, so the
+ * device types must be given to cswp_set_devices() by this client.  A stored
+ * list is used instead of fetching the list from the server.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param directory Existing directory for the lists, NULL to stop using it
+ */
+int cswp_client_set_reg_list_cache(cswp_client_t* client,
+                                   const char* directory);
+
 /**
  * Read registers from a device
  *
@@ -329,6 +706,12 @@ int cswp_device_reg_write(cswp_client_t* client,
 /**
  * Read memory from a device
  *
+ * Outside a batch, reads too large for one message, or that would take more
+ * than about 10ms at the measured transfer rate, are split into chunks that
+ * are a multiple of 8 bytes and several are kept in flight.  Reading
+ * stops at the first chunk that fails, with bytesRead covering the chunks
+ * before it.
+ *
  * @param client Pointer to cswp_client_t
  * @param deviceNo The device index
  * @param address The address to read from
@@ -350,6 +733,9 @@ int cswp_device_mem_read(cswp_client_t* client,
 /**
  * Write memory to a device
  *
+ * Outside a batch, writes too large for one message are split into chunks
+ * in the same way as cswp_device_mem_read()
+ *
  * @param client Pointer to cswp_client_t
  * @param deviceNo The device index
  * @param address The address to read from
@@ -406,6 +792,221 @@ int cswp_device_mem_poll(cswp_client_t* client,
                          uint8_t* buf,
                          size_t* bytesRead);
 
+/**
+ * Fill memory on a device with a repeated pattern
+ *
+ * The pattern is expanded by the server, so only the pattern is sent
+ * however large the range.  The pattern is repeated from its first byte
+ * at address, and the last repeat is cut short if size is not a multiple
+ * of patternSize.
+ *
+ * This is an implementation defined command: check the device reports
+ * CSWP_CAP_MEM_FILL with cswp_get_device_capabilities() before use.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param address The address to fill from
+ * @param size The number of bytes to fill
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param pattern The pattern to repeat
+ * @param patternSize The number of bytes in the pattern, 1 to
+ *                    CSWP_MEM_FILL_MAX_PATTERN
+ */
+int cswp_device_mem_fill(cswp_client_t* client,
+                         unsigned deviceNo,
+                         uint64_t address,
+                         size_t size,
+                         cswp_access_size_t accessSize,
+                         unsigned flags,
+                         const uint8_t* pattern,
+                         size_t patternSize);
+
+/**
+ * Memory segment for cswp_device_mem_read_multi() and
+ * cswp_device_mem_write_multi()
+ */
+typedef struct
+{
+    uint64_t address; /**< Address of the segment */
+    uint8_t* data;    /**< Receives the data read, or the data to write */
+    size_t size;      /**< Number of bytes in the segment */
+} cswp_mem_segment_t;
+
+/**
+ * Read a list of memory segments from a device
+ *
+ * All segments share the device, access size and flags, and are read with
+ * one request rather than one each.  Lists too large for one message are
+ * split over several.  A segment that fails does not stop the others:
+ * its data is zeroed and its result is given in status.
+ *
+ * In a batch, segs and status must remain valid until the batch completes.
+ *
+ * This is an implementation defined command: check the device reports
+ * CSWP_CAP_MEM_MULTI with cswp_get_device_capabilities() before use.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param segs The segments to read
+ * @param count The number of segments
+ * @param status Receives the result for each segment, may be NULL.
+ *               Segments in messages that were not sent are CSWP_FAILED
+ * @return CSWP_SUCCESS if all segments were read, otherwise the first
+ *         failure
+ */
+int cswp_device_mem_read_multi(cswp_client_t* client,
+                               unsigned deviceNo,
+                               cswp_access_size_t accessSize,
+                               unsigned flags,
+                               const cswp_mem_segment_t* segs,
+                               unsigned count,
+                               int* status);
+
+/**
+ * Write a list of memory segments to a device
+ *
+ * As cswp_device_mem_read_multi(), but writes the data of each segment
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param segs The segments to write
+ * @param count The number of segments
+ * @param status Receives the result for each segment, may be NULL.
+ *               Segments in messages that were not sent are CSWP_FAILED
+ * @return CSWP_SUCCESS if all segments were written, otherwise the first
+ *         failure
+ */
+int cswp_device_mem_write_multi(cswp_client_t* client,
+                                unsigned deviceNo,
+                                cswp_access_size_t accessSize,
+                                unsigned flags,
+                                const cswp_mem_segment_t* segs,
+                                unsigned count,
+                                int* status);
+
+/**
+ * Checksum memory on a device
+ *
+ * The memory is read and checksummed on the target, so only the digests
+ * cross the link.  With a blockSize of 0 one digest covers the range,
+ * otherwise there is a digest for each blockSize bytes, the last covering
+ * what remains.  cswp_checksum_count() gives the number of digests, and
+ * cswp_checksum() the digest expected for some data.  Ranges with more
+ * digests than fit in one message are split over several.
+ *
+ * In a batch, digests must remain valid until the batch completes.
+ *
+ * This is an implementation defined command: check the device reports
+ * CSWP_CAP_MEM_CHECKSUM with cswp_get_device_capabilities() before use.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param address The address to checksum from
+ * @param size The number of bytes to checksum
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param algorithm The checksum algorithm
+ * @param blockSize Bytes covered by each digest, or 0 for one digest.
+ *                  Should be a multiple of the access size
+ * @param digests Receives the digests
+ */
+int cswp_device_mem_checksum(cswp_client_t* client,
+                             unsigned deviceNo,
+                             uint64_t address,
+                             size_t size,
+                             cswp_access_size_t accessSize,
+                             unsigned flags,
+                             cswp_checksum_t algorithm,
+                             size_t blockSize,
+                             uint64_t* digests);
+
+/**
+ * Refresh a copy of memory on a device, transferring only changed blocks
+ *
+ * buf holds the previous contents of the range, for example from an
+ * earlier call or cswp_device_mem_read(), or zeros the first time.  A
+ * digest of each blockSize bytes of buf is sent, and the server returns
+ * only the blocks whose contents no longer match, which are copied into
+ * buf.  Afterwards buf holds the current contents of the whole range.
+ * Ranges too large for one message are split over several.
+ *
+ * In a batch, buf and changed must remain valid until the batch completes.
+ *
+ * This is an implementation defined command: check the device reports
+ * CSWP_CAP_MEM_DELTA with cswp_get_device_capabilities() before use.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param address The address to read from
+ * @param size The number of bytes to read
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param blockSize Bytes in each block, or 0 for one block.  Should be a
+ *                  multiple of the access size
+ * @param buf The previous contents, receives the current contents
+ * @param changed Receives a bitmap with bit n of byte n / 8 set if block n
+ *                changed, cswp_checksum_count() bits.  May be NULL
+ */
+int cswp_device_mem_read_delta(cswp_client_t* client,
+                               unsigned deviceNo,
+                               uint64_t address,
+                               size_t size,
+                               cswp_access_size_t accessSize,
+                               unsigned flags,
+                               size_t blockSize,
+                               uint8_t* buf,
+                               uint8_t* changed);
+
+/**
+ * Search memory on a device for a pattern
+ *
+ * The memory is searched on the target, and only the addresses of matches
+ * are returned, in address order.  Where mask is given, only the bits set
+ * in each mask byte are compared with the pattern.
+ *
+ * Outside a batch, requests continue after the last match until maxHits
+ * are found or the range is searched.  In a batch one request is made,
+ * returning as many matches as fit in a response, and hits and hitCount
+ * must remain valid until the batch completes.
+ *
+ * This is an implementation defined command: check the device reports
+ * CSWP_CAP_MEM_SEARCH with cswp_get_device_capabilities() before use.
+ *
+ * @param client Pointer to cswp_client_t
+ * @param deviceNo The device index
+ * @param address The address to search from
+ * @param size The number of bytes to search
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param pattern The pattern to find
+ * @param mask Bits of each pattern byte to compare, NULL to compare all
+ * @param patternSize The number of bytes in the pattern (and mask), 1 to
+ *                    CSWP_MEM_SEARCH_MAX_PATTERN
+ * @param alignment Matches start at multiples of this address, 0 or 1 for
+ *                  any address
+ * @param hits Receives the address of each match
+ * @param maxHits The most matches to find
+ * @param hitCount Receives the number of matches found
+ */
+int cswp_device_mem_search(cswp_client_t* client,
+                           unsigned deviceNo,
+                           uint64_t address,
+                           size_t size,
+                           cswp_access_size_t accessSize,
+                           unsigned flags,
+                           const uint8_t* pattern,
+                           const uint8_t* mask,
+                           size_t patternSize,
+                           size_t alignment,
+                           uint64_t* hits,
+                           size_t maxHits,
+                           size_t* hitCount);
+
 #ifdef __cplusplus
 }
 #endif
@@ -81,6 +81,24 @@ int cswp_decode_init_response_body(CSWP_BUFFER* buf,
 }
 
 
+int cswp_encode_init_message_size(CSWP_BUFFER* buf,
+                                  varint_t maxMessageSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, maxMessageSize));
+    return res;
+}
+
+
+int cswp_decode_init_response_message_size(CSWP_BUFFER* buf,
+                                           varint_t* messageSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, messageSize));
+    return res;
+}
+
+
 int cswp_encode_term_command(CSWP_BUFFER* buf)
 {
     int res = CSWP_SUCCESS;
@@ -292,7 +310,7 @@ int cswp_encode_reg_read_command(CSWP_BUFFER* buf,
     __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_REG_READ));
     __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
     __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
-    for (i = 0; i < count; ++i)
+    for (i = 0; registerIDs != NULL && i < count; ++i)
         __CSWP_CHECK(cswp_buffer_put_varint(buf, registerIDs[i]));
     return res;
 }
@@ -346,6 +364,24 @@ int cswp_decode_mem_read_response_body(CSWP_BUFFER* buf,
 }
 
 
+int cswp_encode_mem_write_header(CSWP_BUFFER* buf,
+                                 varint_t deviceNo,
+                                 uint64_t address,
+                                 varint_t size,
+                                 varint_t accessSize,
+                                 varint_t flags)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_WRITE));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    return res;
+}
+
+
 int cswp_encode_mem_write_command(CSWP_BUFFER* buf,
                                   varint_t deviceNo,
                                   uint64_t address,
@@ -355,12 +391,7 @@ int cswp_encode_mem_write_command(CSWP_BUFFER* buf,
                                   const uint8_t* data)
 {
     int res = CSWP_SUCCESS;
-    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_WRITE));
-    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
-    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
-    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
-    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
-    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_encode_mem_write_header(buf, deviceNo, address, size, accessSize, flags));
     __CSWP_CHECK(cswp_buffer_put_data(buf, data, size));
     return res;
 }
@@ -401,6 +432,230 @@ int cswp_decode_mem_poll_response_body(CSWP_BUFFER* buf,
 }
 
 
+int cswp_encode_mem_fill_command(CSWP_BUFFER* buf,
+                                 varint_t deviceNo,
+                                 uint64_t address,
+                                 varint_t size,
+                                 varint_t accessSize,
+                                 varint_t flags,
+                                 const uint8_t* pattern,
+                                 varint_t patternSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_FILL));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, patternSize));
+    __CSWP_CHECK(cswp_buffer_put_data(buf, pattern, patternSize));
+    return res;
+}
+
+
+int cswp_encode_mem_read_multi_command(CSWP_BUFFER* buf,
+                                       varint_t deviceNo,
+                                       varint_t accessSize,
+                                       varint_t flags,
+                                       varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_READ_MULTI));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_write_multi_command(CSWP_BUFFER* buf,
+                                        varint_t deviceNo,
+                                        varint_t accessSize,
+                                        varint_t flags,
+                                        varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_WRITE_MULTI));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_segment(CSWP_BUFFER* buf,
+                            uint64_t address,
+                            varint_t size)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    return res;
+}
+
+
+int cswp_decode_mem_read_multi_response_body(CSWP_BUFFER* buf,
+                                             varint_t* size)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    return res;
+}
+
+
+int cswp_decode_mem_segment_status_count(CSWP_BUFFER* buf,
+                                         varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_segment_status(CSWP_BUFFER* buf,
+                                   varint_t* status)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, status));
+    return res;
+}
+
+
+int cswp_encode_mem_checksum_command(CSWP_BUFFER* buf,
+                                     varint_t deviceNo,
+                                     uint64_t address,
+                                     varint_t size,
+                                     varint_t accessSize,
+                                     varint_t flags,
+                                     varint_t algorithm,
+                                     varint_t blockSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_CHECKSUM));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, algorithm));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, blockSize));
+    return res;
+}
+
+
+int cswp_decode_mem_checksum_response_body(CSWP_BUFFER* buf,
+                                           varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_checksum_digest(CSWP_BUFFER* buf,
+                                    uint64_t* digest)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, digest));
+    return res;
+}
+
+
+int cswp_encode_mem_read_delta_command(CSWP_BUFFER* buf,
+                                       varint_t deviceNo,
+                                       uint64_t address,
+                                       varint_t size,
+                                       varint_t accessSize,
+                                       varint_t flags,
+                                       varint_t algorithm,
+                                       varint_t blockSize,
+                                       varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_READ_DELTA));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, algorithm));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, blockSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_read_delta_digest(CSWP_BUFFER* buf,
+                                      uint64_t digest)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, digest));
+    return res;
+}
+
+
+int cswp_decode_mem_read_delta_response_body(CSWP_BUFFER* buf,
+                                             varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_search_command(CSWP_BUFFER* buf,
+                                   varint_t deviceNo,
+                                   uint64_t address,
+                                   varint_t size,
+                                   varint_t accessSize,
+                                   varint_t flags,
+                                   varint_t alignment,
+                                   varint_t maxHits,
+                                   const uint8_t* pattern,
+                                   const uint8_t* mask,
+                                   varint_t patternSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_command_header(buf, CSWP_MEM_SEARCH));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, alignment));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, maxHits));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, patternSize));
+    __CSWP_CHECK(cswp_buffer_put_data(buf, pattern, patternSize));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, mask ? patternSize : 0));
+    if (mask)
+    {
+        __CSWP_CHECK(cswp_buffer_put_data(buf, mask, patternSize));
+    }
+    return res;
+}
+
+
+int cswp_decode_mem_search_response_body(CSWP_BUFFER* buf,
+                                         varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_search_hit(CSWP_BUFFER* buf,
+                               uint64_t* address)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    return res;
+}
+
+
 int cswp_decode_async_message_body(CSWP_BUFFER* buf,
                                    varint_t* deviceNo,
                                    varint_t* level,
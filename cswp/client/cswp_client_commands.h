@@ -74,6 +74,30 @@ int cswp_decode_init_response_body(CSWP_BUFFER* buf,
                                    size_t serverIDSize,
                                    varint_t* serverVersion);
 
+/**
+ * Encode the message size field of a CSWP_INIT command
+ *
+ * The field follows the client ID when clientProtocolVersion is
+ * CSWP_PROTOCOL_v2 or later
+ *
+ * @param buf The buffer to encode to
+ * @param maxMessageSize The largest message the client can send or receive
+ */
+int cswp_encode_init_message_size(CSWP_BUFFER* buf,
+                                  varint_t maxMessageSize);
+
+/**
+ * Decode the message size field of a CSWP_INIT response
+ *
+ * The field follows the server version when serverProtocolVersion is
+ * CSWP_PROTOCOL_v2 or later
+ *
+ * @param buf The buffer to decode from
+ * @param messageSize Receives the maximum message size for the session
+ */
+int cswp_decode_init_response_message_size(CSWP_BUFFER* buf,
+                                           varint_t* messageSize);
+
 /**
  * Encode a CSWP_TERM command
  *
@@ -277,10 +301,14 @@ int cswp_decode_reg_info(CSWP_BUFFER* buf,
 /**
  * Encode a CSWP_REG_READ command
  *
+ * If registerIDs is NULL the caller should then encode the register IDs
+ * with count calls to:
+ *   cswp_buffer_put_varint(buf, registerID);
+ *
  * @param buf The buffer to encode to
  * @param deviceNo The device number
  * @param count The number of registers to read
- * @param registerIDs Array of register IDs
+ * @param registerIDs Array of register IDs, or NULL
  */
 int cswp_encode_reg_read_command(CSWP_BUFFER* buf,
                                  varint_t deviceNo,
@@ -346,6 +374,26 @@ int cswp_encode_mem_read_command(CSWP_BUFFER* buf,
 int cswp_decode_mem_read_response_body(CSWP_BUFFER* buf,
                                        varint_t* count);
 
+/**
+ * Encode a CSWP_MEM_WRITE command without its data
+ *
+ * The size bytes of data must follow in the message, for example as a
+ * separate segment passed to cswp_client_transport_t::sendv()
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param address The address to write to
+ * @param size The number of bytes to write
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ */
+int cswp_encode_mem_write_header(CSWP_BUFFER* buf,
+                                 varint_t deviceNo,
+                                 uint64_t address,
+                                 varint_t size,
+                                 varint_t accessSize,
+                                 varint_t flags);
+
 /**
  * Encode a CSWP_MEM_WRITE command
  *
@@ -403,6 +451,249 @@ int cswp_encode_mem_poll_command(CSWP_BUFFER* buf,
 int cswp_decode_mem_poll_response_body(CSWP_BUFFER* buf,
                                        varint_t* count);
 
+/**
+ * Encode a CSWP_MEM_FILL command
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param address The address to fill from
+ * @param size The number of bytes to fill
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param pattern The pattern to repeat
+ * @param patternSize The number of bytes in the pattern
+ */
+int cswp_encode_mem_fill_command(CSWP_BUFFER* buf,
+                                 varint_t deviceNo,
+                                 uint64_t address,
+                                 varint_t size,
+                                 varint_t accessSize,
+                                 varint_t flags,
+                                 const uint8_t* pattern,
+                                 varint_t patternSize);
+
+/**
+ * Encode a CSWP_MEM_READ_MULTI command
+ *
+ * count segments must follow, each encoded with cswp_encode_mem_segment()
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param count The number of segments
+ */
+int cswp_encode_mem_read_multi_command(CSWP_BUFFER* buf,
+                                       varint_t deviceNo,
+                                       varint_t accessSize,
+                                       varint_t flags,
+                                       varint_t count);
+
+/**
+ * Encode a CSWP_MEM_WRITE_MULTI command
+ *
+ * count segments must follow, each encoded with cswp_encode_mem_segment(),
+ * then the data for all segments in order
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param count The number of segments
+ */
+int cswp_encode_mem_write_multi_command(CSWP_BUFFER* buf,
+                                        varint_t deviceNo,
+                                        varint_t accessSize,
+                                        varint_t flags,
+                                        varint_t count);
+
+/**
+ * Encode a segment of a CSWP_MEM_READ_MULTI or CSWP_MEM_WRITE_MULTI command
+ *
+ * @param buf The buffer to encode to
+ * @param address The address of the segment
+ * @param size The number of bytes in the segment
+ */
+int cswp_encode_mem_segment(CSWP_BUFFER* buf,
+                            uint64_t address,
+                            varint_t size);
+
+/**
+ * Decode a CSWP_MEM_READ_MULTI response
+ *
+ * The client should then obtain a pointer to the data for all segments
+ * with a call to:
+ *   cswp_buffer_get_direct(buf, &pData, size);
+ * followed by the segment status with
+ * cswp_decode_mem_segment_status_count() and cswp_decode_mem_segment_status()
+ *
+ * @param buf The buffer to decode from
+ * @param size Receives the number of bytes of data
+ */
+int cswp_decode_mem_read_multi_response_body(CSWP_BUFFER* buf,
+                                             varint_t* size);
+
+/**
+ * Decode the number of segment status values in a CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI response
+ *
+ * @param buf The buffer to decode from
+ * @param count Receives the number of segments
+ */
+int cswp_decode_mem_segment_status_count(CSWP_BUFFER* buf,
+                                         varint_t* count);
+
+/**
+ * Decode the status of one segment of a CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI response
+ *
+ * @param buf The buffer to decode from
+ * @param status Receives the result of the segment access (cswp_result_t)
+ */
+int cswp_decode_mem_segment_status(CSWP_BUFFER* buf,
+                                   varint_t* status);
+
+/**
+ * Encode a CSWP_MEM_CHECKSUM command
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param address The address to checksum from
+ * @param size The number of bytes to checksum
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param algorithm The checksum algorithm (cswp_checksum_t)
+ * @param blockSize Bytes covered by each digest, or 0 for one digest
+ */
+int cswp_encode_mem_checksum_command(CSWP_BUFFER* buf,
+                                     varint_t deviceNo,
+                                     uint64_t address,
+                                     varint_t size,
+                                     varint_t accessSize,
+                                     varint_t flags,
+                                     varint_t algorithm,
+                                     varint_t blockSize);
+
+/**
+ * Decode a CSWP_MEM_CHECKSUM response
+ *
+ * The client should then decode count digests with
+ * cswp_decode_mem_checksum_digest()
+ *
+ * @param buf The buffer to decode from
+ * @param count Receives the number of digests
+ */
+int cswp_decode_mem_checksum_response_body(CSWP_BUFFER* buf,
+                                           varint_t* count);
+
+/**
+ * Decode one digest of a CSWP_MEM_CHECKSUM response
+ *
+ * @param buf The buffer to decode from
+ * @param digest Receives the digest
+ */
+int cswp_decode_mem_checksum_digest(CSWP_BUFFER* buf,
+                                    uint64_t* digest);
+
+/**
+ * Encode a CSWP_MEM_READ_DELTA command
+ *
+ * count digests must follow, each encoded with
+ * cswp_encode_mem_read_delta_digest()
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param address The address to read from
+ * @param size The number of bytes to read
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param algorithm The checksum algorithm (cswp_checksum_t) of the digests
+ * @param blockSize Bytes covered by each digest, or 0 for one block
+ * @param count The number of digests
+ */
+int cswp_encode_mem_read_delta_command(CSWP_BUFFER* buf,
+                                       varint_t deviceNo,
+                                       uint64_t address,
+                                       varint_t size,
+                                       varint_t accessSize,
+                                       varint_t flags,
+                                       varint_t algorithm,
+                                       varint_t blockSize,
+                                       varint_t count);
+
+/**
+ * Encode the digest the client holds for one block of a
+ * CSWP_MEM_READ_DELTA command
+ *
+ * @param buf The buffer to encode to
+ * @param digest The digest
+ */
+int cswp_encode_mem_read_delta_digest(CSWP_BUFFER* buf,
+                                      uint64_t digest);
+
+/**
+ * Decode a CSWP_MEM_READ_DELTA response
+ *
+ * The client should then obtain a pointer to the changed block bitmap,
+ * bit n of byte n / 8 set for each block n that changed, with a call to:
+ *   cswp_buffer_get_direct(buf, &pBitmap, (count + 7) / 8);
+ * followed by the data of the changed blocks in order with
+ * cswp_buffer_get_direct()
+ *
+ * @param buf The buffer to decode from
+ * @param count Receives the number of blocks
+ */
+int cswp_decode_mem_read_delta_response_body(CSWP_BUFFER* buf,
+                                             varint_t* count);
+
+/**
+ * Encode a CSWP_MEM_SEARCH command
+ *
+ * @param buf The buffer to encode to
+ * @param deviceNo The device number
+ * @param address The address to search from
+ * @param size The number of bytes to search
+ * @param accessSize The access size (cswp_access_size_t) to use
+ * @param flags Flags
+ * @param alignment Matches start at multiples of this address, 0 or 1 for any
+ * @param maxHits The most matches to return, 0 for as many as fit
+ * @param pattern The pattern to find
+ * @param mask Bits of each pattern byte to compare, NULL to compare all
+ * @param patternSize The number of bytes in the pattern (and mask)
+ */
+int cswp_encode_mem_search_command(CSWP_BUFFER* buf,
+                                   varint_t deviceNo,
+                                   uint64_t address,
+                                   varint_t size,
+                                   varint_t accessSize,
+                                   varint_t flags,
+                                   varint_t alignment,
+                                   varint_t maxHits,
+                                   const uint8_t* pattern,
+                                   const uint8_t* mask,
+                                   varint_t patternSize);
+
+/**
+ * Decode a CSWP_MEM_SEARCH response
+ *
+ * The client should then decode count addresses with
+ * cswp_decode_mem_search_hit()
+ *
+ * @param buf The buffer to decode from
+ * @param count Receives the number of matches
+ */
+int cswp_decode_mem_search_response_body(CSWP_BUFFER* buf,
+                                         varint_t* count);
+
+/**
+ * Decode one match of a CSWP_MEM_SEARCH response
+ *
+ * @param buf The buffer to decode from
+ * @param address Receives the address of the match
+ */
+int cswp_decode_mem_search_hit(CSWP_BUFFER* buf,
+                               uint64_t* address);
+
 /**
  * Decode a CSWP_ASYNC_MESSAGE message
  *
@@ -23,6 +23,19 @@ CSWP_BUFFER* cswp_buffer_alloc(size_t size)
     return buf;
 }
 
+CSWP_BUFFER* cswp_buffer_realloc(CSWP_BUFFER* buf, size_t size)
+{
+    CSWP_BUFFER* newBuf;
+
+    if (size < buf->used)
+        return NULL;
+
+    newBuf = (CSWP_BUFFER*)realloc(buf, sizeof(CSWP_BUFFER) + size);
+    if (newBuf != NULL)
+        newBuf->size = size;
+    return newBuf;
+}
+
 void cswp_buffer_free(CSWP_BUFFER* buf)
 {
     free(buf);
@@ -44,6 +57,12 @@ void cswp_buffer_skip(CSWP_BUFFER* buf, size_t count)
     buf->pos += count;
 }
 
+void cswp_buffer_truncate(CSWP_BUFFER* buf, size_t used)
+{
+    buf->used = used;
+    buf->pos = used;
+}
+
 #define __CSWP_REQUIRE_W(b, s) if ((b)->size - (b)->used < (s)) return CSWP_BUFFER_FULL;
 #define __CSWP_REQUIRE_R(b, s) if ((b)->used - (b)->pos < (s)) return CSWP_BUFFER_EMPTY;
 #define __CSWP_PUT_BYTE(b, v) (b)->buf[(b)->pos++] = (v);
@@ -126,6 +145,15 @@ int cswp_buffer_put_data(CSWP_BUFFER* buf, const void* data, size_t size)
     return CSWP_SUCCESS;
 }
 
+int cswp_buffer_put_direct(CSWP_BUFFER* buf, void** ptr, size_t len)
+{
+    __CSWP_REQUIRE_W(buf, len);
+    *ptr = &buf->buf[buf->pos];
+    buf->pos += len;
+    buf->used = buf->pos;
+    return CSWP_SUCCESS;
+}
+
 int cswp_buffer_get_uint8(CSWP_BUFFER* buf, uint8_t* val)
 {
     __CSWP_REQUIRE_R(buf, 1);
@@ -43,6 +43,17 @@ void cswp_buffer_init(CSWP_BUFFER* buffer, size_t size);
  */
 CSWP_BUFFER* cswp_buffer_alloc(size_t size);
 
+/**
+ * Resize a CSWP_BUFFER
+ * Contents, buffer.used and buffer.pos are preserved
+ * buffer.size is set to size
+ * @param buf The buffer to resize, allocated by cswp_buffer_alloc()
+ * @param size The new size of the data buffer, at least buffer.used
+ * @return pointer to the resized CSWP_BUFFER, or NULL if the buffer could
+ *         not be resized, in which case buf is unchanged
+ */
+CSWP_BUFFER* cswp_buffer_realloc(CSWP_BUFFER* buf, size_t size);
+
 /**
  * Free a CSWP_BUFFER
  *
@@ -78,6 +89,16 @@ void cswp_buffer_seek(CSWP_BUFFER* buf, size_t pos);
  */
 void cswp_buffer_skip(CSWP_BUFFER* buf, size_t count);
 
+/**
+ * Discard data at the end of a CSWP_BUFFER
+ *
+ * buffer.used and buffer.pos are set to used
+ *
+ * @param buf CSWP_BUFFER
+ * @param used The number of bytes to keep
+ */
+void cswp_buffer_truncate(CSWP_BUFFER* buf, size_t used);
+
 /**
  * Add a uint8 entry to a buffer
  *
@@ -152,6 +173,20 @@ int cswp_buffer_put_string(CSWP_BUFFER* buf, const char* str);
  */
 int cswp_buffer_put_data(CSWP_BUFFER* buf, const void* data, size_t size);
 
+/**
+ * Reserve space for data in a buffer
+ *
+ * Return a pointer to the current write position so the data can be
+ * written in place
+ * buffer.used is increased by the number of bytes required
+ *
+ * @param buf The buffer
+ * @param ptr Receives the pointer to the reserved space
+ * @param len The number of bytes to reserve
+ * @return CSWP_SUCCESS on success, CSWP_BUFFER_FULL if insufficient space
+ */
+int cswp_buffer_put_direct(CSWP_BUFFER* buf, void** ptr, size_t len);
+
 /**
  * Get a uint8 entry from a buffer
  *
@@ -0,0 +1,83 @@
+// cswp_checksum.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * @file cswp_checksum.h
+ * @brief Checksums for CSWP_MEM_CHECKSUM
+ *
+ * Shared by client and server so a host can compute the digest it expects
+ * the target to report.
+ */
+
+#ifndef CSWP_CHECKSUM_H
+#define CSWP_CHECKSUM_H
+
+#include "cswp_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Check a checksum algorithm is supported
+ *
+ * @param algorithm The algorithm
+ * @return Non-zero if supported
+ */
+int cswp_checksum_valid(cswp_checksum_t algorithm);
+
+/**
+ * Start a checksum
+ *
+ * @param algorithm The algorithm
+ * @return The initial state
+ */
+uint64_t cswp_checksum_init(cswp_checksum_t algorithm);
+
+/**
+ * Add data to a checksum
+ *
+ * @param algorithm The algorithm
+ * @param state The state from cswp_checksum_init() or a previous update
+ * @param data The data
+ * @param size The number of bytes of data
+ * @return The updated state
+ */
+uint64_t cswp_checksum_update(cswp_checksum_t algorithm, uint64_t state,
+                              const void* data, size_t size);
+
+/**
+ * Finish a checksum
+ *
+ * @param algorithm The algorithm
+ * @param state The state after the last update
+ * @return The digest.  A CRC-32 is in the low 32 bits.
+ */
+uint64_t cswp_checksum_final(cswp_checksum_t algorithm, uint64_t state);
+
+/**
+ * Checksum a buffer
+ *
+ * @param algorithm The algorithm
+ * @param data The data
+ * @param size The number of bytes of data
+ * @return The digest
+ */
+uint64_t cswp_checksum(cswp_checksum_t algorithm, const void* data, size_t size);
+
+/**
+ * Number of digests for a CSWP_MEM_CHECKSUM of size bytes
+ *
+ * @param size The number of bytes checksummed
+ * @param blockSize The block size, or 0 for one digest over the range
+ * @return The number of digests
+ */
+size_t cswp_checksum_count(size_t size, size_t blockSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSWP_CHECKSUM_H
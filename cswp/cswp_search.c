@@ -0,0 +1,85 @@
+// cswp_search.c
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "cswp_search.h"
+
+void cswp_search_init(cswp_search_t* search,
+                      const uint8_t* pattern, const uint8_t* mask,
+                      size_t size, size_t alignment)
+{
+    unsigned c;
+    size_t i;
+
+    search->pattern = pattern;
+    search->mask = mask;
+    search->size = size;
+    search->alignment = alignment ? alignment : 1;
+
+    /* The window may move on until the byte at its end could match the
+       same pattern position: with a mask, any byte matching under the
+       mask could */
+    for (c = 0; c < 256; ++c)
+        search->shift[c] = (uint8_t)size;
+    for (i = 0; i + 1 < size; ++i)
+    {
+        for (c = 0; c < 256; ++c)
+        {
+            if (mask ? ((c ^ pattern[i]) & mask[i]) == 0 : c == pattern[i])
+                search->shift[c] = (uint8_t)(size - 1 - i);
+        }
+    }
+}
+
+/*
+ * Check for a match at p
+ */
+static int cswp_search_match(const cswp_search_t* search, const uint8_t* p)
+{
+    size_t i;
+
+    for (i = search->size; i-- > 0; )
+    {
+        if (search->mask ? ((p[i] ^ search->pattern[i]) & search->mask[i]) != 0
+                         : p[i] != search->pattern[i])
+            return 0;
+    }
+    return 1;
+}
+
+size_t cswp_search_window(const cswp_search_t* search,
+                          const uint8_t* data, size_t size, size_t limit,
+                          uint64_t address, uint64_t* hits, size_t maxHits)
+{
+    size_t count = 0;
+    size_t pos = 0;
+    size_t r;
+
+    if (size < search->size)
+        return 0;
+    if (limit > size - search->size + 1)
+        limit = size - search->size + 1;
+
+    while (count < maxHits)
+    {
+        /* Only aligned positions can match, so skip to the next */
+        r = (size_t)((address + pos) % search->alignment);
+        if (r)
+            pos += search->alignment - r;
+        if (pos >= limit)
+            break;
+
+        if (cswp_search_match(search, data + pos))
+        {
+            hits[count++] = address + pos;
+            ++pos;
+        }
+        else
+            pos += search->shift[data[pos + search->size - 1]];
+    }
+
+    return count;
+}
+
+/* end of file cswp_search.c */
@@ -0,0 +1,75 @@
+// cswp_search.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * @file cswp_search.h
+ * @brief Pattern search for CSWP_MEM_SEARCH
+ *
+ * A Boyer-Moore-Horspool search, where each pattern byte may be masked,
+ * shared by the server library and target implementations.
+ */
+
+#ifndef CSWP_SEARCH_H
+#define CSWP_SEARCH_H
+
+#include "cswp_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Prepared search
+ */
+typedef struct
+{
+    const uint8_t* pattern; /**< Pattern to find */
+    const uint8_t* mask;    /**< Bits of each pattern byte compared, NULL for all */
+    size_t size;            /**< Number of bytes in the pattern (and mask) */
+    size_t alignment;       /**< Matches start at multiples of this address */
+    uint8_t shift[256];     /**< Skip for the byte at the end of the window */
+} cswp_search_t;
+
+/**
+ * Prepare a search
+ *
+ * pattern and mask are referenced, not copied
+ *
+ * @param search The search to prepare
+ * @param pattern The pattern to find
+ * @param mask Bits of each pattern byte to compare, NULL to compare all
+ * @param size The number of bytes in the pattern, 1 to
+ *             CSWP_MEM_SEARCH_MAX_PATTERN
+ * @param alignment Matches start at multiples of this address, 0 or 1 for
+ *                  any address
+ */
+void cswp_search_init(cswp_search_t* search,
+                      const uint8_t* pattern, const uint8_t* mask,
+                      size_t size, size_t alignment);
+
+/**
+ * Find matches in a window of memory
+ *
+ * Windows of a larger range should overlap by search->size - 1 bytes, with
+ * limit set so each match is only found in one window.
+ *
+ * @param search The prepared search
+ * @param data The memory contents
+ * @param size The number of bytes of data
+ * @param limit Only matches starting before this offset are found
+ * @param address The address of data
+ * @param hits Receives the address of each match
+ * @param maxHits The most matches to find
+ * @return The number of matches found
+ */
+size_t cswp_search_window(const cswp_search_t* search,
+                          const uint8_t* data, size_t size, size_t limit,
+                          uint64_t address, uint64_t* hits, size_t maxHits);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CSWP_SEARCH_H
@@ -68,8 +68,19 @@ typedef uint64_t varint_t;
 typedef enum
 {
     CSWP_PROTOCOL_v1 = 1,
+    CSWP_PROTOCOL_v2 = 2, /**< CSWP_INIT negotiates the maximum message size */
 } cswp_protocol_ver_t;
 
+/**
+ * Maximum message size for sessions that do not negotiate one
+ */
+#define CSWP_DEFAULT_MESSAGE_SIZE 32768
+
+/**
+ * Maximum message size requested by clients
+ */
+#define CSWP_MAX_MESSAGE_SIZE (4 * 1024 * 1024)
+
 /**
  * Command identifiers for CSWP
  */
@@ -102,6 +113,12 @@ typedef enum
     CSWP_ASYNC_MESSAGE           = 0x00001000, /**< Error/information message */
     /* implementation specific commands */
     CSWP_IMPLEMENTATION_DEFINED_BEGIN = 0x8000, /**< First implementation defined command */
+    CSWP_MEM_FILL                = 0x00008000, /**< Fill memory with a repeated pattern */
+    CSWP_MEM_READ_MULTI          = 0x00008001, /**< Read a list of memory segments */
+    CSWP_MEM_WRITE_MULTI         = 0x00008002, /**< Write a list of memory segments */
+    CSWP_MEM_CHECKSUM            = 0x00008003, /**< Checksum memory blocks */
+    CSWP_MEM_READ_DELTA          = 0x00008004, /**< Read memory blocks that have changed */
+    CSWP_MEM_SEARCH              = 0x00008005, /**< Search memory for a pattern */
     CSWP_IMPLEMENTATION_DEFINED_END   = 0xFFFF, /**< Last implementation defined command */
 } cswp_commands_t;
 
@@ -137,9 +154,23 @@ typedef enum
 {
     CSWP_CAP_REG = 0x1, /**< Register commands supported */
     CSWP_CAP_MEM = 0x2, /**< Memory commands supported */
-    CSWP_CAP_MEM_POLL = 0x200 /**< Memory poll command supported */
+    CSWP_CAP_MEM_POLL = 0x200, /**< Memory poll command supported */
+    CSWP_CAP_MEM_FILL = 0x10000, /**< Memory fill command supported (implementation defined) */
+    CSWP_CAP_MEM_MULTI = 0x20000, /**< Memory read/write multi commands supported (implementation defined) */
+    CSWP_CAP_MEM_CHECKSUM = 0x40000, /**< Memory checksum command supported (implementation defined) */
+    CSWP_CAP_MEM_DELTA = 0x80000, /**< Memory read delta command supported (implementation defined) */
+    CSWP_CAP_MEM_SEARCH = 0x100000 /**< Memory search command supported (implementation defined) */
 } cswp_cap_t;
 
+/**
+ * Checksum algorithms for CSWP_MEM_CHECKSUM
+ */
+typedef enum
+{
+    CSWP_CHECKSUM_CRC32   = 0, /**< CRC-32 (IEEE 802.3, as zlib) */
+    CSWP_CHECKSUM_FNV1A64 = 1, /**< 64-bit FNV-1a hash */
+} cswp_checksum_t;
+
 /**
  * Register information
  */
@@ -186,6 +217,9 @@ typedef struct
 #define CSWP_MEM_POLL_MATCH_NE   (1 << 1) /**< Flag Match Not Equal for poll operation */
 #define CSWP_MEM_POLL_CHECK_LAST (1 << 2) /**< Flag Check last for poll operation */
 
+#define CSWP_MEM_FILL_MAX_PATTERN 64 /**< Largest pattern for a CSWP_MEM_FILL command */
+#define CSWP_MEM_SEARCH_MAX_PATTERN 64 /**< Largest pattern for a CSWP_MEM_SEARCH command */
+
 /**
  * MEM-AP memory access flags
  */
@@ -7,6 +7,8 @@
 #include "cswp_server_commands.h"
 #include "cswp_server_impl.h"
 #include "cswp_buffer.h"
+#include "cswp_checksum.h"
+#include "cswp_search.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -17,7 +19,7 @@
 #endif
 
 /* Server identifier / version info */
-const unsigned SERVER_PROTOCOL_VERSION = CSWP_PROTOCOL_v1;
+const unsigned SERVER_PROTOCOL_VERSION = CSWP_PROTOCOL_v2;
 const char*    SERVER_ID               = "AMIS PoC CSWP Server";
 const unsigned SERVER_VERISION         = 0x0100;
 
@@ -68,9 +70,13 @@ static int cswp_init(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER*
 {
     int res;
     varint_t protocolVersion;
+    varint_t messageSize = CSWP_DEFAULT_MESSAGE_SIZE;
+    size_t serverMessageSize;
     char clientID[256];
 
     res = cswp_decode_init_command_body(cmd, &protocolVersion, clientID, sizeof(clientID));
+    if (res == CSWP_SUCCESS && protocolVersion >= CSWP_PROTOCOL_v2)
+        res = cswp_decode_init_command_message_size(cmd, &messageSize);
     if (res != CSWP_SUCCESS)
     {
         cswp_error(state, rsp, CSWP_INIT, res, "Failed to decode CSWP_INIT command");
@@ -79,9 +85,24 @@ static int cswp_init(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER*
     {
         CSWP_LOG(state, CSWP_LOG_INFO, "Client %s connected: protocol version: %d", clientID, protocolVersion);
 
+        /* Respond with the highest version both sides support */
+        if (protocolVersion > SERVER_PROTOCOL_VERSION)
+            protocolVersion = SERVER_PROTOCOL_VERSION;
+
+        /* Message size is limited by client and transport, but responses
+           are only limited to the default size, so never agree less */
+        serverMessageSize = state->maxMessageSize ? state->maxMessageSize : CSWP_DEFAULT_MESSAGE_SIZE;
+        if (messageSize > serverMessageSize)
+            messageSize = serverMessageSize;
+        if (messageSize < CSWP_DEFAULT_MESSAGE_SIZE)
+            messageSize = CSWP_DEFAULT_MESSAGE_SIZE;
+
         cswp_server_init(state);
-        res = cswp_encode_init_response(rsp, SERVER_PROTOCOL_VERSION,
+        state->messageSize = messageSize;
+        res = cswp_encode_init_response(rsp, protocolVersion,
                                         SERVER_ID, SERVER_VERISION);
+        if (res == CSWP_SUCCESS && protocolVersion >= CSWP_PROTOCOL_v2)
+            res = cswp_encode_init_response_message_size(rsp, messageSize);
         if (res != CSWP_SUCCESS)
         {
             cswp_error(state, rsp, CSWP_INIT, res, "Failed to encode CSWP_INIT response");
@@ -491,6 +512,7 @@ static int cswp_reg_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
     varint_t regCount;
     varint_t regID;
     unsigned r;
+    unsigned* regIDs = NULL;
     uint32_t* regValues = NULL;
 
     res = cswp_decode_reg_read_command_body(cmd, &deviceNo, &regCount);
@@ -506,6 +528,7 @@ static int cswp_reg_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
         }
         else
         {
+            regIDs = malloc(regCount * sizeof(unsigned));
             regValues = malloc(regCount * sizeof(uint32_t));
 
             for (r = 0; r < regCount && res == CSWP_SUCCESS; ++r)
@@ -514,11 +537,21 @@ static int cswp_reg_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
                 if (res == CSWP_SUCCESS)
                 {
                     CSWP_LOG(state, CSWP_LOG_INFO, "Read reg %u", regID);
-                    res = cswp_server_reg_read(state, deviceNo, regID, &regValues[r]);
+                    regIDs[r] = regID;
                 }
+                else
+                {
+                    res = cswp_error(state, rsp, CSWP_REG_READ, res, "Failed to decode register ID");
+                }
+            }
+
+            if (res == CSWP_SUCCESS)
+            {
+                /* Read all registers in one call so the implementation can overlap accesses */
+                res = cswp_server_reg_read_list(state, deviceNo, regCount, regIDs, regValues, &r);
                 if (res != CSWP_SUCCESS)
                 {
-                    res = cswp_error(state, rsp, CSWP_REG_READ, res, "Failed to read register %u", regID);
+                    res = cswp_error(state, rsp, CSWP_REG_READ, res, "Failed to read register %u", regIDs[r]);
                 }
             }
 
@@ -532,6 +565,7 @@ static int cswp_reg_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
             }
         }
 
+        free(regIDs);
         free(regValues);
     }
 
@@ -603,6 +637,7 @@ static int cswp_mem_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
     varint_t accessSize;
     varint_t flags;
     uint8_t* readBuf = NULL;
+    size_t rspStart;
 
     res = cswp_decode_mem_read_command_body(cmd, &deviceNo,
                                             &address, &size,
@@ -622,27 +657,25 @@ static int cswp_mem_read(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
             CSWP_LOG(state, CSWP_LOG_INFO, "Mem read: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
                      deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
 
-            readBuf = malloc(size);
-            res = cswp_server_mem_read(state, deviceNo, address, size, accessSize, flags, readBuf);
+            /* Encode the response first so memory is read straight into it */
+            rspStart = rsp->used;
+            res = cswp_encode_mem_read_response_direct(rsp, size, &readBuf);
             if (res != CSWP_SUCCESS)
             {
-                res = cswp_error(state, rsp, CSWP_MEM_READ, res, "Failed to read memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
-                                 deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_READ, res, "Failed to encode CSWP_MEM_READ response");
             }
-        }
-
-        if (res == CSWP_SUCCESS)
-        {
-            res = cswp_encode_mem_read_response(rsp, size, readBuf);
-
-            if (res != CSWP_SUCCESS)
+            else
             {
-                cswp_error(state, rsp, CSWP_MEM_READ, res, "Failed to encode CSWP_MEM_READ response");
+                res = cswp_server_mem_read(state, deviceNo, address, size, accessSize, flags, readBuf);
+                if (res != CSWP_SUCCESS)
+                {
+                    cswp_buffer_truncate(rsp, rspStart);
+                    res = cswp_error(state, rsp, CSWP_MEM_READ, res, "Failed to read memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+                }
             }
         }
-
-        if (readBuf != NULL)
-            free(readBuf);
     }
 
     return res;
@@ -715,6 +748,7 @@ static int cswp_mem_poll(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
     void* maskBuf;
     void* valueBuf;
     uint8_t* readBuf = NULL;
+    size_t rspStart;
 
     res = cswp_decode_mem_poll_command_body(cmd, &deviceNo,
                                             &address, &size,
@@ -740,26 +774,561 @@ static int cswp_mem_poll(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFF
             CSWP_LOG(state, CSWP_LOG_INFO, "Mem poll: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
                      deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
 
-            readBuf = malloc(size);
-            res = cswp_server_mem_poll(state, deviceNo, address, size, accessSize, flags, tries, interval, maskBuf, valueBuf, readBuf);
+            /* Encode the response first so memory is polled straight into it */
+            rspStart = rsp->used;
+            res = cswp_encode_mem_poll_response_direct(rsp, size, &readBuf);
+            if (res != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_POLL, res, "Failed to encode CSWP_MEM_POLL response");
+            }
+            else
+            {
+                res = cswp_server_mem_poll(state, deviceNo, address, size, accessSize, flags, tries, interval, maskBuf, valueBuf, readBuf);
+                if (res != CSWP_SUCCESS)
+                {
+                    cswp_buffer_truncate(rsp, rspStart);
+                    res = cswp_error(state, rsp, CSWP_MEM_POLL, res, "Failed to poll memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+                }
+            }
+        }
+    }
+
+    return res;
+}
+
+
+static int cswp_mem_fill(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    varint_t deviceNo;
+    uint64_t address;
+    varint_t size;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t patternSize;
+    void* patternBuf;
+
+    res = cswp_decode_mem_fill_command_body(cmd, &deviceNo,
+                                            &address, &size,
+                                            &accessSize, &flags,
+                                            &patternSize);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(cmd, &patternBuf, patternSize);
+
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_FILL, res, "Failed to decode CSWP_MEM_FILL command");
+    }
+    else
+    {
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else if (patternSize == 0 || patternSize > CSWP_MEM_FILL_MAX_PATTERN)
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_FILL, CSWP_BAD_ARGS, "Invalid fill pattern size %u", patternSize);
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem fill: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X, pattern=%u",
+                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags, patternSize);
+
+            res = cswp_server_mem_fill(state, deviceNo, address, size, accessSize, flags, patternBuf, patternSize);
             if (res != CSWP_SUCCESS)
             {
-                res = cswp_error(state, rsp, CSWP_MEM_POLL, res, "Failed to poll memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                res = cswp_error(state, rsp, CSWP_MEM_FILL, res, "Failed to fill memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
                                  deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
             }
         }
 
         if (res == CSWP_SUCCESS)
         {
-            res = cswp_encode_mem_poll_response(rsp, size, readBuf);
+            res = cswp_encode_mem_fill_response(rsp);
             if (res != CSWP_SUCCESS)
             {
-                cswp_error(state, rsp, CSWP_MEM_POLL, res, "Failed to encode CSWP_MEM_POLL response");
+                cswp_error(state, rsp, CSWP_MEM_FILL, res, "Failed to encode CSWP_MEM_FILL response");
             }
         }
+    }
 
-        if (readBuf != NULL)
-            free(readBuf);
+    return res;
+}
+
+
+/*
+ * Decode the segments of a CSWP_MEM_READ_MULTI or CSWP_MEM_WRITE_MULTI
+ * command, checking their total size is within limit
+ */
+static int cswp_mem_multi_total(CSWP_BUFFER* cmd, varint_t count, size_t limit, size_t* total)
+{
+    uint64_t address;
+    varint_t size;
+    varint_t i;
+    int res = CSWP_SUCCESS;
+
+    *total = 0;
+    for (i = 0; i < count && res == CSWP_SUCCESS; ++i)
+    {
+        res = cswp_decode_mem_segment(cmd, &address, &size);
+        if (res == CSWP_SUCCESS && size > limit - *total)
+            res = CSWP_BUFFER_FULL;
+        if (res == CSWP_SUCCESS)
+            *total += size;
+    }
+
+    return res;
+}
+
+
+static int cswp_mem_read_multi(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    int segRes;
+    varint_t deviceNo;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t count;
+    varint_t i;
+    uint64_t address;
+    varint_t size;
+    size_t segStart;
+    size_t cmdEnd;
+    size_t total;
+    size_t offset;
+    uint8_t* readBuf = NULL;
+    size_t rspStart;
+
+    res = cswp_decode_mem_read_multi_command_body(cmd, &deviceNo, &accessSize, &flags, &count);
+    segStart = cmd->pos;
+    if (res == CSWP_SUCCESS)
+        res = cswp_mem_multi_total(cmd, count, rsp->size, &total);
+    cmdEnd = cmd->pos;
+
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_READ_MULTI, res, "Failed to decode CSWP_MEM_READ_MULTI command");
+    }
+    else
+    {
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem read multi: %d: %u segments, 0x%X bytes, acc=0x%X, flags=0x%X",
+                     deviceNo, count, total, accessSize, flags);
+
+            /* Each segment is read straight into the response, and a failed
+               segment only affects its own status */
+            rspStart = rsp->used;
+            res = cswp_encode_mem_read_multi_response_direct(rsp, total, &readBuf);
+            if (res == CSWP_SUCCESS)
+                res = cswp_encode_mem_segment_status_count(rsp, count);
+
+            cswp_buffer_seek(cmd, segStart);
+            for (i = 0, offset = 0; i < count && res == CSWP_SUCCESS; ++i, offset += size)
+            {
+                cswp_decode_mem_segment(cmd, &address, &size);
+                segRes = cswp_server_mem_read(state, deviceNo, address, size, accessSize, flags, readBuf + offset);
+                if (segRes != CSWP_SUCCESS)
+                {
+                    memset(readBuf + offset, 0, size);
+                    CSWP_LOG(state, CSWP_LOG_INFO, "Failed to read memory %d: 0x%08X%08X ..+0x%X: %d",
+                             deviceNo, address >> 32, address & 0xFFFFFFFFL, size, segRes);
+                }
+                res = cswp_encode_mem_segment_status(rsp, segRes);
+            }
+            cswp_buffer_seek(cmd, cmdEnd);
+
+            if (res != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_READ_MULTI, res, "Failed to encode CSWP_MEM_READ_MULTI response");
+            }
+        }
+    }
+
+    return res;
+}
+
+
+static int cswp_mem_write_multi(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    int segRes;
+    varint_t deviceNo;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t count;
+    varint_t i;
+    uint64_t address;
+    varint_t size;
+    size_t segStart;
+    size_t cmdEnd;
+    size_t total;
+    size_t offset;
+    void* writeBuf;
+    size_t rspStart;
+
+    res = cswp_decode_mem_write_multi_command_body(cmd, &deviceNo, &accessSize, &flags, &count);
+    segStart = cmd->pos;
+    if (res == CSWP_SUCCESS)
+        res = cswp_mem_multi_total(cmd, count, cmd->size, &total);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(cmd, &writeBuf, total);
+    cmdEnd = cmd->pos;
+
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_WRITE_MULTI, res, "Failed to decode CSWP_MEM_WRITE_MULTI command");
+    }
+    else
+    {
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem write multi: %d: %u segments, 0x%X bytes, acc=0x%X, flags=0x%X",
+                     deviceNo, count, total, accessSize, flags);
+
+            /* A failed segment only affects its own status */
+            rspStart = rsp->used;
+            res = cswp_encode_mem_write_multi_response(rsp);
+            if (res == CSWP_SUCCESS)
+                res = cswp_encode_mem_segment_status_count(rsp, count);
+
+            cswp_buffer_seek(cmd, segStart);
+            for (i = 0, offset = 0; i < count && res == CSWP_SUCCESS; ++i, offset += size)
+            {
+                cswp_decode_mem_segment(cmd, &address, &size);
+                segRes = cswp_server_mem_write(state, deviceNo, address, size, accessSize, flags,
+                                               (const uint8_t*)writeBuf + offset);
+                if (segRes != CSWP_SUCCESS)
+                {
+                    CSWP_LOG(state, CSWP_LOG_INFO, "Failed to write memory %d: 0x%08X%08X ..+0x%X: %d",
+                             deviceNo, address >> 32, address & 0xFFFFFFFFL, size, segRes);
+                }
+                res = cswp_encode_mem_segment_status(rsp, segRes);
+            }
+            cswp_buffer_seek(cmd, cmdEnd);
+
+            if (res != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_WRITE_MULTI, res, "Failed to encode CSWP_MEM_WRITE_MULTI response");
+            }
+        }
+    }
+
+    return res;
+}
+
+
+static int cswp_mem_checksum(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    varint_t deviceNo;
+    uint64_t address;
+    varint_t size;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t algorithm;
+    varint_t blockSize;
+    size_t count;
+    size_t i;
+    size_t offset;
+    size_t n;
+    uint64_t digest;
+    size_t rspStart;
+    int memRes;
+
+    res = cswp_decode_mem_checksum_command_body(cmd, &deviceNo,
+                                                &address, &size,
+                                                &accessSize, &flags,
+                                                &algorithm, &blockSize);
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_CHECKSUM, res, "Failed to decode CSWP_MEM_CHECKSUM command");
+    }
+    else
+    {
+        count = cswp_checksum_count(size, blockSize);
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else if (!cswp_checksum_valid((cswp_checksum_t)algorithm))
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_CHECKSUM, CSWP_BAD_ARGS, "Invalid checksum algorithm %u", algorithm);
+        }
+        else if (count > rsp->size / sizeof(uint64_t))
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_CHECKSUM, CSWP_BUFFER_FULL, "Too many checksum blocks %u", (unsigned)count);
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem checksum: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X, alg=%u, block=0x%X",
+                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags, algorithm, blockSize);
+
+            /* One digest per block, the last block may be short */
+            rspStart = rsp->used;
+            memRes = CSWP_SUCCESS;
+            res = cswp_encode_mem_checksum_response(rsp, count);
+            for (i = 0, offset = 0; i < count && res == CSWP_SUCCESS; ++i, offset += n)
+            {
+                n = size - offset;
+                if (blockSize != 0 && n > blockSize)
+                    n = blockSize;
+                memRes = cswp_server_mem_checksum(state, deviceNo,
+                                                  (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                                  n, accessSize, flags, (cswp_checksum_t)algorithm, &digest);
+                if (memRes != CSWP_SUCCESS)
+                    break;
+                res = cswp_encode_mem_checksum_digest(rsp, digest);
+            }
+
+            if (memRes != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                res = cswp_error(state, rsp, CSWP_MEM_CHECKSUM, memRes, "Failed to checksum memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                                 deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+            }
+            else if (res != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_CHECKSUM, res, "Failed to encode CSWP_MEM_CHECKSUM response");
+            }
+        }
+    }
+
+    return res;
+}
+
+
+static int cswp_mem_read_delta(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    int memRes = CSWP_SUCCESS;
+    varint_t deviceNo;
+    uint64_t address;
+    varint_t size;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t algorithm;
+    varint_t blockSize;
+    varint_t count;
+    size_t bitmapSize = 0;
+    size_t cmdEnd = 0;
+    size_t i;
+    size_t offset;
+    size_t n;
+    size_t changed = 0;
+    uint64_t digest;
+    uint8_t* bitmap;
+    uint8_t* readBuf;
+    size_t blockStart;
+    size_t rspStart;
+
+    res = cswp_decode_mem_read_delta_command_body(cmd, &deviceNo,
+                                                  &address, &size,
+                                                  &accessSize, &flags,
+                                                  &algorithm, &blockSize, &count);
+    if (res == CSWP_SUCCESS && count > (cmd->used - cmd->pos) / sizeof(uint64_t))
+        res = CSWP_BUFFER_EMPTY;
+    if (res == CSWP_SUCCESS)
+    {
+        bitmapSize = (count + 7) / 8;
+        cmdEnd = cmd->pos + count * sizeof(uint64_t);
+    }
+
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_READ_DELTA, res, "Failed to decode CSWP_MEM_READ_DELTA command");
+    }
+    else
+    {
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else if (!cswp_checksum_valid((cswp_checksum_t)algorithm))
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_READ_DELTA, CSWP_BAD_ARGS, "Invalid checksum algorithm %u", algorithm);
+        }
+        else if (count != cswp_checksum_count(size, blockSize))
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_READ_DELTA, CSWP_BAD_ARGS, "Expected %u block digests, got %u",
+                             (unsigned)cswp_checksum_count(size, blockSize), count);
+        }
+        else if (bitmapSize > rsp->size || size > rsp->size - bitmapSize)
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_READ_DELTA, CSWP_BUFFER_FULL, "Delta read too large 0x%X", size);
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem read delta: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X, block=0x%X",
+                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags, blockSize);
+
+            /* Each block is read straight into the response, then dropped
+               again if it still matches the client's digest */
+            rspStart = rsp->used;
+            res = cswp_encode_mem_read_delta_response_direct(rsp, count, &bitmap);
+            if (res == CSWP_SUCCESS)
+                memset(bitmap, 0, bitmapSize);
+            for (i = 0, offset = 0; i < count && res == CSWP_SUCCESS; ++i, offset += n)
+            {
+                n = size - offset;
+                if (blockSize != 0 && n > blockSize)
+                    n = blockSize;
+                res = cswp_decode_mem_read_delta_digest(cmd, &digest);
+                blockStart = rsp->used;
+                if (res == CSWP_SUCCESS)
+                    res = cswp_buffer_put_direct(rsp, (void**)&readBuf, n);
+                if (res != CSWP_SUCCESS)
+                    break;
+                memRes = cswp_server_mem_read(state, deviceNo,
+                                              (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                              n, accessSize, flags, readBuf);
+                if (memRes != CSWP_SUCCESS)
+                    break;
+                if (cswp_checksum((cswp_checksum_t)algorithm, readBuf, n) == digest)
+                {
+                    cswp_buffer_truncate(rsp, blockStart);
+                }
+                else
+                {
+                    bitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+                    ++changed;
+                }
+            }
+            cswp_buffer_seek(cmd, cmdEnd);
+
+            if (memRes != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                res = cswp_error(state, rsp, CSWP_MEM_READ_DELTA, memRes, "Failed to read memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                                 deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+            }
+            else if (res != CSWP_SUCCESS)
+            {
+                cswp_buffer_truncate(rsp, rspStart);
+                cswp_error(state, rsp, CSWP_MEM_READ_DELTA, res, "Failed to encode CSWP_MEM_READ_DELTA response");
+            }
+            else
+            {
+                CSWP_LOG(state, CSWP_LOG_DEBUG, "Mem read delta: %u of %u blocks changed",
+                         (unsigned)changed, count);
+            }
+        }
+    }
+
+    return res;
+}
+
+
+/* Space for a response header and count ahead of CSWP_MEM_SEARCH matches */
+#define MEM_SEARCH_RSP_HEADER 16
+
+static int cswp_mem_search(cswp_server_state_t* state, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    int res;
+    varint_t deviceNo;
+    uint64_t address;
+    varint_t size;
+    varint_t accessSize;
+    varint_t flags;
+    varint_t alignment;
+    varint_t maxHits;
+    varint_t patternSize;
+    varint_t maskSize = 0;
+    void* patternBuf;
+    void* maskBuf = NULL;
+    cswp_search_t search;
+    uint64_t* hits = NULL;
+    size_t hitCount = 0;
+    size_t fit;
+    size_t i;
+    size_t rspStart;
+
+    res = cswp_decode_mem_search_command_body(cmd, &deviceNo,
+                                              &address, &size,
+                                              &accessSize, &flags,
+                                              &alignment, &maxHits,
+                                              &patternSize);
+    if (res == CSWP_SUCCESS)
+        res = cswp_buffer_get_direct(cmd, &patternBuf, patternSize);
+    if (res == CSWP_SUCCESS)
+        res = cswp_decode_mem_search_mask_size(cmd, &maskSize);
+    if (res == CSWP_SUCCESS && maskSize > 0)
+        res = cswp_buffer_get_direct(cmd, &maskBuf, maskSize);
+
+    if (res != CSWP_SUCCESS)
+    {
+        cswp_error(state, rsp, CSWP_MEM_SEARCH, res, "Failed to decode CSWP_MEM_SEARCH command");
+    }
+    else
+    {
+        /* Return no more matches than fit in the response */
+        fit = (rsp->size - rsp->used > MEM_SEARCH_RSP_HEADER)
+            ? (rsp->size - rsp->used - MEM_SEARCH_RSP_HEADER) / sizeof(uint64_t) : 0;
+        if (maxHits == 0 || maxHits > fit)
+            maxHits = fit;
+
+        if (deviceNo >= state->deviceCount)
+        {
+            res = cswp_error(state, rsp, CSWP_DEVICE_OPEN, CSWP_INVALID_DEVICE, "Invalid device %u", deviceNo);
+        }
+        else if (patternSize == 0 || patternSize > CSWP_MEM_SEARCH_MAX_PATTERN)
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_SEARCH, CSWP_BAD_ARGS, "Invalid search pattern size %u", patternSize);
+        }
+        else if (maskSize != 0 && maskSize != patternSize)
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_SEARCH, CSWP_BAD_ARGS, "Search mask size %u does not match pattern", maskSize);
+        }
+        else if (flags & CSWP_MEM_NO_ADDR_INC)
+        {
+            res = cswp_error(state, rsp, CSWP_MEM_SEARCH, CSWP_BAD_ARGS, "Search requires address increment");
+        }
+        else
+        {
+            CSWP_LOG(state, CSWP_LOG_INFO, "Mem search: %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X, pattern=%u, mask=%u, align=%u, max=%u",
+                     deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags,
+                     patternSize, maskSize, alignment, maxHits);
+
+            cswp_search_init(&search, patternBuf, maskBuf, patternSize, alignment);
+            hits = malloc((maxHits ? maxHits : 1) * sizeof(uint64_t));
+            if (hits == NULL)
+                res = CSWP_FAILED;
+            else
+                res = cswp_server_mem_search(state, deviceNo, address, size, accessSize, flags,
+                                             &search, hits, maxHits, &hitCount);
+            if (res != CSWP_SUCCESS)
+            {
+                res = cswp_error(state, rsp, CSWP_MEM_SEARCH, res, "Failed to search memory %d: 0x%08X%08X ..+0x%X, acc=0x%X, flags=0x%X",
+                                 deviceNo, address >> 32, address & 0xFFFFFFFFL, size, accessSize, flags);
+            }
+            else
+            {
+                rspStart = rsp->used;
+                res = cswp_encode_mem_search_response(rsp, hitCount);
+                for (i = 0; i < hitCount && res == CSWP_SUCCESS; ++i)
+                    res = cswp_encode_mem_search_hit(rsp, hits[i]);
+                if (res != CSWP_SUCCESS)
+                {
+                    cswp_buffer_truncate(rsp, rspStart);
+                    cswp_error(state, rsp, CSWP_MEM_SEARCH, res, "Failed to encode CSWP_MEM_SEARCH response");
+                }
+            }
+        }
+
+        free(hits);
     }
 
     return res;
@@ -845,7 +1414,31 @@ static int cswp_dispatch_command(cswp_server_state_t* state, CSWP_BUFFER* cmd, C
     case CSWP_ASYNC_MESSAGE:
         break;
 
-        /* No support for any other command (including impl defined */
+    case CSWP_MEM_FILL:
+        res = cswp_mem_fill(state, cmd, rsp);
+        break;
+
+    case CSWP_MEM_READ_MULTI:
+        res = cswp_mem_read_multi(state, cmd, rsp);
+        break;
+
+    case CSWP_MEM_WRITE_MULTI:
+        res = cswp_mem_write_multi(state, cmd, rsp);
+        break;
+
+    case CSWP_MEM_CHECKSUM:
+        res = cswp_mem_checksum(state, cmd, rsp);
+        break;
+
+    case CSWP_MEM_READ_DELTA:
+        res = cswp_mem_read_delta(state, cmd, rsp);
+        break;
+
+    case CSWP_MEM_SEARCH:
+        res = cswp_mem_search(state, cmd, rsp);
+        break;
+
+        /* No support for any other command (including other impl defined) */
     default:
         cswp_error(state, rsp, messageType, res, "Unknown message type %d", messageType);
         break;
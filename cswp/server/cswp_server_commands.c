@@ -69,6 +69,24 @@ int cswp_encode_init_response(CSWP_BUFFER* buf,
 }
 
 
+int cswp_decode_init_command_message_size(CSWP_BUFFER* buf,
+                                          varint_t* maxMessageSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, maxMessageSize));
+    return res;
+}
+
+
+int cswp_encode_init_response_message_size(CSWP_BUFFER* buf,
+                                           varint_t messageSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, messageSize));
+    return res;
+}
+
+
 int cswp_encode_term_response(CSWP_BUFFER* buf)
 {
     int res = CSWP_SUCCESS;
@@ -354,6 +372,18 @@ int cswp_encode_mem_read_response(CSWP_BUFFER* buf,
 }
 
 
+int cswp_encode_mem_read_response_direct(CSWP_BUFFER* buf,
+                                         varint_t count,
+                                         uint8_t** data)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_READ, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    __CSWP_CHECK(cswp_buffer_put_direct(buf, (void**)data, count));
+    return res;
+}
+
+
 int cswp_decode_mem_write_command_body(CSWP_BUFFER* buf,
                                        varint_t* deviceNo,
                                        uint64_t* address,
@@ -412,6 +442,259 @@ int cswp_encode_mem_poll_response(CSWP_BUFFER* buf,
 }
 
 
+int cswp_encode_mem_poll_response_direct(CSWP_BUFFER* buf,
+                                         varint_t count,
+                                         uint8_t** data)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_POLL, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    __CSWP_CHECK(cswp_buffer_put_direct(buf, (void**)data, count));
+    return res;
+}
+
+
+int cswp_decode_mem_fill_command_body(CSWP_BUFFER* buf,
+                                      varint_t* deviceNo,
+                                      uint64_t* address,
+                                      varint_t* size,
+                                      varint_t* accessSize,
+                                      varint_t* flags,
+                                      varint_t* patternSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, patternSize));
+    return res;
+}
+
+
+int cswp_encode_mem_fill_response(CSWP_BUFFER* buf)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_FILL, 0));
+    return res;
+}
+
+
+int cswp_decode_mem_read_multi_command_body(CSWP_BUFFER* buf,
+                                            varint_t* deviceNo,
+                                            varint_t* accessSize,
+                                            varint_t* flags,
+                                            varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_write_multi_command_body(CSWP_BUFFER* buf,
+                                             varint_t* deviceNo,
+                                             varint_t* accessSize,
+                                             varint_t* flags,
+                                             varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_segment(CSWP_BUFFER* buf,
+                            uint64_t* address,
+                            varint_t* size)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    return res;
+}
+
+
+int cswp_encode_mem_read_multi_response_direct(CSWP_BUFFER* buf,
+                                               varint_t size,
+                                               uint8_t** data)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_READ_MULTI, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_put_direct(buf, (void**)data, size));
+    return res;
+}
+
+
+int cswp_encode_mem_write_multi_response(CSWP_BUFFER* buf)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_WRITE_MULTI, 0));
+    return res;
+}
+
+
+int cswp_encode_mem_segment_status_count(CSWP_BUFFER* buf,
+                                         varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_segment_status(CSWP_BUFFER* buf,
+                                   varint_t status)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, status));
+    return res;
+}
+
+
+int cswp_decode_mem_checksum_command_body(CSWP_BUFFER* buf,
+                                          varint_t* deviceNo,
+                                          uint64_t* address,
+                                          varint_t* size,
+                                          varint_t* accessSize,
+                                          varint_t* flags,
+                                          varint_t* algorithm,
+                                          varint_t* blockSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, algorithm));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, blockSize));
+    return res;
+}
+
+
+int cswp_encode_mem_checksum_response(CSWP_BUFFER* buf,
+                                      varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_CHECKSUM, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_checksum_digest(CSWP_BUFFER* buf,
+                                    uint64_t digest)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, digest));
+    return res;
+}
+
+
+int cswp_decode_mem_read_delta_command_body(CSWP_BUFFER* buf,
+                                            varint_t* deviceNo,
+                                            uint64_t* address,
+                                            varint_t* size,
+                                            varint_t* accessSize,
+                                            varint_t* flags,
+                                            varint_t* algorithm,
+                                            varint_t* blockSize,
+                                            varint_t* count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, algorithm));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, blockSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, count));
+    return res;
+}
+
+
+int cswp_decode_mem_read_delta_digest(CSWP_BUFFER* buf,
+                                      uint64_t* digest)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, digest));
+    return res;
+}
+
+
+int cswp_encode_mem_read_delta_response_direct(CSWP_BUFFER* buf,
+                                               varint_t count,
+                                               uint8_t** bitmap)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_READ_DELTA, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    __CSWP_CHECK(cswp_buffer_put_direct(buf, (void**)bitmap, (count + 7) / 8));
+    return res;
+}
+
+
+int cswp_decode_mem_search_command_body(CSWP_BUFFER* buf,
+                                        varint_t* deviceNo,
+                                        uint64_t* address,
+                                        varint_t* size,
+                                        varint_t* accessSize,
+                                        varint_t* flags,
+                                        varint_t* alignment,
+                                        varint_t* maxHits,
+                                        varint_t* patternSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, deviceNo));
+    __CSWP_CHECK(cswp_buffer_get_uint64(buf, address));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, size));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, accessSize));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, flags));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, alignment));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, maxHits));
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, patternSize));
+    return res;
+}
+
+
+int cswp_decode_mem_search_mask_size(CSWP_BUFFER* buf,
+                                     varint_t* maskSize)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_get_varint(buf, maskSize));
+    return res;
+}
+
+
+int cswp_encode_mem_search_response(CSWP_BUFFER* buf,
+                                    varint_t count)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_encode_response_header(buf, CSWP_MEM_SEARCH, 0));
+    __CSWP_CHECK(cswp_buffer_put_varint(buf, count));
+    return res;
+}
+
+
+int cswp_encode_mem_search_hit(CSWP_BUFFER* buf,
+                               uint64_t address)
+{
+    int res = CSWP_SUCCESS;
+    __CSWP_CHECK(cswp_buffer_put_uint64(buf, address));
+    return res;
+}
+
+
 int cswp_encode_async_message(CSWP_BUFFER* buf,
                               varint_t errorCode,
                               varint_t deviceNo,
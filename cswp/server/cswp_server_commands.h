@@ -81,6 +81,32 @@ int cswp_encode_init_response(CSWP_BUFFER* buf,
                               const char* serverID,
                               varint_t serverVersion);
 
+/**
+ * Decode the message size field of a CSWP_INIT command
+ *
+ * The field follows the client ID when clientProtocolVersion is
+ * CSWP_PROTOCOL_v2 or later
+ *
+ * @param buf The buffer to decode from
+ * @param maxMessageSize Receives the largest message the client can send or receive
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_init_command_message_size(CSWP_BUFFER* buf,
+                                          varint_t* maxMessageSize);
+
+/**
+ * Encode the message size field of a CSWP_INIT response
+ *
+ * The field follows the server version when the response protocol version
+ * is CSWP_PROTOCOL_v2 or later
+ *
+ * @param buf The buffer to encode to
+ * @param messageSize The maximum message size for the session
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_init_response_message_size(CSWP_BUFFER* buf,
+                                           varint_t messageSize);
+
 /**
  * Encode a CSWP_TERM response
  *
@@ -389,6 +415,20 @@ int cswp_encode_mem_read_response(CSWP_BUFFER* buf,
                                   varint_t count,
                                   const uint8_t* data);
 
+/**
+ * Encode a CSWP_MEM_READ response with space for the data
+ *
+ * The data is written in place by the caller, avoiding a copy
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of bytes read
+ * @param data Receives a pointer to the space for the data
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_read_response_direct(CSWP_BUFFER* buf,
+                                         varint_t count,
+                                         uint8_t** data);
+
 /**
  * Decode a CSWP_MEM_WRITE command
  *
@@ -458,6 +498,314 @@ int cswp_encode_mem_poll_response(CSWP_BUFFER* buf,
                                   varint_t count,
                                   const uint8_t* data);
 
+/**
+ * Encode a CSWP_MEM_POLL response with space for the data
+ *
+ * The data is written in place by the caller, avoiding a copy
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of bytes read
+ * @param data Receives a pointer to the space for the data
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_poll_response_direct(CSWP_BUFFER* buf,
+                                         varint_t count,
+                                         uint8_t** data);
+
+/**
+ * Decode a CSWP_MEM_FILL command
+ *
+ * The server should then obtain a pointer to the pattern
+ * with a call to:
+ *   cswp_buffer_get_direct(buf, &pPattern, patternSize);
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param address Receives the address to fill from
+ * @param size Receives the number of bytes to fill
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param patternSize Receives the number of bytes in the pattern
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_fill_command_body(CSWP_BUFFER* buf,
+                                      varint_t* deviceNo,
+                                      uint64_t* address,
+                                      varint_t* size,
+                                      varint_t* accessSize,
+                                      varint_t* flags,
+                                      varint_t* patternSize);
+
+/**
+ * Encode a CSWP_MEM_FILL response
+ *
+ * @param buf The buffer to encode to
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_fill_response(CSWP_BUFFER* buf);
+
+/**
+ * Decode a CSWP_MEM_READ_MULTI command
+ *
+ * count segments follow, each decoded with cswp_decode_mem_segment()
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param count Receives the number of segments
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_read_multi_command_body(CSWP_BUFFER* buf,
+                                            varint_t* deviceNo,
+                                            varint_t* accessSize,
+                                            varint_t* flags,
+                                            varint_t* count);
+
+/**
+ * Decode a CSWP_MEM_WRITE_MULTI command
+ *
+ * count segments follow, each decoded with cswp_decode_mem_segment().
+ * The server should then obtain a pointer to the data for all segments
+ * with a call to:
+ *   cswp_buffer_get_direct(buf, &pData, totalSize);
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param count Receives the number of segments
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_write_multi_command_body(CSWP_BUFFER* buf,
+                                             varint_t* deviceNo,
+                                             varint_t* accessSize,
+                                             varint_t* flags,
+                                             varint_t* count);
+
+/**
+ * Decode a segment of a CSWP_MEM_READ_MULTI or CSWP_MEM_WRITE_MULTI command
+ *
+ * @param buf The buffer to decode from
+ * @param address Receives the address of the segment
+ * @param size Receives the number of bytes in the segment
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_segment(CSWP_BUFFER* buf,
+                            uint64_t* address,
+                            varint_t* size);
+
+/**
+ * Encode a CSWP_MEM_READ_MULTI response with space for the data
+ *
+ * The data for all segments is written in place by the caller.  The
+ * segment status must follow, encoded with
+ * cswp_encode_mem_segment_status_count() and cswp_encode_mem_segment_status()
+ *
+ * @param buf The buffer to encode to
+ * @param size The number of bytes of data
+ * @param data Receives a pointer to the space for the data
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_read_multi_response_direct(CSWP_BUFFER* buf,
+                                               varint_t size,
+                                               uint8_t** data);
+
+/**
+ * Encode a CSWP_MEM_WRITE_MULTI response
+ *
+ * The segment status must follow, encoded with
+ * cswp_encode_mem_segment_status_count() and cswp_encode_mem_segment_status()
+ *
+ * @param buf The buffer to encode to
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_write_multi_response(CSWP_BUFFER* buf);
+
+/**
+ * Encode the number of segment status values in a CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI response
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of segments
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_segment_status_count(CSWP_BUFFER* buf,
+                                         varint_t count);
+
+/**
+ * Encode the status of one segment of a CSWP_MEM_READ_MULTI or
+ * CSWP_MEM_WRITE_MULTI response
+ *
+ * @param buf The buffer to encode to
+ * @param status The result of the segment access (cswp_result_t)
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_segment_status(CSWP_BUFFER* buf,
+                                   varint_t status);
+
+/**
+ * Decode a CSWP_MEM_CHECKSUM command
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param address Receives the address to checksum from
+ * @param size Receives the number of bytes to checksum
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param algorithm Receives the checksum algorithm (cswp_checksum_t)
+ * @param blockSize Receives the bytes covered by each digest, or 0 for one
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_checksum_command_body(CSWP_BUFFER* buf,
+                                          varint_t* deviceNo,
+                                          uint64_t* address,
+                                          varint_t* size,
+                                          varint_t* accessSize,
+                                          varint_t* flags,
+                                          varint_t* algorithm,
+                                          varint_t* blockSize);
+
+/**
+ * Encode a CSWP_MEM_CHECKSUM response
+ *
+ * count digests must follow, each encoded with
+ * cswp_encode_mem_checksum_digest()
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of digests
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_checksum_response(CSWP_BUFFER* buf,
+                                      varint_t count);
+
+/**
+ * Encode one digest of a CSWP_MEM_CHECKSUM response
+ *
+ * @param buf The buffer to encode to
+ * @param digest The digest
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_checksum_digest(CSWP_BUFFER* buf,
+                                    uint64_t digest);
+
+/**
+ * Decode a CSWP_MEM_READ_DELTA command
+ *
+ * count digests follow, each decoded with
+ * cswp_decode_mem_read_delta_digest()
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param address Receives the address to read from
+ * @param size Receives the number of bytes to read
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param algorithm Receives the checksum algorithm (cswp_checksum_t) of the digests
+ * @param blockSize Receives the bytes covered by each digest, or 0 for one block
+ * @param count Receives the number of digests
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_read_delta_command_body(CSWP_BUFFER* buf,
+                                            varint_t* deviceNo,
+                                            uint64_t* address,
+                                            varint_t* size,
+                                            varint_t* accessSize,
+                                            varint_t* flags,
+                                            varint_t* algorithm,
+                                            varint_t* blockSize,
+                                            varint_t* count);
+
+/**
+ * Decode the digest the client holds for one block of a
+ * CSWP_MEM_READ_DELTA command
+ *
+ * @param buf The buffer to decode from
+ * @param digest Receives the digest
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_read_delta_digest(CSWP_BUFFER* buf,
+                                      uint64_t* digest);
+
+/**
+ * Encode a CSWP_MEM_READ_DELTA response with space for the changed block
+ * bitmap
+ *
+ * The bitmap, bit n of byte n / 8 set for each block n that changed, is
+ * written in place by the caller.  The data of the changed blocks must
+ * follow in order.
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of blocks
+ * @param bitmap Receives a pointer to the (count + 7) / 8 bytes of bitmap
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_read_delta_response_direct(CSWP_BUFFER* buf,
+                                               varint_t count,
+                                               uint8_t** bitmap);
+
+/**
+ * Decode a CSWP_MEM_SEARCH command
+ *
+ * The server should then obtain a pointer to the pattern with a call to:
+ *   cswp_buffer_get_direct(buf, &pPattern, patternSize);
+ * followed by the mask size with cswp_decode_mem_search_mask_size() and
+ * the mask, if any, with cswp_buffer_get_direct()
+ *
+ * @param buf The buffer to decode from
+ * @param deviceNo Receives the device number
+ * @param address Receives the address to search from
+ * @param size Receives the number of bytes to search
+ * @param accessSize Receives the access size (cswp_access_size_t) to use
+ * @param flags Receives flags
+ * @param alignment Receives the alignment of matches, 0 or 1 for any
+ * @param maxHits Receives the most matches to return, 0 for as many as fit
+ * @param patternSize Receives the number of bytes in the pattern
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_search_command_body(CSWP_BUFFER* buf,
+                                        varint_t* deviceNo,
+                                        uint64_t* address,
+                                        varint_t* size,
+                                        varint_t* accessSize,
+                                        varint_t* flags,
+                                        varint_t* alignment,
+                                        varint_t* maxHits,
+                                        varint_t* patternSize);
+
+/**
+ * Decode the mask size of a CSWP_MEM_SEARCH command
+ *
+ * @param buf The buffer to decode from
+ * @param maskSize Receives the number of bytes in the mask, 0 for none
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_decode_mem_search_mask_size(CSWP_BUFFER* buf,
+                                     varint_t* maskSize);
+
+/**
+ * Encode a CSWP_MEM_SEARCH response
+ *
+ * count addresses must follow, each encoded with
+ * cswp_encode_mem_search_hit()
+ *
+ * @param buf The buffer to encode to
+ * @param count The number of matches
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_search_response(CSWP_BUFFER* buf,
+                                    varint_t count);
+
+/**
+ * Encode one match of a CSWP_MEM_SEARCH response
+ *
+ * @param buf The buffer to encode to
+ * @param address The address of the match
+ * @return Error code: CSWP_SUCCESS on success, or other cswp_result_t on error
+ */
+int cswp_encode_mem_search_hit(CSWP_BUFFER* buf,
+                               uint64_t address);
+
 /**
  * Encode a CSWP_ASYNC_MESSAGE message
  *
@@ -5,6 +5,7 @@
 
 #include "cswp_server_impl.h"
 #include "cswp_types.h"
+#include "cswp_checksum.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -12,6 +13,15 @@
 #define snprintf _snprintf
 #endif
 
+/* Size of the buffer used to fill memory when the implementation has no fill */
+#define MEM_FILL_BUFFER_SIZE 4096
+/* Size of the buffer used to checksum memory when the implementation has no
+   checksum */
+#define MEM_CHECKSUM_BUFFER_SIZE 4096
+/* Size of the buffer used to search memory when the implementation has no
+   search */
+#define MEM_SEARCH_BUFFER_SIZE 4096
+
 void cswp_server_init(cswp_server_state_t* state)
 {
     state->deviceCount = 0;
@@ -184,6 +194,28 @@ int cswp_server_reg_read(cswp_server_state_t* state, unsigned deviceNo, unsigned
 }
 
 
+int cswp_server_reg_read_list(cswp_server_state_t* state, unsigned deviceNo,
+                              unsigned count, const unsigned* regIDs, uint32_t* values,
+                              unsigned* failedIndex)
+{
+    unsigned r;
+    int res = CSWP_SUCCESS;
+
+    /* Use list read if implementation supports it */
+    if (state->impl && state->impl->register_read_list)
+        return state->impl->register_read_list(state, deviceNo, count, regIDs, values, failedIndex);
+
+    for (r = 0; r < count && res == CSWP_SUCCESS; ++r)
+    {
+        res = cswp_server_reg_read(state, deviceNo, regIDs[r], &values[r]);
+        if (res != CSWP_SUCCESS)
+            *failedIndex = r;
+    }
+
+    return res;
+}
+
+
 int cswp_server_reg_write(cswp_server_state_t* state, unsigned deviceNo, unsigned regID, uint32_t value)
 {
     /* Check implementation supports register write */
@@ -234,4 +266,147 @@ int cswp_server_mem_poll(cswp_server_state_t* state, unsigned deviceNo,
                                  pMask, pValue, pData);
 }
 
+
+int cswp_server_mem_fill(cswp_server_state_t* state, unsigned deviceNo,
+                         uint64_t address, size_t size,
+                         cswp_access_size_t accessSize, unsigned flags,
+                         const uint8_t* pPattern, size_t patternSize)
+{
+    /* Use fill if implementation supports it */
+    if (state->impl && state->impl->mem_fill)
+        return state->impl->mem_fill(state, deviceNo, address, size, accessSize, flags,
+                                     pPattern, patternSize);
+
+    return cswp_server_mem_fill_by_write(state, deviceNo, address, size, accessSize, flags,
+                                         pPattern, patternSize);
+}
+
+
+int cswp_server_mem_fill_by_write(cswp_server_state_t* state, unsigned deviceNo,
+                                  uint64_t address, size_t size,
+                                  cswp_access_size_t accessSize, unsigned flags,
+                                  const uint8_t* pPattern, size_t patternSize)
+{
+    uint8_t buf[MEM_FILL_BUFFER_SIZE];
+    size_t chunkSize;
+    size_t offset;
+    size_t n;
+    int res = CSWP_SUCCESS;
+
+    /* Write the pattern a buffer at a time.  The buffer holds a whole number
+       of patterns and 64-bit elements, so each write starts at the beginning
+       of the pattern and on an access boundary */
+    if (patternSize == 0 || patternSize > CSWP_MEM_FILL_MAX_PATTERN)
+        return CSWP_BAD_ARGS;
+    chunkSize = sizeof(buf) - sizeof(buf) % (patternSize * sizeof(uint64_t));
+    for (n = 0; n < chunkSize; ++n)
+        buf[n] = pPattern[n % patternSize];
+
+    for (offset = 0; offset < size && res == CSWP_SUCCESS; offset += n)
+    {
+        n = size - offset;
+        if (n > chunkSize)
+            n = chunkSize;
+        res = cswp_server_mem_write(state, deviceNo,
+                                    (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                    n, accessSize, flags, buf);
+    }
+
+    return res;
+}
+
+
+int cswp_server_mem_checksum(cswp_server_state_t* state, unsigned deviceNo,
+                             uint64_t address, size_t size,
+                             cswp_access_size_t accessSize, unsigned flags,
+                             cswp_checksum_t algorithm, uint64_t* pDigest)
+{
+    if (!cswp_checksum_valid(algorithm))
+        return CSWP_BAD_ARGS;
+
+    /* Use checksum if implementation supports it */
+    if (state->impl && state->impl->mem_checksum)
+        return state->impl->mem_checksum(state, deviceNo, address, size, accessSize, flags,
+                                         algorithm, pDigest);
+
+    return cswp_server_mem_checksum_by_read(state, deviceNo, address, size, accessSize, flags,
+                                            algorithm, pDigest);
+}
+
+
+int cswp_server_mem_checksum_by_read(cswp_server_state_t* state, unsigned deviceNo,
+                                     uint64_t address, size_t size,
+                                     cswp_access_size_t accessSize, unsigned flags,
+                                     cswp_checksum_t algorithm, uint64_t* pDigest)
+{
+    uint8_t buf[MEM_CHECKSUM_BUFFER_SIZE];
+    uint64_t sum;
+    size_t offset;
+    size_t n;
+    int res = CSWP_SUCCESS;
+
+    if (!cswp_checksum_valid(algorithm))
+        return CSWP_BAD_ARGS;
+
+    /* Read a buffer at a time.  The buffer size is a multiple of every
+       access size, so each read starts on an access boundary */
+    sum = cswp_checksum_init(algorithm);
+    for (offset = 0; offset < size && res == CSWP_SUCCESS; offset += n)
+    {
+        n = size - offset;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        res = cswp_server_mem_read(state, deviceNo,
+                                   (flags & CSWP_MEM_NO_ADDR_INC) ? address : address + offset,
+                                   n, accessSize, flags, buf);
+        if (res == CSWP_SUCCESS)
+            sum = cswp_checksum_update(algorithm, sum, buf, n);
+    }
+    if (res == CSWP_SUCCESS)
+        *pDigest = cswp_checksum_final(algorithm, sum);
+
+    return res;
+}
+
+
+int cswp_server_mem_search(cswp_server_state_t* state, unsigned deviceNo,
+                           uint64_t address, size_t size,
+                           cswp_access_size_t accessSize, unsigned flags,
+                           const cswp_search_t* search,
+                           uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    uint8_t buf[MEM_SEARCH_BUFFER_SIZE];
+    size_t step;
+    size_t offset;
+    size_t n;
+    int res = CSWP_SUCCESS;
+
+    *pHitCount = 0;
+
+    /* Use search if implementation supports it */
+    if (state->impl && state->impl->mem_search)
+        return state->impl->mem_search(state, deviceNo, address, size, accessSize, flags,
+                                       search, pHits, maxHits, pHitCount);
+
+    /* Otherwise read a buffer at a time.  Buffers overlap so matches
+       across their boundary are found, and each starts a multiple of
+       64 bits after the previous to stay on an access boundary */
+    step = (sizeof(buf) - (search->size - 1)) & ~(size_t)7;
+    for (offset = 0; offset < size && *pHitCount < maxHits; offset += step)
+    {
+        n = size - offset;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        res = cswp_server_mem_read(state, deviceNo, address + offset, n, accessSize, flags, buf);
+        if (res != CSWP_SUCCESS)
+            break;
+        *pHitCount += cswp_search_window(search, buf, n, (offset + n == size) ? n : step,
+                                         address + offset, pHits + *pHitCount, maxHits - *pHitCount);
+        if (offset + n == size)
+            break;
+    }
+
+    return res;
+}
+
 /* End of file cswp_server_impl.c */
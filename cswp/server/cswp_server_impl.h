@@ -131,6 +131,20 @@ int cswp_server_reg_list_build(cswp_server_state_t* state, unsigned deviceNo);
  */
 int cswp_server_reg_read(cswp_server_state_t* state, unsigned deviceNo, unsigned regID, uint32_t* value);
 
+/**
+ * Read a list of registers from a device
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param count Number of registers to read
+ * @param regIDs Register IDs to read
+ * @param values Receives register values
+ * @param failedIndex Receives the index of the first register that failed
+ */
+int cswp_server_reg_read_list(cswp_server_state_t* state, unsigned deviceNo,
+                              unsigned count, const unsigned* regIDs, uint32_t* values,
+                              unsigned* failedIndex);
+
 /**
  * Write register of a device
  *
@@ -193,6 +207,101 @@ int cswp_server_mem_poll(cswp_server_state_t* state, unsigned deviceNo,
                          const uint8_t* pMask, const uint8_t* pValue,
                          uint8_t* pData);
 
+/**
+ * Fill memory on a device with a repeated pattern
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param address The address to fill from
+ * @param size The number of bytes to fill
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param pPattern The pattern, repeated from the first byte
+ * @param patternSize The number of bytes in the pattern
+ */
+int cswp_server_mem_fill(cswp_server_state_t* state, unsigned deviceNo,
+                         uint64_t address, size_t size,
+                         cswp_access_size_t accessSize, unsigned flags,
+                         const uint8_t* pPattern, size_t patternSize);
+
+/**
+ * Fill memory on a device by writing the pattern a buffer at a time
+ *
+ * This is what cswp_server_mem_fill() does when the implementation has no
+ * mem_fill, for implementations that only fill some devices themselves.
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param address The address to fill from
+ * @param size The number of bytes to fill
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param pPattern The pattern, repeated from the first byte
+ * @param patternSize The number of bytes in the pattern
+ */
+int cswp_server_mem_fill_by_write(cswp_server_state_t* state, unsigned deviceNo,
+                                  uint64_t address, size_t size,
+                                  cswp_access_size_t accessSize, unsigned flags,
+                                  const uint8_t* pPattern, size_t patternSize);
+
+/**
+ * Checksum memory on a device
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param address The address to checksum from
+ * @param size The number of bytes to checksum
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param algorithm The checksum algorithm
+ * @param pDigest Receives the digest
+ */
+int cswp_server_mem_checksum(cswp_server_state_t* state, unsigned deviceNo,
+                             uint64_t address, size_t size,
+                             cswp_access_size_t accessSize, unsigned flags,
+                             cswp_checksum_t algorithm, uint64_t* pDigest);
+
+/**
+ * Checksum memory on a device by reading it a buffer at a time
+ *
+ * This is what cswp_server_mem_checksum() does when the implementation has
+ * no mem_checksum, for implementations that only checksum some devices
+ * themselves.
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param address The address to checksum from
+ * @param size The number of bytes to checksum
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param algorithm The checksum algorithm
+ * @param pDigest Receives the digest
+ */
+int cswp_server_mem_checksum_by_read(cswp_server_state_t* state, unsigned deviceNo,
+                                     uint64_t address, size_t size,
+                                     cswp_access_size_t accessSize, unsigned flags,
+                                     cswp_checksum_t algorithm, uint64_t* pDigest);
+
+/**
+ * Search memory on a device for a pattern
+ *
+ * @param state The server state
+ * @param deviceNo The device index
+ * @param address The address to search from
+ * @param size The number of bytes to search
+ * @param accessSize The access size to use
+ * @param flags Flags
+ * @param search The prepared search
+ * @param pHits Receives the address of each match
+ * @param maxHits The most matches to find
+ * @param pHitCount Receives the number of matches found
+ */
+int cswp_server_mem_search(cswp_server_state_t* state, unsigned deviceNo,
+                           uint64_t address, size_t size,
+                           cswp_access_size_t accessSize, unsigned flags,
+                           const cswp_search_t* search,
+                           uint64_t* pHits, size_t maxHits, size_t* pHitCount);
+
 #ifdef __cplusplus
 }
 #endif
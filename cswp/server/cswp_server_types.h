@@ -12,6 +12,7 @@
 #define CSWP_SERVER_TYPES_H
 
 #include "cswp_types.h"
+#include "cswp_search.h"
 
 #include <stdint.h>
 
@@ -214,6 +215,86 @@ typedef struct
      * @param msg Message format string
      */
     void (*log)(struct _cswp_server_state_t* state, cswp_log_level_t level, const char* msg, ...);
+
+    /**
+     * Read a list of registers
+     *
+     * Optional - if not provided each register is read with register_read
+     *
+     * @param state The server state
+     * @param deviceIndex The device number
+     * @param count Number of registers to read
+     * @param registerIDs Register IDs to read
+     * @param values Receives register values
+     * @param failedIndex Receives the index of the first register that
+     *                    failed if an error is returned
+     */
+    int (*register_read_list)(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                              unsigned count, const unsigned* registerIDs, uint32_t* values,
+                              unsigned* failedIndex);
+
+    /**
+     * Fill memory with a repeated pattern
+     *
+     * Optional - if not provided the pattern is expanded into a buffer and
+     * written with mem_write
+     *
+     * @param state The server state
+     * @param deviceIndex The device number
+     * @param address The address to fill from
+     * @param size The number of bytes to fill
+     * @param accessSize The access size to use
+     * @param flags Flags
+     * @param pPattern The pattern, repeated from the first byte
+     * @param patternSize The number of bytes in the pattern
+     */
+    int (*mem_fill)(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                    uint64_t address, size_t size,
+                    cswp_access_size_t accessSize, unsigned flags,
+                    const uint8_t* pPattern, size_t patternSize);
+
+    /**
+     * Checksum memory
+     *
+     * Optional - if not provided the memory is read with mem_read and
+     * checksummed by the server library
+     *
+     * @param state The server state
+     * @param deviceIndex The device number
+     * @param address The address to checksum from
+     * @param size The number of bytes to checksum
+     * @param accessSize The access size to use
+     * @param flags Flags
+     * @param algorithm The checksum algorithm
+     * @param pDigest Receives the digest, as from cswp_checksum()
+     */
+    int (*mem_checksum)(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                        uint64_t address, size_t size,
+                        cswp_access_size_t accessSize, unsigned flags,
+                        cswp_checksum_t algorithm, uint64_t* pDigest);
+
+    /**
+     * Search memory for a pattern
+     *
+     * Optional - if not provided the memory is read with mem_read and
+     * searched by the server library
+     *
+     * @param state The server state
+     * @param deviceIndex The device number
+     * @param address The address to search from
+     * @param size The number of bytes to search
+     * @param accessSize The access size to use
+     * @param flags Flags
+     * @param search The prepared search, see cswp_search_window()
+     * @param pHits Receives the address of each match, in address order
+     * @param maxHits The most matches to find
+     * @param pHitCount Receives the number of matches found
+     */
+    int (*mem_search)(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                      uint64_t address, size_t size,
+                      cswp_access_size_t accessSize, unsigned flags,
+                      const cswp_search_t* search,
+                      uint64_t* pHits, size_t maxHits, size_t* pHitCount);
 } cswp_server_impl_t;
 
 /**
@@ -262,6 +343,19 @@ typedef struct _cswp_server_state_t
      */
     unsigned int systemDescriptionFormat;
 
+    /**
+     * Largest message the transport can carry
+     * Set by the transport, 0 for CSWP_DEFAULT_MESSAGE_SIZE
+     */
+    size_t maxMessageSize;
+
+    /**
+     * Maximum message size negotiated by CSWP_INIT
+     * 0 until negotiated, meaning CSWP_DEFAULT_MESSAGE_SIZE.  The transport
+     * must be able to receive requests and send responses of this size.
+     */
+    size_t messageSize;
+
     /**
      * Private data for the implementation
      */
@@ -4,6 +4,7 @@
 // License. See LICENSE.TXT for details.
 
 #include <memory>
+#include <vector>
 
 #ifdef _WIN32
 #include <winsock2.h>
@@ -26,7 +27,9 @@ public:
     void disconnect();
 
     int send(const void* data, size_t size);
+    int sendv(const cswp_client_iovec_t* iov, unsigned count);
     int receive(void* data, size_t size, size_t* used);
+    int receivev(const cswp_client_iovec_t* iov, unsigned count, size_t* used);
 
 private:
     const char* m_addr;
@@ -85,6 +88,20 @@ static int cswp_tcp_send(cswp_client_t* client, cswp_client_transport_t* transpo
     }
 }
 
+static int cswp_tcp_sendv(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count)
+{
+    CSWPTCPClient* tcpClient = reinterpret_cast<CSWPTCPClient*>(transport->priv);
+
+    try
+    {
+        return tcpClient->sendv(iov, count);
+    }
+    catch (const std::exception& e)
+    {
+        return cswp_client_error(client, CSWP_COMMS, e.what());
+    }
+}
+
 static int cswp_tcp_receive(cswp_client_t* client, cswp_client_transport_t* transport, void* data, size_t size, size_t* used)
 {
     CSWPTCPClient* tcpClient = reinterpret_cast<CSWPTCPClient*>(transport->priv);
@@ -99,6 +116,20 @@ static int cswp_tcp_receive(cswp_client_t* client, cswp_client_transport_t* tran
     }
 }
 
+static int cswp_tcp_receivev(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count, size_t* used)
+{
+    CSWPTCPClient* tcpClient = reinterpret_cast<CSWPTCPClient*>(transport->priv);
+
+    try
+    {
+        return tcpClient->receivev(iov, count, used);
+    }
+    catch (const std::exception& e)
+    {
+        return cswp_client_error(client, CSWP_COMMS, e.what());
+    }
+}
+
 void cswp_client_tcp_transport_init(cswp_client_transport_t* transport,
                                     const char* addr,
                                     int port)
@@ -106,7 +137,10 @@ void cswp_client_tcp_transport_init(cswp_client_transport_t* transport,
     transport->connect = cswp_tcp_connect;
     transport->disconnect = cswp_tcp_disconnect;
     transport->send = cswp_tcp_send;
+    transport->sendv = cswp_tcp_sendv;
     transport->receive = cswp_tcp_receive;
+    transport->receivev = cswp_tcp_receivev;
+    transport->duplex = 1;
 
     transport->priv = new CSWPTCPClient(addr, port);
 }
@@ -160,6 +194,40 @@ int CSWPTCPClient::send(const void* data, size_t size)
     return CSWP_SUCCESS;
 }
 
+// Segments are built for each call, as clients sharing the connection may
+// send on one thread while receiving on another
+static void makeSegments(const cswp_client_iovec_t* iov, unsigned count, std::vector<cswp_tcp_segment_t>& segments)
+{
+    segments.resize(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        segments[i].data = iov[i].data;
+        segments[i].size = iov[i].size;
+    }
+}
+
+int CSWPTCPClient::sendv(const cswp_client_iovec_t* iov, unsigned count)
+{
+    if (!iov || count == 0)
+        return CSWP_BAD_ARGS;
+
+    std::vector<cswp_tcp_segment_t> segments;
+    makeSegments(iov, count, segments);
+    m_tcp->writev(&segments[0], static_cast<int>(count));
+    return CSWP_SUCCESS;
+}
+
+int CSWPTCPClient::receivev(const cswp_client_iovec_t* iov, unsigned count, size_t* used)
+{
+    if (!used || !iov || count == 0)
+        return CSWP_BAD_ARGS;
+
+    std::vector<cswp_tcp_segment_t> segments;
+    makeSegments(iov, count, segments);
+    *used = m_tcp->readv(&segments[0], static_cast<int>(count));
+    return CSWP_SUCCESS;
+}
+
 int CSWPTCPClient::receive(void* data, size_t maxSize, size_t* used)
 {
     if (!used || !data)
@@ -39,6 +39,20 @@ static void test_allocate()
     CHECK_EQUAL(1024, buf3->size);
     CHECK_EQUAL(0, buf3->used);
     cswp_buffer_free(buf3);
+
+    /* resize keeps contents and indexes */
+    buf1 = cswp_buffer_alloc(2);
+    cswp_buffer_put_uint8(buf1, 0x12);
+    cswp_buffer_put_uint8(buf1, 0x34);
+    cswp_buffer_seek(buf1, 1);
+    buf1 = cswp_buffer_realloc(buf1, 4096);
+    CHECK_EQUAL(4096, buf1->size);
+    CHECK_EQUAL(2, buf1->used);
+    CHECK_EQUAL(1, buf1->pos);
+    CHECK_CONTENTS("\x12\x34", buf1->buf, buf1->used);
+    /* can't drop used data */
+    CHECK_EQUAL(0, cswp_buffer_realloc(buf1, 1) != NULL);
+    cswp_buffer_free(buf1);
 }
 
 /*
@@ -52,6 +66,7 @@ static void test_encode()
     CSWP_BUFFER* buf7 = cswp_buffer_alloc(7);
     CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
     char* big_string;
+    void* pDirect;
 
     // uint8
 
@@ -219,6 +234,21 @@ static void test_encode()
     CHECK_CONTENTS("Hello", buf->buf, buf->used);
     cswp_buffer_clear(buf);
 
+    // direct
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_buffer_put_uint8(buf, 0x11));
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_buffer_put_direct(buf, &pDirect, 5));
+    CHECK_EQUAL(1, (uint8_t*)pDirect - buf->buf);
+    CHECK_EQUAL(6, buf->pos);
+    CHECK_EQUAL(6, buf->used);
+    memcpy(pDirect, "Hello", 5);
+    CHECK_CONTENTS("\x11Hello", buf->buf, buf->used);
+    CHECK_EQUAL(CSWP_BUFFER_FULL, cswp_buffer_put_direct(buf, &pDirect, 1024));
+    CHECK_EQUAL(6, buf->used);
+    cswp_buffer_truncate(buf, 1);
+    CHECK_EQUAL(1, buf->pos);
+    CHECK_EQUAL(1, buf->used);
+    cswp_buffer_clear(buf);
+
     cswp_buffer_free(buf0);
     cswp_buffer_free(buf1);
     cswp_buffer_free(buf3);
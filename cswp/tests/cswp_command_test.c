@@ -68,6 +68,7 @@ static void test_cmd_init()
 {
     varint_t msgType, errCode;
     varint_t protoVer, svrVer;
+    varint_t msgSize;
     char ID[256];
     CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
 
@@ -103,6 +104,21 @@ static void test_cmd_init()
     CHECK_EQUAL(0, strcmp("SVR", ID));
     CHECK_EQUAL(1, svrVer);
 
+    /* message size field */
+    cswp_buffer_clear(buf);
+    cswp_encode_init_message_size(buf, 0x10000);
+    CHECK_CONTENTS("\x80\x80\x04", buf->buf, buf->used);
+    cswp_buffer_seek(buf, 0);
+    cswp_decode_init_command_message_size(buf, &msgSize);
+    CHECK_EQUAL(0x10000, msgSize);
+
+    cswp_buffer_clear(buf);
+    cswp_encode_init_response_message_size(buf, 0x8000);
+    CHECK_CONTENTS("\x80\x80\x02", buf->buf, buf->used);
+    cswp_buffer_seek(buf, 0);
+    cswp_decode_init_response_message_size(buf, &msgSize);
+    CHECK_EQUAL(0x8000, msgSize);
+
     cswp_buffer_free(buf);
 }
 
@@ -603,6 +619,12 @@ static void test_cmd_reg_read()
     CHECK_EQUAL(8, buf->used);
     CHECK_CONTENTS("\x81\x04\x03\x02\xD2\x09\x80\x02", buf->buf, buf->used);
 
+    /* IDs encoded by caller */
+    cswp_buffer_clear(buf);
+    cswp_encode_reg_read_command(buf, 3, 2, NULL);
+    CHECK_EQUAL(4, buf->used);
+    CHECK_CONTENTS("\x81\x04\x03\x02", buf->buf, buf->used);
+
     cswp_buffer_set(buf, "\x81\x04\x03\x02\xD2\x09\x80\x02", 8);
     cswp_decode_command_header(buf, &msgType);
     CHECK_EQUAL(CSWP_REG_READ, msgType);
@@ -907,6 +929,333 @@ static void test_cmd_mem_poll()
     cswp_buffer_free(buf);
 }
 
+static void test_cmd_mem_fill()
+{
+    varint_t msgType, errCode;
+    CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
+    uint64_t address;
+    varint_t deviceNo, size, accSize, flags, patternSize;
+    const uint8_t pattern[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+    void* pPattern;
+
+    /* command */
+
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_fill_command(buf, 3, 0xFFFF000080000000, 0x100000, CSWP_ACCESS_SIZE_32, 0, pattern, 4);
+    CHECK_EQUAL(22, buf->pos);
+    CHECK_EQUAL(22, buf->used);
+    CHECK_CONTENTS("\x80\x80\x02\x03\x00\x00\x00\x80\x00\x00\xFF\xFF\x80\x80\x40\x03\x00\x04\xDE\xAD\xBE\xEF", buf->buf, buf->used);
+
+    cswp_buffer_set(buf, "\x80\x80\x02\x03\x00\x10\x00\x80\x00\x00\xFE\xFF\x10\x01\x88\x01\x02\x81\x82", 19);
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_FILL, msgType);
+    CHECK_EQUAL(3, buf->pos);
+    cswp_decode_mem_fill_command_body(buf, &deviceNo, &address, &size, &accSize, &flags, &patternSize);
+    CHECK_EQUAL(17, buf->pos);
+    CHECK_EQUAL(3, deviceNo);
+    CHECK_EQUAL(0xFFFE000080001000, address);
+    CHECK_EQUAL(16, size);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_8, accSize);
+    CHECK_EQUAL(0x88, flags);
+    CHECK_EQUAL(2, patternSize);
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_buffer_get_direct(buf, &pPattern, patternSize));
+    CHECK_EQUAL(0, memcmp(pPattern, "\x81\x82", 2));
+    CHECK_EQUAL(19, buf->pos);
+
+    /* empty response */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_fill_response(buf);
+    CHECK_EQUAL(4, buf->pos);
+    CHECK_EQUAL(4, buf->used);
+    CHECK_CONTENTS("\x80\x80\x02\x00", buf->buf, buf->used);
+
+    cswp_buffer_set(buf, "\x80\x80\x02\x00", 4);
+    cswp_decode_response_header(buf, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_MEM_FILL, msgType);
+    CHECK_EQUAL(0x00, errCode);
+
+    cswp_buffer_free(buf);
+}
+
+static void test_cmd_mem_multi()
+{
+    varint_t msgType, errCode;
+    CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
+    uint64_t address;
+    varint_t deviceNo, size, accSize, flags, count, status;
+    uint8_t* pOut;
+    void* pData;
+
+    /* read command */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_read_multi_command(buf, 1, CSWP_ACCESS_SIZE_32, 0, 2);
+    cswp_encode_mem_segment(buf, 0x1000, 4);
+    cswp_encode_mem_segment(buf, 0x2000, 0x80);
+    CHECK_EQUAL(26, buf->used);
+    CHECK_CONTENTS("\x81\x80\x02\x01\x03\x00\x02\x00\x10\x00\x00\x00\x00\x00\x00\x04\x00\x20\x00\x00\x00\x00\x00\x00\x80\x01", buf->buf, buf->used);
+
+    cswp_buffer_seek(buf, 0);
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_READ_MULTI, msgType);
+    cswp_decode_mem_read_multi_command_body(buf, &deviceNo, &accSize, &flags, &count);
+    CHECK_EQUAL(1, deviceNo);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_32, accSize);
+    CHECK_EQUAL(0, flags);
+    CHECK_EQUAL(2, count);
+    cswp_decode_mem_segment(buf, &address, &size);
+    CHECK_EQUAL(0x1000, address);
+    CHECK_EQUAL(4, size);
+    cswp_decode_mem_segment(buf, &address, &size);
+    CHECK_EQUAL(0x2000, address);
+    CHECK_EQUAL(0x80, size);
+    CHECK_EQUAL(26, buf->pos);
+
+    /* read response: data then segment status */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_read_multi_response_direct(buf, 5, &pOut);
+    memcpy(pOut, "\x01\x02\x03\x04\x05", 5);
+    cswp_encode_mem_segment_status_count(buf, 2);
+    cswp_encode_mem_segment_status(buf, CSWP_SUCCESS);
+    cswp_encode_mem_segment_status(buf, CSWP_MEM_INVALID_ADDRESS);
+    CHECK_EQUAL(14, buf->used);
+    CHECK_CONTENTS("\x81\x80\x02\x00\x05\x01\x02\x03\x04\x05\x02\x00\x81\x06", buf->buf, buf->used);
+
+    cswp_buffer_seek(buf, 0);
+    cswp_decode_response_header(buf, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_MEM_READ_MULTI, msgType);
+    CHECK_EQUAL(0x00, errCode);
+    cswp_decode_mem_read_multi_response_body(buf, &size);
+    CHECK_EQUAL(5, size);
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_buffer_get_direct(buf, &pData, size));
+    CHECK_EQUAL(0, memcmp(pData, "\x01\x02\x03\x04\x05", 5));
+    cswp_decode_mem_segment_status_count(buf, &count);
+    CHECK_EQUAL(2, count);
+    cswp_decode_mem_segment_status(buf, &status);
+    CHECK_EQUAL(CSWP_SUCCESS, status);
+    cswp_decode_mem_segment_status(buf, &status);
+    CHECK_EQUAL(CSWP_MEM_INVALID_ADDRESS, status);
+    CHECK_EQUAL(14, buf->pos);
+
+    /* write command: segments then data */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_write_multi_command(buf, 1, CSWP_ACCESS_SIZE_8, 0x88, 1);
+    cswp_encode_mem_segment(buf, 0x1000, 2);
+    cswp_buffer_put_data(buf, "\xAA\xBB", 2);
+    CHECK_EQUAL(19, buf->used);
+    CHECK_CONTENTS("\x82\x80\x02\x01\x01\x88\x01\x01\x00\x10\x00\x00\x00\x00\x00\x00\x02\xAA\xBB", buf->buf, buf->used);
+
+    cswp_buffer_seek(buf, 0);
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_WRITE_MULTI, msgType);
+    cswp_decode_mem_write_multi_command_body(buf, &deviceNo, &accSize, &flags, &count);
+    CHECK_EQUAL(1, deviceNo);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_8, accSize);
+    CHECK_EQUAL(0x88, flags);
+    CHECK_EQUAL(1, count);
+    cswp_decode_mem_segment(buf, &address, &size);
+    CHECK_EQUAL(0x1000, address);
+    CHECK_EQUAL(2, size);
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_buffer_get_direct(buf, &pData, size));
+    CHECK_EQUAL(0, memcmp(pData, "\xAA\xBB", 2));
+
+    /* write response */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_write_multi_response(buf);
+    cswp_encode_mem_segment_status_count(buf, 1);
+    cswp_encode_mem_segment_status(buf, CSWP_SUCCESS);
+    CHECK_EQUAL(6, buf->used);
+    CHECK_CONTENTS("\x82\x80\x02\x00\x01\x00", buf->buf, buf->used);
+
+    cswp_buffer_free(buf);
+}
+
+static void test_cmd_mem_checksum()
+{
+    varint_t msgType, errCode;
+    CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
+    uint64_t address;
+    varint_t deviceNo, size, accSize, flags, algorithm, blockSize, count;
+    uint64_t digest;
+
+    /* command */
+
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_checksum_command(buf, 3, 0xFFFF000080000000, 0x100000, CSWP_ACCESS_SIZE_32, 0,
+                                     CSWP_CHECKSUM_FNV1A64, 0x1000);
+    CHECK_EQUAL(20, buf->pos);
+    CHECK_EQUAL(20, buf->used);
+    CHECK_CONTENTS("\x83\x80\x02\x03\x00\x00\x00\x80\x00\x00\xFF\xFF\x80\x80\x40\x03\x00\x01\x80\x20", buf->buf, buf->used);
+
+    cswp_buffer_set(buf, "\x83\x80\x02\x03\x00\x10\x00\x80\x00\x00\xFE\xFF\x10\x01\x88\x01\x00\x00", 18);
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_CHECKSUM, msgType);
+    CHECK_EQUAL(3, buf->pos);
+    cswp_decode_mem_checksum_command_body(buf, &deviceNo, &address, &size, &accSize, &flags, &algorithm, &blockSize);
+    CHECK_EQUAL(18, buf->pos);
+    CHECK_EQUAL(3, deviceNo);
+    CHECK_EQUAL(0xFFFE000080001000, address);
+    CHECK_EQUAL(16, size);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_8, accSize);
+    CHECK_EQUAL(0x88, flags);
+    CHECK_EQUAL(CSWP_CHECKSUM_CRC32, algorithm);
+    CHECK_EQUAL(0, blockSize);
+
+    /* response */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_checksum_response(buf, 2);
+    cswp_encode_mem_checksum_digest(buf, 0xCBF43926);
+    cswp_encode_mem_checksum_digest(buf, 0x0123456789ABCDEF);
+    CHECK_EQUAL(21, buf->pos);
+    CHECK_EQUAL(21, buf->used);
+    CHECK_CONTENTS("\x83\x80\x02\x00\x02\x26\x39\xF4\xCB\x00\x00\x00\x00\xEF\xCD\xAB\x89\x67\x45\x23\x01", buf->buf, buf->used);
+
+    buf->pos = 0;
+    cswp_decode_response_header(buf, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_MEM_CHECKSUM, msgType);
+    CHECK_EQUAL(0x00, errCode);
+    cswp_decode_mem_checksum_response_body(buf, &count);
+    CHECK_EQUAL(2, count);
+    cswp_decode_mem_checksum_digest(buf, &digest);
+    CHECK_EQUAL(0xCBF43926, digest);
+    cswp_decode_mem_checksum_digest(buf, &digest);
+    CHECK_EQUAL(0x0123456789ABCDEF, digest);
+    CHECK_EQUAL(21, buf->pos);
+
+    cswp_buffer_free(buf);
+}
+
+static void test_cmd_mem_read_delta()
+{
+    varint_t msgType, errCode;
+    CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
+    uint64_t address;
+    varint_t deviceNo, size, accSize, flags, algorithm, blockSize, count;
+    uint64_t digest;
+    uint8_t* bitmap;
+
+    /* command */
+
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_read_delta_command(buf, 3, 0xFFFF000080000000, 0x2000, CSWP_ACCESS_SIZE_32, 0,
+                                       CSWP_CHECKSUM_FNV1A64, 0x1000, 2);
+    cswp_encode_mem_read_delta_digest(buf, 0x0123456789ABCDEF);
+    CHECK_EQUAL(28, buf->pos);
+    CHECK_EQUAL(28, buf->used);
+    CHECK_CONTENTS("\x84\x80\x02\x03\x00\x00\x00\x80\x00\x00\xFF\xFF\x80\x40\x03\x00\x01\x80\x20\x02"
+                   "\xEF\xCD\xAB\x89\x67\x45\x23\x01", buf->buf, buf->used);
+
+    buf->pos = 0;
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_READ_DELTA, msgType);
+    CHECK_EQUAL(3, buf->pos);
+    cswp_decode_mem_read_delta_command_body(buf, &deviceNo, &address, &size, &accSize, &flags,
+                                            &algorithm, &blockSize, &count);
+    CHECK_EQUAL(20, buf->pos);
+    CHECK_EQUAL(3, deviceNo);
+    CHECK_EQUAL(0xFFFF000080000000, address);
+    CHECK_EQUAL(0x2000, size);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_32, accSize);
+    CHECK_EQUAL(0, flags);
+    CHECK_EQUAL(CSWP_CHECKSUM_FNV1A64, algorithm);
+    CHECK_EQUAL(0x1000, blockSize);
+    CHECK_EQUAL(2, count);
+    cswp_decode_mem_read_delta_digest(buf, &digest);
+    CHECK_EQUAL(0x0123456789ABCDEF, digest);
+    CHECK_EQUAL(28, buf->pos);
+
+    /* response */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_read_delta_response_direct(buf, 10, &bitmap);
+    bitmap[0] = 0x05;
+    bitmap[1] = 0x02;
+    cswp_buffer_put_data(buf, "AB", 2);
+    CHECK_EQUAL(9, buf->used);
+    CHECK_CONTENTS("\x84\x80\x02\x00\x0A\x05\x02\x41\x42", buf->buf, buf->used);
+
+    buf->pos = 0;
+    cswp_decode_response_header(buf, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_MEM_READ_DELTA, msgType);
+    CHECK_EQUAL(0x00, errCode);
+    cswp_decode_mem_read_delta_response_body(buf, &count);
+    CHECK_EQUAL(10, count);
+    CHECK_EQUAL(5, buf->pos);
+
+    cswp_buffer_free(buf);
+}
+
+static void test_cmd_mem_search()
+{
+    varint_t msgType, errCode;
+    CSWP_BUFFER* buf = cswp_buffer_alloc(1024);
+    uint64_t address;
+    varint_t deviceNo, size, accSize, flags, alignment, maxHits, patternSize, maskSize, count;
+    uint8_t data[2];
+
+    /* command */
+
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_search_command(buf, 3, 0xFFFF000080000000, 0x100, CSWP_ACCESS_SIZE_32, 0,
+                                   4, 10, (const uint8_t*)"\xAA\x55", (const uint8_t*)"\xFF\x0F", 2);
+    CHECK_EQUAL(24, buf->pos);
+    CHECK_EQUAL(24, buf->used);
+    CHECK_CONTENTS("\x85\x80\x02\x03\x00\x00\x00\x80\x00\x00\xFF\xFF\x80\x02\x03\x00\x04\x0A\x02"
+                   "\xAA\x55\x02\xFF\x0F", buf->buf, buf->used);
+
+    buf->pos = 0;
+    cswp_decode_command_header(buf, &msgType);
+    CHECK_EQUAL(CSWP_MEM_SEARCH, msgType);
+    CHECK_EQUAL(3, buf->pos);
+    cswp_decode_mem_search_command_body(buf, &deviceNo, &address, &size, &accSize, &flags,
+                                        &alignment, &maxHits, &patternSize);
+    CHECK_EQUAL(19, buf->pos);
+    CHECK_EQUAL(3, deviceNo);
+    CHECK_EQUAL(0xFFFF000080000000, address);
+    CHECK_EQUAL(0x100, size);
+    CHECK_EQUAL(CSWP_ACCESS_SIZE_32, accSize);
+    CHECK_EQUAL(0, flags);
+    CHECK_EQUAL(4, alignment);
+    CHECK_EQUAL(10, maxHits);
+    CHECK_EQUAL(2, patternSize);
+    cswp_buffer_get_data(buf, data, 2);
+    CHECK_CONTENTS("\xAA\x55", data, 2);
+    cswp_decode_mem_search_mask_size(buf, &maskSize);
+    CHECK_EQUAL(2, maskSize);
+    cswp_buffer_get_data(buf, data, 2);
+    CHECK_CONTENTS("\xFF\x0F", data, 2);
+    CHECK_EQUAL(24, buf->pos);
+
+    /* without mask */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_search_command(buf, 0, 0x1000, 0x10, CSWP_ACCESS_SIZE_DEF, 0,
+                                   0, 0, (const uint8_t*)"\x12", NULL, 1);
+    CHECK_EQUAL(20, buf->used);
+    CHECK_CONTENTS("\x85\x80\x02\x00\x00\x10\x00\x00\x00\x00\x00\x00\x10\x00\x00\x00\x00\x01"
+                   "\x12\x00", buf->buf, buf->used);
+
+    /* response */
+    cswp_buffer_clear(buf);
+    cswp_encode_mem_search_response(buf, 2);
+    cswp_encode_mem_search_hit(buf, 0x80000004);
+    cswp_encode_mem_search_hit(buf, 0xFFFF000080000010);
+    CHECK_EQUAL(21, buf->used);
+    CHECK_CONTENTS("\x85\x80\x02\x00\x02\x04\x00\x00\x80\x00\x00\x00\x00"
+                   "\x10\x00\x00\x80\x00\x00\xFF\xFF", buf->buf, buf->used);
+
+    buf->pos = 0;
+    cswp_decode_response_header(buf, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_MEM_SEARCH, msgType);
+    CHECK_EQUAL(0x00, errCode);
+    cswp_decode_mem_search_response_body(buf, &count);
+    CHECK_EQUAL(2, count);
+    cswp_decode_mem_search_hit(buf, &address);
+    CHECK_EQUAL(0x80000004, address);
+    cswp_decode_mem_search_hit(buf, &address);
+    CHECK_EQUAL(0xFFFF000080000010, address);
+    CHECK_EQUAL(21, buf->pos);
+
+    cswp_buffer_free(buf);
+}
+
 static void test_async_message()
 {
     varint_t msgType, errCode;
@@ -954,5 +1303,10 @@ void test_commands()
     test_cmd_mem_read();
     test_cmd_mem_write();
     test_cmd_mem_poll();
+    test_cmd_mem_fill();
+    test_cmd_mem_multi();
+    test_cmd_mem_checksum();
+    test_cmd_mem_read_delta();
+    test_cmd_mem_search();
     test_async_message();
 }
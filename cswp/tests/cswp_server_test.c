@@ -9,23 +9,77 @@
 #include "cswp_server_commands.h"
 #include "cswp_server_impl.h"
 #include "cswp_server_types.h"
+#include "cswp_checksum.h"
 #include "cswp_test.h"
 
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 typedef struct
 {
     cswp_server_state_t* serverState;
     CSWP_BUFFER* cmd;
     CSWP_BUFFER* rsp;
+    /* responses not yet received, in order */
+    CSWP_BUFFER* queue;
+    /* offset of oldest response in queue */
+    size_t queueHead;
+    /* number of requests sent */
+    unsigned numSent;
+    /* number of requests sent with sendv */
+    unsigned numSendv;
+    /* number of responses received with receivev */
+    unsigned numReceivev;
+    /* simulated round trip time in us, 0 for none */
+    unsigned delayUs;
+    /* simulated transfer rate in bytes per ms, 0 for unlimited */
+    unsigned bytesPerMs;
+    /* number of responses queued and not yet received */
+    unsigned numQueued;
+    /* largest value of numQueued */
+    unsigned maxQueued;
+    /* number of threads receiving */
+    unsigned receiving;
+    /* number of sends made while receiving, on a transport without duplex */
+    unsigned numOverlaps;
+#ifndef _WIN32
+    /* clients sharing the connection may send and receive at once */
+    pthread_mutex_t lock;
+#endif
 } cswp_test_client_priv_t;
 
+#ifndef _WIN32
+#define test_transport_lock(priv)   pthread_mutex_lock(&(priv)->lock)
+#define test_transport_unlock(priv) pthread_mutex_unlock(&(priv)->lock)
+#define test_transport_yield()      sched_yield()
+#else
+#define test_transport_lock(priv)
+#define test_transport_unlock(priv)
+#define test_transport_yield()
+#endif
+
 static int test_transport_connect(cswp_client_t* client, cswp_client_transport_t* transport)
 {
     cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
-    priv->cmd = cswp_buffer_alloc(16384);
-    priv->rsp = cswp_buffer_alloc(16384);
+    priv->cmd = cswp_buffer_alloc(CSWP_MAX_MESSAGE_SIZE);
+    priv->rsp = cswp_buffer_alloc(CSWP_MAX_MESSAGE_SIZE);
+    priv->queue = cswp_buffer_alloc(2 * CSWP_MAX_MESSAGE_SIZE);
+    priv->queueHead = 0;
+    priv->numSent = 0;
+    priv->numSendv = 0;
+    priv->numReceivev = 0;
+    priv->numQueued = 0;
+    priv->maxQueued = 0;
+    priv->receiving = 0;
+    priv->numOverlaps = 0;
+#ifndef _WIN32
+    pthread_mutex_init(&priv->lock, NULL);
+#endif
 
     return CSWP_SUCCESS;
 }
@@ -35,22 +89,38 @@ static int test_transport_disconnect(cswp_client_t* client, cswp_client_transpor
     cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
     cswp_buffer_free(priv->cmd);
     cswp_buffer_free(priv->rsp);
+    cswp_buffer_free(priv->queue);
+#ifndef _WIN32
+    pthread_mutex_destroy(&priv->lock);
+#endif
 
     return CSWP_SUCCESS;
 }
 
-static int test_transport_send(cswp_client_t* client, cswp_client_transport_t* transport, const void* data, size_t size)
+/*
+ * Spin for the time the link would take to exchange bytes
+ */
+static void test_transport_delay(cswp_test_client_priv_t* priv, size_t bytes)
 {
-    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
-    cswp_buffer_clear(priv->cmd);
-    memcpy(priv->cmd->buf, data, size);
-    priv->cmd->pos = priv->cmd->used = size;
-    return CSWP_SUCCESS;
+    uint64_t us = priv->delayUs;
+    clock_t end;
+
+    if (priv->bytesPerMs)
+        us += (uint64_t)bytes * 1000 / priv->bytesPerMs;
+    if (us == 0)
+        return;
+
+    end = clock() + (clock_t)(us * CLOCKS_PER_SEC / 1000000);
+    while (clock() < end)
+        ;
 }
 
-static int test_transport_receive(cswp_client_t* client, cswp_client_transport_t* transport, void* data, size_t size, size_t* used)
+/*
+ * Requests are executed as they are sent and the responses queued, so the
+ * client may have several requests outstanding
+ */
+static int test_transport_execute(cswp_test_client_priv_t* priv)
 {
-    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
     int res = CSWP_SUCCESS;
     uint32_t cmdSize;
     varint_t numCmds;
@@ -58,6 +128,8 @@ static int test_transport_receive(cswp_client_t* client, cswp_client_transport_t
     unsigned c;
     uint8_t* pLen;
 
+    priv->numSent++;
+
     /* check command size */
     cswp_buffer_seek(priv->cmd, 0);
     cswp_buffer_get_uint32(priv->cmd, &cmdSize);
@@ -104,27 +176,155 @@ static int test_transport_receive(cswp_client_t* client, cswp_client_transport_t
     *pLen++ = ((priv->rsp->used >> 16) & 0xFF);
     *pLen++ = ((priv->rsp->used >> 24) & 0xFF);
 
-    if (priv->rsp->used > size)
-        return CSWP_OUTPUT_BUFFER_OVERFLOW;
+    test_transport_delay(priv, priv->cmd->used + priv->rsp->used);
 
-    memcpy(data, priv->rsp->buf, priv->rsp->used);
-    *used = priv->rsp->used;
+    if (++priv->numQueued > priv->maxQueued)
+        priv->maxQueued = priv->numQueued;
 
     // command errors are encoded in response
+    cswp_buffer_seek(priv->queue, priv->queue->used);
+    return cswp_buffer_put_data(priv->queue, priv->rsp->buf, priv->rsp->used);
+}
+
+static int test_transport_send(cswp_client_t* client, cswp_client_transport_t* transport, const void* data, size_t size)
+{
+    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
+    int res;
+
+    test_transport_lock(priv);
+    if (priv->receiving && !transport->duplex)
+        priv->numOverlaps++;
+    cswp_buffer_clear(priv->cmd);
+    cswp_buffer_put_data(priv->cmd, data, size);
+    res = test_transport_execute(priv);
+    test_transport_unlock(priv);
+
+    return res;
+}
+
+static int test_transport_sendv(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count)
+{
+    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
+    unsigned i;
+    int res;
+
+    test_transport_lock(priv);
+    if (priv->receiving && !transport->duplex)
+        priv->numOverlaps++;
+    cswp_buffer_clear(priv->cmd);
+    for (i = 0; i < count; ++i)
+        cswp_buffer_put_data(priv->cmd, iov[i].data, iov[i].size);
+    priv->numSendv++;
+    res = test_transport_execute(priv);
+    test_transport_unlock(priv);
+
+    return res;
+}
+
+static int test_transport_receivev(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count, size_t* used)
+{
+    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
+    uint32_t rspSize;
+    uint8_t* pLen;
+    size_t capacity = 0;
+    size_t copied = 0;
+    size_t n;
+    unsigned i;
+
+    /* take the oldest queued response */
+    if (priv->queueHead == priv->queue->used)
+        return CSWP_COMMS;
+    pLen = priv->queue->buf + priv->queueHead;
+    rspSize = pLen[0] | (pLen[1] << 8) | (pLen[2] << 16) | ((uint32_t)pLen[3] << 24);
+
+    for (i = 0; i < count; ++i)
+        capacity += iov[i].size;
+    if (rspSize > capacity)
+        return CSWP_OUTPUT_BUFFER_OVERFLOW;
+
+    for (i = 0; copied < rspSize; ++i)
+    {
+        n = rspSize - copied;
+        if (n > iov[i].size)
+            n = iov[i].size;
+        memcpy(iov[i].data, pLen + copied, n);
+        copied += n;
+    }
+    *used = rspSize;
+
+    priv->numQueued--;
+    priv->queueHead += rspSize;
+    if (priv->queueHead == priv->queue->used)
+    {
+        cswp_buffer_clear(priv->queue);
+        priv->queueHead = 0;
+    }
+
     return CSWP_SUCCESS;
 }
 
+/*
+ * Receive as a thread sharing the connection would, noting that a receive
+ * is in progress for a while before the response is taken
+ */
+static int test_transport_receive_locked(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count, size_t* used)
+{
+    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
+    int res;
+
+    test_transport_lock(priv);
+    priv->receiving++;
+    test_transport_unlock(priv);
+    test_transport_yield();
+
+    test_transport_lock(priv);
+    res = test_transport_receivev(client, transport, iov, count, used);
+    priv->receiving--;
+    test_transport_unlock(priv);
+
+    return res;
+}
+
+static int test_transport_receive(cswp_client_t* client, cswp_client_transport_t* transport, void* data, size_t size, size_t* used)
+{
+    cswp_client_iovec_t iov;
+
+    iov.data = data;
+    iov.size = size;
+
+    return test_transport_receive_locked(client, transport, &iov, 1, used);
+}
+
+static int test_transport_count_receivev(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count, size_t* used)
+{
+    cswp_test_client_priv_t* priv = (cswp_test_client_priv_t*)transport->priv;
+
+    test_transport_lock(priv);
+    priv->numReceivev++;
+    test_transport_unlock(priv);
+
+    return test_transport_receive_locked(client, transport, iov, count, used);
+}
+
 cswp_client_transport_t testClientTransport = {
     /*.connect = */ test_transport_connect,
     /*.disconnect = */ test_transport_disconnect,
     /*.send = */ test_transport_send,
     /*.receive = */ test_transport_receive,
     /*.priv = */ NULL,
+    /*.sendv = */ test_transport_sendv,
+    /*.receivev = */ test_transport_count_receivev,
+    /*.duplex = */ 1,
 };
 
 static char testCfg[2][16];
 static uint32_t testRegs[10];
 static uint8_t testMem[16];
+/* memory for large transfers, at TEST_BIG_MEM_BASE */
+#define TEST_BIG_MEM_BASE 0x100000
+static uint8_t testBigMem[256 * 1024];
+/* transfer that fits in one message but is sent without copying */
+#define TEST_DIRECT_SIZE 8192
 
 static int test_impl_init(cswp_server_state_t* state)
 {
@@ -265,6 +465,19 @@ static int test_impl_mem_read(struct _cswp_server_state_t* state, unsigned devic
     if (deviceIndex != 0)
         return CSWP_UNSUPPORTED;
 
+    if (address >= TEST_BIG_MEM_BASE && address - TEST_BIG_MEM_BASE + size <= sizeof(testBigMem))
+    {
+        memcpy(pData, testBigMem + (address - TEST_BIG_MEM_BASE), size);
+        return CSWP_SUCCESS;
+    }
+
+    /* without address increment, testMem acts as byte wide FIFOs */
+    if ((flags & CSWP_MEM_NO_ADDR_INC) && address < sizeof(testMem))
+    {
+        memset(pData, testMem[address], size);
+        return CSWP_SUCCESS;
+    }
+
     if (address > sizeof(testMem) || (address+size) > sizeof(testMem))
         return CSWP_BAD_ARGS;
 
@@ -281,6 +494,18 @@ static int test_impl_mem_write(struct _cswp_server_state_t* state, unsigned devi
     if (deviceIndex != 0)
         return CSWP_UNSUPPORTED;
 
+    if (address >= TEST_BIG_MEM_BASE && address - TEST_BIG_MEM_BASE + size <= sizeof(testBigMem))
+    {
+        memcpy(testBigMem + (address - TEST_BIG_MEM_BASE), pData, size);
+        return CSWP_SUCCESS;
+    }
+
+    if ((flags & CSWP_MEM_NO_ADDR_INC) && address < sizeof(testMem) && size > 0)
+    {
+        testMem[address] = pData[size - 1];
+        return CSWP_SUCCESS;
+    }
+
     if (address > sizeof(testMem) || (address+size) > sizeof(testMem))
         return CSWP_BAD_ARGS;
 
@@ -299,6 +524,12 @@ static int test_impl_mem_poll(struct _cswp_server_state_t* state, int deviceInde
     if (deviceIndex != 0)
         return CSWP_UNSUPPORTED;
 
+    if (address >= TEST_BIG_MEM_BASE && address - TEST_BIG_MEM_BASE + size <= sizeof(testBigMem))
+    {
+        memcpy(pData, testBigMem + (address - TEST_BIG_MEM_BASE), size);
+        return CSWP_SUCCESS;
+    }
+
     if (address > sizeof(testMem) || (address+size) > sizeof(testMem))
         return CSWP_BAD_ARGS;
 
@@ -326,13 +557,191 @@ const cswp_server_impl_t testImpl = {
     /*.mem_poll = */ test_impl_mem_poll,
 };
 
+static unsigned testRegListCalls;
+
+static int test_impl_reg_read_list(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                   unsigned count, const unsigned* registerIDs, uint32_t* values,
+                                   unsigned* failedIndex)
+{
+    unsigned r;
+    int res;
+
+    ++testRegListCalls;
+    for (r = 0; r < count; ++r)
+    {
+        res = test_impl_reg_read(state, deviceIndex, registerIDs[r], &values[r]);
+        if (res != CSWP_SUCCESS)
+        {
+            *failedIndex = r;
+            return res;
+        }
+    }
+
+    return CSWP_SUCCESS;
+}
+
+const cswp_server_impl_t testListImpl = {
+    /*.init = */ test_impl_init,
+    /*.term = */ test_impl_term,
+    /*.init_devices = */ NULL,
+    /*.clear_devices = */ NULL,
+    /*.device_add = */ test_impl_device_add,
+    /*.device_open = */ test_impl_device_open,
+    /*.device_close = */ NULL,
+    /*.set_config = */ test_impl_set_config,
+    /*.get_config = */ test_impl_get_config,
+    /*.get_device_capabilities = */ test_impl_get_device_capabilities,
+    /*.register_list_build = */ NULL,
+    /*.register_read = */ test_impl_reg_read,
+    /*.register_write = */ test_impl_reg_write,
+    /*.mem_read = */ test_impl_mem_read,
+    /*.mem_write = */ test_impl_mem_write,
+    /*.mem_poll = */ test_impl_mem_poll,
+    /*.log = */ NULL,
+    /*.register_read_list = */ test_impl_reg_read_list,
+};
+
+static unsigned testMemFillCalls;
+
+static int test_impl_mem_fill(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                              uint64_t address, size_t size,
+                              cswp_access_size_t accessSize, unsigned flags,
+                              const uint8_t* pPattern, size_t patternSize)
+{
+    size_t i;
+
+    ++testMemFillCalls;
+    if (deviceIndex != 0)
+        return CSWP_UNSUPPORTED;
+
+    if (address < TEST_BIG_MEM_BASE || address - TEST_BIG_MEM_BASE + size > sizeof(testBigMem))
+        return CSWP_BAD_ARGS;
+
+    for (i = 0; i < size; ++i)
+        testBigMem[address - TEST_BIG_MEM_BASE + i] = pPattern[i % patternSize];
+
+    return CSWP_SUCCESS;
+}
+
+const cswp_server_impl_t testFillImpl = {
+    /*.init = */ test_impl_init,
+    /*.term = */ test_impl_term,
+    /*.init_devices = */ NULL,
+    /*.clear_devices = */ NULL,
+    /*.device_add = */ test_impl_device_add,
+    /*.device_open = */ test_impl_device_open,
+    /*.device_close = */ NULL,
+    /*.set_config = */ test_impl_set_config,
+    /*.get_config = */ test_impl_get_config,
+    /*.get_device_capabilities = */ test_impl_get_device_capabilities,
+    /*.register_list_build = */ NULL,
+    /*.register_read = */ test_impl_reg_read,
+    /*.register_write = */ test_impl_reg_write,
+    /*.mem_read = */ test_impl_mem_read,
+    /*.mem_write = */ test_impl_mem_write,
+    /*.mem_poll = */ test_impl_mem_poll,
+    /*.log = */ NULL,
+    /*.register_read_list = */ NULL,
+    /*.mem_fill = */ test_impl_mem_fill,
+};
+
+static unsigned testMemChecksumCalls;
+
+static int test_impl_mem_checksum(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                  uint64_t address, size_t size,
+                                  cswp_access_size_t accessSize, unsigned flags,
+                                  cswp_checksum_t algorithm, uint64_t* pDigest)
+{
+    ++testMemChecksumCalls;
+    if (deviceIndex != 0)
+        return CSWP_UNSUPPORTED;
+
+    if (address < TEST_BIG_MEM_BASE || address - TEST_BIG_MEM_BASE + size > sizeof(testBigMem))
+        return CSWP_BAD_ARGS;
+
+    *pDigest = cswp_checksum(algorithm, testBigMem + (address - TEST_BIG_MEM_BASE), size);
+
+    return CSWP_SUCCESS;
+}
+
+const cswp_server_impl_t testChecksumImpl = {
+    /*.init = */ test_impl_init,
+    /*.term = */ test_impl_term,
+    /*.init_devices = */ NULL,
+    /*.clear_devices = */ NULL,
+    /*.device_add = */ test_impl_device_add,
+    /*.device_open = */ test_impl_device_open,
+    /*.device_close = */ NULL,
+    /*.set_config = */ test_impl_set_config,
+    /*.get_config = */ test_impl_get_config,
+    /*.get_device_capabilities = */ test_impl_get_device_capabilities,
+    /*.register_list_build = */ NULL,
+    /*.register_read = */ test_impl_reg_read,
+    /*.register_write = */ test_impl_reg_write,
+    /*.mem_read = */ test_impl_mem_read,
+    /*.mem_write = */ test_impl_mem_write,
+    /*.mem_poll = */ test_impl_mem_poll,
+    /*.log = */ NULL,
+    /*.register_read_list = */ NULL,
+    /*.mem_fill = */ NULL,
+    /*.mem_checksum = */ test_impl_mem_checksum,
+};
+
+static unsigned testMemSearchCalls;
+
+static int test_impl_mem_search(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                uint64_t address, size_t size,
+                                cswp_access_size_t accessSize, unsigned flags,
+                                const cswp_search_t* search,
+                                uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    ++testMemSearchCalls;
+    if (deviceIndex != 0)
+        return CSWP_UNSUPPORTED;
+
+    if (address < TEST_BIG_MEM_BASE || address - TEST_BIG_MEM_BASE + size > sizeof(testBigMem))
+        return CSWP_BAD_ARGS;
+
+    *pHitCount = cswp_search_window(search, testBigMem + (address - TEST_BIG_MEM_BASE), size, size,
+                                    address, pHits, maxHits);
+
+    return CSWP_SUCCESS;
+}
+
+const cswp_server_impl_t testSearchImpl = {
+    /*.init = */ test_impl_init,
+    /*.term = */ test_impl_term,
+    /*.init_devices = */ NULL,
+    /*.clear_devices = */ NULL,
+    /*.device_add = */ test_impl_device_add,
+    /*.device_open = */ test_impl_device_open,
+    /*.device_close = */ NULL,
+    /*.set_config = */ test_impl_set_config,
+    /*.get_config = */ test_impl_get_config,
+    /*.get_device_capabilities = */ test_impl_get_device_capabilities,
+    /*.register_list_build = */ NULL,
+    /*.register_read = */ test_impl_reg_read,
+    /*.register_write = */ test_impl_reg_write,
+    /*.mem_read = */ test_impl_mem_read,
+    /*.mem_write = */ test_impl_mem_write,
+    /*.mem_poll = */ test_impl_mem_poll,
+    /*.log = */ NULL,
+    /*.register_read_list = */ NULL,
+    /*.mem_fill = */ NULL,
+    /*.mem_checksum = */ NULL,
+    /*.mem_search = */ test_impl_mem_search,
+};
+
 static void test_init_term()
 {
     int res;
     cswp_client_t client;
-    cswp_server_state_t state;
+    cswp_server_state_t state = {0};
     char ID[256];
     unsigned protoVer, svrVer;
+    CSWP_BUFFER* cmd;
+    CSWP_BUFFER* rsp;
+    varint_t msgType, errCode, version, messageSize;
 
     state.impl = &testImpl;
     testClientTransport.priv = calloc(1, sizeof(cswp_test_client_priv_t));
@@ -343,12 +752,16 @@ static void test_init_term()
                     &protoVer, ID, sizeof(ID), &svrVer);
 
     CHECK_EQUAL(CSWP_SUCCESS, res);
-    CHECK_EQUAL(1, protoVer);
+    CHECK_EQUAL(CSWP_PROTOCOL_v2, protoVer);
     CHECK_EQUAL(0, strcmp("AMIS PoC CSWP Server", ID));
     CHECK_EQUAL(0x100, svrVer);
 
     CHECK_EQUAL(0, state.deviceCount);
 
+    /* transport did not set a limit so default is used */
+    CHECK_EQUAL(CSWP_DEFAULT_MESSAGE_SIZE, state.messageSize);
+    CHECK_EQUAL(CSWP_DEFAULT_MESSAGE_SIZE, cswp_client_get_message_size(&client));
+
     res = cswp_term(&client);
     CHECK_EQUAL(CSWP_SUCCESS, res);
 
@@ -356,15 +769,40 @@ static void test_init_term()
     CHECK_EQUAL(CSWP_SUCCESS, res);
 
     free(testClientTransport.priv);
+
+    /* client asking for less than the default still gets the default */
+    cmd = cswp_buffer_alloc(256);
+    rsp = cswp_buffer_alloc(256);
+    cswp_encode_init_command(cmd, CSWP_PROTOCOL_v2, "Small client");
+    cswp_encode_init_message_size(cmd, 16);
+    cswp_buffer_seek(cmd, 0);
+    res = cswp_handle_command(&state, cmd, rsp);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(CSWP_DEFAULT_MESSAGE_SIZE, state.messageSize);
+
+    cswp_buffer_seek(rsp, 0);
+    res = cswp_decode_response_header(rsp, &msgType, &errCode);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(CSWP_SUCCESS, errCode);
+    res = cswp_decode_init_response_body(rsp, &version, ID, sizeof(ID), &version);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_decode_init_response_message_size(rsp, &messageSize);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(CSWP_DEFAULT_MESSAGE_SIZE, messageSize);
+
+    cswp_server_term(&state);
+    cswp_buffer_free(cmd);
+    cswp_buffer_free(rsp);
 }
 
-static void do_init(cswp_client_t* client, cswp_client_transport_t* transport)
+static void do_init_sized(cswp_client_t* client, cswp_client_transport_t* transport, size_t maxMessageSize)
 {
     int res;
     cswp_server_state_t* state;
 
     state = calloc(1, sizeof(cswp_server_state_t));
     state->impl = &testImpl;
+    state->maxMessageSize = maxMessageSize;
 
     transport->priv = calloc(1, sizeof(cswp_test_client_priv_t));
     ((cswp_test_client_priv_t*)transport->priv)->serverState = state;
@@ -377,6 +815,11 @@ static void do_init(cswp_client_t* client, cswp_client_transport_t* transport)
     CHECK_EQUAL(CSWP_SUCCESS, res);
 }
 
+static void do_init(cswp_client_t* client, cswp_client_transport_t* transport)
+{
+    do_init_sized(client, transport, 0);
+}
+
 static void do_term(cswp_client_t* client, cswp_client_transport_t* transport)
 {
     int res;
@@ -669,35 +1112,174 @@ static void test_reg_list()
 }
 
 
-static void test_reg_access()
+/* Cache key for device 0's register list */
+static const char testRegListKey[] = "AMIS PoC CSWP Server\n256\nType 1";
+
+/*
+ * Cache file for device 0's register list, named as by the client
+ */
+static void test_reg_list_file(char* path, size_t pathSize)
+{
+    const char* key = testRegListKey;
+    uint32_t h = 2166136261u;
+
+    while (*key)
+    {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    snprintf(path, pathSize, "./Type_1_%08x.reglist", (unsigned)h);
+}
+
+static void test_reg_list_cache()
 {
     cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    const cswp_reg_list_t* regList;
+    const cswp_reg_list_t* again;
+    const cswp_register_info_t* info;
+    cswp_register_info_t registerInfo[20];
+    char strbuf[1024];
+    char path[256];
+    unsigned regCount;
+    unsigned opsComplete;
+    unsigned i;
+    FILE* f;
     int res;
-    unsigned regIDs[3];
-    uint32_t regVals[3];
+
+    test_reg_list_file(path, sizeof(path));
+    remove(path);
 
     do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
     do_setup_devices(&client);
     do_open_device(&client, 0);
 
-    memset(testRegs, 0, sizeof(testRegs));
-    testRegs[1] = 0xDEADBEEF;
-    testRegs[2] = 0x80000000;
-    testRegs[6] = 0x12345678;
+    /* fetched once, then kept */
+    testPriv->numSent = 0;
+    res = cswp_device_get_reg_list(&client, 0, &regList);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(10, cswp_reg_list_count(regList));
+    info = cswp_reg_list_entries(regList);
+    for (i = 0; i < 10; ++i)
+    {
+        char expName[16];
+        sprintf(expName, "R_%d", i);
+        CHECK_EQUAL(i, info[i].id);
+        CHECK_EQUAL(0, strcmp(expName, info[i].name));
+        CHECK_EQUAL(1, info + i == cswp_reg_list_find(regList, expName));
+    }
+    CHECK_EQUAL(0, strcmp("Register 7", cswp_reg_list_find(regList, "R_7")->description));
+    CHECK_EQUAL(1, cswp_reg_list_find(regList, "R_10") == NULL);
+    CHECK_EQUAL(1, cswp_reg_list_find(regList, "") == NULL);
 
-    regIDs[0] = 1;
-    regIDs[1] = 6;
-    regIDs[2] = 2;
+    res = cswp_device_get_reg_list(&client, 0, &again);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, regList == again);
+    res = cswp_device_reg_list(&client, 0, &regCount, registerInfo, 20, strbuf, sizeof(strbuf));
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(10, regCount);
+    CHECK_EQUAL(0, strcmp("R 9", registerInfo[9].displayName));
 
-    res = cswp_device_reg_read(&client, 0, 3, regIDs, regVals, 3);
+    /* caller's buffers are still checked */
+    res = cswp_device_reg_list(&client, 0, &regCount, registerInfo, 20, strbuf, 40);
+    CHECK_EQUAL(CSWP_OUTPUT_BUFFER_OVERFLOW, res);
+    res = cswp_device_reg_list(&client, 0, &regCount, registerInfo, 5, strbuf, sizeof(strbuf));
+    CHECK_EQUAL(CSWP_OUTPUT_BUFFER_OVERFLOW, res);
+    CHECK_EQUAL(10, regCount);
+
+    /* batches always ask the server */
+    cswp_batch_begin(&client, 0);
+    res = cswp_device_get_reg_list(&client, 0, &again);
+    CHECK_EQUAL(CSWP_NOT_PERMITTED, res);
+    cswp_device_reg_list(&client, 0, &regCount, registerInfo, 20, strbuf, sizeof(strbuf));
+    res = cswp_batch_end(&client, &opsComplete);
     CHECK_EQUAL(CSWP_SUCCESS, res);
-    /* values returned in order of read */
-    CHECK_EQUAL(0xDEADBEEF, regVals[0]);
-    CHECK_EQUAL(0x12345678, regVals[1]);
-    CHECK_EQUAL(0x80000000, regVals[2]);
+    CHECK_EQUAL(2, testPriv->numSent);
+    CHECK_EQUAL(10, regCount);
 
-    regIDs[0] = 4;
-    regIDs[1] = 9;
+    /* setting devices drops kept lists */
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+    res = cswp_client_set_reg_list_cache(&client, ".");
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    testPriv->numSent = 0;
+    res = cswp_device_get_reg_list(&client, 0, &regList);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    do_term(&client, &testClientTransport);
+
+    /* a new connection uses the stored list */
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+    res = cswp_client_set_reg_list_cache(&client, ".");
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    testPriv->numSent = 0;
+    res = cswp_device_get_reg_list(&client, 0, &regList);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, testPriv->numSent);
+    CHECK_EQUAL(10, cswp_reg_list_count(regList));
+    CHECK_EQUAL(3, cswp_reg_list_find(regList, "R_3")->id);
+
+    /* unreadable files are replaced from the server */
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+    f = fopen(path, "r+b");
+    CHECK_EQUAL(1, f != NULL);
+    /* more registers than the file holds */
+    fseek(f, 8 + sizeof(testRegListKey), SEEK_SET);
+    fputc(0x7F, f);
+    fclose(f);
+    testPriv->numSent = 0;
+    res = cswp_device_get_reg_list(&client, 0, &regList);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(10, cswp_reg_list_count(regList));
+    do_setup_devices(&client);
+    testPriv->numSent = 0;
+    res = cswp_device_reg_list(&client, 0, &regCount, registerInfo, 20, strbuf, sizeof(strbuf));
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, testPriv->numSent);
+    CHECK_EQUAL(0, strcmp("Register 9", registerInfo[9].description));
+
+    do_term(&client, &testClientTransport);
+
+    remove(path);
+}
+
+static void test_reg_access()
+{
+    cswp_client_t client;
+    int res;
+    unsigned regIDs[3];
+    uint32_t regVals[3];
+
+    do_init(&client, &testClientTransport);
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    memset(testRegs, 0, sizeof(testRegs));
+    testRegs[1] = 0xDEADBEEF;
+    testRegs[2] = 0x80000000;
+    testRegs[6] = 0x12345678;
+
+    regIDs[0] = 1;
+    regIDs[1] = 6;
+    regIDs[2] = 2;
+
+    res = cswp_device_reg_read(&client, 0, 3, regIDs, regVals, 3);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    /* values returned in order of read */
+    CHECK_EQUAL(0xDEADBEEF, regVals[0]);
+    CHECK_EQUAL(0x12345678, regVals[1]);
+    CHECK_EQUAL(0x80000000, regVals[2]);
+
+    regIDs[0] = 4;
+    regIDs[1] = 9;
     regIDs[2] = 0;
     regVals[0] = 0x0BADF00D;
     regVals[1] = 0xAA55AA55;
@@ -713,6 +1295,45 @@ static void test_reg_access()
 }
 
 
+static void test_reg_read_list()
+{
+    cswp_client_t client;
+    int res;
+    unsigned regIDs[3];
+    uint32_t regVals[3];
+
+    do_init(&client, &testClientTransport);
+    ((cswp_test_client_priv_t*)testClientTransport.priv)->serverState->impl = &testListImpl;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    memset(testRegs, 0, sizeof(testRegs));
+    testRegs[3] = 0xCAFEF00D;
+    testRegs[7] = 0x00C0FFEE;
+    testRegListCalls = 0;
+
+    regIDs[0] = 7;
+    regIDs[1] = 3;
+    regIDs[2] = 0;
+
+    /* whole request is passed to the implementation in one call */
+    res = cswp_device_reg_read(&client, 0, 3, regIDs, regVals, 3);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testRegListCalls);
+    CHECK_EQUAL(0x00C0FFEE, regVals[0]);
+    CHECK_EQUAL(0xCAFEF00D, regVals[1]);
+    CHECK_EQUAL(0, regVals[2]);
+
+    /* failure in the list is reported */
+    regIDs[1] = 20;
+    res = cswp_device_reg_read(&client, 0, 3, regIDs, regVals, 3);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(2, testRegListCalls);
+
+    do_term(&client, &testClientTransport);
+}
+
+
 static void test_mem_access()
 {
     cswp_client_t client;
@@ -736,6 +1357,15 @@ static void test_mem_access()
     CHECK_EQUAL(0, memcmp(readBuf, "o world", 8));
     CHECK_EQUAL(8, bytesRead);
 
+    /* failed read replaces the reserved response data with an error */
+    res = cswp_device_mem_read(&client, 0, 8, 16, CSWP_ACCESS_SIZE_DEF, 0, readBuf, &bytesRead);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    res = cswp_device_mem_read(&client, 0, 6, 6, CSWP_ACCESS_SIZE_DEF, 0, readBuf, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, memcmp(readBuf, "world", 6));
+    CHECK_EQUAL(6, bytesRead);
+
     res = cswp_device_mem_write(&client, 0, 0, 14, CSWP_ACCESS_SIZE_DEF, 0, (uint8_t*)"Goodbye world");
     CHECK_EQUAL(CSWP_SUCCESS, res);
     CHECK_EQUAL(0, memcmp(testMem, "Goodbye world", 14));
@@ -879,6 +1509,1433 @@ static void test_batch()
     do_term(&client, &testClientTransport);
 }
 
+static void test_message_size()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t* data;
+    int res;
+
+    data = calloc(1, 65536);
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* request larger than default message size can't be encoded in a batch */
+    cswp_batch_begin(&client, 0);
+    res = cswp_device_mem_write(&client, 0, 0, 40000, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_BUFFER_FULL, res);
+    cswp_batch_end(&client, NULL);
+
+    do_term(&client, &testClientTransport);
+
+    /* transport allows larger messages */
+    do_init_sized(&client, &testClientTransport, 65536);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    CHECK_EQUAL(65536, testPriv->serverState->messageSize);
+    CHECK_EQUAL(65536, cswp_client_get_message_size(&client));
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* request reaches server, which rejects the address range */
+    res = cswp_device_mem_write(&client, 0, 0, 40000, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(1, testPriv->cmd->used > 40000);
+
+    /* but not beyond the negotiated size */
+    cswp_batch_begin(&client, 0);
+    res = cswp_device_mem_write(&client, 0, 0, 65536, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_BUFFER_FULL, res);
+    cswp_batch_end(&client, NULL);
+
+    do_term(&client, &testClientTransport);
+
+    free(data);
+}
+
+static void test_large_batch()
+{
+    cswp_client_t client;
+    unsigned regIDs[1000];
+    uint32_t regVals[1000];
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    for (i = 0; i < 10; ++i)
+        testRegs[i] = 0x1000 + i;
+
+    /* more commands than the initial pending response allocation */
+    res = cswp_batch_begin(&client, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    for (i = 0; i < 1000; ++i)
+    {
+        regIDs[i] = i % 10;
+        regVals[i] = 0;
+        res = cswp_device_reg_read(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1000, opsComplete);
+    for (i = 0; i < 1000; ++i)
+        CHECK_EQUAL(0x1000 + (i % 10), regVals[i]);
+
+    /* pending responses are reused for the next batch */
+    res = cswp_batch_begin(&client, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    for (i = 0; i < 3; ++i)
+    {
+        res = cswp_device_reg_read(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(3, opsComplete);
+
+    do_term(&client, &testClientTransport);
+}
+
+typedef struct
+{
+    unsigned calls;
+    cswp_batch_handle_t handle;
+    int result;
+    unsigned opsCompleted;
+} test_batch_completion_t;
+
+static void test_batch_callback(cswp_client_t* client, cswp_batch_handle_t handle,
+                                int result, unsigned opsCompleted, void* userData)
+{
+    test_batch_completion_t* completion = (test_batch_completion_t*)userData;
+
+    completion->calls++;
+    completion->handle = handle;
+    completion->result = result;
+    completion->opsCompleted = opsCompleted;
+}
+
+static void test_async_batch()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    cswp_batch_handle_t handles[10];
+    test_batch_completion_t completion[2];
+    unsigned regIDs[10];
+    uint32_t regVals[10];
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    for (i = 0; i < 10; ++i)
+    {
+        testRegs[i] = 0x2000 + i;
+        regIDs[i] = i;
+    }
+
+    /* nothing to submit */
+    res = cswp_batch_submit(&client, NULL, NULL, &handles[0]);
+    CHECK_EQUAL(CSWP_NOT_PERMITTED, res);
+
+    res = cswp_client_set_window(&client, 0);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_client_set_window(&client, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* two batches are sent without receiving responses */
+    memset(regVals, 0, sizeof(regVals));
+    testPriv->numSent = 0;
+    for (i = 0; i < 2; ++i)
+    {
+        cswp_batch_begin(&client, 0);
+        res = cswp_device_reg_read(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+        res = cswp_batch_submit(&client, NULL, NULL, &handles[i]);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    CHECK_EQUAL(2, testPriv->numSent);
+    CHECK_EQUAL(0, cswp_batch_poll(&client, handles[0]));
+    CHECK_EQUAL(0, cswp_batch_poll(&client, handles[1]));
+    CHECK_EQUAL(0, regVals[0]);
+
+    /* third batch completes the first to stay within the window */
+    cswp_batch_begin(&client, 0);
+    cswp_device_reg_read(&client, 0, 1, &regIDs[2], &regVals[2], 1);
+    res = cswp_batch_submit(&client, NULL, NULL, &handles[2]);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(3, testPriv->numSent);
+    CHECK_EQUAL(1, cswp_batch_poll(&client, handles[0]));
+    CHECK_EQUAL(0, cswp_batch_poll(&client, handles[1]));
+    CHECK_EQUAL(0x2000, regVals[0]);
+
+    /* collect out of order */
+    res = cswp_batch_wait(&client, handles[2], &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(0x2001, regVals[1]);
+    CHECK_EQUAL(0x2002, regVals[2]);
+    res = cswp_batch_wait(&client, handles[0], &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    res = cswp_batch_wait(&client, handles[1], &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* handles are released by wait */
+    res = cswp_batch_wait(&client, handles[0], &opsComplete);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* uncollected batches don't limit the number submitted */
+    memset(regVals, 0, sizeof(regVals));
+    for (i = 0; i < 10; ++i)
+    {
+        cswp_batch_begin(&client, 0);
+        cswp_device_reg_read(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        res = cswp_batch_submit(&client, NULL, NULL, &handles[i]);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    for (i = 10; i > 0; --i)
+    {
+        res = cswp_batch_wait(&client, handles[i-1], &opsComplete);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+        CHECK_EQUAL(0x2000 + i - 1, regVals[i-1]);
+    }
+
+    /* callbacks are made before a synchronous request is sent */
+    memset(completion, 0, sizeof(completion));
+    cswp_batch_begin(&client, 0);
+    cswp_device_reg_read(&client, 0, 3, regIDs, regVals, 3);
+    res = cswp_batch_submit(&client, test_batch_callback, &completion[0], &handles[0]);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    cswp_batch_begin(&client, 0);
+    cswp_device_reg_read(&client, 0, 1, regIDs, regVals, 1);
+    cswp_device_reg_read(&client, 1, 1, regIDs, regVals, 1);
+    res = cswp_batch_submit(&client, test_batch_callback, &completion[1], NULL);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, completion[0].calls);
+
+    res = cswp_device_reg_read(&client, 0, 1, &regIDs[5], &regVals[5], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, completion[0].calls);
+    CHECK_EQUAL(handles[0], completion[0].handle);
+    CHECK_EQUAL(CSWP_SUCCESS, completion[0].result);
+    CHECK_EQUAL(1, completion[0].opsCompleted);
+    CHECK_EQUAL(1, completion[1].calls);
+    CHECK_EQUAL(CSWP_UNSUPPORTED, completion[1].result);
+    CHECK_EQUAL(1, completion[1].opsCompleted);
+    CHECK_EQUAL(0x2005, regVals[5]);
+
+    /* empty batch completes immediately */
+    testPriv->numSent = 0;
+    cswp_batch_begin(&client, 0);
+    res = cswp_batch_submit(&client, test_batch_callback, &completion[0], NULL);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, completion[0].calls);
+    CHECK_EQUAL(0, testPriv->numSent);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_shared_session()
+{
+    cswp_client_t client;
+    cswp_client_t client2;
+    cswp_test_client_priv_t* testPriv;
+    cswp_batch_handle_t handle1, handle2;
+    unsigned regIDs[2] = { 3, 4 };
+    uint32_t regVals1[2];
+    uint32_t regVals2[2];
+    unsigned opsComplete;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    testRegs[3] = 0x3003;
+    testRegs[4] = 0x3004;
+
+    res = cswp_client_init_shared(&client2, &client);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* connection is owned by the first client */
+    res = cswp_init(&client2, "Test client 2", NULL, NULL, 0, NULL);
+    CHECK_EQUAL(CSWP_NOT_PERMITTED, res);
+
+    /* both clients use the one connection */
+    testPriv->numSent = 0;
+    regVals2[0] = 0;
+    res = cswp_device_reg_read(&client2, 0, 1, &regIDs[0], regVals2, 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0x3003, regVals2[0]);
+    CHECK_EQUAL(1, testPriv->numSent);
+
+    /* batches are built separately */
+    memset(regVals1, 0, sizeof(regVals1));
+    memset(regVals2, 0, sizeof(regVals2));
+    cswp_batch_begin(&client, 0);
+    cswp_batch_begin(&client2, 0);
+    res = cswp_device_reg_read(&client, 0, 2, regIDs, regVals1, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_reg_read(&client2, 0, 1, &regIDs[1], regVals2, 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_reg_read(&client2, 1, 1, &regIDs[1], &regVals2[1], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    res = cswp_batch_submit(&client, NULL, NULL, &handle1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_batch_submit(&client2, NULL, NULL, &handle2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(3, testPriv->numSent);
+
+    /* each client completes only its own batches */
+    res = cswp_batch_wait(&client2, handle1, &opsComplete);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_batch_wait(&client2, handle2, &opsComplete);
+    CHECK_EQUAL(CSWP_UNSUPPORTED, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(0x3004, regVals2[0]);
+
+    /* the earlier response was received on the way */
+    CHECK_EQUAL(1, cswp_batch_poll(&client, handle1));
+    CHECK_EQUAL(0x3003, regVals1[0]);
+    CHECK_EQUAL(0x3004, regVals1[1]);
+    res = cswp_batch_wait(&client, handle1, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+
+    res = cswp_client_term(&client2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    do_term(&client, &testClientTransport);
+}
+
+#ifndef _WIN32
+#define SHARED_THREAD_BATCHES 200
+
+/*
+ * Client using a shared session from its own thread
+ */
+typedef struct
+{
+    cswp_client_t* client;
+    /* register read by the thread's batches */
+    unsigned regID;
+    /* number of batches with unexpected results */
+    unsigned failures;
+} shared_session_thread_t;
+
+static void* shared_session_thread(void* arg)
+{
+    shared_session_thread_t* thread = (shared_session_thread_t*)arg;
+    cswp_client_t* client = thread->client;
+    cswp_batch_handle_t handle;
+    const cswp_reg_list_t* regList;
+    unsigned regCount;
+    uint32_t values[2];
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    for (i = 0; i < SHARED_THREAD_BATCHES; ++i)
+    {
+        /* completed by whichever thread receives the response, updating
+           this client's register lists and error message */
+        values[0] = 0;
+        cswp_batch_begin(client, 0);
+        cswp_device_reg_list(client, 0, &regCount, NULL, 0, NULL, 0);
+        cswp_device_reg_read(client, 0, 1, &thread->regID, &values[0], 1);
+        cswp_device_reg_read(client, 1, 1, &thread->regID, &values[1], 1);
+        res = cswp_batch_submit(client, NULL, NULL, &handle);
+        if (res != CSWP_SUCCESS)
+        {
+            thread->failures++;
+            continue;
+        }
+
+        /* meanwhile use the same state from this thread */
+        res = cswp_device_get_reg_list(client, 0, &regList);
+        if (res != CSWP_SUCCESS || cswp_reg_list_count(regList) != 10)
+            thread->failures++;
+        res = cswp_device_reg_read(client, 1, 1, &thread->regID, &values[1], 1);
+        if (res != CSWP_UNSUPPORTED)
+            thread->failures++;
+
+        res = cswp_batch_wait(client, handle, &opsComplete);
+        if (res != CSWP_UNSUPPORTED || opsComplete != 2 || values[0] != testRegs[thread->regID])
+            thread->failures++;
+    }
+
+    return NULL;
+}
+
+static void test_shared_session_threads(int duplex)
+{
+    cswp_client_t client;
+    cswp_client_t client2;
+    cswp_test_client_priv_t* testPriv;
+    shared_session_thread_t threads[2];
+    pthread_t ids[2];
+    unsigned i;
+    int res;
+
+    testClientTransport.duplex = duplex;
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    testRegs[3] = 0x3003;
+    testRegs[4] = 0x3004;
+
+    res = cswp_client_init_shared(&client2, &client);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* two threads issue batches at once, only sending while another
+       receives if the transport allows it */
+    testPriv->numSent = 0;
+    threads[0].client = &client;
+    threads[1].client = &client2;
+    for (i = 0; i < 2; ++i)
+    {
+        threads[i].regID = 3 + i;
+        threads[i].failures = 0;
+        res = pthread_create(&ids[i], NULL, shared_session_thread, &threads[i]);
+        CHECK_EQUAL(0, res);
+    }
+    for (i = 0; i < 2; ++i)
+        pthread_join(ids[i], NULL);
+
+    CHECK_EQUAL(0, threads[0].failures);
+    CHECK_EQUAL(0, threads[1].failures);
+    CHECK_EQUAL(1, testPriv->numSent >= 2 * 2 * SHARED_THREAD_BATCHES);
+    CHECK_EQUAL(0, testPriv->numOverlaps);
+
+    res = cswp_client_term(&client2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    do_term(&client, &testClientTransport);
+    testClientTransport.duplex = 1;
+}
+#endif
+
+static void test_template()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    cswp_batch_template_t* tmpl;
+    test_batch_completion_t completion;
+    unsigned regIDs[2] = { 1, 2 };
+    uint32_t writeVals[2] = { 0x1111, 0x2222 };
+    uint32_t regVals[2];
+    uint8_t writeData[4] = { 1, 2, 3, 4 };
+    uint8_t readData[4];
+    size_t bytesRead;
+    unsigned opsComplete;
+    unsigned regID;
+    uint32_t regValue;
+    uint64_t address;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    memset(testRegs, 0, sizeof(testRegs));
+    memset(testMem, 0, sizeof(testMem));
+
+    /* nothing being recorded */
+    res = cswp_template_end(&client, &tmpl);
+    CHECK_EQUAL(CSWP_NOT_PERMITTED, res);
+
+    /* record, without sending anything */
+    testPriv->numSent = 0;
+    res = cswp_template_begin(&client, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_reg_write(&client, 0, 2, regIDs, writeVals, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_mem_write(&client, 0, 0, 4, CSWP_ACCESS_SIZE_32, 0, writeData);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_reg_read(&client, 0, 2, regIDs, regVals, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_mem_read(&client, 0, 0, 4, CSWP_ACCESS_SIZE_32, 0, readData, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_template_end(&client, &tmpl);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, testPriv->numSent);
+    CHECK_EQUAL(0, testRegs[1]);
+
+    /* run as recorded */
+    memset(regVals, 0, sizeof(regVals));
+    memset(readData, 0, sizeof(readData));
+    res = cswp_template_run(&client, tmpl, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(4, opsComplete);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0x1111, testRegs[1]);
+    CHECK_EQUAL(0x2222, testRegs[2]);
+    CHECK_EQUAL(0x1111, regVals[0]);
+    CHECK_EQUAL(0x2222, regVals[1]);
+    CHECK_CONTENTS("\x01\x02\x03\x04", readData, 4);
+    CHECK_EQUAL(4, bytesRead);
+
+    /* patch operands */
+    regID = 7;
+    regValue = 0x7777;
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 0, CSWP_TEMPLATE_REG_ID, 1, &regID, sizeof(regID)));
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 0, CSWP_TEMPLATE_REG_VALUE, 1, &regValue, sizeof(regValue)));
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 2, CSWP_TEMPLATE_REG_ID, 1, &regID, sizeof(regID)));
+    address = 8;
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 1, CSWP_TEMPLATE_ADDRESS, 0, &address, sizeof(address)));
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 1, CSWP_TEMPLATE_DATA, 0, "\x0A\x0B\x0C\x0D", 4));
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 3, CSWP_TEMPLATE_ADDRESS, 0, &address, sizeof(address)));
+
+    /* not recorded, or wrong size */
+    CHECK_EQUAL(CSWP_BAD_ARGS, cswp_template_set(tmpl, 2, CSWP_TEMPLATE_ADDRESS, 0, &address, sizeof(address)));
+    CHECK_EQUAL(CSWP_BAD_ARGS, cswp_template_set(tmpl, 0, CSWP_TEMPLATE_REG_ID, 2, &regID, sizeof(regID)));
+    CHECK_EQUAL(CSWP_BAD_ARGS, cswp_template_set(tmpl, 1, CSWP_TEMPLATE_DATA, 0, writeData, 2));
+    CHECK_EQUAL(CSWP_BAD_ARGS, cswp_template_set(tmpl, 1, CSWP_TEMPLATE_ADDRESS, 0, &regID, sizeof(regID)));
+
+    memset(regVals, 0, sizeof(regVals));
+    res = cswp_template_run(&client, tmpl, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(4, opsComplete);
+    CHECK_EQUAL(0x1111, testRegs[1]);
+    CHECK_EQUAL(0x2222, testRegs[2]);
+    CHECK_EQUAL(0x7777, testRegs[7]);
+    CHECK_EQUAL(0x1111, regVals[0]);
+    CHECK_EQUAL(0x7777, regVals[1]);
+    CHECK_CONTENTS("\x0A\x0B\x0C\x0D", testMem + 8, 4);
+    CHECK_CONTENTS("\x0A\x0B\x0C\x0D", readData, 4);
+
+    /* submit without waiting */
+    memset(&completion, 0, sizeof(completion));
+    address = 0;
+    CHECK_EQUAL(CSWP_SUCCESS, cswp_template_set(tmpl, 3, CSWP_TEMPLATE_ADDRESS, 0, &address, sizeof(address)));
+    res = cswp_template_submit(&client, tmpl, test_batch_callback, &completion, NULL);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, completion.calls);
+    cswp_batch_flush(&client);
+    CHECK_EQUAL(1, completion.calls);
+    CHECK_EQUAL(CSWP_SUCCESS, completion.result);
+    CHECK_EQUAL(4, completion.opsCompleted);
+    CHECK_CONTENTS("\x01\x02\x03\x04", readData, 4);
+
+    /* commands after recording execute as normal */
+    regVals[0] = 0;
+    res = cswp_device_reg_read(&client, 0, 1, &regIDs[0], regVals, 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0x1111, regVals[0]);
+
+    cswp_template_free(tmpl);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_write_behind()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    unsigned regIDs[4] = { 1, 2, 3, 4 };
+    uint32_t regVals[4] = { 0x11, 0x22, 0x33, 0x44 };
+    uint32_t readVals[4];
+    uint8_t data[4] = { 0xA, 0xB, 0xC, 0xD };
+    unsigned opsComplete;
+    clock_t start;
+    int i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    memset(testRegs, 0, sizeof(testRegs));
+    memset(testMem, 0, sizeof(testMem));
+
+    res = cswp_client_set_write_behind(&client, 4, 0, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* writes are queued */
+    testPriv->numSent = 0;
+    for (i = 0; i < 2; ++i)
+    {
+        res = cswp_device_reg_write(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    res = cswp_device_mem_write(&client, 0, 4, 4, CSWP_ACCESS_SIZE_32, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, testPriv->numSent);
+    CHECK_EQUAL(0, testRegs[1]);
+
+    /* and sent with the next command that needs a response */
+    res = cswp_device_reg_read(&client, 0, 2, regIDs, readVals, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0x11, readVals[0]);
+    CHECK_EQUAL(0x22, readVals[1]);
+    CHECK_CONTENTS("\x0A\x0B\x0C\x0D", testMem + 4, 4);
+
+    /* or when the operation limit is reached */
+    testPriv->numSent = 0;
+    for (i = 0; i < 4; ++i)
+    {
+        res = cswp_device_reg_write(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0x44, testRegs[4]);
+
+    /* errors are reported by the next synchronous call */
+    testPriv->numSent = 0;
+    res = cswp_device_reg_write(&client, 1, 1, &regIDs[0], &regVals[0], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[0], &regVals[3], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    readVals[0] = 0;
+    res = cswp_device_reg_read(&client, 0, 1, &regIDs[0], readVals, 1);
+    CHECK_EQUAL(CSWP_UNSUPPORTED, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    /* later writes and the read still executed */
+    CHECK_EQUAL(0x44, readVals[0]);
+    res = cswp_device_reg_read(&client, 0, 1, &regIDs[0], readVals, 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* error from writes sent at the limit is held for the next call */
+    res = cswp_device_mem_write(&client, 0, 14, 4, CSWP_ACCESS_SIZE_32, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    for (i = 0; i < 3; ++i)
+    {
+        res = cswp_device_reg_write(&client, 0, 1, &regIDs[i], &regVals[i], 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    res = cswp_client_flush_writes(&client);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_client_flush_writes(&client);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* explicit batches are sent after queued writes */
+    testPriv->numSent = 0;
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[0], &regVals[0], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    cswp_batch_begin(&client, 0);
+    CHECK_EQUAL(1, testPriv->numSent);
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[1], &regVals[0], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(2, testPriv->numSent);
+
+    /* writes queued for longer than the delay are sent */
+    res = cswp_client_set_write_behind(&client, 100, 0, 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    testPriv->numSent = 0;
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[0], &regVals[1], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, testPriv->numSent);
+    start = clock();
+    while ((clock() - start) * 1000 < 5 * CLOCKS_PER_SEC)
+        ;
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[1], &regVals[1], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0x22, testRegs[1]);
+
+    /* disabling sends queued writes */
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[2], &regVals[0], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_client_set_write_behind(&client, 0, 0, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numSent);
+    CHECK_EQUAL(0x11, testRegs[3]);
+    res = cswp_device_reg_write(&client, 0, 1, &regIDs[2], &regVals[1], 1);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(3, testPriv->numSent);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_sendv()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t* data;
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    data = malloc(TEST_DIRECT_SIZE);
+    for (i = 0; i < TEST_DIRECT_SIZE; ++i)
+        data[i] = (uint8_t)(i * 7);
+    memset(testBigMem, 0, TEST_DIRECT_SIZE);
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* large writes are sent from the caller's buffer */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_write(&client, 0, TEST_BIG_MEM_BASE, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(1, testPriv->numSendv);
+    CHECK_EQUAL(0, memcmp(testBigMem, data, TEST_DIRECT_SIZE));
+
+    /* small writes are copied */
+    res = cswp_device_mem_write(&client, 0, 0, 4, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numSent);
+    CHECK_EQUAL(1, testPriv->numSendv);
+    CHECK_EQUAL(0, memcmp(testMem, data, 4));
+
+    /* as are writes in a batch, which may outlive the caller's buffer */
+    memset(testBigMem, 0, TEST_DIRECT_SIZE);
+    cswp_batch_begin(&client, 0);
+    res = cswp_device_mem_write(&client, 0, TEST_BIG_MEM_BASE, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(3, testPriv->numSent);
+    CHECK_EQUAL(1, testPriv->numSendv);
+    CHECK_EQUAL(0, memcmp(testBigMem, data, TEST_DIRECT_SIZE));
+
+    /* errors from the server are reported */
+    res = cswp_device_mem_write(&client, 0, 0, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(2, testPriv->numSendv);
+
+    /* the next request is encoded normally */
+    res = cswp_device_mem_write(&client, 0, 4, 4, CSWP_ACCESS_SIZE_DEF, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numSendv);
+
+    do_term(&client, &testClientTransport);
+
+    free(data);
+}
+
+static void test_receivev()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t* data;
+    uint8_t* mask;
+    size_t bytesRead;
+    cswp_batch_handle_t handle;
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    data = malloc(TEST_DIRECT_SIZE);
+    mask = calloc(1, TEST_DIRECT_SIZE);
+    for (i = 0; i < TEST_DIRECT_SIZE; ++i)
+        testBigMem[i] = (uint8_t)(i * 13);
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* large reads are received into the caller's buffer */
+    testPriv->numReceivev = 0;
+    memset(data, 0, TEST_DIRECT_SIZE);
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numReceivev);
+    CHECK_EQUAL(TEST_DIRECT_SIZE, bytesRead);
+    CHECK_EQUAL(0, memcmp(data, testBigMem, TEST_DIRECT_SIZE));
+
+    /* as are polls */
+    memset(data, 0, TEST_DIRECT_SIZE);
+    res = cswp_device_mem_poll(&client, 0, TEST_BIG_MEM_BASE, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, 1, 0,
+                               mask, mask, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numReceivev);
+    CHECK_EQUAL(TEST_DIRECT_SIZE, bytesRead);
+    CHECK_EQUAL(0, memcmp(data, testBigMem, TEST_DIRECT_SIZE));
+
+    /* and single reads submitted as batches */
+    memset(data, 0, TEST_DIRECT_SIZE);
+    cswp_batch_begin(&client, 0);
+    cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data, &bytesRead);
+    res = cswp_batch_submit(&client, NULL, NULL, &handle);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    res = cswp_batch_wait(&client, handle, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(3, testPriv->numReceivev);
+    CHECK_EQUAL(0, memcmp(data, testBigMem, TEST_DIRECT_SIZE));
+
+    /* failed reads report the server's error */
+    res = cswp_device_mem_read(&client, 0, 0, TEST_DIRECT_SIZE, CSWP_ACCESS_SIZE_DEF, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(4, testPriv->numReceivev);
+    CHECK_EQUAL(1, strstr(client.errorMsg, "Failed to read memory") != NULL);
+
+    /* small reads and reads with other commands use the response buffer */
+    memset(data, 0, TEST_DIRECT_SIZE);
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, 16, CSWP_ACCESS_SIZE_DEF, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, memcmp(data, testBigMem, 16));
+    cswp_batch_begin(&client, 0);
+    cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, 4096, CSWP_ACCESS_SIZE_DEF, 0, data, &bytesRead);
+    cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE + 4096, 4096, CSWP_ACCESS_SIZE_DEF, 0, data + 4096, &bytesRead);
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, opsComplete);
+    CHECK_EQUAL(4, testPriv->numReceivev);
+    CHECK_EQUAL(0, memcmp(data, testBigMem, TEST_DIRECT_SIZE));
+
+    do_term(&client, &testClientTransport);
+
+    free(mask);
+    free(data);
+}
+
+static void test_mem_chunked()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t* data;
+    uint8_t fifo[64];
+    size_t bytesRead;
+    unsigned i;
+    int res;
+
+    data = malloc(sizeof(testBigMem));
+    for (i = 0; i < sizeof(testBigMem); ++i)
+        data[i] = (uint8_t)(i * 3 + (i >> 12));
+    memset(testBigMem, 0, sizeof(testBigMem));
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* transfers larger than a message are split */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_write(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent > sizeof(testBigMem) / CSWP_DEFAULT_MESSAGE_SIZE);
+    CHECK_EQUAL(0, memcmp(testBigMem, data, sizeof(testBigMem)));
+
+    memset(data, 0, sizeof(testBigMem));
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(sizeof(testBigMem), bytesRead);
+    CHECK_EQUAL(0, memcmp(testBigMem, data, sizeof(testBigMem)));
+
+    /* chunks keep to the access size */
+    for (i = 0; i < 2; ++i)
+    {
+        res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE + 2, sizeof(testBigMem) - 2 - i * 6,
+                                   CSWP_ACCESS_SIZE_16, 0, data, &bytesRead);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+        CHECK_EQUAL(sizeof(testBigMem) - 2 - i * 6, bytesRead);
+        CHECK_EQUAL(0, memcmp(testBigMem + 2, data, bytesRead));
+    }
+
+    /* without address increment every chunk accesses the same address */
+    res = cswp_device_mem_write(&client, 0, 3, sizeof(testBigMem), CSWP_ACCESS_SIZE_8, CSWP_MEM_NO_ADDR_INC, testBigMem);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(testBigMem[sizeof(testBigMem) - 1], testMem[3]);
+    testMem[3] = 0x5A;
+    res = cswp_device_mem_read(&client, 0, 3, sizeof(testBigMem), CSWP_ACCESS_SIZE_8, CSWP_MEM_NO_ADDR_INC, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(sizeof(testBigMem), bytesRead);
+    CHECK_EQUAL(0x5A, data[0]);
+    CHECK_EQUAL(0x5A, data[sizeof(testBigMem) - 1]);
+
+    /* read stops at the first failed chunk */
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE + 4096, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(1, bytesRead < sizeof(testBigMem) - 4096);
+    CHECK_EQUAL(0, bytesRead % 8);
+    CHECK_EQUAL(0, memcmp(testBigMem + 4096, data, bytesRead));
+
+    /* the next request is unaffected */
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, sizeof(fifo), CSWP_ACCESS_SIZE_32, 0, fifo, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, memcmp(testBigMem, fifo, sizeof(fifo)));
+
+    do_term(&client, &testClientTransport);
+    free(data);
+
+    /* write chunks stay within the request byte window when messages are
+       larger, so are still pipelined */
+    data = malloc(2 * CSWP_MAX_MESSAGE_SIZE);
+    memset(data, 0xA5, 2 * CSWP_MAX_MESSAGE_SIZE);
+    do_init_sized(&client, &testClientTransport, CSWP_MAX_MESSAGE_SIZE);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    testPriv->maxQueued = 0;
+    res = cswp_device_mem_write(&client, 0, 3, 2 * CSWP_MAX_MESSAGE_SIZE, CSWP_ACCESS_SIZE_8, CSWP_MEM_NO_ADDR_INC, data);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0xA5, testMem[3]);
+    CHECK_EQUAL(1, testPriv->maxQueued > 1);
+
+    do_term(&client, &testClientTransport);
+
+    free(data);
+}
+
+static void test_mem_fill()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    const uint8_t pattern[3] = { 0x11, 0x22, 0x33 };
+    uint8_t longPattern[CSWP_MEM_FILL_MAX_PATTERN + 1];
+    unsigned i;
+    int res;
+
+    for (i = 0; i < sizeof(longPattern); ++i)
+        longPattern[i] = (uint8_t)(i + 1);
+    memset(testBigMem, 0, sizeof(testBigMem));
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* without an implementation fill the server writes the pattern itself,
+       still needing only one request */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_fill(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem) - 1, CSWP_ACCESS_SIZE_8, 0,
+                               pattern, sizeof(pattern));
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    for (i = 0; i < sizeof(testBigMem) - 1; ++i)
+    {
+        if (testBigMem[i] != pattern[i % sizeof(pattern)])
+            break;
+    }
+    CHECK_EQUAL(sizeof(testBigMem) - 1, i);
+    CHECK_EQUAL(0, testBigMem[sizeof(testBigMem) - 1]);
+
+    /* the last repeat is cut short */
+    res = cswp_device_mem_fill(&client, 0, 1, 10, CSWP_ACCESS_SIZE_DEF, 0, (const uint8_t*)"ABCD", 4);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_CONTENTS("ABCDABCDAB", testMem + 1, 10);
+
+    /* without address increment every write goes to the same address */
+    res = cswp_device_mem_fill(&client, 0, 3, 4096 + 2, CSWP_ACCESS_SIZE_8, CSWP_MEM_NO_ADDR_INC,
+                               longPattern, CSWP_MEM_FILL_MAX_PATTERN);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testMem[3]);
+
+    /* pattern size is checked */
+    res = cswp_device_mem_fill(&client, 0, 0, 4, CSWP_ACCESS_SIZE_DEF, 0, pattern, 0);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_device_mem_fill(&client, 0, 0, 4, CSWP_ACCESS_SIZE_DEF, 0, longPattern, sizeof(longPattern));
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* write failures are reported */
+    res = cswp_device_mem_fill(&client, 0, TEST_BIG_MEM_BASE + 8, sizeof(testBigMem), CSWP_ACCESS_SIZE_8, 0,
+                               pattern, sizeof(pattern));
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* implementation fill is used when provided */
+    testPriv->serverState->impl = &testFillImpl;
+    testMemFillCalls = 0;
+    res = cswp_device_mem_fill(&client, 0, TEST_BIG_MEM_BASE + 5, 7, CSWP_ACCESS_SIZE_8, 0,
+                               longPattern, 2);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testMemFillCalls);
+    CHECK_CONTENTS("\x01\x02\x01\x02\x01\x02\x01", testBigMem + 5, 7);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_mem_multi()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t buf[4][8];
+    uint8_t* big;
+    cswp_mem_segment_t segs[40];
+    int status[40];
+    unsigned i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    memcpy(testMem, "Hello world", 12);
+    for (i = 0; i < 16; ++i)
+        testBigMem[i] = (uint8_t)(0xA0 + i);
+    memset(buf, 0xFF, sizeof(buf));
+
+    /* all segments are read with one request, a failed segment is zeroed */
+    segs[0].address = 0;  segs[0].data = buf[0]; segs[0].size = 5;
+    segs[1].address = 6;  segs[1].data = buf[1]; segs[1].size = 5;
+    segs[2].address = TEST_BIG_MEM_BASE + 4; segs[2].data = buf[2]; segs[2].size = 8;
+    segs[3].address = sizeof(testMem) - 4; segs[3].data = buf[3]; segs[3].size = 8;
+    testPriv->numSent = 0;
+    res = cswp_device_mem_read_multi(&client, 0, CSWP_ACCESS_SIZE_DEF, 0, segs, 4, status);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(CSWP_SUCCESS, status[0]);
+    CHECK_EQUAL(CSWP_SUCCESS, status[1]);
+    CHECK_EQUAL(CSWP_SUCCESS, status[2]);
+    CHECK_EQUAL(CSWP_BAD_ARGS, status[3]);
+    CHECK_CONTENTS("Hello", buf[0], 5);
+    CHECK_CONTENTS("world", buf[1], 5);
+    CHECK_CONTENTS("\xA4\xA5\xA6\xA7\xA8\xA9\xAA\xAB", buf[2], 8);
+    CHECK_CONTENTS("\0\0\0\0\0\0\0\0", buf[3], 8);
+
+    /* the connection is still usable */
+    res = cswp_device_mem_read_multi(&client, 0, CSWP_ACCESS_SIZE_DEF, 0, segs, 2, NULL);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+
+    /* writes */
+    segs[0].address = 0; segs[0].data = (uint8_t*)"J"; segs[0].size = 1;
+    segs[1].address = 6; segs[1].data = (uint8_t*)"W"; segs[1].size = 1;
+    res = cswp_device_mem_write_multi(&client, 0, CSWP_ACCESS_SIZE_DEF, 0, segs, 2, status);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(CSWP_SUCCESS, status[0]);
+    CHECK_EQUAL(CSWP_SUCCESS, status[1]);
+    CHECK_CONTENTS("Jello World", testMem, 12);
+
+    /* lists larger than a message are split */
+    big = malloc(40 * 1024);
+    for (i = 0; i < 40; ++i)
+    {
+        segs[i].address = TEST_BIG_MEM_BASE + i * 2048;
+        segs[i].data = big + i * 1024;
+        segs[i].size = 1024;
+    }
+    for (i = 0; i < 40 * 1024; ++i)
+        big[i] = (uint8_t)(i * 5);
+    testPriv->numSent = 0;
+    res = cswp_device_mem_write_multi(&client, 0, CSWP_ACCESS_SIZE_32, 0, segs, 40, status);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numSent);
+    CHECK_EQUAL(CSWP_SUCCESS, status[39]);
+    CHECK_CONTENTS(big + 39 * 1024, testBigMem + 39 * 2048, 1024);
+
+    memset(big, 0, 40 * 1024);
+    testPriv->numSent = 0;
+    res = cswp_device_mem_read_multi(&client, 0, CSWP_ACCESS_SIZE_32, 0, segs, 40, status);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testPriv->numSent);
+    for (i = 0; i < 40; ++i)
+        CHECK_CONTENTS(testBigMem + i * 2048, big + i * 1024, 1024);
+
+    free(big);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_mem_checksum()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint64_t digests[5];
+    uint64_t* many;
+    size_t count;
+    unsigned i;
+    int res;
+
+    /* reference values */
+    CHECK_EQUAL(0xCBF43926, cswp_checksum(CSWP_CHECKSUM_CRC32, "123456789", 9));
+    CHECK_EQUAL(0x06D5573923C6CDFC, cswp_checksum(CSWP_CHECKSUM_FNV1A64, "123456789", 9));
+    CHECK_EQUAL(0xCBF29CE484222325, cswp_checksum(CSWP_CHECKSUM_FNV1A64, "", 0));
+    CHECK_EQUAL(1, cswp_checksum_count(0, 16));
+    CHECK_EQUAL(1, cswp_checksum_count(100, 0));
+    CHECK_EQUAL(1, cswp_checksum_count(16, 16));
+    CHECK_EQUAL(2, cswp_checksum_count(17, 16));
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    for (i = 0; i < sizeof(testBigMem); ++i)
+        testBigMem[i] = (uint8_t)(i * 7 + (i >> 8));
+    memcpy(testMem, "123456789", 9);
+
+    /* without an implementation checksum the server reads the memory,
+       still needing only one request */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_checksum(&client, 0, 0, 9, CSWP_ACCESS_SIZE_DEF, 0,
+                                   CSWP_CHECKSUM_CRC32, 0, digests);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0xCBF43926, digests[0]);
+
+    res = cswp_device_mem_checksum(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                   CSWP_CHECKSUM_FNV1A64, 0, digests);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(cswp_checksum(CSWP_CHECKSUM_FNV1A64, testBigMem, sizeof(testBigMem)), digests[0]);
+
+    /* one digest per block, the last block is short */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_checksum(&client, 0, TEST_BIG_MEM_BASE + 8, 4500, CSWP_ACCESS_SIZE_8, 0,
+                                   CSWP_CHECKSUM_CRC32, 1000, digests);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    for (i = 0; i < 4; ++i)
+        CHECK_EQUAL(cswp_checksum(CSWP_CHECKSUM_CRC32, testBigMem + 8 + i * 1000, 1000), digests[i]);
+    CHECK_EQUAL(cswp_checksum(CSWP_CHECKSUM_CRC32, testBigMem + 4008, 500), digests[4]);
+
+    /* algorithm is checked */
+    res = cswp_device_mem_checksum(&client, 0, 0, 9, CSWP_ACCESS_SIZE_DEF, 0,
+                                   (cswp_checksum_t)7, 0, digests);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* read failures are reported */
+    res = cswp_device_mem_checksum(&client, 0, 8, 16, CSWP_ACCESS_SIZE_DEF, 0,
+                                   CSWP_CHECKSUM_CRC32, 4, digests);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* more digests than fit in a message are split over several */
+    count = cswp_checksum_count(sizeof(testBigMem), 16);
+    many = malloc(count * sizeof(uint64_t));
+    testPriv->numSent = 0;
+    res = cswp_device_mem_checksum(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                   CSWP_CHECKSUM_FNV1A64, 16, many);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent > 1);
+    for (i = 0; i < count; ++i)
+    {
+        if (many[i] != cswp_checksum(CSWP_CHECKSUM_FNV1A64, testBigMem + i * 16, 16))
+            break;
+    }
+    CHECK_EQUAL(count, i);
+    free(many);
+
+    /* implementation checksum is used when provided */
+    testPriv->serverState->impl = &testChecksumImpl;
+    testMemChecksumCalls = 0;
+    res = cswp_device_mem_checksum(&client, 0, TEST_BIG_MEM_BASE, 64, CSWP_ACCESS_SIZE_8, 0,
+                                   CSWP_CHECKSUM_CRC32, 32, digests);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, testMemChecksumCalls);
+    CHECK_EQUAL(cswp_checksum(CSWP_CHECKSUM_CRC32, testBigMem + 32, 32), digests[1]);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_mem_read_delta()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    uint8_t buf[4500];
+    uint8_t changed[2];
+    uint8_t* big;
+    uint8_t* bigChanged;
+    size_t count;
+    unsigned ok, rejected;
+    unsigned i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    for (i = 0; i < sizeof(testBigMem); ++i)
+        testBigMem[i] = (uint8_t)(i * 3 + (i >> 8));
+
+    /* starting from zeros every block is returned */
+    memset(buf, 0, sizeof(buf));
+    testPriv->numSent = 0;
+    res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, sizeof(buf), CSWP_ACCESS_SIZE_32, 0,
+                                     1000, buf, changed);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(0x1F, changed[0]);
+    CHECK_CONTENTS(testBigMem, buf, sizeof(buf));
+
+    /* only changed blocks are returned */
+    testBigMem[1500] ^= 0xFF;
+    testBigMem[4499] ^= 0xFF;
+    res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, sizeof(buf), CSWP_ACCESS_SIZE_32, 0,
+                                     1000, buf, changed);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0x12, changed[0]);
+    CHECK_CONTENTS(testBigMem, buf, sizeof(buf));
+
+    res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, sizeof(buf), CSWP_ACCESS_SIZE_32, 0,
+                                     1000, buf, changed);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, changed[0]);
+
+    /* one block */
+    memcpy(testMem, "Hello world", 12);
+    memset(buf, 0, sizeof(buf));
+    res = cswp_device_mem_read_delta(&client, 0, 0, 12, CSWP_ACCESS_SIZE_DEF, 0, 0, buf, NULL);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_CONTENTS("Hello world", buf, 12);
+
+    /* read failures are reported */
+    res = cswp_device_mem_read_delta(&client, 0, 8, 16, CSWP_ACCESS_SIZE_DEF, 0, 4, buf, changed);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* blocks must fit in a message */
+    res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                     sizeof(testBigMem), buf, NULL);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* blocks close to the message size either fit or are rejected */
+    big = malloc(2 * CSWP_DEFAULT_MESSAGE_SIZE);
+    ok = 0;
+    rejected = 0;
+    for (i = CSWP_DEFAULT_MESSAGE_SIZE - 128; i <= CSWP_DEFAULT_MESSAGE_SIZE; ++i)
+    {
+        memset(big, 0, 2 * i);
+        res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, 2 * i, CSWP_ACCESS_SIZE_8, 0,
+                                         i, big, NULL);
+        if (res == CSWP_SUCCESS && memcmp(big, testBigMem, 2 * i) == 0)
+            ++ok;
+        else if (res == CSWP_BAD_ARGS)
+            ++rejected;
+    }
+    CHECK_EQUAL(129, ok + rejected);
+    CHECK_EQUAL(1, ok > 0 && rejected > 0);
+    free(big);
+
+    /* larger ranges are split, and unchanged blocks cost only a digest */
+    big = malloc(sizeof(testBigMem));
+    memcpy(big, testBigMem, sizeof(testBigMem));
+    count = cswp_checksum_count(sizeof(testBigMem), 4096);
+    bigChanged = malloc((count + 7) / 8);
+    testBigMem[70000] ^= 0xFF;
+    testPriv->numSent = 0;
+    res = cswp_device_mem_read_delta(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                     4096, big, bigChanged);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent > 1);
+    CHECK_CONTENTS(testBigMem, big, sizeof(testBigMem));
+    for (i = 0; i < count; ++i)
+        CHECK_EQUAL(i == 70000 / 4096, (bigChanged[i / 8] >> (i % 8)) & 1);
+    free(bigChanged);
+    free(big);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_mem_search()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    const uint8_t pattern[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+    const uint8_t maskPattern[] = { 0xD0, 0x0D };
+    const uint8_t mask[] = { 0xF0, 0x0F };
+    uint64_t hits[8];
+    uint64_t* many;
+    size_t hitCount;
+    unsigned opsComplete;
+    unsigned i;
+    int res;
+
+    do_init(&client, &testClientTransport);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* one match crosses the server's read buffer boundary */
+    memset(testBigMem, 0, sizeof(testBigMem));
+    memcpy(testBigMem + 100, pattern, sizeof(pattern));
+    memcpy(testBigMem + 4094, pattern, sizeof(pattern));
+    memcpy(testBigMem + 10001, pattern, sizeof(pattern));
+    memcpy(testBigMem + 20000, pattern, sizeof(pattern));
+
+    testPriv->numSent = 0;
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    CHECK_EQUAL(4, hitCount);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 100, hits[0]);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 4094, hits[1]);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 10001, hits[2]);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 20000, hits[3]);
+
+    /* matches end within the range */
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE + 101, 3995, CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(0, hitCount);
+
+    /* alignment */
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, sizeof(pattern), 4, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, hitCount);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 100, hits[0]);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 20000, hits[1]);
+
+    /* stops at maxHits */
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 2, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(2, hitCount);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 4094, hits[1]);
+
+    /* masked compare: 0xDx 0xxD */
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 maskPattern, mask, sizeof(maskPattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(4, hitCount);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 10001, hits[2]);
+
+    /* in a batch a single request is made */
+    cswp_batch_begin(&client, 0);
+    cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                           pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    res = cswp_batch_end(&client, &opsComplete);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, opsComplete);
+    CHECK_EQUAL(4, hitCount);
+
+    /* pattern size is checked by the client and the server */
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, 16, CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, 0, 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, 16, CSWP_ACCESS_SIZE_32, 0,
+                                 testBigMem, NULL, CSWP_MEM_SEARCH_MAX_PATTERN + 1, 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+    res = cswp_device_mem_search(&client, 0, 0, 8, CSWP_ACCESS_SIZE_DEF, CSWP_MEM_NO_ADDR_INC,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* read failures are reported */
+    res = cswp_device_mem_search(&client, 0, 8, 16, CSWP_ACCESS_SIZE_DEF, 0,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_BAD_ARGS, res);
+
+    /* more matches than fit in a response continue after the last */
+    memset(testBigMem, 0x5A, 8192);
+    many = malloc(8192 * sizeof(uint64_t));
+    testPriv->numSent = 0;
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 (const uint8_t*)"\x5A\x5A", NULL, 2, 0, many, 8192, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent > 1);
+    CHECK_EQUAL(8191, hitCount);
+    for (i = 0; i < hitCount; ++i)
+    {
+        if (many[i] != TEST_BIG_MEM_BASE + i)
+            break;
+    }
+    CHECK_EQUAL(hitCount, i);
+    free(many);
+
+    /* implementation search is used when provided */
+    testPriv->serverState->impl = &testSearchImpl;
+    testMemSearchCalls = 0;
+    res = cswp_device_mem_search(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0,
+                                 pattern, NULL, sizeof(pattern), 0, hits, 8, &hitCount);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testMemSearchCalls);
+    CHECK_EQUAL(2, hitCount);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 10001, hits[0]);
+    CHECK_EQUAL(TEST_BIG_MEM_BASE + 20000, hits[1]);
+
+    do_term(&client, &testClientTransport);
+}
+
+static void test_link_stats()
+{
+    cswp_client_t client;
+    cswp_test_client_priv_t* testPriv;
+    cswp_client_link_stats_t stats;
+    uint8_t* data;
+    unsigned regID = 1;
+    uint32_t value;
+    size_t bytesRead;
+    unsigned numSent;
+    unsigned i;
+    int res;
+
+    data = malloc(sizeof(testBigMem));
+    for (i = 0; i < sizeof(testBigMem); ++i)
+        testBigMem[i] = (uint8_t)(i * 7);
+
+    do_init_sized(&client, &testClientTransport, CSWP_MAX_MESSAGE_SIZE);
+    testPriv = (cswp_test_client_priv_t*)testClientTransport.priv;
+    do_setup_devices(&client);
+    do_open_device(&client, 0);
+
+    /* 2ms round trip at 5MB/s */
+    testPriv->delayUs = 2000;
+    testPriv->bytesPerMs = 5000;
+
+    /* small requests measure round trip time */
+    for (i = 0; i < 32; ++i)
+    {
+        res = cswp_device_reg_read(&client, 0, 1, &regID, &value, 1);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    res = cswp_client_get_link_stats(&client, &stats);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, stats.rttSamples >= 32);
+    CHECK_EQUAL(1, stats.rtt >= 1500 && stats.rtt < 1000000);
+    CHECK_EQUAL(0, stats.bandwidthSamples);
+    CHECK_EQUAL(0, stats.bandwidth);
+
+    /* large ones measure transfer rate, sent in one message until known */
+    testPriv->numSent = 0;
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, 65536, CSWP_ACCESS_SIZE_32, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent);
+    res = cswp_client_get_link_stats(&client, &stats);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, stats.bandwidthSamples);
+    CHECK_EQUAL(1, stats.bandwidth > 0 && stats.bandwidth < 20000000);
+
+    /* write-behind without a byte limit sends about a round trip's worth */
+    res = cswp_client_set_write_behind(&client, 100000, 0, 0);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    testPriv->numSent = 0;
+    for (i = 0; i < 2000; ++i)
+    {
+        res = cswp_device_mem_write(&client, 0, i % 4, 4, CSWP_ACCESS_SIZE_32, 0, data);
+        CHECK_EQUAL(CSWP_SUCCESS, res);
+    }
+    CHECK_EQUAL(1, testPriv->numSent > 0);
+    numSent = testPriv->numSent;
+    res = cswp_client_flush_writes(&client);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(1, testPriv->numSent <= numSent + 1);
+    cswp_client_set_write_behind(&client, 0, 0, 0);
+
+    /* and large transfers are split to keep each chunk short */
+    testPriv->numSent = 0;
+    memset(data, 0, sizeof(testBigMem));
+    res = cswp_device_mem_read(&client, 0, TEST_BIG_MEM_BASE, sizeof(testBigMem), CSWP_ACCESS_SIZE_32, 0, data, &bytesRead);
+    CHECK_EQUAL(CSWP_SUCCESS, res);
+    CHECK_EQUAL(sizeof(testBigMem), bytesRead);
+    CHECK_EQUAL(1, testPriv->numSent >= 3);
+    CHECK_EQUAL(0, memcmp(testBigMem, data, sizeof(testBigMem)));
+
+    testPriv->delayUs = 0;
+    testPriv->bytesPerMs = 0;
+    do_term(&client, &testClientTransport);
+
+    free(data);
+}
+
 
 void test_server()
 {
@@ -890,8 +2947,29 @@ void test_server()
     test_config();
     test_get_device_capabilities();
     test_reg_list();
+    test_reg_list_cache();
     test_reg_access();
+    test_reg_read_list();
     test_mem_access();
+    test_message_size();
 
     test_batch();
+    test_large_batch();
+    test_async_batch();
+    test_shared_session();
+#ifndef _WIN32
+    test_shared_session_threads(1);
+    test_shared_session_threads(0);
+#endif
+    test_template();
+    test_write_behind();
+    test_sendv();
+    test_receivev();
+    test_mem_chunked();
+    test_mem_fill();
+    test_mem_multi();
+    test_mem_checksum();
+    test_mem_read_delta();
+    test_mem_search();
+    test_link_stats();
 }
@@ -9,6 +9,8 @@
 
 #include <stdexcept>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #ifdef _WIN32
 #include "initguid.h"
@@ -19,6 +21,11 @@ namespace
 }
 #endif
 
+// Bulk transfers that don't end a message must be a multiple of the
+// endpoint's packet size, or the device sees the message end early.  1024
+// covers SuperSpeed and is a multiple of the high and full speed sizes.
+static const size_t USB_PACKET_ALIGN = 1024;
+
 class CSWPUSBClient
 {
 public:
@@ -29,11 +36,18 @@ public:
     void disconnect();
 
     int send(const void* data, size_t size);
+    int sendv(const cswp_client_iovec_t* iov, unsigned count);
     int receive(void* data, size_t size, size_t* used);
 
 private:
+    typedef std::vector<std::pair<int, size_t> > WriteList;
+    void submitWrite(const void* data, size_t size, WriteList& writes);
+
     std::string m_serialNumber;
 
+    // Copies of segment data between packet aligned transfers
+    std::vector<uint8_t> m_staging;
+
     std::auto_ptr<USBDevice> m_usb;
     int m_epCmd;
     int m_epRsp;
@@ -89,6 +103,20 @@ static int cswp_usb_send(cswp_client_t* client, cswp_client_transport_t* transpo
     }
 }
 
+static int cswp_usb_sendv(cswp_client_t* client, cswp_client_transport_t* transport, const cswp_client_iovec_t* iov, unsigned count)
+{
+    CSWPUSBClient* usbClient = reinterpret_cast<CSWPUSBClient*>(transport->priv);
+
+    try
+    {
+        return usbClient->sendv(iov, count);
+    }
+    catch (const std::exception& e)
+    {
+        return cswp_client_error(client, CSWP_COMMS, e.what());
+    }
+}
+
 static int cswp_usb_receive(cswp_client_t* client, cswp_client_transport_t* transport, void* data, size_t size, size_t* used)
 {
     CSWPUSBClient* usbClient = reinterpret_cast<CSWPUSBClient*>(transport->priv);
@@ -109,7 +137,14 @@ void cswp_client_usb_transport_init(cswp_client_transport_t* transport,
     transport->connect = cswp_usb_connect;
     transport->disconnect = cswp_usb_disconnect;
     transport->send = cswp_usb_send;
+    transport->sendv = cswp_usb_sendv;
     transport->receive = cswp_usb_receive;
+    // Read transfers must be whole packets, so a response can't be split
+    // at the start of the read data
+    transport->receivev = NULL;
+    // Transfers are completed through one queue, taken by whichever call is
+    // waiting, so sends must not overlap a receive
+    transport->duplex = 0;
 
     transport->priv = new CSWPUSBClient(serialNumber);
 }
@@ -191,6 +226,91 @@ int CSWPUSBClient::send(const void* data, size_t size)
     return CSWP_COMMS;
 }
 
+void CSWPUSBClient::submitWrite(const void* data, size_t size, WriteList& writes)
+{
+    writes.push_back(std::make_pair(m_usb->submitWriteTransfer(m_epCmd, data, size), size));
+}
+
+/*
+ * Send the segments as a sequence of write transfers
+ *
+ * Whole packets are sent directly from each segment.  The bytes either side
+ * of a segment boundary are staged so every transfer but the last is a
+ * whole number of packets, and only those bytes are copied.
+ */
+int CSWPUSBClient::sendv(const cswp_client_iovec_t* iov, unsigned count)
+{
+    WriteList writes;
+    size_t stageStart = 0;
+    size_t staged = 0;
+    bool failed = false;
+
+    // staging is not resized once transfers reference it
+    m_staging.resize((count + 1) * USB_PACKET_ALIGN);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(iov[i].data);
+        size_t left = iov[i].size;
+
+        // complete a partly staged packet
+        if (staged > 0)
+        {
+            size_t take = std::min(left, USB_PACKET_ALIGN - staged);
+            memcpy(&m_staging[stageStart + staged], p, take);
+            staged += take;
+            p += take;
+            left -= take;
+            if (staged == USB_PACKET_ALIGN)
+            {
+                submitWrite(&m_staging[stageStart], staged, writes);
+                stageStart += staged;
+                staged = 0;
+            }
+        }
+
+        // send whole packets from the caller's buffer and stage the rest
+        size_t direct = left - (left % USB_PACKET_ALIGN);
+        if (direct > 0)
+        {
+            submitWrite(p, direct, writes);
+            p += direct;
+            left -= direct;
+        }
+        if (left > 0)
+        {
+            memcpy(&m_staging[stageStart + staged], p, left);
+            staged += left;
+        }
+    }
+    if (staged > 0)
+        submitWrite(&m_staging[stageStart], staged, writes);
+
+    // wait for all transfers, as they reference the buffers
+    while (!writes.empty())
+    {
+        USBDevice::Transfer_Status status;
+        size_t used;
+        int token = m_usb->completeTransfer(&status, &used);
+
+        for (WriteList::iterator w = writes.begin(); w != writes.end(); ++w)
+        {
+            if (w->first == token)
+            {
+                if (status != USBDevice::Transfer_SUCCESS || used < w->second)
+                    failed = true;
+                writes.erase(w);
+                break;
+            }
+        }
+    }
+
+    if (failed)
+        throw std::runtime_error("Failed to send command");
+
+    return CSWP_SUCCESS;
+}
+
 int CSWPUSBClient::receive(void* data, size_t size, size_t* used)
 {
     // TODO: run on other thread for async responses
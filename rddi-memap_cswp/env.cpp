@@ -186,12 +186,14 @@ private:
     {
         std::string address;
         std::string type;
+        bool canFill;       //!< Server supports CSWP_MEM_FILL for this AP
     };
 
     APInfo& getAP(int apNumber);
 
     void doRead(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsigned flags, unsigned size, void* buf, bool incr);
     void doWrite(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsigned flags, unsigned size, const void* buf, bool incr);
+    void doFill(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsigned flags, unsigned size, uint64 pattern, bool incr);
 
     void log(const char* fmt, ...);
 
@@ -307,6 +309,7 @@ MemAPImpl::MemAPImpl(RddiLogger& logger,
             APInfo apInfo;
             apInfo.address = d->second.get<std::string>("<xmlattr>.address");
             apInfo.type = d->second.get<std::string>("<xmlattr>.type");
+            apInfo.canFill = false;
             m_aps.push_back(apInfo);
         }
 
@@ -418,6 +421,11 @@ void MemAPImpl::MEM_AP_Open(int apNumber)
     int res = cswp_device_open(&m_cswpClient, apNumber, NULL, 0);
     if (res != CSWP_SUCCESS)
         throw RddiEx(RDDI_FAILED, "Failed to open CSWP device");
+
+    // fills can be expanded on the target if the server supports it
+    unsigned capabilities, capabilityData;
+    res = cswp_get_device_capabilities(&m_cswpClient, apNumber, &capabilities, &capabilityData);
+    apInfo.canFill = (res == CSWP_SUCCESS && (capabilities & CSWP_CAP_MEM_FILL) != 0);
 }
 
 void MemAPImpl::MEM_AP_Close(int apNumber)
@@ -524,11 +532,33 @@ void MemAPImpl::doWrite(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsi
         throw RddiEx(RDDI_FAILED, "CSWP memory write failed");
 }
 
+void MemAPImpl::doFill(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsigned flags, unsigned size, uint64 pattern, bool incr)
+{
+    // one element of the pattern, in target byte order
+    uint8_t patternBytes[8];
+    size_t patternSize = accessSizeBytes(accSize);
+    for (size_t i = 0; i < patternSize; ++i)
+        patternBytes[i] = static_cast<uint8_t>(pattern >> (8 * i));
+
+    int res = cswp_device_mem_fill(&m_cswpClient, apNumber,
+                                   addr, size, mapAccessSize(accSize), mapFlags(flags, incr),
+                                   patternBytes, patternSize);
+    if (res != CSWP_SUCCESS)
+        throw RddiEx(RDDI_FAILED, "CSWP memory fill failed");
+}
+
 void MemAPImpl::MEM_AP_WriteValueRepeat(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize, unsigned flags, unsigned repeatCount, uint64 val)
 {
     if (!m_connected)
         throw RddiEx(RDDI_NOCONN, "MEM-AP interface not connected");
 
+    // let the target repeat the value rather than sending every copy
+    if (getAP(apNumber).canFill)
+    {
+        doFill(apNumber, addr, accSize, flags, accessSizeBytes(accSize) * repeatCount, val, false);
+        return;
+    }
+
     // generate buffer and write
     size_t bufSz;
     uint32 repVal;
@@ -570,6 +600,12 @@ void MemAPImpl::MEM_AP_Fill(int apNumber, uint64 addr, MEM_AP_ACC_SIZE accSize,
     if (!m_connected)
         throw RddiEx(RDDI_NOCONN, "MEM-AP interface not connected");
 
+    if (getAP(apNumber).canFill)
+    {
+        doFill(apNumber, addr, accSize, flags, accessSizeBytes(accSize) * repeatCount, pattern, true);
+        return;
+    }
+
     // generate buffer and write
     size_t bufSz;
     uint32 repVal;
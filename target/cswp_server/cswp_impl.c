@@ -4,7 +4,10 @@
 // License. See LICENSE.TXT for details.
 
 #include "cswp_server_types.h"
+#include "cswp_server_impl.h"
 #include "cswp_buffer.h"
+#include "cswp_checksum.h"
+#include "cswp_search.h"
 
 #include <dirent.h>
 #include <stdio.h>
@@ -19,15 +22,16 @@
 #include <sys/types.h>
 #include <sys/mman.h>
 #include <stdarg.h>
+#include <pthread.h>
 
 #define MAX_DEV_PATH 256
 
 static FILE* logFile;
 static int verbose;
 
-// SIGBUS handling
-volatile sig_atomic_t sigbusValid = 0;
-sigjmp_buf sigbusJmp;
+// SIGBUS handling, per thread as TCP sessions execute on their own threads
+__thread volatile sig_atomic_t sigbusValid = 0;
+__thread sigjmp_buf sigbusJmp;
 
 #define V_ERR 0
 #define V_INFO 1
@@ -40,13 +44,53 @@ sigjmp_buf sigbusJmp;
 #define CORESIGHT_CSW_OFFSET 0xD00
 #define CORESIGHT_TAR_OFFSET 0xD04
 #define CORESIGHT_DRW_OFFSET 0xD0C
+#define CORESIGHT_BD_OFFSET 0xD10
+#define CORESIGHT_MEMAP_REGS_SIZE 0x1000
+#define CORESIGHT_TAR_INC_BOUNDARY 0x400
 
 // Bit masks for cswp_server_device_priv_t->supportedAccessWidths
 #define WIDTH_8_MASK 1
 #define WIDTH_16_MASK 1 << 1
 #define WIDTH_32_MASK 1 << 2
+#define WIDTH_64_MASK 1 << 3
 #define WIDTHS_DETERMINED_MASK 1 << 7
 
+// /dev/mem mapping window cache
+#define MEM_WINDOW_MAX 32
+#define MEM_WINDOW_GRANULE (64 * 1024)
+#define MEM_MAP_BUDGET_DEFAULT (16 * 1024 * 1024)
+
+// Fill buffer for physical memory and MEM-APs
+#define MEM_FILL_CHUNK 4096
+
+// Read buffer for checksums of physical memory and MEM-APs
+#define MEM_CHECKSUM_CHUNK 4096
+
+// Read buffer for searches of physical memory and MEM-APs
+#define MEM_SEARCH_CHUNK 4096
+
+static size_t memMapBudget = MEM_MAP_BUDGET_DEFAULT;
+
+// Memory attribute map
+#define MEM_ATTR_MAX 64
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    // Normal memory can be copied with any access size
+    int normal;
+    // Allowed access sizes as WIDTH_*_MASK bits, 0 if any
+    uint8_t widths;
+} mem_attr_region_t;
+
+static mem_attr_region_t memAttrMap[MEM_ATTR_MAX];
+static unsigned memAttrCount;
+
+// Batched CoreSight register reads
+#define REG_POOL_THREADS 4
+#define REG_POOL_MIN_BATCH 8
+
 void setup_logging(int level, const char* filename)
 {
     verbose = level;
@@ -74,6 +118,11 @@ void vlog(int level, const char* msg, ...)
     }
 }
 
+void set_mem_map_budget(size_t bytes)
+{
+    memMapBudget = bytes;
+}
+
 void sigbus_handler(int signum)
 {
     if (sigbusValid)
@@ -89,6 +138,125 @@ void sigbus_handler(int signum)
     raise(signum);
 }
 
+/*
+ * Memory attribute map
+ *
+ * Loaded from a text file with one region per line:
+ *   <start> <size> normal|device [widths]
+ * where widths is an optional comma separated list of allowed access
+ * sizes in bits, e.g. 32,64.  Lines starting with # are ignored.
+ */
+static int mem_attr_compare(const void* a, const void* b)
+{
+    const mem_attr_region_t* ra = a;
+    const mem_attr_region_t* rb = b;
+
+    if (ra->start < rb->start)
+        return -1;
+    return (ra->start > rb->start) ? 1 : 0;
+}
+
+int load_mem_attr_map(const char* filename)
+{
+    char line[256];
+    char startStr[32], sizeStr[32], typeStr[16], widthStr[32];
+    FILE* f;
+    int fields;
+    char* w;
+
+    f = fopen(filename, "r");
+    if (f == NULL)
+    {
+        vlog(V_DEBUG, "No memory attribute map %s\n", filename);
+        return CSWP_FAILED;
+    }
+
+    memAttrCount = 0;
+    while (fgets(line, sizeof(line), f) && memAttrCount < MEM_ATTR_MAX)
+    {
+        mem_attr_region_t* region = &memAttrMap[memAttrCount];
+
+        if (line[0] == '#')
+            continue;
+        fields = sscanf(line, "%31s %31s %15s %31s", startStr, sizeStr, typeStr, widthStr);
+        if (fields < 3)
+            continue;
+
+        region->start = strtoull(startStr, NULL, 0);
+        region->end = region->start + strtoull(sizeStr, NULL, 0);
+        region->normal = (strcmp("normal", typeStr) == 0);
+        region->widths = 0;
+        if (fields == 4)
+        {
+            for (w = strtok(widthStr, ","); w != NULL; w = strtok(NULL, ","))
+            {
+                switch (atoi(w))
+                {
+                case 8:  region->widths |= WIDTH_8_MASK; break;
+                case 16: region->widths |= WIDTH_16_MASK; break;
+                case 32: region->widths |= WIDTH_32_MASK; break;
+                case 64: region->widths |= WIDTH_64_MASK; break;
+                }
+            }
+        }
+
+        vlog(V_DEBUG, "Memory region 0x%llx-0x%llx %s\n",
+             (unsigned long long)region->start, (unsigned long long)region->end,
+             region->normal ? "normal" : "device");
+        if (region->end > region->start)
+            ++memAttrCount;
+    }
+    fclose(f);
+
+    qsort(memAttrMap, memAttrCount, sizeof(memAttrMap[0]), mem_attr_compare);
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Find the region containing an address
+ *
+ * Returns NULL if the address is not in the map.  segEnd receives the end
+ * of the region, or the start of the next region if not in the map.
+ */
+static const mem_attr_region_t* mem_attr_find(uint64_t address, uint64_t* segEnd)
+{
+    unsigned lo = 0, hi = memAttrCount;
+
+    /* Find first region starting after address */
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+        if (memAttrMap[mid].start <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo > 0 && address < memAttrMap[lo-1].end)
+    {
+        *segEnd = memAttrMap[lo-1].end;
+        if (lo < memAttrCount && memAttrMap[lo].start < *segEnd)
+            *segEnd = memAttrMap[lo].start;
+        return &memAttrMap[lo-1];
+    }
+
+    *segEnd = (lo < memAttrCount) ? memAttrMap[lo].start : UINT64_MAX;
+    return NULL;
+}
+
+static uint8_t mem_attr_width(cswp_access_size_t accessSize)
+{
+    switch (accessSize)
+    {
+    case CSWP_ACCESS_SIZE_8:  return WIDTH_8_MASK;
+    case CSWP_ACCESS_SIZE_16: return WIDTH_16_MASK;
+    case CSWP_ACCESS_SIZE_32: return WIDTH_32_MASK;
+    case CSWP_ACCESS_SIZE_64: return WIDTH_64_MASK;
+    default:                  return 0;
+    }
+}
+
 typedef struct
 {
     char* path;
@@ -100,8 +268,170 @@ typedef struct
     // [2] - word access supported
     // [7] - supported access widths determined
     uint8_t supportedAccessWidths;
+
+    // MEM-AP register page, mapped when BASE_ADDRESS is set
+    uint8_t* regMap;
+    size_t regMapSize;
+    volatile uint8_t* regs;
+
+    // Arbitration for the MEM-AP shared with other sessions
+    struct _device_arb_t* arb;
+
+    // Last values written to CSW and TAR
+    uint32_t cswShadow;
+    uint32_t tarShadow;
+    int cswValid;
+    int tarValid;
+
+    // Register attribute files, indexed by register ID
+    int* regFds;
+    unsigned regFdCount;
+
+    // Memory access backend, NULL if device has no memory access
+    const struct _mem_backend_t* memBackend;
+    // Window onto physical memory for windowed devices
+    uint64_t memBase;
+    uint64_t memLimit;
 } cswp_server_device_priv_t;
 
+/*
+ * Hardware device shared by all sessions that use it
+ *
+ * Sessions keep their own device state, so a device is locked for each
+ * access and a session's cached register values are dropped whenever
+ * another session used the device since its last access
+ */
+typedef struct _device_arb_t
+{
+    uint64_t address;
+    unsigned refCount;
+    pthread_mutex_t lock;
+    const cswp_server_device_priv_t* owner;
+    struct _device_arb_t* next;
+} device_arb_t;
+
+static device_arb_t* deviceArbList;
+static pthread_mutex_t deviceArbListLock = PTHREAD_MUTEX_INITIALIZER;
+
+static void device_arb_attach(cswp_server_device_priv_t* devPriv, uint64_t address)
+{
+    device_arb_t* arb;
+
+    pthread_mutex_lock(&deviceArbListLock);
+    for (arb = deviceArbList; arb != NULL; arb = arb->next)
+    {
+        if (arb->address == address)
+            break;
+    }
+    if (arb == NULL)
+    {
+        arb = calloc(1, sizeof(device_arb_t));
+        if (arb != NULL)
+        {
+            arb->address = address;
+            pthread_mutex_init(&arb->lock, NULL);
+            arb->next = deviceArbList;
+            deviceArbList = arb;
+        }
+    }
+    if (arb != NULL)
+        arb->refCount++;
+    devPriv->arb = arb;
+    pthread_mutex_unlock(&deviceArbListLock);
+}
+
+static void device_arb_detach(cswp_server_device_priv_t* devPriv)
+{
+    device_arb_t* arb = devPriv->arb;
+    device_arb_t** pArb;
+
+    if (arb == NULL)
+        return;
+
+    pthread_mutex_lock(&deviceArbListLock);
+    if (arb->owner == devPriv)
+        arb->owner = NULL;
+    if (--arb->refCount == 0)
+    {
+        for (pArb = &deviceArbList; *pArb != NULL; pArb = &(*pArb)->next)
+        {
+            if (*pArb == arb)
+            {
+                *pArb = arb->next;
+                break;
+            }
+        }
+        pthread_mutex_destroy(&arb->lock);
+        free(arb);
+    }
+    devPriv->arb = NULL;
+    pthread_mutex_unlock(&deviceArbListLock);
+}
+
+static void device_arb_acquire(cswp_server_device_priv_t* devPriv)
+{
+    device_arb_t* arb = devPriv->arb;
+
+    if (arb == NULL)
+        return;
+
+    pthread_mutex_lock(&arb->lock);
+    if (arb->owner != devPriv)
+    {
+        devPriv->cswValid = 0;
+        devPriv->tarValid = 0;
+        arb->owner = devPriv;
+    }
+}
+
+static void device_arb_release(cswp_server_device_priv_t* devPriv)
+{
+    if (devPriv->arb != NULL)
+        pthread_mutex_unlock(&devPriv->arb->lock);
+}
+
+/*
+ * Cached mapping of a page aligned physical address range
+ */
+typedef struct
+{
+    off_t base;
+    size_t length;
+    uint8_t* addr;
+    unsigned lastUse;
+} mem_window_t;
+
+/*
+ * Batch of register reads shared with the worker pool
+ */
+typedef struct
+{
+    cswp_device_info_t* devInfo;
+    cswp_server_device_priv_t* devPriv;
+    const unsigned* registerIDs;
+    uint32_t* values;
+    unsigned count;
+    unsigned next;
+    unsigned done;
+    unsigned failedIndex;
+    int res;
+} reg_read_job_t;
+
+/*
+ * Worker threads for batched register reads, started on first use
+ */
+typedef struct
+{
+    pthread_t threads[REG_POOL_THREADS];
+    unsigned threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    reg_read_job_t* job;
+    int started;
+    int stop;
+} reg_pool_t;
+
 /*
  * Private data for server 
  */
@@ -110,8 +440,297 @@ typedef struct
     cswp_server_device_priv_t* devicePriv;
     uint8_t* lastPollData;
     uint32_t lastPollDataSize;
+
+    // /dev/mem is held open for the session
+    int memFd;
+    int memFdWritable;
+
+    // Mapped windows, least recently used is evicted first
+    mem_window_t memWindows[MEM_WINDOW_MAX];
+    unsigned memWindowCount;
+    size_t memMappedBytes;
+    unsigned memUseCounter;
+
+    reg_pool_t regPool;
 } cswp_server_priv_t;
 
+/*
+ * Memory access backend for a device
+ */
+typedef struct _mem_backend_t
+{
+    const char* name;
+    int (*read)(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                uint64_t address, size_t size,
+                cswp_access_size_t accessSize, unsigned flags, uint8_t* pData);
+    int (*write)(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                 uint64_t address, size_t size,
+                 cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData);
+    // NULL to write the pattern through write a buffer at a time
+    int (*fill)(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                uint64_t address, size_t size,
+                cswp_access_size_t accessSize, unsigned flags,
+                const uint8_t* pPattern, size_t patternSize);
+    // NULL to read through read a buffer at a time
+    int (*checksum)(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                    uint64_t address, size_t size,
+                    cswp_access_size_t accessSize, unsigned flags,
+                    cswp_checksum_t algorithm, uint64_t* pDigest);
+    int (*search)(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                  uint64_t address, size_t size,
+                  cswp_access_size_t accessSize, unsigned flags,
+                  const cswp_search_t* search,
+                  uint64_t* pHits, size_t maxHits, size_t* pHitCount);
+    // Check a range lies within the device before it is accessed in parts,
+    // NULL if every address is allowed
+    int (*check)(cswp_server_device_priv_t* devPriv, uint64_t address, size_t size);
+} mem_backend_t;
+
+/*
+ * Get the session /dev/mem file descriptor, opening on first use
+ */
+static int mem_fd(cswp_server_priv_t* priv)
+{
+    if (priv->memFd < 0)
+    {
+        priv->memFd = open("/dev/mem", O_RDWR);
+        priv->memFdWritable = 1;
+        if (priv->memFd < 0)
+        {
+            priv->memFd = open("/dev/mem", O_RDONLY);
+            priv->memFdWritable = 0;
+        }
+        if (priv->memFd < 0)
+            perror("Open mem failed: ");
+    }
+
+    return priv->memFd;
+}
+
+static void mem_window_unmap(cswp_server_priv_t* priv, unsigned w)
+{
+    mem_window_t* win = &priv->memWindows[w];
+
+    vlog(V_TRACE, "Unmap window 0x%llx ..+0x%zx\n", (unsigned long long)win->base, win->length);
+    munmap(win->addr, win->length);
+    priv->memMappedBytes -= win->length;
+    priv->memWindows[w] = priv->memWindows[--priv->memWindowCount];
+}
+
+/*
+ * Release all mapped windows and the /dev/mem file descriptor
+ */
+static void mem_windows_release(cswp_server_priv_t* priv)
+{
+    while (priv->memWindowCount > 0)
+        mem_window_unmap(priv, 0);
+
+    if (priv->memFd >= 0)
+        close(priv->memFd);
+    priv->memFd = -1;
+}
+
+/*
+ * Get a pointer to a physical address range through the window cache
+ *
+ * Windows are mapped on granule boundaries so that neighbouring accesses
+ * hit the same window.  Least recently used windows are unmapped to keep
+ * the total mapped size within the budget.
+ */
+static int mem_window_get(cswp_server_priv_t* priv, uint64_t address, size_t size, int write, uint8_t** ptr)
+{
+    size_t pageSize = sysconf(_SC_PAGE_SIZE);
+    off_t pageAddr = address & ~(pageSize - 1);
+    size_t length;
+    off_t winBase;
+    size_t winLength;
+    uint8_t* addr;
+    unsigned w;
+
+    if (size == 0)
+        size = 1;
+    length = ((address + size - pageAddr + pageSize - 1) / pageSize) * pageSize;
+
+    if (mem_fd(priv) < 0)
+        return CSWP_MEM_FAILED;
+    if (write && !priv->memFdWritable)
+        return CSWP_MEM_FAILED;
+
+    /* Look for a window covering the range */
+    for (w = 0; w < priv->memWindowCount; ++w)
+    {
+        mem_window_t* win = &priv->memWindows[w];
+        if (pageAddr >= win->base &&
+            pageAddr + length <= win->base + win->length)
+        {
+            win->lastUse = ++priv->memUseCounter;
+            *ptr = win->addr + (address - win->base);
+            return CSWP_SUCCESS;
+        }
+    }
+
+    /* Map a new window, evicting least recently used ones to stay in budget */
+    winBase = pageAddr & ~((off_t)MEM_WINDOW_GRANULE - 1);
+    winLength = ((pageAddr + length - winBase + MEM_WINDOW_GRANULE - 1) / MEM_WINDOW_GRANULE) * MEM_WINDOW_GRANULE;
+
+    while (priv->memWindowCount > 0 &&
+           (priv->memWindowCount == MEM_WINDOW_MAX ||
+            priv->memMappedBytes + winLength > memMapBudget))
+    {
+        unsigned lru = 0;
+        for (w = 1; w < priv->memWindowCount; ++w)
+            if (priv->memWindows[w].lastUse < priv->memWindows[lru].lastUse)
+                lru = w;
+        mem_window_unmap(priv, lru);
+    }
+
+    addr = mmap(NULL, winLength, PROT_READ | (priv->memFdWritable ? PROT_WRITE : 0),
+                MAP_SHARED, priv->memFd, winBase);
+    if (addr == MAP_FAILED)
+    {
+        /* Granule may cover a disallowed range, so fall back to the exact pages */
+        winBase = pageAddr;
+        winLength = length;
+        addr = mmap(NULL, winLength, PROT_READ | (priv->memFdWritable ? PROT_WRITE : 0),
+                    MAP_SHARED, priv->memFd, winBase);
+    }
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap failed: ");
+        return CSWP_MEM_FAILED;
+    }
+
+    vlog(V_TRACE, "Map window 0x%llx ..+0x%zx\n", (unsigned long long)winBase, winLength);
+
+    w = priv->memWindowCount++;
+    priv->memWindows[w].base = winBase;
+    priv->memWindows[w].length = winLength;
+    priv->memWindows[w].addr = addr;
+    priv->memWindows[w].lastUse = ++priv->memUseCounter;
+    priv->memMappedBytes += winLength;
+
+    *ptr = addr + (address - winBase);
+    return CSWP_SUCCESS;
+}
+
+/*
+ * MEM-AP registers are accessed through the register page mapped when the
+ * device base address is set
+ */
+#define MEMAP_REG(devPriv, offset) (*(volatile uint32_t*)((devPriv)->regs + (offset)))
+
+static void memap_unmap_regs(cswp_server_device_priv_t* devPriv)
+{
+    if (devPriv->regMap)
+        munmap(devPriv->regMap, devPriv->regMapSize);
+    device_arb_detach(devPriv);
+    devPriv->regMap = NULL;
+    devPriv->regMapSize = 0;
+    devPriv->regs = NULL;
+    devPriv->cswValid = 0;
+    devPriv->tarValid = 0;
+}
+
+static int memap_map_regs(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv)
+{
+    size_t pageSize = sysconf(_SC_PAGE_SIZE);
+    off_t pageAddr = devPriv->address & ~(pageSize - 1);
+    size_t length = ((devPriv->address + CORESIGHT_MEMAP_REGS_SIZE - pageAddr + pageSize - 1) / pageSize) * pageSize;
+    uint8_t* addr;
+
+    memap_unmap_regs(devPriv);
+
+    if (mem_fd(priv) < 0 || !priv->memFdWritable)
+        return CSWP_MEM_FAILED;
+
+    addr = mmap(NULL, length, PROT_READ|PROT_WRITE,
+                MAP_SHARED, priv->memFd, pageAddr);
+    if (addr == MAP_FAILED)
+    {
+        perror("mmap failed: ");
+        return CSWP_MEM_FAILED;
+    }
+
+    vlog(V_DEBUG, "Mapped MEM-AP registers at 0x%08x\n", devPriv->address);
+
+    devPriv->regMap = addr;
+    devPriv->regMapSize = length;
+    devPriv->regs = addr + (devPriv->address - pageAddr);
+    device_arb_attach(devPriv, devPriv->address);
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Ensure the register page is mapped, e.g. if BASE_ADDRESS was never set
+ */
+static int memap_get_regs(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv)
+{
+    if (devPriv->regs == NULL)
+        return memap_map_regs(priv, devPriv);
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Write CSW unless the last value written is already there
+ */
+static void memap_set_csw(cswp_server_device_priv_t* devPriv, uint32_t cswVal)
+{
+    if (!devPriv->cswValid || devPriv->cswShadow != cswVal)
+    {
+        MEMAP_REG(devPriv, CORESIGHT_CSW_OFFSET) = cswVal;
+        devPriv->cswShadow = cswVal;
+        devPriv->cswValid = 1;
+    }
+}
+
+/*
+ * Write TAR unless it already holds the address
+ */
+static void memap_set_tar(cswp_server_device_priv_t* devPriv, uint32_t tarVal)
+{
+    if (!devPriv->tarValid || devPriv->tarShadow != tarVal)
+    {
+        MEMAP_REG(devPriv, CORESIGHT_TAR_OFFSET) = tarVal;
+        devPriv->tarShadow = tarVal;
+        devPriv->tarValid = 1;
+    }
+}
+
+/*
+ * Track TAR after an auto-incrementing transfer
+ *
+ * The increment is only architecturally defined within the increment
+ * boundary, so the shadow is dropped if the transfer reaches it
+ */
+static void memap_advance_tar(cswp_server_device_priv_t* devPriv, uint32_t address, size_t size)
+{
+    uint32_t end = address + size;
+
+    if ((end & ~(CORESIGHT_TAR_INC_BOUNDARY - 1)) == (address & ~(CORESIGHT_TAR_INC_BOUNDARY - 1)))
+        devPriv->tarShadow = end;
+    else
+        devPriv->tarValid = 0;
+}
+
+/*
+ * Close the cached register attribute file descriptors for a device
+ */
+static void cs_reg_fds_close(cswp_server_device_priv_t* devPriv)
+{
+    unsigned r;
+
+    for (r = 0; r < devPriv->regFdCount; ++r)
+    {
+        if (devPriv->regFds[r] >= 0)
+            close(devPriv->regFds[r]);
+    }
+    free(devPriv->regFds);
+    devPriv->regFds = NULL;
+    devPriv->regFdCount = 0;
+}
+
 /*
  * Server logging function
  */
@@ -194,6 +813,8 @@ static int is_mem_ap_type(const char* type)
 
 static int cswp_server_impl_clear_devices(cswp_server_state_t* state);
 static int cswp_server_impl_init_devices(cswp_server_state_t* state, unsigned int deviceCount);
+static void reg_pool_stop(reg_pool_t* pool);
+static const mem_backend_t* mem_backend_for_type(const char* deviceType, const cswp_server_device_priv_t* devPriv);
 
 static int cswp_server_impl_load_sdf(char* sdfPath, char** data, uint32_t* sdfSize)
 {
@@ -279,6 +900,7 @@ static int cswp_server_impl_init(cswp_server_state_t* state)
     }
 
     priv = (cswp_server_priv_t*)calloc(1, sizeof(cswp_server_priv_t));
+    priv->memFd = -1;
     state->priv = priv;
     cswp_server_impl_init_devices(state, numDevices);
 
@@ -287,6 +909,7 @@ static int cswp_server_impl_init(cswp_server_state_t* state)
     state->deviceTypes[0] = strdup("memory");
     priv->devicePriv[0].path = strdup("/dev/mem");
     priv->devicePriv[0].address = 0;
+    priv->devicePriv[0].memBackend = mem_backend_for_type("memory", &priv->devicePriv[0]);
     /* Other devices use name from CoreSight driver */
     for (i = 0; i < numEntries; ++i)
     {
@@ -322,6 +945,11 @@ static int cswp_server_impl_term(cswp_server_state_t* state)
     cswp_server_impl_clear_devices(state);
 
     priv = (cswp_server_priv_t*)state->priv;
+    if (priv)
+    {
+        reg_pool_stop(&priv->regPool);
+        mem_windows_release(priv);
+    }
     if (priv && priv->lastPollData)
         free(priv->lastPollData);
     free(priv);
@@ -347,7 +975,11 @@ static int cswp_server_impl_clear_devices(cswp_server_state_t* state)
     if (priv != NULL)
     {
         for (i = 0; i < state->deviceCount; ++i)
+        {
+            memap_unmap_regs(&priv->devicePriv[i]);
+            cs_reg_fds_close(&priv->devicePriv[i]);
             free(priv->devicePriv[i].path);
+        }
         free(priv->devicePriv);
     }
 
@@ -362,6 +994,13 @@ static int cswp_server_impl_device_add(cswp_server_state_t* state, unsigned devi
     priv->devicePriv[deviceIndex].regsDiscovered = 0;
     priv->devicePriv[deviceIndex].supportedAccessWidths = 0;
     priv->devicePriv[deviceIndex].address = 0;
+    memap_unmap_regs(&priv->devicePriv[deviceIndex]);
+    cs_reg_fds_close(&priv->devicePriv[deviceIndex]);
+    priv->devicePriv[deviceIndex].memBase = 0;
+    priv->devicePriv[deviceIndex].memLimit = 0;
+    priv->devicePriv[deviceIndex].memBackend = mem_backend_for_type(deviceType, &priv->devicePriv[deviceIndex]);
+    if (priv->devicePriv[deviceIndex].memBackend)
+        vlog(V_DEBUG, "Device %d uses %s memory access\n", deviceIndex, priv->devicePriv[deviceIndex].memBackend->name);
 
     free(priv->devicePriv[deviceIndex].path);
     if (is_mem_ap_type(deviceType) ||
@@ -377,28 +1016,278 @@ static int cswp_server_impl_device_add(cswp_server_state_t* state, unsigned devi
 }
 
 /*
- * Handler for CoreSight device open
+ * Open the register attribute files for a device
+ *
+ * Attributes are opened read/write where the driver allows it, otherwise
+ * read or write only.  Any that can't be opened are left as -1 and opened
+ * on each access instead.
  */
-static int cswp_server_impl_cs_device_build_regs(cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv)
+static void cs_reg_fds_open(cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv)
 {
-    char subPath[256];
-    int numSubdirs, numEntries;
-    struct dirent **entries;
+    char regPath[MAX_DEV_PATH * 2];
+    unsigned r;
+    int fd;
 
-    /* Registers in a directory or sub-directory */
-    struct {
-        char* dirName;
-        char** regNames;
-        size_t numRegs;
-    } *subdirRegs;
+    cs_reg_fds_close(devPriv);
 
-    unsigned totalRegs;
-    int i, r, dr;
+    devPriv->regFds = malloc(devInfo->registerCount * sizeof(int));
+    if (devPriv->regFds == NULL)
+        return;
+    devPriv->regFdCount = devInfo->registerCount;
 
-    if (devPriv->path == NULL)
+    for (r = 0; r < devPriv->regFdCount; ++r)
     {
-        return CSWP_NOT_INITIALIZED;
-    }
+        snprintf(regPath, sizeof(regPath), "%s/%s",
+                 devPriv->path,
+                 devInfo->registerInfo[r].name);
+
+        fd = open(regPath, O_RDWR);
+        if (fd < 0)
+            fd = open(regPath, O_RDONLY);
+        if (fd < 0)
+            fd = open(regPath, O_WRONLY);
+        devPriv->regFds[r] = fd;
+    }
+}
+
+/*
+ * Read a register attribute of a CoreSight device
+ */
+static int cs_reg_read(cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv,
+                       unsigned registerID, uint32_t* value)
+{
+    char rdBuf[64];
+    int readRes;
+
+    if (registerID < devPriv->regFdCount && devPriv->regFds[registerID] >= 0)
+    {
+        /* Reading from the start re-reads the attribute */
+        readRes = pread(devPriv->regFds[registerID], rdBuf, sizeof(rdBuf)-1, 0);
+    }
+    else
+    {
+        /* register IDs are allocated sequentially, so can access directly */
+        cswp_register_info_t* regInfo = &devInfo->registerInfo[registerID];
+        char regPath[MAX_DEV_PATH * 2];
+        int fd;
+
+        /* Read from file in CoreSight device */
+        snprintf(regPath, sizeof(regPath), "%s/%s",
+                 devPriv->path,
+                 regInfo->name);
+
+        vlog(V_DEBUG, "Reading from %s\n", regPath);
+
+        fd = open(regPath, O_RDONLY);
+        if (fd < 0)
+            return CSWP_REG_FAILED;
+
+        readRes = read(fd, rdBuf, sizeof(rdBuf)-1);
+        close(fd);
+    }
+    if (readRes < 0)
+        return CSWP_REG_FAILED;
+    rdBuf[readRes] = '\0';
+
+    /* Convert from hex - almost all props use
+     * kstrtoul(16) apart from enable_xxx, but this is just testing for non-zero */
+    errno = 0;
+    *value = strtoul(rdBuf, NULL, 16);
+    if (errno != 0)
+        return CSWP_REG_FAILED;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Write a register attribute of a CoreSight device
+ */
+static int cs_reg_write(cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv,
+                        unsigned registerID, uint32_t value)
+{
+    char wrBuf[64];
+    int writeRes;
+
+    /* Convert to hex - almost all props use
+     * kstrtoul(16) apart from enable_xxx, but this is just testing for non-zero */
+    snprintf(wrBuf, sizeof(wrBuf), "%X", value);
+
+    if (registerID < devPriv->regFdCount && devPriv->regFds[registerID] >= 0)
+    {
+        writeRes = pwrite(devPriv->regFds[registerID], wrBuf, strlen(wrBuf), 0);
+    }
+    else
+    {
+        /* register IDs are allocated sequentially, so can access directly */
+        cswp_register_info_t* regInfo = &devInfo->registerInfo[registerID];
+        char regPath[MAX_DEV_PATH * 2];
+        int fd;
+
+        /* Write to file in CoreSight device */
+        snprintf(regPath, sizeof(regPath), "%s/%s",
+                 devPriv->path,
+                 regInfo->name);
+
+        vlog(V_DEBUG, "Writing %s to %s\n", wrBuf, regPath);
+
+        fd = open(regPath, O_WRONLY);
+        if (fd < 0)
+            return CSWP_REG_FAILED;
+
+        writeRes = write(fd, wrBuf, strlen(wrBuf));
+        close(fd);
+    }
+    if (writeRes < 0)
+        return CSWP_REG_FAILED;
+
+    return CSWP_SUCCESS;
+}
+
+/*
+ * Run register reads from a batch until none are left
+ *
+ * Called with the pool lock held, which is dropped around each read
+ */
+static void reg_pool_run(reg_pool_t* pool)
+{
+    reg_read_job_t* job = pool->job;
+    unsigned r;
+    int res;
+
+    while (job->next < job->count)
+    {
+        r = job->next++;
+        pthread_mutex_unlock(&pool->lock);
+
+        res = cs_reg_read(job->devInfo, job->devPriv, job->registerIDs[r], &job->values[r]);
+
+        pthread_mutex_lock(&pool->lock);
+        if (res != CSWP_SUCCESS && r < job->failedIndex)
+        {
+            job->failedIndex = r;
+            job->res = res;
+        }
+        if (++job->done == job->count)
+            pthread_cond_signal(&pool->done);
+    }
+}
+
+static void* reg_pool_worker(void* arg)
+{
+    reg_pool_t* pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stop)
+    {
+        if (pool->job && pool->job->next < pool->job->count)
+            reg_pool_run(pool);
+        else
+            pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void reg_pool_start(reg_pool_t* pool)
+{
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pool->job = NULL;
+    pool->stop = 0;
+
+    for (pool->threadCount = 0; pool->threadCount < REG_POOL_THREADS; ++pool->threadCount)
+    {
+        if (pthread_create(&pool->threads[pool->threadCount], NULL, reg_pool_worker, pool) != 0)
+            break;
+    }
+    pool->started = 1;
+}
+
+static void reg_pool_stop(reg_pool_t* pool)
+{
+    unsigned t;
+
+    if (!pool->started)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (t = 0; t < pool->threadCount; ++t)
+        pthread_join(pool->threads[t], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    pool->started = 0;
+}
+
+/*
+ * Read a batch of CoreSight device registers on the worker pool
+ *
+ * The calling thread takes part, so the batch completes even if no
+ * workers could be started
+ */
+static int reg_pool_read(cswp_server_priv_t* priv, cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv,
+                         unsigned count, const unsigned* registerIDs, uint32_t* values, unsigned* failedIndex)
+{
+    reg_pool_t* pool = &priv->regPool;
+    reg_read_job_t job;
+
+    if (!pool->started)
+        reg_pool_start(pool);
+
+    job.devInfo = devInfo;
+    job.devPriv = devPriv;
+    job.registerIDs = registerIDs;
+    job.values = values;
+    job.count = count;
+    job.next = 0;
+    job.done = 0;
+    job.failedIndex = count;
+    job.res = CSWP_SUCCESS;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->job = &job;
+    pthread_cond_broadcast(&pool->work);
+    reg_pool_run(pool);
+    while (job.done < job.count)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pool->job = NULL;
+    pthread_mutex_unlock(&pool->lock);
+
+    *failedIndex = job.failedIndex;
+    return job.res;
+}
+
+
+/*
+ * Handler for CoreSight device open
+ */
+static int cswp_server_impl_cs_device_build_regs(cswp_device_info_t* devInfo, cswp_server_device_priv_t* devPriv)
+{
+    char subPath[256];
+    int numSubdirs, numEntries;
+    struct dirent **entries;
+
+    /* Registers in a directory or sub-directory */
+    struct {
+        char* dirName;
+        char** regNames;
+        size_t numRegs;
+    } *subdirRegs;
+
+    unsigned totalRegs;
+    int i, r, dr;
+
+    if (devPriv->path == NULL)
+    {
+        return CSWP_NOT_INITIALIZED;
+    }
     vlog(V_DEBUG, "Scanning %s\n", devPriv->path);
 
     /* Build list of top level and child directories */
@@ -473,6 +1362,9 @@ static int cswp_server_impl_cs_device_build_regs(cswp_device_info_t* devInfo, cs
 
     vlog(V_DEBUG, "Found %d registers in %s\n", totalRegs, devPriv->path);
 
+    /* Hold the register attributes open while the device is open */
+    cs_reg_fds_open(devInfo, devPriv);
+
     return CSWP_SUCCESS;
 }
 
@@ -512,6 +1404,18 @@ static int cswp_server_impl_device_open(cswp_server_state_t* state, unsigned dev
 
     cswp_server_priv_t *priv = state->priv;
     priv->devicePriv[deviceIndex].regsDiscovered = 0;
+    cs_reg_fds_close(&priv->devicePriv[deviceIndex]);
+
+    return CSWP_SUCCESS;
+}
+
+
+static int cswp_server_impl_device_close(cswp_server_state_t* state, unsigned deviceIndex)
+{
+    cswp_server_priv_t *priv = state->priv;
+
+    /* Release register attribute files until the device is opened again */
+    cs_reg_fds_close(&priv->devicePriv[deviceIndex]);
 
     return CSWP_SUCCESS;
 }
@@ -538,6 +1442,7 @@ static int cswp_server_impl_set_config(struct _cswp_server_state_t* state, unsig
                     free(devPriv->path);
                     devPriv->path = strdup(value);
                     devPriv->regsDiscovered = 0;
+                    cs_reg_fds_close(devPriv);
                 }
             }
         }
@@ -551,12 +1456,25 @@ static int cswp_server_impl_set_config(struct _cswp_server_state_t* state, unsig
         if (strcmp("BASE_ADDRESS", name) == 0)
         {
             devPriv->address = strtol(value, NULL, 16);
+            res = memap_map_regs((cswp_server_priv_t*)state->priv, devPriv);
         }
         else
         {
             res = CSWP_BAD_ARGS;
         }
     }
+    else if (strcmp("memory", state->deviceTypes[deviceIndex]) == 0)
+    {
+        /* Setting a limit makes the device a window onto physical memory */
+        if (strcmp("BASE_ADDRESS", name) == 0)
+            devPriv->memBase = strtoull(value, NULL, 16);
+        else if (strcmp("LIMIT", name) == 0)
+            devPriv->memLimit = strtoull(value, NULL, 16);
+        else
+            res = CSWP_BAD_ARGS;
+
+        devPriv->memBackend = mem_backend_for_type(state->deviceTypes[deviceIndex], devPriv);
+    }
 
     return res;
 }
@@ -586,6 +1504,20 @@ static int cswp_server_impl_get_config(struct _cswp_server_state_t* state, unsig
         sprintf(address, "0x%08x", devPriv->address);
         res = cswp_server_fill_config(value, address, valueSize);
     }
+    else if (strcmp("BASE_ADDRESS", name) == 0 && is_mem_ap_type(state->deviceTypes[deviceIndex]))
+    {
+        char address[16];
+        sprintf(address, "0x%08x", devPriv->address);
+        res = cswp_server_fill_config(value, address, valueSize);
+    }
+    else if ((strcmp("BASE_ADDRESS", name) == 0 || strcmp("LIMIT", name) == 0) &&
+             strcmp("memory", state->deviceTypes[deviceIndex]) == 0)
+    {
+        char address[24];
+        sprintf(address, "0x%llx",
+                (unsigned long long)(strcmp("LIMIT", name) == 0 ? devPriv->memLimit : devPriv->memBase));
+        res = cswp_server_fill_config(value, address, valueSize);
+    }
     else
         /* Only "path" config item supported */
         res = CSWP_BAD_ARGS;
@@ -597,11 +1529,11 @@ static int cswp_server_impl_get_device_capabilities(struct _cswp_server_state_t*
 {
     *capabilitiesData = 0;
     if (strcmp("mem-ap.v2", state->deviceTypes[deviceIndex]) == 0)
-      *capabilities = CSWP_CAP_REG | CSWP_CAP_MEM | CSWP_CAP_MEM_POLL;
+      *capabilities = CSWP_CAP_REG | CSWP_CAP_MEM | CSWP_CAP_MEM_POLL | CSWP_CAP_MEM_FILL | CSWP_CAP_MEM_MULTI | CSWP_CAP_MEM_CHECKSUM | CSWP_CAP_MEM_DELTA | CSWP_CAP_MEM_SEARCH;
     else if (strcmp("mem-ap.v1", state->deviceTypes[deviceIndex]) == 0)
-      *capabilities = CSWP_CAP_REG | CSWP_CAP_MEM | CSWP_CAP_MEM_POLL;
+      *capabilities = CSWP_CAP_REG | CSWP_CAP_MEM | CSWP_CAP_MEM_POLL | CSWP_CAP_MEM_FILL | CSWP_CAP_MEM_MULTI | CSWP_CAP_MEM_CHECKSUM | CSWP_CAP_MEM_DELTA | CSWP_CAP_MEM_SEARCH;
     else if (strcmp("memory", state->deviceTypes[deviceIndex]) == 0)
-      *capabilities = CSWP_CAP_MEM | CSWP_CAP_MEM_POLL;
+      *capabilities = CSWP_CAP_MEM | CSWP_CAP_MEM_POLL | CSWP_CAP_MEM_FILL | CSWP_CAP_MEM_MULTI | CSWP_CAP_MEM_CHECKSUM | CSWP_CAP_MEM_DELTA | CSWP_CAP_MEM_SEARCH;
     else if (strcmp("dap.v6", state->deviceTypes[deviceIndex]) == 0)
       *capabilities = CSWP_CAP_REG;
     else if (strcmp("dap.v5", state->deviceTypes[deviceIndex]) == 0)
@@ -706,147 +1638,90 @@ static int copy(void* dest, const void* src, size_t size, cswp_access_size_t acc
     return res;
 }
 
-static int do_32bit_read(int fd, uint64_t address, uint32_t* value)
+/*
+ * Copy normal memory to or from a /dev/mem mapping at address
+ *
+ * On arm64 /dev/mem maps anything outside the kernel's RAM as Device
+ * memory, where unaligned accesses fault, and library memcpy() may use
+ * them.  So only the 64-bit aligned whole words of the span are copied
+ * with 64-bit accesses, and any head and tail use the requested size.
+ */
+static int copy_normal(void* dest, const void* src, uint64_t address, size_t size,
+                       cswp_access_size_t accessSize)
 {
-    int res = CSWP_SUCCESS;
-    char *addr;
-    size_t pageSize, pages;
-    off_t pageAddr;
-    size_t size = 4;
-    if (fd < 0)
-    {
-        perror("Open mem failed: ");
-        return CSWP_MEM_FAILED;
-    }
-    pageSize = sysconf(_SC_PAGE_SIZE);
-    pageAddr = address & ~(pageSize - 1);
-    pages = (address + size - pageAddr + pageSize - 1) / pageSize;
-    addr = mmap(NULL, pageSize * pages, PROT_READ,
-                MAP_SHARED, fd, pageAddr);
-    if (addr == MAP_FAILED)
-    {
-        perror("mmap failed: ");
-        return CSWP_MEM_FAILED;
-    }
+    size_t head = (size_t)(-address & 7);
+    const volatile uint64_t* s;
+    volatile uint64_t* d;
+    size_t words;
+    size_t i;
+    int res;
 
-    if (sigsetjmp(sigbusJmp, 1) == 0)
+    if (head > size)
+        head = size;
+    words = (size - head) / 8;
+
+    res = copy(dest, src, head, accessSize);
+    if (res == CSWP_SUCCESS)
     {
-        sigbusValid = 1;
-        res = copy_32((uint8_t*)value, addr + (address - pageAddr), size);
+        s = (const volatile uint64_t*)((const uint8_t*)src + head);
+        d = (volatile uint64_t*)((uint8_t*)dest + head);
+        for (i = 0; i < words; ++i)
+            d[i] = s[i];
+
+        head += words * 8;
+        res = copy((uint8_t*)dest + head, (const uint8_t*)src + head, size - head, accessSize);
     }
-    else
-        res = CSWP_MEM_FAILED;
-    sigbusValid = 0;
 
-    munmap(addr, pageSize * pages);
     return res;
 }
 
-static int do_32bit_write(int fd, uint64_t address, uint32_t value)
+/*
+ * Direct accesses to the transfer registers leave the shadows stale
+ */
+static void memap_reg_accessed(cswp_server_device_priv_t* devPriv, int registerID)
 {
-    int res = CSWP_SUCCESS;
-    char *addr;
-    size_t pageSize, pages;
-    off_t pageAddr;
-    size_t size = 4;
-
-    if (fd < 0)
+    if (registerID >= CORESIGHT_CSW_OFFSET && registerID < CORESIGHT_BD_OFFSET + 16)
     {
-        perror("Open mem failed: ");
-        return CSWP_MEM_FAILED;
+        devPriv->cswValid = 0;
+        devPriv->tarValid = 0;
     }
+}
 
-    /* mmap requested address range, aligning to page size */
-    /* TODO: limit max mmap size? */
-    pageSize = sysconf(_SC_PAGE_SIZE);
-    pageAddr = address & ~(pageSize - 1);
-    pages = (address + size - pageAddr + pageSize - 1) / pageSize;
-    addr = mmap(NULL, pageSize * pages, PROT_READ|PROT_WRITE,
-                MAP_SHARED, fd, pageAddr);
-    if (addr == MAP_FAILED)
-    {
-      perror("mmap failed: ");
-      return CSWP_MEM_FAILED;
-    }
+static int determine_supported_access_widths(cswp_server_device_priv_t * devPriv)
+{
+    const uint32_t cswVals[] = { 0x0, 0x1, 0x2 };
+    const uint8_t widthMasks[] = { WIDTH_8_MASK, WIDTH_16_MASK, WIDTH_32_MASK };
+    int res = CSWP_SUCCESS;
+    int i;
 
     if (sigsetjmp(sigbusJmp, 1) == 0)
     {
         sigbusValid = 1;
-        res = copy_32(addr + (address - pageAddr), (uint8_t*)(&value), size);
+        for (i = 0; i < 3; ++i)
+        {
+            MEMAP_REG(devPriv, CORESIGHT_CSW_OFFSET) = cswVals[i];
+            if ((MEMAP_REG(devPriv, CORESIGHT_CSW_OFFSET) & 0x7) == cswVals[i])
+                devPriv->supportedAccessWidths |= widthMasks[i];
+        }
+        devPriv->supportedAccessWidths |= WIDTHS_DETERMINED_MASK;
     }
     else
         res = CSWP_MEM_FAILED;
     sigbusValid = 0;
 
-    munmap(addr, pageSize * pages);
-    return res;
-}
-
-static int determine_supported_access_widths(int fd, cswp_server_device_priv_t * devPriv)
-{
-    uint32_t buf = 0x0;
-
-    // check 8-bit
-    uint32_t cswVal = 0x0;
-    int res = do_32bit_write(fd,
-                             devPriv->address | CORESIGHT_CSW_OFFSET,
-                             cswVal);
-    if (res != CSWP_SUCCESS)
-        return res;
-    res = do_32bit_read(fd,
-                        devPriv->address | CORESIGHT_CSW_OFFSET,
-                        &buf);
-    if (res != CSWP_SUCCESS)
-        return res;
-    if ((buf & 0x7) == cswVal)
-        devPriv->supportedAccessWidths |= WIDTH_8_MASK;
-
-    // check 16-bit
-    cswVal = 0x1;
-    res = do_32bit_write(fd,
-                         devPriv->address | CORESIGHT_CSW_OFFSET,
-                         cswVal);
-    if (res != CSWP_SUCCESS)
-        return res;
-    res = do_32bit_read(fd,
-                        devPriv->address | CORESIGHT_CSW_OFFSET,
-                        &buf);
-    if (res != CSWP_SUCCESS)
-        return res;
-    if ((buf & 0x7) == cswVal)
-        devPriv->supportedAccessWidths |= WIDTH_16_MASK;
-
-    // check 32-bit
-    cswVal = 0x2;
-    res = do_32bit_write(fd,
-                         devPriv->address | CORESIGHT_CSW_OFFSET,
-                         cswVal);
-    if (res != CSWP_SUCCESS)
-        return res;
-    res = do_32bit_read(fd,
-                        devPriv->address | CORESIGHT_CSW_OFFSET,
-                        &buf);
-    if (res != CSWP_SUCCESS)
-        return res;
-    if ((buf & 0x7) == cswVal)
-        devPriv->supportedAccessWidths |= WIDTH_32_MASK;
-
-    devPriv->supportedAccessWidths |= WIDTHS_DETERMINED_MASK;
+    /* CSW has been modified */
+    devPriv->cswValid = 0;
 
-    return CSWP_SUCCESS;
+    return res;
 }
 
 int get_csw_size_value(cswp_server_device_priv_t* devPriv, cswp_access_size_t access_size, uint8_t* csw_size_value)
 {
     if (!(devPriv->supportedAccessWidths & WIDTHS_DETERMINED_MASK))
     {
-        int fd = open("/dev/mem", O_RDWR);
-        int res = determine_supported_access_widths(fd, devPriv);
-        close(fd);
+        int res = determine_supported_access_widths(devPriv);
         if (res != CSWP_SUCCESS)
-        {
             return res;
-        }
     }
 
     if ((access_size == CSWP_ACCESS_SIZE_32 ||
@@ -872,86 +1747,412 @@ int get_csw_size_value(cswp_server_device_priv_t* devPriv, cswp_access_size_t ac
     return CSWP_MEM_BAD_ACCESS_SIZE;
 }
 
-static int cswp_server_impl_reg_read(struct _cswp_server_state_t* state, unsigned deviceIndex, int registerID, uint32_t* value)
+/*
+ * MEM-AP transfer engine
+ *
+ * CSW and TAR are only written when they differ from the last values
+ * written, and the whole transfer runs under a single SIGBUS guard.
+ *
+ * Auto-incrementing transfers are split at the TAR increment boundary and
+ * TAR is re-programmed at the start of each chunk. 32-bit transfers that
+ * fall within a single 16 byte block are made through the banked data
+ * registers, which leave TAR unchanged so repeated accesses to the same
+ * block (e.g. polls) need no TAR writes at all.
+ */
+static int memap_setup(cswp_server_device_priv_t* devPriv, cswp_access_size_t* accessSize,
+                       unsigned flags, uint32_t* cswVal)
 {
-    int res = CSWP_SUCCESS;
-    cswp_device_info_t* devInfo = &state->deviceInfo[deviceIndex];
-    cswp_server_device_priv_t* devPriv = &((cswp_server_priv_t*)state->priv)->devicePriv[deviceIndex];
+    uint8_t cswSize;
+    int res;
 
-    if (devPriv->path == NULL)
-    {
-        vlog(V_INFO, "Path not set for device %d", deviceIndex);
-        return CSWP_NOT_INITIALIZED;
-    }
+    /* MEM-AP default access size is 32-bit */
+    if (*accessSize == CSWP_ACCESS_SIZE_DEF)
+        *accessSize = CSWP_ACCESS_SIZE_32;
 
-    if (state->deviceTypes[deviceIndex] == NULL)
-    {
-        vlog(V_INFO, "Type not set for device %d", deviceIndex);
-        return CSWP_NOT_INITIALIZED;
-    }
+    res = get_csw_size_value(devPriv, *accessSize, &cswSize);
+    if (res != CSWP_SUCCESS)
+        return res;
 
-    if (devPriv->regsDiscovered == 0)
-    {
-        res = cswp_server_impl_device_discover_regs(state, deviceIndex);
-        if (res != CSWP_SUCCESS)
-            return res;
-    }
+    *cswVal = CORESIGHT_MEMAP_CSW | cswSize;
+    *cswVal |= (flags & CSWP_MEM_NO_ADDR_INC) ? 0x0 : CORESIGHT_CSW_ADDR_INC;
 
-    if (registerID >= devInfo->registerCount)
-        return CSWP_BAD_ARGS;
+    return CSWP_SUCCESS;
+}
 
-    /* no driver for mem-ap so access it through /mem/dev */
-    if (is_mem_ap_type(state->deviceTypes[deviceIndex]))
-    {
-            int fd = open("/dev/mem", O_RDONLY);
-            if (fd < 0) {
-                return CSWP_REG_FAILED;
-            }
+/*
+ * Read size bytes through DRW, extracting each element from its byte lane
+ */
+static void memap_drw_read(cswp_server_device_priv_t* devPriv, uint32_t address, size_t size,
+                           cswp_access_size_t accessSize, int inc, uint8_t* pData)
+{
+    volatile uint32_t* drw = &MEMAP_REG(devPriv, CORESIGHT_DRW_OFFSET);
+    unsigned shift;
+    uint32_t data;
+    uint16_t half;
+    size_t i;
 
-            res = do_32bit_read(fd, devPriv->address | registerID, value);
-            close(fd);
-    }
-    else
+    switch (accessSize)
     {
-        /* register IDs are allocated sequentially, so can access directly */
-        cswp_register_info_t* regInfo = &devInfo->registerInfo[registerID];
-
-        char regPath[256];
-        char rdBuf[64];
-
-        /* Read from file in CoreSight device */
-        snprintf(regPath, 255, "%s/%s",
-                 devPriv->path,
-                 regInfo->name);
+    case CSWP_ACCESS_SIZE_8:
+        shift = 8 * (address & 0x3);
+        for (i = 0; i < size; ++i)
+        {
+            pData[i] = *drw >> shift;
+            if (inc)
+                shift = (shift + 8) & 0x1F;
+        }
+        break;
+    case CSWP_ACCESS_SIZE_16:
+        shift = 8 * (address & 0x2);
+        for (i = 0; i + 2 <= size; i += 2)
+        {
+            half = *drw >> shift;
+            memcpy(&pData[i], &half, 2);
+            if (inc)
+                shift ^= 16;
+        }
+        break;
+    default:
+        for (i = 0; i + 4 <= size; i += 4)
+        {
+            data = *drw;
+            memcpy(&pData[i], &data, 4);
+        }
+        break;
+    }
+}
 
-        vlog(V_DEBUG, "Reading from %s\n", regPath);
+/*
+ * Write size bytes through DRW, moving each element to its byte lane
+ */
+static void memap_drw_write(cswp_server_device_priv_t* devPriv, uint32_t address, size_t size,
+                            cswp_access_size_t accessSize, int inc, const uint8_t* pData)
+{
+    volatile uint32_t* drw = &MEMAP_REG(devPriv, CORESIGHT_DRW_OFFSET);
+    unsigned shift;
+    uint32_t data;
+    uint16_t half;
+    size_t i;
 
-        int fd = open(regPath, O_RDONLY);
-        if (fd < 0) {
-          return CSWP_REG_FAILED;
+    switch (accessSize)
+    {
+    case CSWP_ACCESS_SIZE_8:
+        shift = 8 * (address & 0x3);
+        for (i = 0; i < size; ++i)
+        {
+            *drw = (uint32_t)pData[i] << shift;
+            if (inc)
+                shift = (shift + 8) & 0x1F;
+        }
+        break;
+    case CSWP_ACCESS_SIZE_16:
+        shift = 8 * (address & 0x2);
+        for (i = 0; i + 2 <= size; i += 2)
+        {
+            memcpy(&half, &pData[i], 2);
+            *drw = (uint32_t)half << shift;
+            if (inc)
+                shift ^= 16;
         }
+        break;
+    default:
+        for (i = 0; i + 4 <= size; i += 4)
+        {
+            memcpy(&data, &pData[i], 4);
+            *drw = data;
+        }
+        break;
+    }
+}
+
+/*
+ * Check whether a chunk can be made through the banked data registers
+ */
+static int memap_use_banked(uint32_t address, size_t size, cswp_access_size_t accessSize, int inc)
+{
+    return inc &&
+        accessSize == CSWP_ACCESS_SIZE_32 &&
+        (address & 0x3) == 0 &&
+        size >= 4 &&
+        (address & ~0xF) == ((address + size - 1) & ~0xF);
+}
+
+/*
+ * Transfer between memory and either pRead or pWrite with the device held
+ */
+static int memap_transfer_locked(cswp_server_device_priv_t* devPriv,
+                                 uint64_t address, size_t size,
+                                 cswp_access_size_t accessSize, unsigned flags,
+                                 uint8_t* pRead, const uint8_t* pWrite)
+{
+    int inc = (flags & CSWP_MEM_NO_ADDR_INC) == 0;
+    unsigned accessSizeBytes;
+    uint32_t cswVal;
+    uint32_t chunkAddr;
+    size_t chunkSize;
+    size_t offset;
+    size_t i;
+    int res;
+
+    res = memap_setup(devPriv, &accessSize, flags, &cswVal);
+    if (res != CSWP_SUCCESS)
+        return res;
+    accessSizeBytes = 1 << (accessSize-1);
 
-        int readRes = read(fd, rdBuf, sizeof(rdBuf));
-        if (readRes < 0) {
-          close(fd);
-          return CSWP_REG_FAILED;
+    /* Whole aligned elements only, so no element straddles the increment
+       boundary and every chunk is a whole number of elements */
+    if (((address | size) & (accessSizeBytes - 1)) != 0)
+    {
+        vlog(V_INFO, "MEM-AP transfer 0x%llx..+0x%zx not aligned to %u byte accesses\n",
+             (unsigned long long)address, size, accessSizeBytes);
+        return CSWP_BAD_ARGS;
+    }
+
+    if (sigsetjmp(sigbusJmp, 1) == 0)
+    {
+        sigbusValid = 1;
+        memap_set_csw(devPriv, cswVal);
+
+        for (offset = 0; offset < size; offset += chunkSize)
+        {
+            chunkAddr = (address + (inc ? offset : 0)) & 0xFFFFFFFF;
+            chunkSize = size - offset;
+            if (inc)
+            {
+                /* Stop at the increment boundary */
+                uint32_t boundaryLeft = CORESIGHT_TAR_INC_BOUNDARY -
+                    (chunkAddr & (CORESIGHT_TAR_INC_BOUNDARY - 1));
+                if (chunkSize > boundaryLeft)
+                    chunkSize = boundaryLeft;
+            }
+
+            if (memap_use_banked(chunkAddr, chunkSize, accessSize, inc))
+            {
+                volatile uint32_t* bd = &MEMAP_REG(devPriv, CORESIGHT_BD_OFFSET + (chunkAddr & 0xC));
+                uint32_t data;
+
+                memap_set_tar(devPriv, chunkAddr & ~0xF);
+                for (i = 0; i < chunkSize; i += 4)
+                {
+                    if (pRead)
+                    {
+                        data = bd[i/4];
+                        memcpy(&pRead[offset + i], &data, 4);
+                    }
+                    else
+                    {
+                        memcpy(&data, &pWrite[offset + i], 4);
+                        bd[i/4] = data;
+                    }
+                }
+            }
+            else
+            {
+                memap_set_tar(devPriv, chunkAddr);
+                if (pRead)
+                    memap_drw_read(devPriv, chunkAddr, chunkSize, accessSize, inc, &pRead[offset]);
+                else
+                    memap_drw_write(devPriv, chunkAddr, chunkSize, accessSize, inc, &pWrite[offset]);
+                if (inc)
+                    memap_advance_tar(devPriv, chunkAddr, chunkSize);
+            }
         }
-        close(fd);
-        rdBuf[readRes] = '\0';
+    }
+    else
+    {
+        res = CSWP_MEM_FAILED;
+        devPriv->cswValid = 0;
+        devPriv->tarValid = 0;
+    }
+    sigbusValid = 0;
+
+    return res;
+}
+
+/*
+ * Transfer between memory and either pRead or pWrite
+ */
+static int memap_transfer(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                          uint64_t address, size_t size,
+                          cswp_access_size_t accessSize, unsigned flags,
+                          uint8_t* pRead, const uint8_t* pWrite)
+{
+    int res;
+
+    res = memap_get_regs(priv, devPriv);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    device_arb_acquire(devPriv);
+    res = memap_transfer_locked(devPriv, address, size, accessSize, flags, pRead, pWrite);
+    device_arb_release(devPriv);
+
+    return res;
+}
+
+static int memap_read(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                      uint64_t address, size_t size,
+                      cswp_access_size_t accessSize, unsigned flags, uint8_t* pData)
+{
+    return memap_transfer(priv, devPriv, address, size, accessSize, flags, pData, NULL);
+}
+
+static int memap_write(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                       uint64_t address, size_t size,
+                       cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData)
+{
+    return memap_transfer(priv, devPriv, address, size, accessSize, flags, NULL, pData);
+}
 
-        /* Convert from hex - almost all props use
-         * kstrtoul(16) apart from enable_xxx, but this is just testing for non-zero */
-        errno = 0;
-        *value = strtoul(rdBuf, NULL, 16);
-        if (errno != 0)
-          return CSWP_REG_FAILED;
+/*
+ * Repeat a pattern into buf
+ *
+ * One repeat is written, then the filled part is copied onto the rest,
+ * doubling each time, so most bytes are moved by memcpy
+ */
+static void fill_pattern(uint8_t* buf, size_t size, const uint8_t* pPattern, size_t patternSize)
+{
+    size_t n, c;
+
+    for (n = 0; n < size && n < patternSize; ++n)
+        buf[n] = pPattern[n];
+    while (n < size)
+    {
+        c = (n < size - n) ? n : size - n;
+        memcpy(buf + n, buf, c);
+        n += c;
+    }
+}
+
+/*
+ * Size of a fill buffer holding whole repeats of the pattern and whole
+ * 64-bit elements, so consecutive writes keep the pattern and access size
+ * aligned
+ */
+static size_t fill_chunk_size(size_t patternSize)
+{
+    return MEM_FILL_CHUNK - MEM_FILL_CHUNK % (patternSize * sizeof(uint64_t));
+}
+
+static int memap_fill(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                      uint64_t address, size_t size,
+                      cswp_access_size_t accessSize, unsigned flags,
+                      const uint8_t* pPattern, size_t patternSize)
+{
+    int inc = (flags & CSWP_MEM_NO_ADDR_INC) == 0;
+    uint8_t buf[MEM_FILL_CHUNK];
+    size_t chunkSize = fill_chunk_size(patternSize);
+    size_t offset;
+    size_t n;
+    int res;
+
+    res = memap_get_regs(priv, devPriv);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    fill_pattern(buf, chunkSize, pPattern, patternSize);
+
+    /* Hold the AP for the whole fill */
+    device_arb_acquire(devPriv);
+    for (offset = 0; offset < size && res == CSWP_SUCCESS; offset += n)
+    {
+        n = size - offset;
+        if (n > chunkSize)
+            n = chunkSize;
+        res = memap_transfer_locked(devPriv, address + (inc ? offset : 0), n, accessSize, flags, NULL, buf);
     }
+    device_arb_release(devPriv);
 
     return res;
 }
 
+static int memap_checksum(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                          uint64_t address, size_t size,
+                          cswp_access_size_t accessSize, unsigned flags,
+                          cswp_checksum_t algorithm, uint64_t* pDigest)
+{
+    int inc = (flags & CSWP_MEM_NO_ADDR_INC) == 0;
+    uint8_t buf[MEM_CHECKSUM_CHUNK];
+    uint64_t sum = cswp_checksum_init(algorithm);
+    size_t offset;
+    size_t n;
+    int res;
 
-static int cswp_server_impl_reg_write(struct _cswp_server_state_t* state, unsigned deviceIndex, int registerID, uint32_t value)
+    res = memap_get_regs(priv, devPriv);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    /* Hold the AP for the whole checksum */
+    device_arb_acquire(devPriv);
+    for (offset = 0; offset < size && res == CSWP_SUCCESS; offset += n)
+    {
+        n = size - offset;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        res = memap_transfer_locked(devPriv, address + (inc ? offset : 0), n, accessSize, flags, buf, NULL);
+        if (res == CSWP_SUCCESS)
+            sum = cswp_checksum_update(algorithm, sum, buf, n);
+    }
+    device_arb_release(devPriv);
+
+    if (res == CSWP_SUCCESS)
+        *pDigest = cswp_checksum_final(algorithm, sum);
+    return res;
+}
+
+/*
+ * Offset of the next search window from one of n bytes at offset
+ *
+ * Windows overlap by the pattern size less one so matches across their
+ * boundary are found, and each starts a multiple of 64 bits after the
+ * previous to keep accesses aligned.  The last window of the range is
+ * searched to its end.  Zero means the window is too short to step on.
+ */
+static size_t mem_search_step(const cswp_search_t* search, size_t offset, size_t n, size_t size)
+{
+    if (offset + n == size)
+        return n;
+    if (n < search->size - 1)
+        return 0;
+    return (n - (search->size - 1)) & ~(size_t)7;
+}
+
+static int memap_search(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                        uint64_t address, size_t size,
+                        cswp_access_size_t accessSize, unsigned flags,
+                        const cswp_search_t* search,
+                        uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    uint8_t buf[MEM_SEARCH_CHUNK];
+    size_t offset;
+    size_t step;
+    size_t n;
+    int res;
+
+    *pHitCount = 0;
+    res = memap_get_regs(priv, devPriv);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    /* Hold the AP for the whole search */
+    device_arb_acquire(devPriv);
+    for (offset = 0; offset < size && *pHitCount < maxHits && res == CSWP_SUCCESS; offset += step)
+    {
+        n = size - offset;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        step = mem_search_step(search, offset, n, size);
+        res = memap_transfer_locked(devPriv, address + offset, n, accessSize, flags, buf, NULL);
+        if (res == CSWP_SUCCESS)
+            *pHitCount += cswp_search_window(search, buf, n, step, address + offset,
+                                             pHits + *pHitCount, maxHits - *pHitCount);
+    }
+    device_arb_release(devPriv);
+
+    return res;
+}
+
+static int cswp_server_impl_reg_read(struct _cswp_server_state_t* state, unsigned deviceIndex, int registerID, uint32_t* value)
 {
     int res = CSWP_SUCCESS;
     cswp_device_info_t* devInfo = &state->deviceInfo[deviceIndex];
@@ -982,62 +2183,82 @@ static int cswp_server_impl_reg_write(struct _cswp_server_state_t* state, unsign
     /* no driver for mem-ap so access it through /mem/dev */
     if (is_mem_ap_type(state->deviceTypes[deviceIndex]))
     {
-         int fd = open("/dev/mem", O_RDWR);
-         if (fd < 0) {
-            return CSWP_REG_FAILED;
-         }
-         res = do_32bit_write(fd, devPriv->address | registerID, value);
-         close(fd);
+        res = memap_get_regs((cswp_server_priv_t*)state->priv, devPriv);
+        if (res != CSWP_SUCCESS)
+            return res;
+
+        device_arb_acquire(devPriv);
+        if (sigsetjmp(sigbusJmp, 1) == 0)
+        {
+            sigbusValid = 1;
+            *value = MEMAP_REG(devPriv, registerID);
+        }
+        else
+            res = CSWP_MEM_FAILED;
+        sigbusValid = 0;
+
+        memap_reg_accessed(devPriv, registerID);
+        device_arb_release(devPriv);
     }
     else
     {
-        /* register IDs are allocated sequentially, so can access directly */
-        cswp_register_info_t* regInfo = &devInfo->registerInfo[registerID];
-
-        char regPath[256];
-        char wrBuf[64];
-
-        /* Write to file in CoreSight device */
-        snprintf(regPath, 255, "%s/%s",
-                 devPriv->path,
-                 regInfo->name);
+        res = cs_reg_read(devInfo, devPriv, registerID, value);
+    }
 
-        /* Convert to hex - almost all props use
-         * kstrtoul(16) apart from enable_xxx, but this is just testing for non-zero */
-        snprintf(wrBuf, sizeof(wrBuf)-1, "%X", value);
-        wrBuf[sizeof(wrBuf)-1] = '\0';
+    return res;
+}
 
-        vlog(V_DEBUG, "Writing %s to %s\n", wrBuf, regPath);
+static int cswp_server_impl_reg_read_list(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                          unsigned count, const unsigned* registerIDs, uint32_t* values,
+                                          unsigned* failedIndex)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    cswp_device_info_t* devInfo = &state->deviceInfo[deviceIndex];
+    cswp_server_device_priv_t* devPriv = &priv->devicePriv[deviceIndex];
+    unsigned r;
+    int res = CSWP_SUCCESS;
 
-        int fd = open(regPath, O_WRONLY);
-        if (fd < 0) {
-            return CSWP_REG_FAILED;
+    /*
+     * Attribute reads of CoreSight devices may block in the driver, so
+     * larger batches are spread across the worker pool.  Everything else
+     * is read in order on this thread.
+     */
+    if (count >= REG_POOL_MIN_BATCH &&
+        devPriv->path != NULL &&
+        devPriv->regsDiscovered &&
+        devPriv->regFds != NULL &&
+        state->deviceTypes[deviceIndex] != NULL &&
+        !is_mem_ap_type(state->deviceTypes[deviceIndex]))
+    {
+        for (r = 0; r < count; ++r)
+        {
+            if (registerIDs[r] >= devInfo->registerCount)
+            {
+                *failedIndex = r;
+                return CSWP_BAD_ARGS;
+            }
         }
 
-        int writeRes = write(fd, wrBuf, sizeof(wrBuf));
-        if (writeRes < 0) {
-          close(fd);
-          return CSWP_REG_FAILED;
-        }
+        return reg_pool_read(priv, devInfo, devPriv, count, registerIDs, values, failedIndex);
+    }
 
-        close(fd);
+    for (r = 0; r < count && res == CSWP_SUCCESS; ++r)
+    {
+        res = cswp_server_impl_reg_read(state, deviceIndex, registerIDs[r], &values[r]);
+        if (res != CSWP_SUCCESS)
+            *failedIndex = r;
     }
 
     return res;
 }
 
 
-static int cswp_server_impl_mem_read(struct _cswp_server_state_t* state, unsigned deviceIndex,
-                                     uint64_t address, size_t size,
-                                     cswp_access_size_t accessSize, unsigned flags, uint8_t* pData)
+
+static int cswp_server_impl_reg_write(struct _cswp_server_state_t* state, unsigned deviceIndex, int registerID, uint32_t value)
 {
-    cswp_server_device_priv_t* devPriv = &((cswp_server_priv_t*)state->priv)->devicePriv[deviceIndex];
-    char *addr;
-    size_t pageSize, pages;
-    off_t pageAddr;
-    size_t i;
     int res = CSWP_SUCCESS;
-    unsigned accessSizeBytes;
+    cswp_device_info_t* devInfo = &state->deviceInfo[deviceIndex];
+    cswp_server_device_priv_t* devPriv = &((cswp_server_priv_t*)state->priv)->devicePriv[deviceIndex];
 
     if (devPriv->path == NULL)
     {
@@ -1051,135 +2272,278 @@ static int cswp_server_impl_mem_read(struct _cswp_server_state_t* state, unsigne
         return CSWP_NOT_INITIALIZED;
     }
 
-    /* Only device 0 supports mem access */
-    if (deviceIndex != 0)
-        return CSWP_UNSUPPORTED;
-
-    if ((flags & CSWP_MEM_NO_ADDR_INC) && accessSize == CSWP_ACCESS_SIZE_DEF)
+    if (devPriv->regsDiscovered == 0)
     {
-        vlog(V_INFO, "Invalid access size for repeated read");
-        return CSWP_BAD_ARGS;
+        res = cswp_server_impl_device_discover_regs(state, deviceIndex);
+        if (res != CSWP_SUCCESS)
+            return res;
     }
-    accessSizeBytes = 1 << (accessSize-1);
 
-    /* no driver for mem-ap so access it through /dev/mem
-       operations: - write TAR register
-                   - write CSW register
-                   - read DRW register 
-    */
+    if (registerID >= devInfo->registerCount)
+        return CSWP_BAD_ARGS;
+
+    /* no driver for mem-ap so access it through /mem/dev */
     if (is_mem_ap_type(state->deviceTypes[deviceIndex]))
     {
-      int fd = open("/dev/mem", O_RDWR);
-      uint8_t cswSize;
-      res = get_csw_size_value(devPriv, accessSize, &cswSize);
-      if (res != CSWP_SUCCESS)
-      {
-          close(fd);
-          return res;
-      }
-
-      // CSW
-      uint32_t cswVal = CORESIGHT_MEMAP_CSW | cswSize;
-      cswVal |= (flags & CSWP_MEM_NO_ADDR_INC) ? 0x0 : CORESIGHT_CSW_ADDR_INC;
-      res = do_32bit_write(fd,
-                           devPriv->address | CORESIGHT_CSW_OFFSET,
-                           cswVal);
-      if (res != CSWP_SUCCESS)
-      {
-          close(fd);
-          return res;
-      }
-      // TAR
-      res = do_32bit_write(fd,
-                           devPriv->address | CORESIGHT_TAR_OFFSET,
-                           address & 0xFFFFFFFF);
-      if (res != CSWP_SUCCESS)
-      {
-          close(fd);
-          return res;
-      }
-
-      for(i=0; i<size/accessSizeBytes; i++)
-      {
-          uint32_t data;
-          res = do_32bit_read(fd,
-                              devPriv->address | CORESIGHT_DRW_OFFSET,
-                              &data);
-          if (res != CSWP_SUCCESS)
-          {
-              close(fd);
-              return res;
-          }
-
-          // Copy data from correct byte lane
-          uint32_t copyData;
-          uint32_t currAddr = address + (i*accessSizeBytes);
-          if (accessSize == CSWP_ACCESS_SIZE_8)
-              copyData = (data >> (8 * (currAddr & 0x3))) & 0xff;
-          else if (accessSize == CSWP_ACCESS_SIZE_16)
-              copyData = (data >> (8 * (currAddr & 0x2))) & 0xffff;
-          else
-              copyData = data;
-          copy(&pData[i*accessSizeBytes], &copyData, accessSizeBytes, accessSize);
-      }
-      close(fd);
+        res = memap_get_regs((cswp_server_priv_t*)state->priv, devPriv);
+        if (res != CSWP_SUCCESS)
+            return res;
+
+        device_arb_acquire(devPriv);
+        if (sigsetjmp(sigbusJmp, 1) == 0)
+        {
+            sigbusValid = 1;
+            MEMAP_REG(devPriv, registerID) = value;
+        }
+        else
+            res = CSWP_MEM_FAILED;
+        sigbusValid = 0;
+
+        memap_reg_accessed(devPriv, registerID);
+        device_arb_release(devPriv);
     }
     else
     {
-        /* Use mmap with /dev/mem to get physical memory */
-        int fd = open(devPriv->path, O_RDONLY);
-        if (fd < 0)
-        {
-            perror("Open mem failed: ");
-            return CSWP_MEM_FAILED;
-        }
+        res = cs_reg_write(devInfo, devPriv, registerID, value);
+    }
 
-        /* mmap requested address range, aligning to page size */
-        /* TODO: limit max mmap size? */
-        pageSize = sysconf(_SC_PAGE_SIZE);
-        pageAddr = address & ~(pageSize - 1);
-        pages = (address + size - pageAddr + pageSize - 1) / pageSize;
-        addr = mmap(NULL, pageSize * pages, PROT_READ,
-                    MAP_SHARED, fd, pageAddr);
-        if (addr == MAP_FAILED)
-        {
-            close(fd);
-            perror("mmap failed: ");
-            return CSWP_MEM_FAILED;
-        }
+    return res;
+}
+
+
+/*
+ * Physical memory through the cached /dev/mem mappings
+ *
+ * The range is split where the memory attribute changes.  Normal memory
+ * is copied a 64-bit word at a time where aligned, see copy_normal().
+ * Device memory, and anything not in the attribute map, keeps the strict
+ * loops that use exactly the requested access size.
+ */
+static int phys_mem_transfer(cswp_server_priv_t* priv,
+                             uint64_t address, size_t size,
+                             cswp_access_size_t accessSize, unsigned flags,
+                             uint8_t* pRead, const uint8_t* pWrite)
+{
+    unsigned accessSizeBytes = (accessSize == CSWP_ACCESS_SIZE_DEF) ? 1 : 1 << (accessSize-1);
+    const mem_attr_region_t* region;
+    uint64_t segEnd;
+    size_t segSize;
+    size_t offset;
+    uint8_t *addr;
+    size_t i;
+    int res = CSWP_SUCCESS;
 
-        /* Copy from mmapd region */
-        if (flags & CSWP_MEM_NO_ADDR_INC)
+    if (sigsetjmp(sigbusJmp, 1) == 0)
+    {
+        sigbusValid = 1;
+        for (offset = 0; offset < size && res == CSWP_SUCCESS; offset += segSize)
         {
-            for (i = 0; i < size/accessSizeBytes && res == CSWP_SUCCESS; ++i)
+            region = mem_attr_find(address + offset, &segEnd);
+            segSize = size - offset;
+            if ((flags & CSWP_MEM_NO_ADDR_INC) == 0 && segEnd - (address + offset) < segSize)
+                segSize = segEnd - (address + offset);
+
+            if (region && region->widths != 0 &&
+                accessSize != CSWP_ACCESS_SIZE_DEF &&
+                (region->widths & mem_attr_width(accessSize)) == 0)
             {
-                res = copy(pData, addr + (address - pageAddr), accessSizeBytes, accessSize);
-                pData += accessSizeBytes;
+                vlog(V_INFO, "Access size not allowed at 0x%llx\n", (unsigned long long)(address + offset));
+                res = CSWP_BAD_ARGS;
+                break;
+            }
+
+            if (flags & CSWP_MEM_NO_ADDR_INC)
+            {
+                res = mem_window_get(priv, address, accessSizeBytes, pWrite != NULL, &addr);
+                for (i = 0; i < size/accessSizeBytes && res == CSWP_SUCCESS; ++i)
+                {
+                    if (pRead)
+                        res = copy(&pRead[i*accessSizeBytes], addr, accessSizeBytes, accessSize);
+                    else
+                        res = copy(addr, &pWrite[i*accessSizeBytes], accessSizeBytes, accessSize);
+                }
+                break;
+            }
+
+            res = mem_window_get(priv, address + offset, segSize, pWrite != NULL, &addr);
+            if (res != CSWP_SUCCESS)
+                break;
+
+            if (region && region->normal)
+            {
+                if (pRead)
+                    res = copy_normal(&pRead[offset], addr, address + offset, segSize, accessSize);
+                else
+                    res = copy_normal(addr, &pWrite[offset], address + offset, segSize, accessSize);
+            }
+            else
+            {
+                if (pRead)
+                    res = copy(&pRead[offset], addr, segSize, accessSize);
+                else
+                    res = copy(addr, &pWrite[offset], segSize, accessSize);
             }
         }
-        else
-        {
-            res = copy(pData, addr + (address - pageAddr), size, accessSize);
-        }
-        munmap(addr, pageSize * pages);
-        close(fd);
     }
+    else
+        res = CSWP_MEM_FAILED;
+    sigbusValid = 0;
 
     return res;
 }
 
+static int phys_mem_read(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                         uint64_t address, size_t size,
+                         cswp_access_size_t accessSize, unsigned flags, uint8_t* pData)
+{
+    return phys_mem_transfer(priv, address, size, accessSize, flags, pData, NULL);
+}
 
-static int cswp_server_impl_mem_write(struct _cswp_server_state_t* state, unsigned deviceIndex,
-                                      uint64_t address, size_t size,
-                                      cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData)
+static int phys_mem_write(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                          uint64_t address, size_t size,
+                          cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData)
 {
-    cswp_server_device_priv_t* devPriv = &((cswp_server_priv_t*)state->priv)->devicePriv[deviceIndex];
-    char *addr;
-    size_t pageSize, pages;
-    off_t pageAddr;
-    size_t i;
+    return phys_mem_transfer(priv, address, size, accessSize, flags, NULL, pData);
+}
+
+/*
+ * Search physical memory read through phys_mem_read() a buffer at a time
+ */
+static int phys_mem_search(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                           uint64_t address, size_t size,
+                           cswp_access_size_t accessSize, unsigned flags,
+                           const cswp_search_t* search,
+                           uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    uint8_t buf[MEM_SEARCH_CHUNK];
+    size_t offset;
+    size_t step;
+    size_t n;
     int res = CSWP_SUCCESS;
-    unsigned accessSizeBytes;
+
+    *pHitCount = 0;
+    for (offset = 0; offset < size && *pHitCount < maxHits && res == CSWP_SUCCESS; offset += step)
+    {
+        n = size - offset;
+        if (n > sizeof(buf))
+            n = sizeof(buf);
+        step = mem_search_step(search, offset, n, size);
+        res = phys_mem_read(priv, devPriv, address + offset, n, accessSize, flags, buf);
+        if (res == CSWP_SUCCESS)
+            *pHitCount += cswp_search_window(search, buf, n, step, address + offset,
+                                             pHits + *pHitCount, maxHits - *pHitCount);
+    }
+
+    return res;
+}
+
+/*
+ * Window onto physical memory
+ *
+ * Device addresses are offsets from the configured base address and must
+ * stay within the configured limit
+ */
+static int window_mem_check(cswp_server_device_priv_t* devPriv, uint64_t address, size_t size)
+{
+    if (address >= devPriv->memLimit || size > devPriv->memLimit - address)
+    {
+        vlog(V_INFO, "Access 0x%llx..+0x%zx outside window\n", (unsigned long long)address, size);
+        return CSWP_BAD_ARGS;
+    }
+
+    return CSWP_SUCCESS;
+}
+
+static int window_mem_read(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                           uint64_t address, size_t size,
+                           cswp_access_size_t accessSize, unsigned flags, uint8_t* pData)
+{
+    int res = window_mem_check(devPriv, address, size);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    return phys_mem_read(priv, devPriv, devPriv->memBase + address, size, accessSize, flags, pData);
+}
+
+static int window_mem_write(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                            uint64_t address, size_t size,
+                            cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData)
+{
+    int res = window_mem_check(devPriv, address, size);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    return phys_mem_write(priv, devPriv, devPriv->memBase + address, size, accessSize, flags, pData);
+}
+
+static int window_mem_search(cswp_server_priv_t* priv, cswp_server_device_priv_t* devPriv,
+                             uint64_t address, size_t size,
+                             cswp_access_size_t accessSize, unsigned flags,
+                             const cswp_search_t* search,
+                             uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    size_t i;
+    int res = window_mem_check(devPriv, address, size);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    /* Matches are reported as device addresses */
+    res = phys_mem_search(priv, devPriv, devPriv->memBase + address, size, accessSize, flags,
+                          search, pHits, maxHits, pHitCount);
+    for (i = 0; i < *pHitCount; ++i)
+        pHits[i] -= devPriv->memBase;
+    return res;
+}
+
+static const mem_backend_t physMemBackend = {
+    "physical",
+    phys_mem_read,
+    phys_mem_write,
+    NULL,
+    NULL,
+    phys_mem_search,
+    NULL
+};
+
+static const mem_backend_t memApMemBackend = {
+    "mem-ap",
+    memap_read,
+    memap_write,
+    memap_fill,
+    memap_checksum,
+    memap_search,
+    NULL
+};
+
+static const mem_backend_t windowMemBackend = {
+    "window",
+    window_mem_read,
+    window_mem_write,
+    NULL,
+    NULL,
+    window_mem_search,
+    window_mem_check
+};
+
+/*
+ * Select the memory backend for a device type and its configuration
+ */
+static const mem_backend_t* mem_backend_for_type(const char* deviceType, const cswp_server_device_priv_t* devPriv)
+{
+    if (is_mem_ap_type(deviceType))
+        return &memApMemBackend;
+    else if (strcmp("memory", deviceType) == 0)
+        return (devPriv->memLimit != 0) ? &windowMemBackend : &physMemBackend;
+    else
+        return NULL;
+}
+
+/*
+ * Get the memory backend for a device, checking it is ready for access
+ */
+static int mem_backend_get(cswp_server_state_t* state, unsigned deviceIndex, const mem_backend_t** backend)
+{
+    cswp_server_device_priv_t* devPriv = &((cswp_server_priv_t*)state->priv)->devicePriv[deviceIndex];
 
     if (devPriv->path == NULL)
     {
@@ -1193,121 +2557,131 @@ static int cswp_server_impl_mem_write(struct _cswp_server_state_t* state, unsign
         return CSWP_NOT_INITIALIZED;
     }
 
-    /* Only device 0 supports mem access */
-    if (deviceIndex != 0)
+    if (devPriv->memBackend == NULL)
         return CSWP_UNSUPPORTED;
 
+    *backend = devPriv->memBackend;
+    return CSWP_SUCCESS;
+}
+
+static int cswp_server_impl_mem_read(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                     uint64_t address, size_t size,
+                                     cswp_access_size_t accessSize, unsigned flags, uint8_t* pData)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    const mem_backend_t* backend;
+    int res;
+
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
+
     if ((flags & CSWP_MEM_NO_ADDR_INC) && accessSize == CSWP_ACCESS_SIZE_DEF)
     {
         vlog(V_INFO, "Invalid access size for repeated read");
         return CSWP_BAD_ARGS;
     }
-    accessSizeBytes = 1 << (accessSize-1);
 
-    /* no driver for mem-ap so access it through /dev/mem
-       operations: - write TAR register
-                   - write CSW register
-                   - read DRW register 
-    */
-    if (is_mem_ap_type(state->deviceTypes[deviceIndex]))
-    {
-        int fd = open("/dev/mem", O_RDWR);
-        uint8_t cswSize;
-        res = get_csw_size_value(devPriv, accessSize, &cswSize);
-        if (res != CSWP_SUCCESS)
-        {
-            close(fd);
-            return res;
-        }
+    return backend->read(priv, &priv->devicePriv[deviceIndex], address, size, accessSize, flags, pData);
+}
 
-        // CSW
-        uint32_t cswVal = CORESIGHT_MEMAP_CSW | cswSize;
-        cswVal |= (flags & CSWP_MEM_NO_ADDR_INC) ? 0x0 : CORESIGHT_CSW_ADDR_INC;
-        res = do_32bit_write(fd,
-                             devPriv->address | CORESIGHT_CSW_OFFSET,
-                             cswVal);
-        if (res != CSWP_SUCCESS)
-        {
-            close(fd);
-            return res;
-        }
-        // TAR
-        res = do_32bit_write(fd,
-                             devPriv->address | CORESIGHT_TAR_OFFSET,
-                             address & 0xFFFFFFFF);
-        if (res != CSWP_SUCCESS)
-        {
-            close(fd);
-            return res;
-        }
 
-        for(i=0; i<size/accessSizeBytes; i++)
-        {
-            uint32_t data;
-            copy(&data, &pData[i*accessSizeBytes], accessSizeBytes, accessSize);
-
-            // Move write data to correct byte lane
-            uint32_t writeData;
-            uint32_t currAddr = address + (i*accessSizeBytes);
-            if (accessSize == CSWP_ACCESS_SIZE_8)
-                writeData = (data << (8 * (currAddr & 0x3))) & 0xff;
-            else if (accessSize == CSWP_ACCESS_SIZE_16)
-                writeData = (data << (8 * (currAddr & 0x2))) & 0xffff;
-            else
-                writeData = data;
-            res = do_32bit_write(fd,
-                                 devPriv->address | CORESIGHT_DRW_OFFSET,
-                                 writeData);
-            if (res != CSWP_SUCCESS)
-                break;
-        }
-        close(fd);
-    }
-    else
+static int cswp_server_impl_mem_write(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                      uint64_t address, size_t size,
+                                      cswp_access_size_t accessSize, unsigned flags, const uint8_t* pData)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    const mem_backend_t* backend;
+    int res;
+
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    if ((flags & CSWP_MEM_NO_ADDR_INC) && accessSize == CSWP_ACCESS_SIZE_DEF)
     {
-        /* Use mmap with /dev/mem to get physical memory */
-        int fd = open(devPriv->path, O_RDWR);
-        if (fd < 0)
-        {
-            perror("Open mem failed: ");
-            return CSWP_MEM_FAILED;
-        }
+        vlog(V_INFO, "Invalid access size for repeated write");
+        return CSWP_BAD_ARGS;
+    }
 
-        /* mmap requested address range, aligning to page size */
-        /* TODO: limit max mmap size? */
-        pageSize = sysconf(_SC_PAGE_SIZE);
-        pageAddr = address & ~(pageSize - 1);
-        pages = (address + size - pageAddr + pageSize - 1) / pageSize;
-        addr = mmap(NULL, pageSize * pages, PROT_READ|PROT_WRITE,
-                    MAP_SHARED, fd, pageAddr);
-        if (addr == MAP_FAILED)
-        {
-            close(fd);
-            perror("mmap failed: ");
-            return CSWP_MEM_FAILED;
-        }
+    return backend->write(priv, &priv->devicePriv[deviceIndex], address, size, accessSize, flags, pData);
+}
 
-        /* Copy to mmapd region */
-        if (flags & CSWP_MEM_NO_ADDR_INC)
-        {
-            for (i = 0; i < size/accessSizeBytes && res == CSWP_SUCCESS; ++i)
-            {
-                res = copy(addr + (address - pageAddr), pData, accessSizeBytes, accessSize);
-                pData += accessSizeBytes;
-            }
-        }
-        else
-        {
-            res = copy(addr + (address - pageAddr), pData, size, accessSize);
-        }
 
-        munmap(addr, pageSize * pages);
-        close(fd);
+static int cswp_server_impl_mem_fill(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                     uint64_t address, size_t size,
+                                     cswp_access_size_t accessSize, unsigned flags,
+                                     const uint8_t* pPattern, size_t patternSize)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    const mem_backend_t* backend;
+    int res;
+
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    if ((flags & CSWP_MEM_NO_ADDR_INC) && accessSize == CSWP_ACCESS_SIZE_DEF)
+    {
+        vlog(V_INFO, "Invalid access size for repeated fill");
+        return CSWP_BAD_ARGS;
     }
 
+    if (backend->fill)
+        return backend->fill(priv, &priv->devicePriv[deviceIndex], address, size, accessSize, flags, pPattern, patternSize);
+
+    if (backend->check)
+        res = backend->check(&priv->devicePriv[deviceIndex], address, size);
+    if (res == CSWP_SUCCESS)
+        res = cswp_server_mem_fill_by_write(state, deviceIndex, address, size, accessSize, flags,
+                                            pPattern, patternSize);
+    return res;
+}
+
+
+static int cswp_server_impl_mem_checksum(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                         uint64_t address, size_t size,
+                                         cswp_access_size_t accessSize, unsigned flags,
+                                         cswp_checksum_t algorithm, uint64_t* pDigest)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    const mem_backend_t* backend;
+    int res;
+
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    if (backend->checksum)
+        return backend->checksum(priv, &priv->devicePriv[deviceIndex], address, size, accessSize, flags, algorithm, pDigest);
+
+    if (backend->check)
+        res = backend->check(&priv->devicePriv[deviceIndex], address, size);
+    if (res == CSWP_SUCCESS)
+        res = cswp_server_mem_checksum_by_read(state, deviceIndex, address, size, accessSize, flags,
+                                               algorithm, pDigest);
     return res;
 }
 
+static int cswp_server_impl_mem_search(struct _cswp_server_state_t* state, unsigned deviceIndex,
+                                       uint64_t address, size_t size,
+                                       cswp_access_size_t accessSize, unsigned flags,
+                                       const cswp_search_t* search,
+                                       uint64_t* pHits, size_t maxHits, size_t* pHitCount)
+{
+    cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
+    const mem_backend_t* backend;
+    int res;
+
+    *pHitCount = 0;
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
+
+    return backend->search(priv, &priv->devicePriv[deviceIndex], address, size, accessSize, flags,
+                           search, pHits, maxHits, pHitCount);
+}
+
 
 static int cswp_server_impl_check_last(struct _cswp_server_state_t* state,
                                        size_t size,
@@ -1367,37 +2741,20 @@ static int cswp_server_impl_mem_poll(struct _cswp_server_state_t* state, int dev
 {
     cswp_server_priv_t* priv = (cswp_server_priv_t*)state->priv;
     cswp_server_device_priv_t* devPriv = &priv->devicePriv[deviceIndex];
-    int fd;
-    char *addr;
-    size_t pageSize, pages;
-    off_t pageAddr;
+    const mem_backend_t* backend;
     uint8_t* cmpBuf;
     uint8_t* valBuf;
     int res;
     size_t i;
 
-    unsigned accessSizeBytes;
-
     if (flags & CSWP_MEM_POLL_CHECK_LAST)
     {
         return cswp_server_impl_check_last(state, size, flags, pMask, pValue, pData);
     }
 
-    if (devPriv->path == NULL)
-    {
-        vlog(V_INFO, "Path not set for device %d", deviceIndex);
-        return CSWP_NOT_INITIALIZED;
-    }
-
-    if (state->deviceTypes[deviceIndex] == NULL)
-    {
-        vlog(V_INFO, "Type not set for device %d", deviceIndex);
-        return CSWP_NOT_INITIALIZED;
-    }
-
-    /* Only device 0 supports mem access */
-    if (deviceIndex != 0)
-        return CSWP_UNSUPPORTED;
+    res = mem_backend_get(state, deviceIndex, &backend);
+    if (res != CSWP_SUCCESS)
+        return res;
 
     /* Allocate buffers */
     cmpBuf = malloc(size);
@@ -1416,123 +2773,32 @@ static int cswp_server_impl_mem_poll(struct _cswp_server_state_t* state, int dev
     for (i = 0; i < size; ++i)
         cmpBuf[i] = pValue[i] & pMask[i];
 
-    accessSizeBytes = 1 << (accessSize-1);
-    if (is_mem_ap_type(state->deviceTypes[deviceIndex]))
+    res = CSWP_MEM_POLL_NO_MATCH;
+    while (tries-- > 0)
     {
         int cmpRes;
-        fd = open("/dev/mem", O_RDWR);
-        uint8_t cswSize;
-        res = get_csw_size_value(devPriv, accessSize, &cswSize);
-
-        if (res == CSWP_SUCCESS)
-          // Can assume access is a 32-bit access now
-          res = do_32bit_write(fd,
-                               devPriv->address | CORESIGHT_CSW_OFFSET,
-                               CORESIGHT_MEMAP_CSW | cswSize);
-
-        if (res == CSWP_SUCCESS)
-          res = do_32bit_write(fd,
-                               devPriv->address | CORESIGHT_TAR_OFFSET,
-                               address & 0xFFFFFFFF);
 
-        while ((tries-- > 0) && (res == CSWP_SUCCESS))
-        {
-            uint32_t data;
-            for(i = 0; (i < size/accessSizeBytes) && (res == CSWP_SUCCESS); i++)
-            {
-                res = do_32bit_read(fd,
-                                    devPriv->address | CORESIGHT_DRW_OFFSET,
-                                    &data);
-
-                // Copy data from correct byte lane
-                uint32_t copyData;
-                uint32_t currAddr = address + (i*accessSizeBytes);
-                if (accessSize == CSWP_ACCESS_SIZE_8)
-                    copyData = (data >> (8 * (currAddr & 0x3))) & 0xff;
-                else if (accessSize == CSWP_ACCESS_SIZE_16)
-                    copyData = (data >> (8 * (currAddr & 0x2))) & 0xffff;
-                else
-                    copyData = data;
-                copy(&pData[i*accessSizeBytes], &copyData, accessSizeBytes, accessSize);
-            }
-
-            if (res != CSWP_SUCCESS)
-                break;
-
-            /* Copy and mask */
-            for (i = 0; i < size; ++i)
-                valBuf[i] = pData[i] & pMask[i];
-
-            cmpRes = memcmp(valBuf, cmpBuf, size);
-            if (((flags & CSWP_MEM_POLL_MATCH_NE) && (cmpRes != 0)) ||
-                (((flags & CSWP_MEM_POLL_MATCH_NE) == 0) && (cmpRes == 0)))
-            {
-                res = CSWP_SUCCESS;
-                break;
-            }
-            else
-                res = CSWP_MEM_POLL_NO_MATCH;
-
-            if (interval > 0)
-                usleep(interval);
-        }
-        close(fd);
-    }
-    else
-    {
-        /* Use mmap with /dev/mem to get physical memory */
-        fd = open(devPriv->path, O_RDONLY);
-        if (fd < 0)
-        {
-            perror("Open mem failed: ");
-            return CSWP_MEM_FAILED;
-        }
+        /* Each try re-reads the whole range */
+        res = backend->read(priv, devPriv, address, size, accessSize, flags, pData);
+        if (res != CSWP_SUCCESS)
+            break;
 
-        /* mmap requested address range, aligning to page size */
-        /* TODO: limit max mmap size? */
-        pageSize = sysconf(_SC_PAGE_SIZE);
-        pageAddr = address & ~(pageSize - 1);
-        pages = (address + size - pageAddr + pageSize - 1) / pageSize;
-        addr = mmap(NULL, pageSize * pages, PROT_READ,
-                    MAP_SHARED, fd, pageAddr);
-        if (addr == MAP_FAILED)
-        {
-            close(fd);
-            free(cmpBuf);
-            free(valBuf);
-            perror("mmap failed: ");
-            return CSWP_MEM_FAILED;
-        }
+        /* Copy and mask */
+        for (i = 0; i < size; ++i)
+            valBuf[i] = pData[i] & pMask[i];
 
-        while (tries-- > 0)
+        cmpRes = memcmp(valBuf, cmpBuf, size);
+        if (((flags & CSWP_MEM_POLL_MATCH_NE) && (cmpRes != 0)) ||
+            (((flags & CSWP_MEM_POLL_MATCH_NE) == 0) && (cmpRes == 0)))
         {
-            int cmpRes, cpyRes;
-
-            /* Copy from mmapd region */
-            cpyRes = copy(pData, addr + (address - pageAddr), size, accessSize);
-            if (cpyRes != CSWP_SUCCESS)
-                break;
-
-            /* Copy and mask */
-            for (i = 0; i < size; ++i)
-                valBuf[i] = pData[i] & pMask[i];
-
-            cmpRes = memcmp(valBuf, cmpBuf, size);
-            if (((flags & CSWP_MEM_POLL_MATCH_NE) && (cmpRes != 0)) ||
-                (((flags & CSWP_MEM_POLL_MATCH_NE) == 0) && (cmpRes == 0)))
-            {
-                res = CSWP_SUCCESS;
-                break;
-            }
-            else
-                res = CSWP_MEM_POLL_NO_MATCH;
-
-            if (interval > 0)
-                usleep(interval);
+            res = CSWP_SUCCESS;
+            break;
         }
+        else
+            res = CSWP_MEM_POLL_NO_MATCH;
 
-        munmap(addr, pageSize * pages);
-        close(fd);
+        if (interval > 0)
+            usleep(interval);
     }
 
     /* Store or clear read data in priv for future check operations */
@@ -1570,6 +2836,7 @@ const cswp_server_impl_t cswpServerImpl = {
     .clear_devices = cswp_server_impl_clear_devices,
     .device_add = cswp_server_impl_device_add,
     .device_open = cswp_server_impl_device_open,
+    .device_close = cswp_server_impl_device_close,
     .set_config = cswp_server_impl_set_config,
     .get_config = cswp_server_impl_get_config,
     .get_device_capabilities = cswp_server_impl_get_device_capabilities,
@@ -1579,5 +2846,9 @@ const cswp_server_impl_t cswpServerImpl = {
     .mem_read = cswp_server_impl_mem_read,
     .mem_write = cswp_server_impl_mem_write,
     .mem_poll = cswp_server_impl_mem_poll,
-    .log = cswp_server_impl_log
+    .log = cswp_server_impl_log,
+    .register_read_list = cswp_server_impl_reg_read_list,
+    .mem_fill = cswp_server_impl_mem_fill,
+    .mem_checksum = cswp_server_impl_mem_checksum,
+    .mem_search = cswp_server_impl_mem_search
 };
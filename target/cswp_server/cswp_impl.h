@@ -25,4 +25,15 @@ void setup_logging(int level, const char* filename);
 void close_logging();
 void vlog(int level, const char* msg, ...);
 
+/*
+ * Limit on bytes of /dev/mem kept mapped between memory accesses
+ */
+void set_mem_map_budget(size_t bytes);
+
+/*
+ * Load the normal/device memory attribute map for physical memory
+ */
+#define MEM_ATTR_MAP_DEFAULT "/sdf/memory.map"
+int load_mem_attr_map(const char* filename);
+
 #endif // CSWP_IMPL_H
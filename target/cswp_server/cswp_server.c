@@ -18,6 +18,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <unistd.h>
 #include <poll.h>
 #include <signal.h>
@@ -40,12 +41,19 @@
 #define le32_to_cpu(x)  le32toh(x)
 #define le16_to_cpu(x)  le16toh(x)
 
-#define BUFFER_SIZE 32768
+/* USB messages are limited to the default size */
+#define BUFFER_SIZE CSWP_DEFAULT_MESSAGE_SIZE
+
+/* Number of command and response buffers in each pipeline stage */
+#define PIPELINE_DEPTH 4
 
 #define STR_INTERFACE_ "CSWP"
 
 #define PORT "8192"
-#define BACKLOG 1
+#define BACKLOG 8
+
+/* Events handled per epoll_wait() call */
+#define TCP_MAX_EVENTS 16
 
 #define INVALID_FD (-1)
 
@@ -178,6 +186,7 @@ typedef struct
     ssize_t (*read_msg)(int fd, void* buf, size_t sz);
     ssize_t (*write_msg)(int fd, void* buf, ssize_t sz);
     pthread_t cmdThreadId;
+    int pipeline;
 } server_state_t;
 
 server_state_t gServerState = {
@@ -227,116 +236,391 @@ static ssize_t write_msg_usb(int fd, void* buf, ssize_t sz)
     return bytesSent;
 }
 
-static int process_commands(server_state_t* state)
+/*
+ * Read the next command message
+ *
+ * Returns 1 if a command was read, 0 if the client has gone and -1 if
+ * nothing was read but the caller should wait for the next command
+ */
+static int receive_command(server_state_t* state, CSWP_BUFFER* cmd)
 {
-    CSWP_BUFFER* cmd = cswp_buffer_alloc(BUFFER_SIZE);
-    CSWP_BUFFER* rsp = cswp_buffer_alloc(BUFFER_SIZE);
+    cswp_buffer_clear(cmd);
 
-    cswp_server_state_t cswpServer = {0};
+    /* Read command size from bulk OUT endpoint */
+    vlog(V_DEBUG, "Waiting for command\n");
 
-    cswpServer.impl = &cswpServerImpl;
+    ssize_t bytesRead = state->read_msg(state->outFd, cmd->buf, cmd->size);
+    vlog(V_DEBUG, "Read %lu\n", bytesRead);
+    if (bytesRead == -1)
+    {
+        switch (errno)
+        {
+        case ESHUTDOWN:
+            /* USB endpoint has shutdown - e.g. disconnected, go back and wait */
+            /* for next command */
+            return -1;
 
-    vlog(V_INFO, "Command thread start\n");
+        default:
+            fprintf(stderr, "Error reading data from client: %d: %s\n", errno, strerror(errno));
+            return 0;
+        }
+    }
+    else if (bytesRead == 0)
+    {
+        /* Client closed connection and read was cancelled, 0 bytes were read */
+        /* No error occurred during read */
+        vlog(V_INFO, "Read 0 bytes, will try to accept new connection\n");
+        return 0;
+    }
+
+    cmd->used = bytesRead;
+    hex_dump(cmd->buf, cmd->used);
 
-    while (state->active)
+    return 1;
+}
+
+/*
+ * Execute all commands in a message and build the response message
+ */
+static void execute_commands(cswp_server_state_t* cswpServer, CSWP_BUFFER* cmd, CSWP_BUFFER* rsp)
+{
+    /* Check the reported command size matches the amount of data read */
+    cswp_buffer_seek(cmd, 0);
+    uint32_t cmdSize;
+    cswp_buffer_get_uint32(cmd, &cmdSize);
+    vlog(V_DEBUG, "Command size: %lu\n", cmd->used);
+    if (cmdSize != cmd->used)
     {
-        cswp_buffer_clear(cmd);
+        fprintf(stderr, "Warning! expected %u bytes, but read buffer contains %lu\n", cmdSize, cmd->used);
+    }
 
-        /* Read command size from bulk OUT endpoint */
-        vlog(V_DEBUG, "Waiting for command\n");
+    /* Get the rest of the header */
+    varint_t numCmds;
+    uint8_t abortOnError;
+    cswp_buffer_get_varint(cmd, &numCmds);
+    cswp_buffer_get_uint8(cmd, &abortOnError);
+
+    /* Initialise response buffer */
+    cswp_buffer_clear(rsp);
+    /*   reserve space for response size */
+    cswp_buffer_put_uint32(rsp, 0);
+    /*   write number of responses */
+    cswp_buffer_put_varint(rsp, numCmds);
+
+    /* Process command */
+    unsigned c;
+    int res = CSWP_SUCCESS;
+    for (c = 0; c < numCmds && cmd->pos < cmd->used; ++c)
+    {
+        res = cswp_handle_command(cswpServer, cmd, rsp);
+        if (res != CSWP_SUCCESS && abortOnError)
+            break;
+    }
 
-        ssize_t bytesRead = state->read_msg(state->outFd, cmd->buf, cmd->size);
-        vlog(V_DEBUG, "Read %lu\n", bytesRead);
-        if (bytesRead == -1)
-        {
-            switch (errno)
-            {
-            case ESHUTDOWN:
-                /* USB endpoint has shutdown - e.g. disconnected, go back and wait */
-                /* for next command */
-                continue;
+    /* Generate cancelled errors for subsequent commands if abort on error */
+    if (res != CSWP_SUCCESS && abortOnError)
+    {
+        for (; c < numCmds; ++c)
+            cswp_encode_error_response(rsp, 0, CSWP_CANCELLED,
+                                       "Cancelled");
+    }
 
-            default:
-                fprintf(stderr, "Error reading data from client: %d: %s\n", errno, strerror(errno));
-                break;
-            }
-        }
-        else if (bytesRead == 0)
+    vlog(V_DEBUG, "Response size: %lu\n", rsp->used);
+
+    /* Update response size */
+    uint8_t* pLen = rsp->buf;
+    *pLen++ = (rsp->used & 0xFF);
+    *pLen++ = ((rsp->used >> 8) & 0xFF);
+    *pLen++ = ((rsp->used >> 16) & 0xFF);
+    *pLen++ = ((rsp->used >> 24) & 0xFF);
+
+    hex_dump(rsp->buf, rsp->used);
+}
+
+/*
+ * Send a response message
+ */
+static int send_response(server_state_t* state, CSWP_BUFFER* rsp)
+{
+    if (state->write_msg(state->inFd, rsp->buf, rsp->used) == -1)
+    {
+        fprintf(stderr, "write(%d): %s", errno, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Bounded queue of buffers passed between pipeline stages
+ */
+typedef struct
+{
+    CSWP_BUFFER* items[PIPELINE_DEPTH];
+    unsigned head;
+    unsigned count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} buffer_queue_t;
+
+static void buffer_queue_init(buffer_queue_t* q)
+{
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->cond, NULL);
+}
+
+static void buffer_queue_destroy(buffer_queue_t* q)
+{
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+}
+
+/*
+ * Add a buffer to the queue
+ *
+ * Each queue can hold every buffer of its kind, so this never waits
+ */
+static void buffer_queue_push(buffer_queue_t* q, CSWP_BUFFER* buf)
+{
+    pthread_mutex_lock(&q->lock);
+    q->items[(q->head + q->count) % PIPELINE_DEPTH] = buf;
+    q->count++;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Take a buffer from the queue, waiting until one is available
+ *
+ * Returns NULL once the queue is closed and empty
+ */
+static CSWP_BUFFER* buffer_queue_pop(buffer_queue_t* q)
+{
+    CSWP_BUFFER* buf = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed)
+        pthread_cond_wait(&q->cond, &q->lock);
+    if (q->count > 0)
+    {
+        buf = q->items[q->head];
+        q->head = (q->head + 1) % PIPELINE_DEPTH;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return buf;
+}
+
+/*
+ * Take a buffer from the queue if one is available, without waiting
+ */
+static CSWP_BUFFER* buffer_queue_try_pop(buffer_queue_t* q)
+{
+    CSWP_BUFFER* buf = NULL;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->count > 0)
+    {
+        buf = q->items[q->head];
+        q->head = (q->head + 1) % PIPELINE_DEPTH;
+        q->count--;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return buf;
+}
+
+static unsigned buffer_queue_count(buffer_queue_t* q)
+{
+    unsigned count;
+
+    pthread_mutex_lock(&q->lock);
+    count = q->count;
+    pthread_mutex_unlock(&q->lock);
+
+    return count;
+}
+
+static void buffer_queue_close(buffer_queue_t* q)
+{
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/*
+ * Pipeline state
+ *
+ * Command buffers cycle cmdFree -> receive -> cmdReady -> execute -> cmdFree
+ * Response buffers cycle rspFree -> execute -> rspReady -> transmit -> rspFree
+ */
+typedef struct
+{
+    server_state_t* state;
+    buffer_queue_t cmdFree;
+    buffer_queue_t cmdReady;
+    buffer_queue_t rspFree;
+    buffer_queue_t rspReady;
+} pipeline_t;
+
+static void pipeline_stop(pipeline_t* p)
+{
+    buffer_queue_close(&p->cmdFree);
+    buffer_queue_close(&p->cmdReady);
+    buffer_queue_close(&p->rspFree);
+    buffer_queue_close(&p->rspReady);
+}
+
+static void* receive_thread(void* arg)
+{
+    pipeline_t* p = (pipeline_t*)arg;
+    CSWP_BUFFER* cmd;
+    int res;
+
+    while (p->state->active && (cmd = buffer_queue_pop(&p->cmdFree)) != NULL)
+    {
+        do
         {
-            /* Client closed connection and read was cancelled, 0 bytes were read */
-            /* No error occurred during read */
-            vlog(V_INFO, "Read 0 bytes, will try to accept new connection\n");
+            res = receive_command(p->state, cmd);
+        } while (res < 0 && p->state->active);
+
+        if (res <= 0)
             break;
-        }
 
-        cmd->used = bytesRead;
-        hex_dump(cmd->buf, cmd->used);
+        buffer_queue_push(&p->cmdReady, cmd);
+    }
 
-        /* Check the reported command size matches the amount of data read */
-        cswp_buffer_seek(cmd, 0);
-        uint32_t cmdSize;
-        cswp_buffer_get_uint32(cmd, &cmdSize);
-        vlog(V_DEBUG, "Command size: %lu\n", cmd->used);
-        if (cmdSize != cmd->used)
-        {
-            fprintf(stderr, "Warning! expected %u bytes, but read buffer contains %lu\n", cmdSize, cmd->used);
-        }
+    /* Execute stage finishes the commands already received */
+    buffer_queue_close(&p->cmdReady);
 
-        /* Get the rest of the header */
-        varint_t numCmds;
-        uint8_t abortOnError;
-        cswp_buffer_get_varint(cmd, &numCmds);
-        cswp_buffer_get_uint8(cmd, &abortOnError);
-
-        /* Initialise response buffer */
-        cswp_buffer_clear(rsp);
-        /*   reserve space for response size */
-        cswp_buffer_put_uint32(rsp, 0);
-        /*   write number of responses */
-        cswp_buffer_put_varint(rsp, numCmds);
-
-        /* Process command */
-        unsigned c;
-        int res = CSWP_SUCCESS;
-        for (c = 0; c < numCmds && cmd->pos < cmd->used; ++c)
-        {
-            res = cswp_handle_command(&cswpServer, cmd, rsp);
-            if (res != CSWP_SUCCESS && abortOnError)
-                break;
-        }
+    return NULL;
+}
 
-        /* Generate cancelled errors for subsequent commands if abort on error */
-        if (res != CSWP_SUCCESS && abortOnError)
+static void* transmit_thread(void* arg)
+{
+    pipeline_t* p = (pipeline_t*)arg;
+    CSWP_BUFFER* rsp;
+
+    while ((rsp = buffer_queue_pop(&p->rspReady)) != NULL)
+    {
+        if (send_response(p->state, rsp) != 0)
         {
-            for (; c < numCmds; ++c)
-                cswp_encode_error_response(rsp, 0, CSWP_CANCELLED,
-                                           "Cancelled");
+            /* Link has failed so stop all stages */
+            pipeline_stop(p);
+            shutdown(p->state->outFd, SHUT_RDWR);
+            break;
         }
+        buffer_queue_push(&p->rspFree, rsp);
+    }
 
-        vlog(V_DEBUG, "Response size: %lu\n", rsp->used);
+    return NULL;
+}
 
-        /* Update response size */
-        uint8_t* pLen = rsp->buf;
-        *pLen++ = (rsp->used & 0xFF);
-        *pLen++ = ((rsp->used >> 8) & 0xFF);
-        *pLen++ = ((rsp->used >> 16) & 0xFF);
-        *pLen++ = ((rsp->used >> 24) & 0xFF);
+/*
+ * Process commands with receive, execute and transmit in separate stages
+ *
+ * The next request is received while the current one executes and the
+ * previous response is sent.  Responses are still sent in request order.
+ */
+static void process_commands_pipelined(server_state_t* state, cswp_server_state_t* cswpServer)
+{
+    pipeline_t p;
+    CSWP_BUFFER* buffers[2 * PIPELINE_DEPTH];
+    CSWP_BUFFER* cmd;
+    CSWP_BUFFER* rsp;
+    pthread_t rxThread, txThread;
+    unsigned i;
+
+    p.state = state;
+    buffer_queue_init(&p.cmdFree);
+    buffer_queue_init(&p.cmdReady);
+    buffer_queue_init(&p.rspFree);
+    buffer_queue_init(&p.rspReady);
+
+    for (i = 0; i < PIPELINE_DEPTH; ++i)
+    {
+        buffers[2*i] = cswp_buffer_alloc(BUFFER_SIZE);
+        buffers[2*i+1] = cswp_buffer_alloc(BUFFER_SIZE);
+        buffer_queue_push(&p.cmdFree, buffers[2*i]);
+        buffer_queue_push(&p.rspFree, buffers[2*i+1]);
+    }
 
-        hex_dump(rsp->buf, rsp->used);
+    pthread_create(&rxThread, NULL, receive_thread, &p);
+    pthread_create(&txThread, NULL, transmit_thread, &p);
 
-        /* Send response */
-        if (state->write_msg(state->inFd, rsp->buf, rsp->used) == -1)
-        {
-            fprintf(stderr, "write(%d): %s", errno, strerror(errno));
+    while ((cmd = buffer_queue_pop(&p.cmdReady)) != NULL)
+    {
+        rsp = buffer_queue_pop(&p.rspFree);
+        if (rsp == NULL)
             break;
+
+        execute_commands(cswpServer, cmd, rsp);
+
+        buffer_queue_push(&p.rspReady, rsp);
+        buffer_queue_push(&p.cmdFree, cmd);
+    }
+
+    /* Let transmit stage send remaining responses, then stop receive stage */
+    buffer_queue_close(&p.rspReady);
+    pthread_join(txThread, NULL);
+    buffer_queue_close(&p.cmdFree);
+    pthread_join(rxThread, NULL);
+
+    buffer_queue_destroy(&p.cmdFree);
+    buffer_queue_destroy(&p.cmdReady);
+    buffer_queue_destroy(&p.rspFree);
+    buffer_queue_destroy(&p.rspReady);
+
+    for (i = 0; i < 2 * PIPELINE_DEPTH; ++i)
+        cswp_buffer_free(buffers[i]);
+}
+
+static int process_commands(server_state_t* state)
+{
+    cswp_server_state_t cswpServer = {0};
+
+    cswpServer.impl = &cswpServerImpl;
+    cswpServer.maxMessageSize = BUFFER_SIZE;
+
+    vlog(V_INFO, "Command thread start\n");
+
+    if (state->pipeline)
+    {
+        process_commands_pipelined(state, &cswpServer);
+    }
+    else
+    {
+        CSWP_BUFFER* cmd = cswp_buffer_alloc(BUFFER_SIZE);
+        CSWP_BUFFER* rsp = cswp_buffer_alloc(BUFFER_SIZE);
+        int res;
+
+        while (state->active)
+        {
+            res = receive_command(state, cmd);
+            if (res < 0)
+                continue;
+            else if (res == 0)
+                break;
+
+            execute_commands(&cswpServer, cmd, rsp);
+
+            /* Send response */
+            if (send_response(state, rsp) != 0)
+                break;
         }
+
+        cswp_buffer_free(cmd);
+        cswp_buffer_free(rsp);
     }
 
     cswp_server_term(&cswpServer);
 
-    cswp_buffer_free(cmd);
-    cswp_buffer_free(rsp);
-
     vlog(V_INFO, "Command thread exit\n");
     fflush(stdout);
 
@@ -472,6 +756,455 @@ static void ep0_handle(int fd)
     }
 }
 
+/*
+ * TCP client session
+ *
+ * The event loop does all socket I/O and the session's execute thread runs
+ * its requests, so a long request only holds up its own session.  Requests
+ * are read in two steps, first the size header and then the rest of the
+ * message, and passed to the execute thread through the same queues as the
+ * USB pipeline.  With --pipeline each session has PIPELINE_DEPTH command
+ * and response buffers, so further requests are read while one executes
+ * and earlier responses are sent, otherwise it has one of each.  Buffers
+ * start at the default message size and grow up to the size negotiated by
+ * CSWP_INIT.
+ *
+ * Buffers held by the event loop are only touched by the event loop, and
+ * buffers held by the execute thread only by the execute thread.  The
+ * session is freed when both have finished with it.
+ */
+typedef struct
+{
+    int fd;
+    int epollFd;
+    cswp_server_state_t cswpServer;
+    pthread_t execThread;
+    /* Serialises changes to the events watched, and refs */
+    pthread_mutex_t lock;
+    int refs;
+    buffer_queue_t cmdFree;
+    buffer_queue_t cmdReady;
+    buffer_queue_t rspFree;
+    buffer_queue_t rspReady;
+    /* Request being read and response being sent by the event loop */
+    CSWP_BUFFER* cmd;
+    CSWP_BUFFER* rsp;
+    uint32_t cmdSize;
+    size_t rspSent;
+} tcp_session_t;
+
+/*
+ * Watch for the socket events the event loop can act on
+ *
+ * Reads are wanted while a request is part read or a command buffer is
+ * free, and writes while a response is part sent or waiting
+ */
+static void tcp_session_arm(tcp_session_t* session)
+{
+    struct epoll_event ev = {0};
+
+    pthread_mutex_lock(&session->lock);
+    if (session->cmd != NULL || buffer_queue_count(&session->cmdFree) > 0)
+        ev.events |= EPOLLIN;
+    if (session->rsp != NULL || buffer_queue_count(&session->rspReady) > 0)
+        ev.events |= EPOLLOUT;
+    ev.data.ptr = session;
+    epoll_ctl(session->epollFd, EPOLL_CTL_MOD, session->fd, &ev);
+    pthread_mutex_unlock(&session->lock);
+}
+
+/*
+ * Have the event loop look at the session again
+ *
+ * Called by the execute thread when it frees a command buffer or queues a
+ * response.  The event loop then re-arms the session for what it can do.
+ */
+static void tcp_session_wake(tcp_session_t* session)
+{
+    struct epoll_event ev = {0};
+
+    pthread_mutex_lock(&session->lock);
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = session;
+    epoll_ctl(session->epollFd, EPOLL_CTL_MOD, session->fd, &ev);
+    pthread_mutex_unlock(&session->lock);
+}
+
+/*
+ * Grow a session buffer to hold size bytes
+ */
+static int tcp_session_grow(CSWP_BUFFER** pBuf, size_t size)
+{
+    CSWP_BUFFER* newBuf;
+
+    if ((*pBuf)->size >= size)
+        return 0;
+
+    newBuf = cswp_buffer_realloc(*pBuf, size);
+    if (newBuf == NULL)
+    {
+        fprintf(stderr, "Failed to allocate %lu byte buffer\n", (unsigned long)size);
+        return -1;
+    }
+    *pBuf = newBuf;
+
+    return 0;
+}
+
+static void tcp_session_free(tcp_session_t* session)
+{
+    buffer_queue_t* queues[4] = {
+        &session->cmdFree, &session->cmdReady, &session->rspFree, &session->rspReady
+    };
+    CSWP_BUFFER* buf;
+    unsigned q;
+
+    for (q = 0; q < 4; ++q)
+    {
+        while ((buf = buffer_queue_try_pop(queues[q])) != NULL)
+            cswp_buffer_free(buf);
+        buffer_queue_destroy(queues[q]);
+    }
+    pthread_mutex_destroy(&session->lock);
+    free(session);
+}
+
+/*
+ * Drop the event loop's or execute thread's hold on the session, closing
+ * the socket and freeing the session when neither needs it
+ */
+static void tcp_session_release(tcp_session_t* session)
+{
+    int refs;
+
+    pthread_mutex_lock(&session->lock);
+    refs = --session->refs;
+    pthread_mutex_unlock(&session->lock);
+
+    if (refs == 0)
+    {
+        close(session->fd);
+        tcp_session_free(session);
+    }
+}
+
+/*
+ * Session execute thread
+ *
+ * Runs until the event loop closes the session
+ */
+static void* tcp_session_thread(void* arg)
+{
+    tcp_session_t* session = (tcp_session_t*)arg;
+    CSWP_BUFFER* cmd;
+    CSWP_BUFFER* rsp;
+
+    while ((cmd = buffer_queue_pop(&session->cmdReady)) != NULL)
+    {
+        rsp = buffer_queue_pop(&session->rspFree);
+        if (rsp == NULL)
+        {
+            buffer_queue_push(&session->cmdFree, cmd);
+            break;
+        }
+
+        if (tcp_session_grow(&rsp, session->cswpServer.messageSize) != 0)
+        {
+            /* Drop the request, the client will time out */
+            buffer_queue_push(&session->rspFree, rsp);
+        }
+        else
+        {
+            execute_commands(&session->cswpServer, cmd, rsp);
+            buffer_queue_push(&session->rspReady, rsp);
+        }
+
+        cswp_buffer_clear(cmd);
+        buffer_queue_push(&session->cmdFree, cmd);
+        tcp_session_wake(session);
+    }
+
+    cswp_server_term(&session->cswpServer);
+    tcp_session_release(session);
+
+    return NULL;
+}
+
+static tcp_session_t* tcp_session_open(int epollFd, int fd, int depth)
+{
+    tcp_session_t* session;
+    struct epoll_event ev = {0};
+    CSWP_BUFFER* buf;
+    int flags;
+    int i;
+
+    session = calloc(1, sizeof(tcp_session_t));
+    if (session == NULL)
+        return NULL;
+
+    flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    session->fd = fd;
+    session->epollFd = epollFd;
+    session->refs = 2;
+    session->cswpServer.impl = &cswpServerImpl;
+    session->cswpServer.maxMessageSize = CSWP_MAX_MESSAGE_SIZE;
+    pthread_mutex_init(&session->lock, NULL);
+    buffer_queue_init(&session->cmdFree);
+    buffer_queue_init(&session->cmdReady);
+    buffer_queue_init(&session->rspFree);
+    buffer_queue_init(&session->rspReady);
+
+    for (i = 0; i < 2 * depth; ++i)
+    {
+        buf = cswp_buffer_alloc(BUFFER_SIZE);
+        if (buf == NULL)
+            break;
+        buffer_queue_push((i & 1) ? &session->rspFree : &session->cmdFree, buf);
+    }
+
+    /* fd is closed by the caller on failure */
+    ev.events = EPOLLIN;
+    ev.data.ptr = session;
+    if (i < 2 * depth ||
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1)
+    {
+        tcp_session_free(session);
+        return NULL;
+    }
+
+    if (pthread_create(&session->execThread, NULL, tcp_session_thread, session) != 0)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        tcp_session_free(session);
+        return NULL;
+    }
+    pthread_detach(session->execThread);
+
+    return session;
+}
+
+/*
+ * Stop serving a session
+ *
+ * Requests not yet started are dropped.  The execute thread finishes any
+ * request it is running, so the session may still be in use by it, but the
+ * event loop must not use the session after this.
+ */
+static void tcp_session_close(tcp_session_t* session)
+{
+    CSWP_BUFFER* cmd;
+
+    vlog(V_INFO, "Closing session %d\n", session->fd);
+
+    pthread_mutex_lock(&session->lock);
+    epoll_ctl(session->epollFd, EPOLL_CTL_DEL, session->fd, NULL);
+    pthread_mutex_unlock(&session->lock);
+    shutdown(session->fd, SHUT_RDWR);
+
+    /* Return buffers so the execute thread can free them */
+    if (session->cmd != NULL)
+        buffer_queue_push(&session->cmdFree, session->cmd);
+    if (session->rsp != NULL)
+        buffer_queue_push(&session->rspFree, session->rsp);
+    while ((cmd = buffer_queue_try_pop(&session->cmdReady)) != NULL)
+        buffer_queue_push(&session->cmdFree, cmd);
+
+    buffer_queue_close(&session->cmdFree);
+    buffer_queue_close(&session->rspReady);
+    buffer_queue_close(&session->rspFree);
+    buffer_queue_close(&session->cmdReady);
+
+    tcp_session_release(session);
+}
+
+/*
+ * Send waiting responses until the socket will take no more
+ *
+ * Returns 0 to keep the session open and -1 to close it
+ */
+static int tcp_session_send(tcp_session_t* session)
+{
+    ssize_t written;
+
+    while (1)
+    {
+        if (session->rsp == NULL)
+        {
+            session->rsp = buffer_queue_try_pop(&session->rspReady);
+            if (session->rsp == NULL)
+                return 0;
+            session->rspSent = 0;
+        }
+
+        while (session->rspSent < session->rsp->used)
+        {
+            written = write(session->fd, session->rsp->buf + session->rspSent,
+                            session->rsp->used - session->rspSent);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                    return 0;
+                fprintf(stderr, "write(%d): %s\n", errno, strerror(errno));
+                return -1;
+            }
+            session->rspSent += written;
+        }
+
+        buffer_queue_push(&session->rspFree, session->rsp);
+        session->rsp = NULL;
+    }
+}
+
+/*
+ * Read requests and pass them to the execute thread until the socket has
+ * no more data or no command buffer is free
+ *
+ * Returns 0 to keep the session open and -1 to close it
+ */
+static int tcp_session_receive(tcp_session_t* session)
+{
+    CSWP_BUFFER* cmd;
+    size_t want;
+    ssize_t bytesRead;
+
+    while (1)
+    {
+        if (session->cmd == NULL)
+        {
+            /* Wait for the execute thread to free a buffer */
+            session->cmd = buffer_queue_try_pop(&session->cmdFree);
+            if (session->cmd == NULL)
+                return 0;
+        }
+
+        cmd = session->cmd;
+        want = (cmd->used < 4) ? 4 : session->cmdSize;
+        bytesRead = read(session->fd, cmd->buf + cmd->used, want - cmd->used);
+        if (bytesRead < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            fprintf(stderr, "Error reading data from client: %d: %s\n", errno, strerror(errno));
+            return -1;
+        }
+        else if (bytesRead == 0)
+        {
+            vlog(V_INFO, "Session %d closed by client\n", session->fd);
+            return -1;
+        }
+        cmd->used += bytesRead;
+
+        if (cmd->used == 4)
+        {
+            session->cmdSize = cmd->buf[0] | (cmd->buf[1] << 8) |
+                (cmd->buf[2] << 16) | ((uint32_t)cmd->buf[3] << 24);
+            if (session->cmdSize < 4 || session->cmdSize > session->cswpServer.maxMessageSize)
+            {
+                fprintf(stderr, "Bad command size %u from session %d\n", session->cmdSize, session->fd);
+                return -1;
+            }
+            if (tcp_session_grow(&session->cmd, session->cmdSize) != 0)
+                return -1;
+            cmd = session->cmd;
+        }
+
+        if (cmd->used < 4 || cmd->used < session->cmdSize)
+            continue;
+
+        hex_dump(cmd->buf, cmd->used);
+        buffer_queue_push(&session->cmdReady, cmd);
+        session->cmd = NULL;
+    }
+}
+
+/*
+ * Serve TCP sessions until the listening socket fails
+ */
+static void tcp_event_loop(int sockfd, int depth)
+{
+    struct epoll_event ev = {0};
+    struct epoll_event events[TCP_MAX_EVENTS];
+    struct sockaddr_storage theirs;
+    tcp_session_t* session;
+    int epollFd;
+    int count;
+    int res;
+    int e;
+
+    epollFd = epoll_create1(0);
+    if (epollFd == INVALID_FD)
+    {
+        fprintf(stderr, "epoll_create1 errno=%d: %s\n", errno, strerror(errno));
+        return;
+    }
+
+    /* Listening socket is identified by a NULL session */
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, sockfd, &ev);
+
+    while (1)
+    {
+        vlog(V_DEBUG, "Waiting for events...\n");
+
+        count = epoll_wait(epollFd, events, TCP_MAX_EVENTS, -1);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "epoll_wait errno=%d: %s\n", errno, strerror(errno));
+            break;
+        }
+
+        for (e = 0; e < count; ++e)
+        {
+            session = events[e].data.ptr;
+            if (session == NULL)
+            {
+                socklen_t sinSz = sizeof(theirs);
+                int newfd = accept(sockfd, (struct sockaddr*)&theirs, &sinSz);
+                if (newfd == INVALID_FD)
+                {
+                    int err = errno;
+                    fprintf(stderr, "accept errno=%d: %s\n", err, strerror(err));
+                    continue;
+                }
+
+                char s[INET_ADDRSTRLEN] = {0};
+                inet_ntop(theirs.ss_family, get_in_addr((struct sockaddr*)&theirs), s, sizeof(s));
+                vlog(V_INFO, "Got connection from %s, session %d\n", s, newfd);
+
+                if (tcp_session_open(epollFd, newfd, depth) == NULL)
+                {
+                    fprintf(stderr, "Failed to open session for %s\n", s);
+                    close(newfd);
+                }
+                continue;
+            }
+
+            /* A hung up client cannot take its responses */
+            res = (events[e].events & (EPOLLHUP | EPOLLERR)) ? -1 : 0;
+            if (res == 0 && (events[e].events & EPOLLOUT))
+                res = tcp_session_send(session);
+            if (res == 0 && (events[e].events & EPOLLIN))
+                res = tcp_session_receive(session);
+
+            if (res < 0)
+                tcp_session_close(session);
+            else
+                tcp_session_arm(session);
+        }
+    }
+
+    close(epollFd);
+}
+
 static int tcp_init(void)
 {
     struct addrinfo hints = {0}, *res = 0;
@@ -542,6 +1275,7 @@ int main(int argc, char **argv)
     int a;
     const char* logFile = 0;
     const char* transport = "";
+    const char* memMapFile = MEM_ATTR_MAP_DEFAULT;
 
     int verbose = 0;
 
@@ -563,10 +1297,26 @@ int main(int argc, char **argv)
             transport = argv[a+1];
             ++a;
         }
+        else if (strcmp("--map-budget", argv[a]) == 0 &&
+                 a < argc-1)
+        {
+            set_mem_map_budget(strtoul(argv[a+1], NULL, 0));
+            ++a;
+        }
+        else if (strcmp("--pipeline", argv[a]) == 0)
+            gServerState.pipeline = 1;
+        else if (strcmp("--mem-map", argv[a]) == 0 &&
+                 a < argc-1)
+        {
+            memMapFile = argv[a+1];
+            ++a;
+        }
     }
 
     setup_logging(verbose, logFile);
 
+    load_mem_attr_map(memMapFile);
+
     vlog(V_INFO, "CSWP %s server\n", transport);
 
     if (strcasecmp(transport, "usb") == 0)
@@ -596,47 +1346,7 @@ int main(int argc, char **argv)
             exit(EXIT_FAILURE);
         }
 
-        struct sockaddr_storage theirs = {0};
-        while (1)
-        {
-            vlog(V_DEBUG, "Waiting for connections...\n");
-
-            socklen_t sinSz = sizeof(theirs);
-            int newfd = accept(sockfd, &theirs, &sinSz);
-            if (newfd == INVALID_FD)
-            {
-                int err = errno;
-                if (err == ETIMEDOUT)
-                {
-                    vlog(V_INFO, "Timeout during accept, will retry\n");
-                }
-                else
-                {
-                    fprintf("accept errno=%d: %s\n", err, strerror(err));
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            char s[INET_ADDRSTRLEN] = {0};
-            inet_ntop(theirs.ss_family, get_in_addr(&theirs), s, sizeof(s));
-            vlog(V_INFO, "Got connection from %s\n", s);
-
-            if (gServerState.active == 0)
-            {
-                gServerState.outFd = newfd;
-                gServerState.inFd = newfd;
-                gServerState.read_msg = cswp_read_msg_tcp;
-                gServerState.write_msg = cswp_write_msg_tcp;
-            }
-
-            gServerState.active = 1;
-
-            process_commands(&gServerState);
-
-            close(newfd);
-            gServerState.active = 0;
-            gServerState.inFd = gServerState.outFd = INVALID_FD;
-        }
+        tcp_event_loop(sockfd, gServerState.pipeline ? PIPELINE_DEPTH : 1);
 
         close(sockfd);
     }
@@ -105,6 +105,12 @@ void TCPDevice::write(const void* data, size_t sz)
         throwEx("write", SOCKERR);
 }
 
+void TCPDevice::writev(const cswp_tcp_segment_t* seg, int count)
+{
+    if (cswp_writev_msg_tcp(m_sockfd, seg, count) == -1)
+        throwEx("writev", SOCKERR);
+}
+
 size_t TCPDevice::read(void* data, size_t sz)
 {
     ssize_t bytesRead = cswp_read_msg_tcp(m_sockfd, data, sz);
@@ -116,6 +122,17 @@ size_t TCPDevice::read(void* data, size_t sz)
     return static_cast<size_t>(bytesRead);
 }
 
+size_t TCPDevice::readv(const cswp_tcp_segment_t* seg, int count)
+{
+    ssize_t bytesRead = cswp_readv_msg_tcp(m_sockfd, seg, count);
+    if (bytesRead == -1)
+        throwEx("read", SOCKERR);
+    else if (bytesRead == 0)
+        throw TransportException("Error during read, connection was shut down on other end");
+
+    return static_cast<size_t>(bytesRead);
+}
+
 void TCPDevice::disconnect()
 {
     close(m_sockfd);
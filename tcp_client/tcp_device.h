@@ -8,6 +8,8 @@
 
 #include <cstdlib>
 
+#include "common_tcp.h"
+
 /**
  * TCP device interface
  */
@@ -33,7 +35,9 @@ public:
     void disconnect();
 
     void write(const void*, size_t);
+    void writev(const cswp_tcp_segment_t* seg, int count);
     size_t read(void* data, size_t sz);
+    size_t readv(const cswp_tcp_segment_t* seg, int count);
 
 private:
     int m_sockfd;
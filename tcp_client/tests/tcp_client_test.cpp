@@ -52,6 +52,7 @@ int getaddrinfo_nice_obj(PCSTR a, PCSTR b, const void* c, void** d)
 }
 
 #else // linux
+#include <sys/uio.h>
 
 extern "C"
 {
@@ -59,6 +60,7 @@ FAKE_VALUE_FUNC(int, socket, int, int, int);
 FAKE_VALUE_FUNC(int, connect, int, void*, socklen_t);
 FAKE_VALUE_FUNC(ssize_t, read, int, void*, size_t);
 FAKE_VALUE_FUNC(ssize_t, write, int, const void*, size_t);
+FAKE_VALUE_FUNC(ssize_t, writev, int, const struct iovec*, int);
 }
 #endif
 
@@ -115,5 +117,14 @@ TEST_CASE("TCPDevice::TCPDevice")
 
     write_fake.return_val = -1;
     REQUIRE_THROWS(tcp.write(NULL, len));
+
+#ifndef _WIN32
+    cswp_tcp_segment_t seg = { buf, len };
+    writev_fake.return_val = len;
+    tcp.writev(&seg, 1);
+
+    writev_fake.return_val = -1;
+    REQUIRE_THROWS(tcp.writev(&seg, 1));
+#endif
 }
 